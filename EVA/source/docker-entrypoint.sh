@@ -28,6 +28,17 @@ function run_cpp_benchmark() {
 }
 
 
+# JSON-lines result records of all application benchmarks
+export RESULTS_FILENAME=${EVA_DIR}/eva_results.jsonl
+
+# Keys generated by the first run of a benchmark are stored and loaded by all
+# further runs (optional), the results record t_keygen vs. t_key_load and the
+# CSV files leave t_keygen empty for runs that loaded their keys
+if [ -n "${KEY_STORE}" ]
+then
+    export KEY_STORE_DIR=${EVA_DIR}/keys
+fi
+
 # MLP
 export OUTPUT_FILENAME=eva_mlp_nn.csv
 run_cpp_benchmark runtime /root/eval/nn-mlp/mlp
@@ -51,3 +62,5 @@ cd /root/eval/chi_squared \
     && python3 -m pip install -r requirements.txt \
     && python3 chi_squared.py
 upload_files EVA ${OUTPUT_FILENAME}
+
+upload_files EVA ${RESULTS_FILENAME}
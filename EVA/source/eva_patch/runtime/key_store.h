@@ -0,0 +1,128 @@
+#ifndef KEY_STORE_H_
+#define KEY_STORE_H_
+
+#include "eva/eva.h"
+#include <unistd.h>
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <variant>
+
+#include "key_store_base.h"
+
+/*
+ * On-disk cache of the keys of an EVA program, so that repeated runs
+ * (NUM_RUNS) load the keys instead of generating them again.
+ *
+ * This is the EVA counterpart of SEAL's key store (SEAL/source/key_store.h)
+ * and uses the same directory (KEY_STORE_DIR). Keys are stored per
+ * fingerprint of the CKKS parameters, i.e., the polynomial modulus degree,
+ * the prime bits and the rotation steps of the Galois keys, as two files,
+ * keys-<fingerprint>.public.eva and keys-<fingerprint>.secret.eva, in EVA's
+ * serialization format. EVA only loads its SEAL contexts through its own
+ * (protobuf) serialization, so a warm run parses the files rather than
+ * mapping them. The secret part is written last, so that concurrent runs never
+ * see a partial pair. The directory, the fingerprint hash, and the atomic
+ * writes are shared with the SEAL and TFHE key stores
+ * (shared/key_store_base.h).
+ *
+ * The store holds secret keys in plain; it is meant for benchmarking only.
+ */
+
+struct KeySet {
+  std::unique_ptr<eva::SEALPublic> public_key;
+  std::unique_ptr<eva::SEALSecret> secret_key;
+
+  /// whether the keys were loaded from the store rather than generated
+  bool loaded = false;
+};
+
+class KeyStore : public KeyStoreBase {
+ public:
+  static constexpr std::uint32_t version = 1;
+
+  using KeyStoreBase::KeyStoreBase;
+
+  /// Store in the directory given by the env var, disabled if it is unset.
+  static KeyStore from_env(const char *env_var = "KEY_STORE_DIR") {
+    return KeyStore(directory_from_env(env_var));
+  }
+
+  /// FNV-1a hash of the parameters the keys are generated for.
+  static std::uint64_t fingerprint(const eva::CKKSParameters &params) {
+    Fingerprint hash;
+    hash.mix(version);
+    hash.mix(params.polyModulusDegree);
+    hash.mix(params.primeBits.size());
+    for (int bits : params.primeBits) hash.mix(static_cast<std::int64_t>(bits));
+    hash.mix(params.rotations.size());
+    for (int step : params.rotations) hash.mix(static_cast<std::int64_t>(step));
+    return hash.value();
+  }
+
+  /// File holding the given part (public or secret) of the keys.
+  std::string path(const eva::CKKSParameters &params, const char *name) const {
+    return key_file(fingerprint(params), std::string(".") + name + ".eva");
+  }
+
+  /// Loads the keys from the store, or generates them and, if the store is
+  /// enabled, adds them to it.
+  KeySet get(const eva::CKKSParameters &params) const {
+    if (enabled()) {
+      KeySet keys;
+      if (load(params, keys)) return keys;
+    }
+    KeySet keys;
+    std::tie(keys.public_key, keys.secret_key) = eva::generateKeys(params);
+    if (enabled()) store(params, keys);
+    return keys;
+  }
+
+  /// Loads the keys into keys, false if the store holds no (valid) pair.
+  bool load(const eva::CKKSParameters &params, KeySet &keys) const {
+    const std::string public_file = path(params, "public");
+    const std::string secret_file = path(params, "secret");
+    if (access(public_file.c_str(), R_OK) != 0 ||
+        access(secret_file.c_str(), R_OK) != 0) {
+      return false;
+    }
+    try {
+      keys.public_key = load_part<eva::SEALPublic>(public_file);
+      keys.secret_key = load_part<eva::SEALSecret>(secret_file);
+    } catch (const std::exception &) {
+      // e.g., a file of an older EVA version, regenerated by the caller
+      keys.public_key.reset();
+      keys.secret_key.reset();
+    }
+    keys.loaded = keys.public_key && keys.secret_key;
+    return keys.loaded;
+  }
+
+  /// Writes the keys into the store.
+  void store(const eva::CKKSParameters &params, const KeySet &keys) const {
+    create_directory();
+    store_part(*keys.public_key, path(params, "public"));
+    store_part(*keys.secret_key, path(params, "secret"));
+  }
+
+ private:
+  /// The object of type T in the file, nullptr if it holds another type.
+  template <typename T>
+  static std::unique_ptr<T> load_part(const std::string &filename) {
+    auto known = eva::loadFromFile(filename);
+    auto part = std::get_if<std::unique_ptr<T>>(&known);
+    return part ? std::move(*part) : nullptr;
+  }
+
+  template <typename T>
+  static void store_part(const T &part, const std::string &filename) {
+    write_file(filename, [&](const std::string &tmp_filename) {
+      eva::saveToFile(part, tmp_filename);
+    });
+  }
+};
+
+#endif
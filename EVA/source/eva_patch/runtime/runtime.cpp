@@ -2,6 +2,9 @@
 #include <chrono>
 #include <iostream>
 
+#include "key_store.h"
+#include "result_record.h"
+
 using namespace eva;
 using namespace std;
 
@@ -23,6 +26,7 @@ int main(int argc, char *argv[]) {
   }
 
   stringstream ss_time;
+  ResultRecord record("eva-runtime");
 
   cout << "Loading Program" << endl;
   auto kt_program = loadFromFile(path + ".eva");
@@ -35,9 +39,12 @@ int main(int argc, char *argv[]) {
 
   cout << "Generating Keys" << endl;
   auto t0 = Time::now();
-  auto [public_key, secret_key] = generateKeys(*params);
+  KeySet keys = KeyStore::from_env().get(*params);
+  auto &public_key = keys.public_key;
+  auto &secret_key = keys.secret_key;
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  ss_time << KeyStore::keygen_column(keys.loaded, t1 - t0) << ",";
+  record.add_timing(KeyStore::timing_name(keys.loaded), t1 - t0);
 
   cout << "Encrypting Inputs" << endl;
   // TODO: Proper inputs from args/cin
@@ -46,18 +53,21 @@ int main(int argc, char *argv[]) {
   auto encrypted_inputs = public_key->encrypt(inputs, *signature);
   auto t3 = Time::now();
   log_time(ss_time, t2, t3, false);
+  record.add_timing("t_input_encryption", t3 - t2);
 
   cout << "Executing Program" << endl;
   auto t4 = Time::now();
   auto encrypted_result = public_key->execute(*program, encrypted_inputs);
   auto t5 = Time::now();
   log_time(ss_time, t4, t5, false);
+  record.add_timing("t_computation", t5 - t4);
 
   cout << "Decrypting Result" << endl;
   auto t6 = Time::now();
   auto result = secret_key->decrypt(encrypted_result, *signature);
   auto t7 = Time::now();
   log_time(ss_time, t6, t7, true);
+  record.add_timing("t_decryption", t7 - t6);
 
   for (double d : result["output"]) {
     cout << "[" << d << "]";
@@ -91,4 +101,14 @@ int main(int argc, char *argv[]) {
   myfile.open(out_filename, std::ios_base::app);
   myfile << ss_time.str() << std::endl;
   myfile.close();
+
+  // write a self-describing record into RESULTS_FILENAME
+  record.set_parameter("library", "EVA");
+  record.set_parameter("scheme", "CKKS");
+  record.set_parameter("program", path);
+  record.set_parameter("vec_size", signature->vecSize);
+  record.set_parameter("poly_modulus_degree", params->polyModulusDegree);
+  record.set_parameter("coeff_modulus_bits", params->primeBits);
+  record.set_metric("mse", mse);
+  record.write();
 }
\ No newline at end of file
@@ -15,10 +15,14 @@
 // operations that can be performed on both ciphertexts
 // and plaintexts.
 
+#include <functional>
 #include <iostream>
+#include <sstream>
 
 #include <helib/helib.h>
 
+#include "perf_counters.h"
+
 int main(int argc, char* argv[])
 {
   /*  Example of BGV scheme  */
@@ -95,10 +99,23 @@ int main(int argc, char* argv[])
   // Print the plaintext
   std::cout << "Initial Plaintext: " << ptxt << std::endl;
 
+  // Hardware counters of each homomorphic operation (only recorded if the
+  // environment variable PERF_COUNTERS is set)
+  PerfCounters counters;
+  std::stringstream ss_perf;
+  auto count = [&](const std::string& operation,
+                   const std::function<void()>& op) {
+    counters.reset();
+    counters.start();
+    op();
+    counters.stop();
+    write_perf_counters_row(ss_perf, operation, counters.mean());
+  };
+
   // Create a ciphertext object
   helib::Ctxt ctxt(public_key);
   // Encrypt the plaintext using the public_key
-  public_key.Encrypt(ctxt, ptxt);
+  count("encrypt_pk", [&]() { public_key.Encrypt(ctxt, ptxt); });
 
   /********** Operations **********/
   // Ciphertext and plaintext operations are performed
@@ -107,7 +124,7 @@ int main(int argc, char* argv[])
   // Square the ciphertext
   // [0] [1] [2] [3] [4] ... [nslots-1]
   // -> [0] [1] [4] [9] [16] ... [(nslots-1)*(nslots-1)]
-  ctxt.multiplyBy(ctxt);
+  count("square", [&]() { ctxt.multiplyBy(ctxt); });
   // Plaintext version
   ptxt.multiplyBy(ptxt);
 
@@ -120,9 +137,9 @@ int main(int argc, char* argv[])
   // Raise the copy to the exponent p-2
   // [0] [1] [4] ... [16] -> [0] [1] [1] ... [1]
   // Note: 0 is a special case because 0^n = 0 for any power n
-  ctxt_divisor.power(p - 2);
+  count("power", [&]() { ctxt_divisor.power(p - 2); });
   // a^{p-2}*a = a^{-1}*a = a / a = 1;
-  ctxt.multiplyBy(ctxt_divisor);
+  count("mul_ct_ct", [&]() { ctxt.multiplyBy(ctxt_divisor); });
 
   // Plaintext version
   helib::Ptxt<helib::BGV> ptxt_divisor(ptxt);
@@ -131,20 +148,20 @@ int main(int argc, char* argv[])
 
   // Double it (using additions)
   // [0] [1] [1] ... [1] [1] -> [0] [2] [2] ... [2] [2]
-  ctxt += ctxt;
+  count("add_ct_ct", [&]() { ctxt += ctxt; });
   // Plaintext version
   ptxt += ptxt;
 
   // Subtract it from itself (result should be 0)
   // i.e. [0] [0] [0] [0] ... [0] [0]
-  ctxt -= ctxt;
+  count("sub_ct_ct", [&]() { ctxt -= ctxt; });
   // Plaintext version
   ptxt -= ptxt;
 
   // Create a plaintext for decryption
   helib::Ptxt<helib::BGV> plaintext_result(context);
   // Decrypt the modified ciphertext
-  secret_key.Decrypt(plaintext_result, ctxt);
+  count("decrypt", [&]() { secret_key.Decrypt(plaintext_result, ctxt); });
 
   std::cout << "Operation: 2(a*a)/(a*a) - 2(a*a)/(a*a) = 0" << std::endl;
   // Print the decrypted plaintext
@@ -155,14 +172,14 @@ int main(int argc, char* argv[])
 
   // We can also add constants
   // [0] [0] [0] ... [0] [0] -> [1] [1] [1] ... [1] [1]
-  ctxt.addConstant(NTL::ZZX(1l));
+  count("add_ct_const", [&]() { ctxt.addConstant(NTL::ZZX(1l)); });
   // Plaintext version
   ptxt.addConstant(NTL::ZZX(1l));
 
   // And multiply by constants
   // [1] [1] [1] ... [1] [1]
   // -> [1*1] [1*1] [1*1] ... [1*1] [1*1] = [1] [1] [1] ... [1] [1]
-  ctxt *= NTL::ZZX(1l);
+  count("mul_ct_const", [&]() { ctxt *= NTL::ZZX(1l); });
   // Plaintext version
   ptxt *= NTL::ZZX(1l);
 
@@ -170,7 +187,7 @@ int main(int argc, char* argv[])
   // ctxt = [1] [1] [1] ... [1] [1], ptxt = [1] [1] [1] ... [1] [1]
   // ctxt + ptxt = [2] [2] [2] ... [2] [2]
   // Note: the output of this is also a ciphertext
-  ctxt += ptxt;
+  count("add_ct_pt", [&]() { ctxt += ptxt; });
 
   // Decrypt the modified ciphertext into a new plaintext
   helib::Ptxt<helib::BGV> new_plaintext_result(context);
@@ -181,5 +198,11 @@ int main(int argc, char* argv[])
   // Should be [2] [2] [2] ... [2] [2]
   std::cout << "Decrypted Result: " << new_plaintext_result << std::endl;
 
+  // Write the hardware counters into PERF_FILENAME
+  if (counters.is_enabled()) {
+    append_perf_counters_file("perf_counters_microbenchmark_helib.csv",
+                              ss_perf.str());
+  }
+
   return 0;
 }
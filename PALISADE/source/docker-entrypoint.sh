@@ -16,14 +16,23 @@ cd /root/eval \
     && make
 
 # Run microbenchmarks
+# (setting PERF_COUNTERS additionally records hardware counters of the timed
+# regions; as only the calling thread is counted, also set OMP_NUM_THREADS=1)
 export OUTPUT_FILENAME=palisade_microbenchmark-bfv-bgv.csv
+export PERF_FILENAME=palisade_microbenchmark-bfv-bgv_perf.csv
 ./microbenchmark-bfv-bgv
 upload_files PALISADE-BFV-BGV ${OUTPUT_FILENAME} fhe_parameters_microbenchmark_bfv_bgv.txt
+if [ -n "${PERF_COUNTERS}" ]; then upload_files PALISADE-BFV-BGV ${PERF_FILENAME}; fi
 
 export OUTPUT_FILENAME=palisade_microbenchmark-ckks.csv
+export PERF_FILENAME=palisade_microbenchmark-ckks_perf.csv
 ./microbenchmark-ckks
 upload_files PALISADE-CKKS ${OUTPUT_FILENAME} fhe_parameters_microbenchmark_ckks.txt
+if [ -n "${PERF_COUNTERS}" ]; then upload_files PALISADE-CKKS ${PERF_FILENAME}; fi
 
 export OUTPUT_FILENAME=palisade_microbenchmark-fhew.csv
+export PERF_FILENAME=palisade_microbenchmark-fhew_perf.csv
 ./microbenchmark-fhew
 upload_files PALISADE-FHEW ${OUTPUT_FILENAME}
+if [ -n "${PERF_COUNTERS}" ]; then upload_files PALISADE-FHEW ${PERF_FILENAME}; fi
+unset PERF_FILENAME
@@ -8,6 +8,8 @@
 #include "cryptocontextgen.h"
 #include "palisade.h"
 
+#include "perf_counters.h"
+
 using namespace std;
 using namespace lbcrypto;
 
@@ -89,12 +91,17 @@ int main(int argc, char *argv[]) {
   const int NUM_REPETITIONS{100};
   std::stringstream ss_time;
 
+  // hardware counters of the timed regions (only if PERF_COUNTERS is set)
+  PerfCounters counters;
+  std::stringstream ss_perf;
+
   // =======================================================
   // Ctxt-Ctxt Multiplication with new ciphertext
   // =======================================================
 
   std::cout << "== Ctxt-Ctxt Multiplication with new ciphertext" << std::endl;
   size_t total_time = 0;
+  counters.reset();
 
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({14});
@@ -103,13 +110,16 @@ int main(int argc, char *argv[]) {
     auto pb = cryptoContext->MakeCKKSPackedPlaintext({28});
     auto cb = cryptoContext->Encrypt(keyPair.publicKey, pb);
 
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ciphertextMult = cryptoContext->EvalMultAndRelinearize(ca, cb);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_mul_ct_ct", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -125,19 +135,23 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Ctxt-Ptxt Multiplication with new ciphertext" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({214});
     auto ca = cryptoContext->Encrypt(keyPair.publicKey, pa);
 
     auto pb = cryptoContext->MakeCKKSPackedPlaintext({28});
 
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ciphertextMult = cryptoContext->EvalMult(ca, pb);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_mul_ct_pt", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -153,6 +167,7 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Ctxt-Ctxt Addition time with new ciphertext" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({214});
     auto ca = cryptoContext->Encrypt(keyPair.publicKey, pa);
@@ -160,13 +175,16 @@ int main(int argc, char *argv[]) {
     auto pb = cryptoContext->MakeCKKSPackedPlaintext({28});
     auto cb = cryptoContext->Encrypt(keyPair.publicKey, pb);
 
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     cryptoContext->EvalAdd(ca, cb);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_add_ct_ct", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -182,19 +200,23 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Ctxt-Ptxt Addition with new ciphertext" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({214});
     auto ca = cryptoContext->Encrypt(keyPair.publicKey, pa);
 
     auto pb = cryptoContext->MakeCKKSPackedPlaintext({28});
 
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ciphertextMult = cryptoContext->EvalAdd(pb, ca);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_add_ct_pt", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -210,15 +232,19 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Sk Encryption time" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({3213});
     cryptoContext->Encrypt(keyPair.publicKey, pa);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_enc_sk", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -227,15 +253,19 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Pk Encryption time" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({3213});
     cryptoContext->Encrypt(keyPair.secretKey, pa);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_enc_pk", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -244,18 +274,22 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Decryption time" << std::endl;
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
     auto pa = cryptoContext->MakeCKKSPackedPlaintext({3213});
     auto ca = cryptoContext->Encrypt(keyPair.publicKey, pa);
 
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     Plaintext ptxt;
     cryptoContext->Decrypt(keyPair.secretKey, ca, &ptxt);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_dec", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -268,7 +302,9 @@ int main(int argc, char *argv[]) {
   auto ctxt = cryptoContext->Encrypt(keyPair.publicKey, ptxt);
 
   total_time = 0;
+  counters.reset();
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto cPrecomp = cryptoContext->EvalFastRotationPrecompute(ctxt);
     uint32_t N = cryptoContext->GetRingDimension();
@@ -276,9 +312,11 @@ int main(int argc, char *argv[]) {
     auto cRot1 = cryptoContext->EvalFastRotation(ctxt, 4, M, cPrecomp);
 
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_rot", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS);
 
   // write ss_time into file
@@ -288,5 +326,11 @@ int main(int argc, char *argv[]) {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write hardware counters into a separate file
+  if (counters.is_enabled()) {
+    append_perf_counters_file("perf_counters_microbenchmark_ckks.csv",
+                              ss_perf.str());
+  }
+
   return 0;
 }
@@ -9,6 +9,8 @@
 #include "cryptocontextgen.h"
 #include "palisade.h"
 
+#include "perf_counters.h"
+
 using namespace std;
 using namespace lbcrypto;
 
@@ -32,21 +34,29 @@ int main(int argc, char *argv[]) {
   const int NUM_REPETITIONS{100};
   std::stringstream ss_time;
 
+  // hardware counters of the timed regions (only if PERF_COUNTERS is set)
+  PerfCounters counters;
+  std::stringstream ss_perf;
+
   // =======================================================
   // Ctxt-Ctxt Multiplication with new ciphertext
   // =======================================================
 
   std::cout << "== Ctxt-Ctxt Multiplication with new ciphertext" << std::endl;
   size_t total_time = 0;
+  counters.reset();
 
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ctAND = cryptoContext.EvalBinGate(AND, ct1, ct2);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_mul_ct_ct", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -76,15 +86,19 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Ctxt-Ctxt Addition time with new ciphertext" << std::endl;
   total_time = 0;
+  counters.reset();
   
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ct1 = cryptoContext.Encrypt(sk, 1);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_add_ct_ct", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -114,15 +128,19 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Sk Encryption time" << std::endl;
   total_time = 0;
+  counters.reset();
   
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     auto ct1 = cryptoContext.Encrypt(sk, 1);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_enc_sk", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -138,16 +156,20 @@ int main(int argc, char *argv[]) {
 
   std::cout << "== Decryption time" << std::endl;
   total_time = 0;
+  counters.reset();
 
   for (size_t i = 0; i < NUM_REPETITIONS; i++) {
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
     LWEPlaintext result;
     cryptoContext.Decrypt(sk, ct1, &result);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     total_time +=
         std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   }
+  write_perf_counters_row(ss_perf, "t_dec", counters.mean());
   ss_time << (total_time / NUM_REPETITIONS) << ",";
 
   // =======================================================
@@ -164,5 +186,11 @@ int main(int argc, char *argv[]) {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write hardware counters into a separate file
+  if (counters.is_enabled()) {
+    append_perf_counters_file("perf_counters_microbenchmark_fhew.csv",
+                              ss_perf.str());
+  }
+
   return 0;
 }
@@ -0,0 +1,129 @@
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+/*
+ * Queue with a fixed capacity between the stages of a pipeline, e.g., the
+ * client (encryption), server (computation), and client (decryption) stages
+ * of a streaming benchmark. A producer blocks while the queue is full, so
+ * that at most capacity items (ciphertexts, which are megabytes each) are
+ * buffered between two stages, however long the input is.
+ *
+ * close() ends the stream: pushes fail from then on, and pops drain the
+ * remaining items before they fail. A stage that fails closes its queues, so
+ * that the other stages return instead of waiting forever.
+ *
+ * The queue also records how full it was at each push and how long pushes
+ * and pops waited, which tells the slowest stage of the pipeline: the queue
+ * in front of it is full, the queue behind it is empty.
+ */
+
+/// Occupancy and waiting times of a BoundedQueue.
+struct QueueStats {
+  std::size_t capacity = 0;
+
+  std::size_t pushes = 0;
+
+  /// largest number of items in the queue (right after a push)
+  std::size_t max_occupancy = 0;
+
+  /// mean number of items in the queue right after a push
+  double mean_occupancy = 0;
+
+  /// time producers waited for space, i.e., the consumer was the bottleneck
+  std::chrono::nanoseconds push_wait{0};
+
+  /// time consumers waited for items, i.e., the producer was the bottleneck
+  std::chrono::nanoseconds pop_wait{0};
+};
+
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {
+    if (capacity == 0) {
+      throw std::invalid_argument("queue capacity must be positive");
+    }
+  }
+
+  /// Appends the item, waits while the queue is full. Returns false (and
+  /// drops the item) if the queue is closed.
+  bool push(T item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto start = std::chrono::steady_clock::now();
+    not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+    push_wait += std::chrono::steady_clock::now() - start;
+    if (closed) return false;
+    items.push_back(std::move(item));
+    pushes++;
+    occupancy_sum += items.size();
+    max_occupancy = std::max(max_occupancy, items.size());
+    not_empty.notify_one();
+    return true;
+  }
+
+  /// Removes the oldest item, waits while the queue is empty. Returns false
+  /// once the queue is closed and empty.
+  bool pop(T &item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto start = std::chrono::steady_clock::now();
+    not_empty.wait(lock, [this] { return closed || !items.empty(); });
+    pop_wait += std::chrono::steady_clock::now() - start;
+    if (items.empty()) return false;
+    item = std::move(items.front());
+    items.pop_front();
+    not_full.notify_one();
+    return true;
+  }
+
+  /// Ends the stream, wakes up all waiting producers and consumers.
+  void close() {
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    not_full.notify_all();
+    not_empty.notify_all();
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return items.size();
+  }
+
+  QueueStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    QueueStats stats;
+    stats.capacity = capacity;
+    stats.pushes = pushes;
+    stats.max_occupancy = max_occupancy;
+    stats.mean_occupancy =
+        pushes == 0 ? 0.0 : static_cast<double>(occupancy_sum) / pushes;
+    stats.push_wait =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(push_wait);
+    stats.pop_wait =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(pop_wait);
+    return stats;
+  }
+
+ private:
+  const std::size_t capacity;
+  mutable std::mutex mutex;
+  std::condition_variable not_full;
+  std::condition_variable not_empty;
+  std::deque<T> items;
+  bool closed = false;
+
+  std::size_t pushes = 0;
+  std::size_t occupancy_sum = 0;
+  std::size_t max_occupancy = 0;
+  std::chrono::steady_clock::duration push_wait{0};
+  std::chrono::steady_clock::duration pop_wait{0};
+};
+
+#endif
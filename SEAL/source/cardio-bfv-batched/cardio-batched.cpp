@@ -1,14 +1,25 @@
 #include "cardio-batched.h"
 #include "../common.h"
+#include "../sweep.h"
+#include "../timing.h"
 
 /*
  * Batched BFV implementation for cardio benchmark.
  */
 
-void CardioBatched::setup_context_bfv(std::size_t poly_modulus_degree) {
-  seal::EncryptionParameters parms(seal::scheme_type::BFV);
-  parms.set_poly_modulus_degree(poly_modulus_degree);
+std::vector<uint64_t> PatientRecord::values() const {
+  return {man,      antecedent, smoking, diabetic, pressure, man,
+          !man,     age,        1,       1,        1,        1,
+          drinking, drinking,   hdl,     height,   phy_act,  weight + 90};
+}
 
+uint64_t PatientRecord::expected_risk() const {
+  return (man && age > 50) + antecedent + smoking + diabetic + pressure +
+         (man && drinking > 3) + (!man && drinking > 2) + (hdl < 40) +
+         (height < weight + 90) + (phy_act < 30);
+}
+
+ParameterSet CardioBatched::build_parameters(std::size_t poly_modulus_degree) {
   //1947,19,6191,8 #16k, default seal (has 9 elements)
   //SECURE BUT INCORRECT # 16k, {30, 60, 60, 60, 60, 60}
   //INSECURE #16k, {30, 60, 60, 60, 60, 60, 60,60}
@@ -16,29 +27,32 @@ void CardioBatched::setup_context_bfv(std::size_t poly_modulus_degree) {
   // SECURE BUT INCORRECT #16k, {60, 60, 60, 60, 60, 60}
   //1240,15,4323,6, #16k {60, 60, 60, 60, 60, 60, 60}
   //1211,15,4294,6 #same as above
+  return build_target().parameters_at(poly_modulus_degree);
+}
 
-#ifdef MANUALPARAMS
-  parms.set_coeff_modulus(seal::CoeffModulus::Create(
-      poly_modulus_degree,  {30, 60, 60, 60, 60, 60}));
-#endif
-
-#ifdef CINGUPARAM
-  parms.set_coeff_modulus(seal::CoeffModulus::Create(
-      poly_modulus_degree, {30, 40, 44, 50, 54, 60, 60}));
+const TargetParameters &CardioBatched::build_target() {
+#if defined(MANUALPARAMS)
+  return target_parameters("cardio_bfv_batched_manualparams");
+#elif defined(CINGUPARAM)
+  return target_parameters("cardio_bfv_batched_cinguparam");
+#else
+  return target_parameters("cardio_bfv_batched_sealparams");
 #endif
+}
 
-#ifdef SEALPARAMS
-  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(
-      poly_modulus_degree, seal::sec_level_type::tc128));
-#endif
+void CardioBatched::setup_context_bfv(const ParameterSet &parameters) {
+  const std::size_t poly_modulus_degree = parameters.poly_modulus_degree;
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(poly_modulus_degree);
+  parms.set_coeff_modulus(parameters.coeff_modulus());
 
   /* To enable batching, we need to set the plain_modulus to be a prime number
    * congruent to 1 modulo 2*poly_modulus_degree. Microsoft SEAL provides a
    * helper method for finding such a prime. In this example we create a 20-bit
    * prime that supports batching.
    */
-  parms.set_plain_modulus(
-      seal::PlainModulus::Batching(poly_modulus_degree, 20));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(
+      poly_modulus_degree, parameters.plain_modulus_bits));
 
   // Instantiate context
   context = seal::SEALContext::Create(parms);
@@ -46,32 +60,17 @@ void CardioBatched::setup_context_bfv(std::size_t poly_modulus_degree) {
   auto qualifiers = context->first_context_data()->qualifiers();
   assert(("Batching is not enabled!", qualifiers.using_batching == true));
 
-  // Create keys
-  seal::KeyGenerator keyGenerator(context);
-
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  // std::ofstream ofs_pk("public_key.dat", std::ios::binary);
-  // publicKey->save(ofs_pk);
-  // ofs_pk.close();
-
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  // std::ofstream ofs_sk("secret_key.dat", std::ios::binary);
-  // secretKey->save(ofs_sk);
-  // ofs_sk.close();
-
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
-  // std::ofstream ofs_rk("relin_keys.dat", std::ios::binary);
-  // relinKeys->save(ofs_rk);
-  // ofs_rk.close();
-
-  // Only generate those keys that are actually required/used
-  std::vector<int> steps = {-1, -2, -3, -4, -5, -6, -7, 8, 16, 32, 56, 64, 72};
-  galoisKeys =
-      std::make_unique<seal::GaloisKeys>(keyGenerator.galois_keys_local(steps));
-  // std::ofstream ofs_gk("galois_keys.dat", std::ios::binary);
-  // galoisKeys->save(ofs_gk);
-  // ofs_gk.close();
+  // Create keys, or load them if a previous run added them to the key store
+  // (KEY_STORE_DIR). Only generate those keys that are actually required/used
+  KeyRequest key_request;
+  key_request.galois_keys = true;
+  key_request.galois_steps = build_target().rotation_steps;
+  KeySet keys = KeyStore::from_env().get(context, key_request);
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
+  galoisKeys = std::move(keys.galois_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -79,60 +78,73 @@ void CardioBatched::setup_context_bfv(std::size_t poly_modulus_degree) {
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
   encoder = std::make_unique<seal::BatchEncoder>(context);
+  plaintextCache = std::make_unique<PlaintextCache>(context);
+  lazyEvaluator = std::make_unique<LazyEvaluator>(*evaluator, *relinKeys);
 }
 
-CiphertextVector CardioBatched::slice(CiphertextVector ctxt, int idx_begin,
-                                      int idx_end) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.begin() + idx_end);
-}
-
-CiphertextVector CardioBatched::slice(CiphertextVector ctxt, int idx_begin) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.end());
-}
-
-// return lhs < rhs
+// return lhs < rhs, where lhs[0] and rhs[0] are the least significant bits
 std::unique_ptr<seal::Ciphertext> CardioBatched::lower(CiphertextVector &lhs,
                                                        CiphertextVector &rhs) {
-  std::unique_ptr<seal::Ciphertext> result =
-      std::make_unique<seal::Ciphertext>();
-
-  const int len = lhs.size();
-  if (len == 1) {
-    // andNY(lhs[0], rhs[0]) = !(lhs[0]) & rhs[0]
-    seal::Plaintext one;
-    std::vector<uint64_t> all_ones(encoder->slot_count(), 1);
-    encoder->encode(all_ones, one);
-    seal::Ciphertext lhs_neg = XOR(lhs[0], one);
-    evaluator->multiply(lhs_neg, rhs[0], *result);
-    evaluator->relinearize_inplace(*result, *relinKeys);
-    return result;
-  }
-
-  auto get_level = [&](seal::Ciphertext &c) -> std::size_t {
-    return context->get_context_data(c.parms_id())->chain_index();
-  };
+  assert(("lower supports same-sized inputs only!", lhs.size() == rhs.size()));
 
-  const int len2 = len >> 1;
+  const seal::Plaintext &one =
+      plaintextCache->batch(std::vector<uint64_t>(encoder->slot_count(), 1));
 
-  CiphertextVector lhs_l = slice(lhs, 0, len2);
-  CiphertextVector lhs_h = slice(lhs, len2);
-  CiphertextVector rhs_l = slice(rhs, 0, len2);
-  CiphertextVector rhs_h = slice(rhs, len2);
-
-  seal::Ciphertext term1 = *lower(lhs_h, rhs_h);
-  seal::Ciphertext h_equal = *equal(lhs_h, rhs_h);
-  seal::Ciphertext l_equal = *lower(lhs_l, rhs_l);
+  // both signals of a bit are derived from a single product p = a*b:
+  //   less  = !a & b       = b - p
+  //   equal = XNOR(a, b)   = 1 - a - b + 2p
+  CiphertextVector less_bits, equal_bits;
+  for (std::size_t i = 0; i < lhs.size(); ++i) {
+    // p feeds both signals, which are multiplied separately later on, hence
+    // it is relinearized right away
+    seal::Ciphertext product;
+    lazyEvaluator->multiply(lhs[i], rhs[i], product);
+    lazyEvaluator->relinearize_inplace(product);
+
+    seal::Ciphertext less;
+    evaluator->sub(rhs[i], product, less);
+    less_bits.push_back(less);
+
+    seal::Ciphertext equal;
+    evaluator->add(product, product, equal);
+    evaluator->sub_inplace(equal, lhs[i]);
+    evaluator->sub_inplace(equal, rhs[i]);
+    evaluator->add_plain_inplace(equal, one);
+    equal_bits.push_back(equal);
+  }
 
-  seal::Ciphertext term2;
+  ComparisonSignals signals =
+      combine_signals(less_bits, equal_bits, 0, lhs.size(), false);
+  return std::make_unique<seal::Ciphertext>(std::move(signals.less));
+}
 
-  if (get_level(l_equal) > get_level(h_equal)) {
-  } else if (get_level(l_equal) < get_level(h_equal)) {
+CardioBatched::ComparisonSignals CardioBatched::combine_signals(
+    CiphertextVector &less_bits, CiphertextVector &equal_bits,
+    std::size_t begin, std::size_t end, bool need_equal) {
+  ComparisonSignals result;
+  if (end - begin == 1) {
+    result.less = std::move(less_bits[begin]);
+    if (need_equal) result.equal = std::move(equal_bits[begin]);
+    return result;
   }
 
-  evaluator->multiply(h_equal, l_equal, term2);
-  evaluator->relinearize_inplace(term2, *relinKeys);
-
-  *result = XOR(term1, term2);
+  // bits [mid, end) are the more significant ones, the equal signal of the
+  // lower half is only needed if the caller needs the one of this range
+  const std::size_t mid = begin + (end - begin) / 2;
+  ComparisonSignals high =
+      combine_signals(less_bits, equal_bits, mid, end, true);
+  ComparisonSignals low =
+      combine_signals(less_bits, equal_bits, begin, mid, need_equal);
+
+  // lhs < rhs if the high bits are lower, or if they are equal and the low
+  // bits are lower. Both cases exclude each other, hence the XOR of the two
+  // terms is a plain addition, which relinearizes both terms at once.
+  lazyEvaluator->multiply(high.equal, low.less, result.less);
+  evaluator->add_inplace(result.less, high.less);
+
+  if (need_equal) {
+    lazyEvaluator->multiply(high.equal, low.equal, result.equal);
+  }
   return result;
 }
 
@@ -142,8 +154,7 @@ seal::Ciphertext CardioBatched::XOR(seal::Ciphertext &lhs,
   // see https://stackoverflow.com/a/46674398
   seal::Ciphertext result;
   evaluator->sub(lhs, rhs, result);
-  evaluator->square_inplace(result);
-  evaluator->relinearize_inplace(result, *relinKeys);
+  lazyEvaluator->square_inplace(result);
   return result;
 }
 
@@ -153,8 +164,7 @@ seal::Ciphertext CardioBatched::XOR(seal::Ciphertext &lhs,
   // see https://stackoverflow.com/a/46674398
   seal::Ciphertext result;
   evaluator->sub_plain(lhs, rhs, result);
-  evaluator->square_inplace(result);
-  evaluator->relinearize_inplace(result, *relinKeys);
+  lazyEvaluator->square_inplace(result);
   return result;
 }
 
@@ -258,6 +268,80 @@ seal::Plaintext CardioBatched::encode(std::vector<uint64_t> numbers) {
   return encode(numbers, context->first_parms_id());
 }
 
+std::size_t CardioBatched::records_per_ciphertext() {
+  const std::size_t row_size = encoder->slot_count() / 2;
+  return 2 * (row_size / RECORD_SLOTS);
+}
+
+std::size_t CardioBatched::record_offset(std::size_t record) {
+  const std::size_t row_size = encoder->slot_count() / 2;
+  const std::size_t records_per_row = row_size / RECORD_SLOTS;
+  return (record / records_per_row) * row_size +
+         (record % records_per_row) * RECORD_SLOTS;
+}
+
+std::vector<uint64_t> CardioBatched::layout_records(
+    const std::vector<std::vector<uint64_t>> &records) {
+  assert(("Too many records for one ciphertext!",
+          records.size() <= records_per_ciphertext()));
+  std::vector<uint64_t> slots(encoder->slot_count(), 0);
+  for (std::size_t r = 0; r < records.size(); ++r) {
+    std::size_t slot = record_offset(r);
+    for (auto n : records[r]) {
+      // most significant bit first, as in encode()
+      for (int i = NUM_BITS - 1; i >= 0; --i) slots[slot++] = (n >> i) & 1;
+    }
+  }
+  return slots;
+}
+
+seal::Plaintext CardioBatched::encode_records(
+    const std::vector<std::vector<uint64_t>> &records) {
+  seal::Plaintext encoded_records;
+  encoder->encode(layout_records(records), encoded_records);
+  return encoded_records;
+}
+
+const seal::Plaintext &CardioBatched::encode_replicated(
+    const std::vector<uint64_t> &numbers, std::size_t num_records) {
+  return plaintextCache->batch(layout_records(
+      std::vector<std::vector<uint64_t>>(num_records, numbers)));
+}
+
+const seal::Plaintext &CardioBatched::replicated_mask(
+    const std::vector<uint64_t> &numbers, std::size_t num_records,
+    seal::parms_id_type parms_id) {
+  return plaintextCache->batch_ntt(
+      layout_records(std::vector<std::vector<uint64_t>>(num_records, numbers)),
+      parms_id);
+}
+
+const seal::Plaintext &CardioBatched::value_mask(std::size_t first_value,
+                                                 std::size_t num_values,
+                                                 std::size_t num_records,
+                                                 seal::parms_id_type parms_id) {
+  std::vector<uint64_t> mask(encoder->slot_count(), 0);
+  for (std::size_t r = 0; r < num_records; ++r) {
+    std::size_t begin = record_offset(r) + first_value * NUM_BITS;
+    std::fill_n(mask.begin() + begin, num_values * NUM_BITS, 1);
+  }
+  return plaintextCache->batch_ntt(mask, parms_id);
+}
+
+std::vector<uint64_t> CardioBatched::decrypt_risks(seal::Ciphertext &ctxt,
+                                                   std::size_t num_records) {
+  seal::Plaintext p;
+  decryptor->decrypt(ctxt, p);
+  std::vector<uint64_t> dec;
+  encoder->decode(p, dec);
+  // the risk score of each record is in its slot 7
+  std::vector<uint64_t> risks;
+  for (std::size_t r = 0; r < num_records; ++r) {
+    risks.push_back(dec[record_offset(r) + NUM_BITS - 1]);
+  }
+  return risks;
+}
+
 void CardioBatched::print_vec(seal::Ciphertext &ctxt) {
   seal::Plaintext p;
   decryptor->decrypt(ctxt, p);
@@ -289,6 +373,85 @@ std::vector<seal::Ciphertext> CardioBatched::split_by_binary_rep(
   return result;
 }
 
+seal::Ciphertext CardioBatched::compute_risk(seal::Ciphertext &inputs,
+                                            std::size_t num_records) {
+  // all masks, constants, and rotations are relative to the first slot of a
+  // record, so that each record is processed exactly like a single patient
+
+  // the inputs are multiplied by four masks, hence transformed into NTT form
+  // only once (the masks are cached in NTT form)
+  seal::Ciphertext inputs_ntt = to_ntt(*evaluator, inputs);
+  auto parms_id = inputs_ntt.parms_id();
+
+  // mask the flags
+  seal::Ciphertext bool_flags;
+  const seal::Plaintext &mask =
+      replicated_mask({1, 1, 1, 1, 1, 1, 1}, num_records, parms_id);
+  multiply_plain_ntt(*evaluator, inputs_ntt, mask, bool_flags);
+  // set 1 at bit positions 63, 71, 78 (required for batching scheme)
+  const seal::Plaintext &addendum =
+      encode_replicated({0, 0, 0, 0, 0, 0, 0, 1, 1, 1}, num_records);
+  evaluator->add_plain_inplace(bool_flags, addendum);
+
+  // prepare b by adding missing values and extracting values for lhs of smaller
+  // equation
+  const seal::Plaintext &mask_b_enc =
+      value_mask(14, 3, num_records, parms_id);
+  seal::Ciphertext b;
+  multiply_plain_ntt(*evaluator, inputs_ntt, mask_b_enc, b);
+  lazyEvaluator->rotate_rows_inplace(b, 56, *galoisKeys);
+  // merge with the constants that are not given as inputs
+  const seal::Plaintext &const_b =
+      encode_replicated({50, 0, 0, 0, 0, 3, 2}, num_records);
+  evaluator->add_plain_inplace(b, const_b);
+
+  // prepare c by adding missing values and extracting values for rhs of smaller
+  // equation
+  const seal::Plaintext &mask_c_enc =
+      value_mask(7, 7, num_records, parms_id);
+  seal::Ciphertext c;
+  multiply_plain_ntt(*evaluator, inputs_ntt, mask_c_enc, c);
+  lazyEvaluator->rotate_rows_inplace(c, 56, *galoisKeys);
+  // merge with the constants that are not given as inputs
+  const seal::Plaintext &const_c =
+      encode_replicated({0, 0, 0, 0, 0, 0, 0, 40, 0, 30}, num_records);
+  evaluator->add_plain_inplace(c, const_c);
+
+  // extract and merge weight+90 into other values in ciphertext c
+  const seal::Plaintext &mask_weight90_enc =
+      value_mask(17, 1, num_records, parms_id);
+  seal::Ciphertext weight90;
+  multiply_plain_ntt(*evaluator, inputs_ntt, mask_weight90_enc, weight90);
+  lazyEvaluator->rotate_rows_inplace(weight90, 72, *galoisKeys);
+  evaluator->add_inplace(c, weight90);
+
+  // bool_flags, b, c are the ciphertexts where first nine slots contain actual
+  // values, i.e., (index+1) mod 8 == 0 contains index-th input
+  std::vector<seal::Ciphertext> b_encoded = split_by_binary_rep(b);
+  std::vector<seal::Ciphertext> c_encoded = split_by_binary_rep(c);
+
+  // lower_result := b_encoded < c_encoded
+  seal::Ciphertext lower_result = *lower(b_encoded, c_encoded);
+
+  // condition_result := bool_flags & lower_result
+  seal::Ciphertext condition_result;
+  lazyEvaluator->multiply(bool_flags, lower_result, condition_result);
+
+  // perform sum & rotate to compute the result of the cardio program, all
+  // rotations stay within the RECORD_SLOTS of each record
+  seal::Ciphertext rot8, rot4, rot2, final_result;
+  lazyEvaluator->rotate_rows(condition_result, 8 * NUM_BITS, *galoisKeys,
+                             rot8);
+  evaluator->add_inplace(rot8, condition_result);
+  evaluator->rotate_rows(rot8, 4 * NUM_BITS, *galoisKeys, rot4);
+  evaluator->add_inplace(rot4, rot8);
+  evaluator->rotate_rows(rot4, 2 * NUM_BITS, *galoisKeys, rot2);
+  evaluator->add_inplace(rot2, rot4);
+  evaluator->rotate_rows(rot2, 1 * NUM_BITS, *galoisKeys, final_result);
+  evaluator->add_inplace(final_result, rot2);
+  return final_result;
+}
+
 namespace {
 void log_time(std::stringstream &ss,
               std::chrono::time_point<std::chrono::high_resolution_clock> start,
@@ -297,22 +460,47 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<ms>(end - start).count();
   if (!last) ss << ",";
 }
+
+/// Random but reproducible patients, all values fit into NUM_BITS bits.
+std::vector<PatientRecord> random_patients(std::size_t num_patients,
+                                           std::mt19937 &gen) {
+  std::bernoulli_distribution flag;
+  std::uniform_int_distribution<uint64_t> age(18, 99), hdl(20, 99),
+      height(50, 220), phy_act(0, 120), drinking(0, 10), weight(30, 165);
+  std::vector<PatientRecord> patients(num_patients);
+  for (auto &p : patients) {
+    p = {flag(gen),    flag(gen),     flag(gen),      flag(gen),
+         flag(gen),    age(gen),      hdl(gen),       height(gen),
+         phy_act(gen), drinking(gen), weight(gen)};
+  }
+  return patients;
+}
 }  // namespace
 
 void CardioBatched::run_cardio() {
-  std::stringstream ss_time;
-
-  auto t0 = Time::now();
   // poly_modulus_degree:
   // - must be a power of two
   // - determines the number of ciphertext slots
   // - determines the max. of the sum of coeff_moduli bits
-  // setup_context_bfv(32768);
-  setup_context_bfv(16384);
+  // run_cardio(build_parameters(32768), "cardio-bfv-batched");
+  run_cardio(build_target().parameters, "cardio-bfv-batched");
+}
+
+void CardioBatched::run_cardio(const ParameterSet &parameters,
+                               const std::string &benchmark) {
+  std::stringstream ss_time;
+  // allocation statistics per phase, only collected if MEMORY_PROFILE is set
+  PhaseProfiler phase_profiler;
+
+  phase_profiler.begin();
+  auto t0 = Time::now();
+  setup_context_bfv(parameters);
 
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  phase_profiler.end("t_keygen");
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
+  phase_profiler.begin();
   auto t2 = Time::now();
 
   // encode and encrypt keystream
@@ -324,17 +512,18 @@ void CardioBatched::run_cardio() {
   // === client-side computation ====================================
 
   // define input values
-  bool man = false;
-  bool antecedent = true;
-  bool smoking = true;
-  bool diabetic = true;
-  bool pressure = true;
-  uint64_t age = 55;
-  uint64_t hdl = 50;
-  uint64_t height = 80;
-  uint64_t phy_act = 45;
-  uint64_t drinking = 4;
-  uint64_t weight = 80;
+  PatientRecord patient;
+  patient.man = false;
+  patient.antecedent = true;
+  patient.smoking = true;
+  patient.diabetic = true;
+  patient.pressure = true;
+  patient.age = 55;
+  patient.hdl = 50;
+  patient.height = 80;
+  patient.phy_act = 45;
+  patient.drinking = 4;
+  patient.weight = 80;
 
   // == Conditions ====
   // F  +1  if man                                  && 50 < [age]
@@ -349,134 +538,52 @@ void CardioBatched::run_cardio() {
   // F  +1  if TRUE                                 && [phy_act] < 30
 
   // encode and encrypt the inputs
-  std::vector<uint64_t> in;
-  in.push_back(man);
-  in.push_back(antecedent);
-  in.push_back(smoking);
-  in.push_back(diabetic);
-  in.push_back(pressure);
-  in.push_back(man);
-  in.push_back(!man);
-  in.push_back(age);
-  in.push_back(1);
-  in.push_back(1);
-  in.push_back(1);
-  in.push_back(1);
-  in.push_back(drinking);
-  in.push_back(drinking);
-  in.push_back(hdl);
-  in.push_back(height);
-  in.push_back(phy_act);
-  in.push_back(weight + 90);
+  std::vector<uint64_t> in = patient.values();
 
   seal::Ciphertext result = encode_and_encrypt(in);
 
   auto t3 = Time::now();
+  phase_profiler.end("t_input_encryption");
   log_time(ss_time, t2, t3, false);
 
   // // transmit data to server...
 
   // // === server-side computation ====================================
 
+  phase_profiler.begin();
   auto t4 = Time::now();
 
   // homomorphically execute the Kreyvium algorithm to decrypt data
   // seal::Plaintext ks = encode(keystream);
   // seal::Ciphertext result = XOR(inputs, ks);
 
-  // create a copy of the input vector
-  seal::Ciphertext bool_flags = result;
-  // mask the flags
-  seal::Plaintext mask = encode({1, 1, 1, 1, 1, 1, 1}, bool_flags.parms_id());
-  evaluator->multiply_plain_inplace(bool_flags, mask);
-  // set 1 at bit positions 63, 71, 78 (required for batching scheme)
-  seal::Plaintext addendum =
-      encode({0, 0, 0, 0, 0, 0, 0, 1, 1, 1}, bool_flags.parms_id());
-  evaluator->add_plain_inplace(bool_flags, addendum);
-
-  // prepare b by adding missing values and extracting values for lhs of smaller
-  // equation
-  std::vector<uint64_t> mask_b(encoder->slot_count(), 0);
-  for (size_t i = 112; i < 112 + 3 * NUM_BITS; i++) mask_b[i] = 1;
-  seal::Plaintext mask_b_enc;
-  encoder->encode(mask_b, mask_b_enc);
-  seal::Ciphertext b;
-  evaluator->multiply_plain(result, mask_b_enc, b);
-  evaluator->relinearize_inplace(b, *relinKeys);
-  evaluator->rotate_rows_inplace(b, 56, *galoisKeys);
-  // merge with the constants that are not given as inputs
-  seal::Plaintext const_b = encode({50, 0, 0, 0, 0, 3, 2}, b.parms_id());
-  evaluator->add_plain_inplace(b, const_b);
-
-  // prepare c by adding missing values and extracting values for rhs of smaller
-  // equation
-  std::vector<uint64_t> mask_c(encoder->slot_count(), 0);
-  for (size_t i = 56; i < 56 + 7 * NUM_BITS; i++) mask_c[i] = 1;
-  seal::Plaintext mask_c_enc;
-  encoder->encode(mask_c, mask_c_enc);
-  seal::Ciphertext c;
-  evaluator->multiply_plain(result, mask_c_enc, c);
-  evaluator->relinearize_inplace(c, *relinKeys);
-  evaluator->rotate_rows_inplace(c, 56, *galoisKeys);
-  // merge with the constants that are not given as inputs
-  seal::Plaintext const_c =
-      encode({0, 0, 0, 0, 0, 0, 0, 40, 0, 30}, c.parms_id());
-  evaluator->add_plain_inplace(c, const_c);
-
-  // extract and merge weight+90 into other values in ciphertext c
-  std::vector<uint64_t> mask_weight90(encoder->slot_count(), 0);
-  for (size_t i = 136; i < 136 + 1 * NUM_BITS; i++) mask_weight90[i] = 1;
-  seal::Plaintext mask_weight90_enc;
-  encoder->encode(mask_weight90, mask_weight90_enc);
-  seal::Ciphertext weight90;
-  evaluator->multiply_plain(result, mask_weight90_enc, weight90);
-  evaluator->relinearize_inplace(weight90, *relinKeys);
-  evaluator->rotate_rows_inplace(weight90, 72, *galoisKeys);
-  evaluator->add_inplace(c, weight90);
-
-  // bool_flags, b, c are the ciphertexts where first nine slots contain actual
-  // values, i.e., (index+1) mod 8 == 0 contains index-th input
-  std::vector<seal::Ciphertext> b_encoded = split_by_binary_rep(b);
-  std::vector<seal::Ciphertext> c_encoded = split_by_binary_rep(c);
-
-  // lower_result := b_encoded < c_encoded
-  seal::Ciphertext lower_result = *lower(b_encoded, c_encoded);
-
-  // condition_result := bool_flags & lower_result
-  seal::Ciphertext condition_result;
-  evaluator->multiply(bool_flags, lower_result, condition_result);
-  evaluator->relinearize_inplace(condition_result, *relinKeys);
-
-  // perform sum & rotate to compute the result of the cardio program
-  seal::Ciphertext rot8, rot4, rot2, final_result;
-  evaluator->rotate_rows(condition_result, 8 * NUM_BITS, *galoisKeys, rot8);
-  evaluator->add_inplace(rot8, condition_result);
-  evaluator->rotate_rows(rot8, 4 * NUM_BITS, *galoisKeys, rot4);
-  evaluator->add_inplace(rot4, rot8);
-  evaluator->rotate_rows(rot4, 2 * NUM_BITS, *galoisKeys, rot2);
-  evaluator->add_inplace(rot2, rot4);
-  evaluator->rotate_rows(rot2, 1 * NUM_BITS, *galoisKeys, final_result);
-  evaluator->add_inplace(final_result, rot2);
+  seal::Ciphertext final_result = compute_risk(result, 1);
 
   auto t5 = Time::now();
+  phase_profiler.end("t_computation");
   log_time(ss_time, t4, t5, false);
 
+  phase_profiler.begin();
   auto t6 = Time::now();
 
   // retrieve the final result (ciphertext slot 7)
-  seal::Plaintext p;
-  decryptor->decrypt(final_result, p);
-  std::vector<uint64_t> dec;
-  encoder->decode(p, dec);
-  uint64_t risk_value = dec[7];
+  uint64_t risk_value = decrypt_risks(final_result, 1)[0];
   std::cout << "Result: " << risk_value << std::endl;
 
   assert(
       ("Cardio benchmark does not produce expected result!", risk_value == 6));
 
   auto t7 = Time::now();
+  phase_profiler.end("t_decryption");
   log_time(ss_time, t6, t7, true);
 
+  // remaining noise budget, i.e., by how much the modulus chain could shrink
+  int noise_budget = decryptor->invariant_noise_budget(final_result);
+  std::cout << "Noise budget: " << noise_budget << " bits" << std::endl;
+  std::cout << "Relinearizations: " << lazyEvaluator->relinearizations()
+            << " (" << lazyEvaluator->removed_relinearizations()
+            << " removed by lazy relinearization)" << std::endl;
+
   // write ss_time into file
   std::ofstream myfile;
   auto out_filename = std::getenv("OUTPUT_FILENAME");
@@ -487,44 +594,223 @@ void CardioBatched::run_cardio() {
                     std::ifstream::badbit);
   myfile << ss_time.str() << std::endl;
 
+  // write allocation statistics per phase into file
+  if (phase_profiler.is_enabled()) {
+    std::ofstream memory_file = open_csv_file(
+        "MEMORY_FILENAME", "memory_cardio_batched.csv", PhaseProfiler::header());
+    phase_profiler.write_csv(memory_file);
+  }
+
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record(benchmark);
+  add_encryption_parameters(record, context);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.set_metric("noise_budget_bits", noise_budget);
+  record.set_metric("relinearizations", lazyEvaluator->relinearizations());
+  record.set_metric("relinearizations_removed",
+                    lazyEvaluator->removed_relinearizations());
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_cardio.txt");
 }
 
-std::unique_ptr<seal::Ciphertext> CardioBatched::multvect(
-    CiphertextVector bitvec) {
-  const int size = bitvec.size();
-  for (std::size_t k = 1; k < size; k *= 2) {
-    for (std::size_t i = 0; i < size - k; i += 2 * k) {
-      evaluator->multiply_inplace(bitvec[i], bitvec[i + k]);
-      evaluator->relinearize_inplace(bitvec[i], *relinKeys);
+void CardioBatched::run_cohort() {
+  std::vector<int> cohort_sizes = {1, 10, 100, 1000, 10000, 100000};
+  if (auto v = std::getenv("COHORT_SIZES")) {
+    cohort_sizes = parse_int_list(v, ',');
+  }
+
+  auto t0 = Time::now();
+  setup_context_bfv(build_target().parameters);
+  auto t1 = Time::now();
+
+  const std::size_t capacity = records_per_ciphertext();
+  std::cout << "Packing " << capacity << " patients per ciphertext"
+            << std::endl;
+
+  std::ofstream file = open_csv_file(
+      "COHORT_FILENAME", "cardio_batched_cohort.csv",
+      parameters_csv_header() +
+          ",patients,patients_per_ciphertext,ciphertexts,t_keygen,"
+          "t_input_encryption,t_computation,t_decryption,ms_per_patient,"
+          "patients_per_second");
+
+  std::mt19937 gen(42);
+  for (int cohort_size : cohort_sizes) {
+    const std::size_t num_patients = static_cast<std::size_t>(cohort_size);
+    std::vector<PatientRecord> patients = random_patients(num_patients, gen);
+
+    // ciphertexts are processed one after another (and not kept), so that
+    // memory does not grow with the cohort size
+    Time::duration t_enc(0), t_comp(0), t_dec(0);
+    std::size_t num_ciphertexts = 0;
+    lazyEvaluator->reset_counters();
+    for (std::size_t first = 0; first < num_patients; first += capacity) {
+      const std::size_t count = std::min(capacity, num_patients - first);
+      num_ciphertexts++;
+
+      auto t2 = Time::now();
+      std::vector<std::vector<uint64_t>> records;
+      for (std::size_t i = first; i < first + count; ++i) {
+        records.push_back(patients[i].values());
+      }
+      seal::Ciphertext inputs(context);
+      encryptor->encrypt(encode_records(records), inputs);
+      auto t3 = Time::now();
+      seal::Ciphertext risks_ctxt = compute_risk(inputs, count);
+      auto t4 = Time::now();
+      std::vector<uint64_t> risks = decrypt_risks(risks_ctxt, count);
+      auto t5 = Time::now();
+      t_enc += t3 - t2;
+      t_comp += t4 - t3;
+      t_dec += t5 - t4;
+
+      for (std::size_t i = 0; i < count; ++i) {
+        if (risks[i] != patients[first + i].expected_risk()) {
+          throw std::runtime_error("Wrong risk score for patient " +
+                                   std::to_string(first + i));
+        }
+      }
     }
+
+    // key generation is a one-time cost and hence not amortized
+    auto total_ms = std::chrono::duration<double, std::milli>(
+                        t_enc + t_comp + t_dec).count();
+    double ms_per_patient = total_ms / num_patients;
+    std::cout << num_patients << " patients in " << num_ciphertexts
+              << " ciphertexts: " << ms_per_patient << " ms per patient"
+              << std::endl;
+
+    write_parameters_csv(file, context);
+    file << "," << num_patients << "," << capacity << "," << num_ciphertexts
+         << "," << KeyStore::keygen_column(keysLoaded, t1 - t0) << ","
+         << std::chrono::duration_cast<ms>(t_enc).count() << ","
+         << std::chrono::duration_cast<ms>(t_comp).count() << ","
+         << std::chrono::duration_cast<ms>(t_dec).count() << ","
+         << ms_per_patient << "," << 1000.0 / ms_per_patient << std::endl;
+
+    ResultRecord record("cardio-bfv-batched-cohort");
+    add_encryption_parameters(record, context);
+    record.set_parameter("patients", num_patients);
+    record.set_parameter("patients_per_ciphertext", capacity);
+    record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+    record.add_timing("t_input_encryption", t_enc);
+    record.add_timing("t_computation", t_comp);
+    record.add_timing("t_decryption", t_dec);
+    record.set_metric("ciphertexts", num_ciphertexts);
+    record.set_metric("ms_per_patient", ms_per_patient);
+    record.set_metric("relinearizations", lazyEvaluator->relinearizations());
+    record.set_metric("relinearizations_removed",
+                      lazyEvaluator->removed_relinearizations());
+    record.write();
   }
-  return std::make_unique<seal::Ciphertext>(bitvec[0]);
 }
 
-std::unique_ptr<seal::Ciphertext> CardioBatched::equal(CiphertextVector &lhs,
-                                                       CiphertextVector &rhs) {
-  assert(("equal supports same-sized inputs only!", lhs.size() == rhs.size()));
+CircuitTrial CardioBatched::plan_trial(const ParameterSet &parameters) {
+  CircuitTrial trial;
+  try {
+    setup_context_bfv(parameters);
+  } catch (const std::logic_error &e) {
+    // e.g., not enough primes of the requested size for this ring degree
+    std::cout << "Skipping parameters: " << e.what() << std::endl;
+    return trial;
+  }
 
-  CiphertextVector comp;
-  for (std::size_t i = 0; i < lhs.size(); ++i) {
-    seal::Ciphertext tmp;
-    tmp = XOR(lhs[i], rhs[i]);
+  // a full ciphertext, so that every record's slots are checked
+  const std::size_t count = records_per_ciphertext();
+  std::mt19937 gen(7);
+  std::vector<PatientRecord> patients = random_patients(count, gen);
+  std::vector<std::vector<uint64_t>> records;
+  for (auto &p : patients) records.push_back(p.values());
+  seal::Ciphertext inputs(context);
+  encryptor->encrypt(encode_records(records), inputs);
+  trial.fresh_noise_budget = decryptor->invariant_noise_budget(inputs);
+
+  seal::Ciphertext risks_ctxt = compute_risk(inputs, count);
+  trial.output_noise_budgets.push_back(
+      decryptor->invariant_noise_budget(risks_ctxt));
+
+  std::vector<uint64_t> risks = decrypt_risks(risks_ctxt, count);
+  trial.correct = true;
+  for (std::size_t i = 0; i < count; ++i) {
+    trial.correct &= risks[i] == patients[i].expected_risk();
+  }
+  return trial;
+}
+
+void CardioBatched::run_planned() {
+  int margin_bits = 10;
+  if (auto v = std::getenv("PLAN_MARGIN_BITS")) margin_bits = std::stoi(v);
+  std::vector<std::size_t> degrees = {4096, 8192, 16384, 32768};
+  if (auto v = std::getenv("PLAN_POLY_MODULUS_DEGREES")) {
+    degrees.clear();
+    for (int d : parse_int_list(v, ',')) degrees.push_back(d);
+  }
 
-    seal::Plaintext one;
-    std::vector<uint64_t> all_ones(encoder->slot_count(), 1);
-    encoder->encode(all_ones, one);
+  ModulusPlanner planner(
+      [this](const ParameterSet &parameters) { return plan_trial(parameters); },
+      20, margin_bits);
+  auto t0 = Time::now();
+  ModulusPlan plan = planner.plan(degrees);
+  auto t1 = Time::now();
 
-    tmp = XOR(tmp, one);
-    comp.push_back(tmp);
+  std::ofstream file = open_csv_file(
+      "PLAN_FILENAME", "cardio_batched_plan.csv",
+      "poly_modulus_degree,log_q,coeff_modulus,plain_modulus_bits,step,"
+      "correct,fresh_noise_budget,output_noise_budget,consumed_noise_budget");
+  for (auto &step : plan.steps) {
+    auto &bits = step.parameters.coeff_modulus_bits;
+    file << step.parameters.poly_modulus_degree << "," << total_bits(bits)
+         << ",";
+    for (std::size_t i = 0; i < bits.size(); ++i) {
+      if (i > 0) file << ":";
+      file << bits[i];
+    }
+    file << "," << step.parameters.plain_modulus_bits << ","
+         << (step.probe ? "probe" : "verify") << "," << step.trial.correct
+         << "," << step.trial.fresh_noise_budget << ","
+         << step.trial.min_output_noise_budget() << ","
+         << step.trial.consumed_noise_budget() << std::endl;
   }
-  std::unique_ptr<seal::Ciphertext> mv_result = multvect(comp);
-  return mv_result;
+
+  // the last successful run is the one that verified the selected parameters
+  const ParameterSet &selected = plan.parameters;
+  auto verified = std::find_if(
+      plan.steps.rbegin(), plan.steps.rend(),
+      [](const PlannerStep &step) { return step.trial.succeeded(); });
+  std::cout << "Planned parameters: N = " << selected.poly_modulus_degree
+            << ", log q = " << total_bits(selected.coeff_modulus_bits)
+            << " (" << plan.steps.size() << " runs, "
+            << std::chrono::duration_cast<ms>(t1 - t0).count() << " ms)"
+            << std::endl;
+
+  // the benchmark itself (keygen included) is timed with the plan only
+  run_cardio(selected, "cardio-bfv-batched-planned");
+
+  ResultRecord record("cardio-bfv-batched-plan");
+  add_encryption_parameters(record, context);
+  record.set_parameter("margin_bits", margin_bits);
+  record.add_timing("t_planning", t1 - t0);
+  record.set_metric("circuit_runs", plan.steps.size());
+  record.set_metric("consumed_noise_budget_bits",
+                    verified->trial.consumed_noise_budget());
+  record.set_metric("noise_budget_bits",
+                    verified->trial.min_output_noise_budget());
+  record.write();
 }
 
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'cardio-batched-bfv'..." << std::endl;
-  CardioBatched().run_cardio();
+  if (has_flag(argc, argv, "--cohort")) {
+    CardioBatched().run_cohort();
+  } else if (has_flag(argc, argv, "--plan")) {
+    CardioBatched().run_planned();
+  } else {
+    CardioBatched().run_cardio();
+  }
   return 0;
 }
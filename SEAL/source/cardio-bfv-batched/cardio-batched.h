@@ -19,12 +19,45 @@
 #include <random>
 #include <vector>
 
+#include "../key_store.h"
+#include "../lazy_relin.h"
+#include "../modulus_planner.h"
+#include "../plaintext_cache.h"
+#include "../targets.h"
+
 #define NUM_BITS 8
 
+/// values per patient record (flags, lhs and rhs of the comparisons)
+#define NUM_VALUES 18
+
+/// slots occupied by one patient record
+#define RECORD_SLOTS (NUM_VALUES * NUM_BITS)
+
 typedef std::vector<seal::Ciphertext> CiphertextVector;
 typedef std::chrono::high_resolution_clock Time;
 typedef std::chrono::milliseconds ms;
 
+/// Inputs of the cardio program for one patient.
+struct PatientRecord {
+  bool man;
+  bool antecedent;
+  bool smoking;
+  bool diabetic;
+  bool pressure;
+  uint64_t age;
+  uint64_t hdl;
+  uint64_t height;
+  uint64_t phy_act;
+  uint64_t drinking;
+  uint64_t weight;
+
+  /// The 18 values of the record in slot order, see run_cardio().
+  std::vector<uint64_t> values() const;
+
+  /// Risk score computed in plaintext, used to verify the results.
+  uint64_t expected_risk() const;
+};
+
 class CardioBatched {
  private:
   /// the seal context, i.e. object that holds params/etc
@@ -42,11 +75,20 @@ class CardioBatched {
   /// keys required to relinearize after multipliction (ptr for consistency)
   std::unique_ptr<seal::RelinKeys> relinKeys;
 
+  /// whether the keys were loaded from the key store instead of generated
+  bool keysLoaded = false;
+
   std::unique_ptr<seal::Encryptor> encryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::BatchEncoder> encoder;
 
+  /// encoded masks and constants of the server-side computation
+  std::unique_ptr<PlaintextCache> plaintextCache;
+
+  /// ciphertext-ciphertext multiplications, relinearized lazily
+  std::unique_ptr<LazyEvaluator> lazyEvaluator;
+
   void print_vec(seal::Ciphertext &ctxt);
 
   void print_ciphertext(std::string name, seal::Ciphertext &ctxt);
@@ -65,27 +107,99 @@ class CardioBatched {
 
   seal::Ciphertext XOR(seal::Ciphertext &lhs, seal::Plaintext &rhs);
 
+  /// less: lhs < rhs, equal: lhs == rhs for a range of bits
+  struct ComparisonSignals {
+    seal::Ciphertext less;
+    seal::Ciphertext equal;
+  };
+
+  /// Combines the per-bit signals of bits [begin, end) in a balanced tree.
+  /// The equal signal is only computed if need_equal is set. Consumes the
+  /// bits of the range.
+  ComparisonSignals combine_signals(CiphertextVector &less_bits,
+                                    CiphertextVector &equal_bits,
+                                    std::size_t begin, std::size_t end,
+                                    bool need_equal);
+
+  /// Number of patient records that fit into one ciphertext. Records never
+  /// span the two rows of the batching matrix, as rotations are per row.
+  std::size_t records_per_ciphertext();
+
+  /// First slot of the given record.
+  std::size_t record_offset(std::size_t record);
+
+  /// Slots holding the values of each record (as NUM_BITS bits each) at the
+  /// record's offset, i.e., the first record is laid out as encode() does.
+  std::vector<uint64_t> layout_records(
+      const std::vector<std::vector<uint64_t>> &records);
+
+  /// Encodes the records, e.g., the inputs of several patients.
+  seal::Plaintext encode_records(
+      const std::vector<std::vector<uint64_t>> &records);
+
+  /// Same values (constants) for each record, from the plaintext cache.
+  const seal::Plaintext &encode_replicated(const std::vector<uint64_t> &numbers,
+                                           std::size_t num_records);
+
+  /// As encode_replicated(), in NTT form for multiply_plain_ntt().
+  const seal::Plaintext &replicated_mask(const std::vector<uint64_t> &numbers,
+                                         std::size_t num_records,
+                                         seal::parms_id_type parms_id);
+
+  /// Mask that is 1 in all bits of values [first_value, first_value +
+  /// num_values) of each record, in NTT form for multiply_plain_ntt().
+  const seal::Plaintext &value_mask(std::size_t first_value,
+                                    std::size_t num_values,
+                                    std::size_t num_records,
+                                    seal::parms_id_type parms_id);
+
+  /// Server-side computation of the risk scores of all records in inputs.
+  seal::Ciphertext compute_risk(seal::Ciphertext &inputs,
+                                std::size_t num_records);
+
+  /// Decrypts the risk scores of the first num_records records.
+  std::vector<uint64_t> decrypt_risks(seal::Ciphertext &ctxt,
+                                      std::size_t num_records);
+
  public:
-  void setup_context_bfv(std::size_t poly_modulus_degree);
+  /// Entry of targets.h selected at build time (MANUALPARAMS, CINGUPARAM, or
+  /// SEAL's default modulus for SEALPARAMS).
+  static const TargetParameters &build_target();
+
+  /// The parameters of build_target() at the given ring dimension.
+  static ParameterSet build_parameters(std::size_t poly_modulus_degree);
+
+  void setup_context_bfv(const ParameterSet &parameters);
 
   void run_cardio();
 
-  seal::Ciphertext encode_and_encrypt(std::vector<uint64_t> number);
+  /// Single-patient benchmark with the given parameters, recorded as
+  /// benchmark in RESULTS_FILENAME.
+  void run_cardio(const ParameterSet &parameters,
+                  const std::string &benchmark);
 
-  seal::Plaintext encode(std::vector<uint64_t> numbers);
+  /// Runs the circuit once on a full ciphertext of patients with the given
+  /// parameters and checks the risk scores, see ModulusPlanner.
+  CircuitTrial plan_trial(const ParameterSet &parameters);
 
-  seal::Plaintext encode(std::vector<uint64_t> numbers,
-                         seal::parms_id_type parms_id);
+  /// Selects the smallest parameters that the circuit still decrypts
+  /// correctly with (see ModulusPlanner), writes the planner's runs into
+  /// PLAN_FILENAME, and runs the benchmark with these parameters.
+  void run_planned();
 
-  std::unique_ptr<seal::Ciphertext> equal(CiphertextVector &lhs,
-                                          CiphertextVector &rhs);
+  /// Packs as many patients as fit into each ciphertext and reports the
+  /// amortized per-patient latency and the throughput for cohorts of
+  /// COHORT_SIZES (default: 1 to 100k) patients.
+  void run_cohort();
 
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin, int idx_end);
+  seal::Ciphertext encode_and_encrypt(std::vector<uint64_t> number);
 
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin);
+  seal::Plaintext encode(std::vector<uint64_t> numbers);
 
-  std::unique_ptr<seal::Ciphertext> multvect(CiphertextVector bitvec);
+  seal::Plaintext encode(std::vector<uint64_t> numbers,
+                         seal::parms_id_type parms_id);
 
+  /// Parallel-prefix comparator of depth ceil(log2(NUM_BITS)) + 1.
   std::unique_ptr<seal::Ciphertext> lower(CiphertextVector &lhs,
                                           CiphertextVector &rhs);
 
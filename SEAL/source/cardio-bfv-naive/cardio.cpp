@@ -1,6 +1,9 @@
 #include "cardio.h"
 
 #include "../common.h"
+#include "../key_store.h"
+#include "../task_graph.h"
+#include "../timing.h"
 
 #define SEX_FIELD 0
 #define ANTECEDENT_FIELD 1
@@ -34,12 +37,12 @@ void Cardio::setup_context_bfv(std::size_t poly_modulus_degree,
   // Instantiate context
   context = seal::SEALContext::Create(params);
 
-  /// Create keys
-  seal::KeyGenerator keyGenerator(context);
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeySet keys = KeyStore::from_env().get(context, KeyRequest());
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -48,198 +51,164 @@ void Cardio::setup_context_bfv(std::size_t poly_modulus_degree,
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
   encoder = std::make_unique<seal::IntegerEncoder>(context);
+  lazyEvaluator = std::make_unique<LazyEvaluator>(*evaluator, *relinKeys);
+  bitEvaluator = std::make_unique<BitEvaluator>(
+      *evaluator, *lazyEvaluator, encoder->encode(1), true);
 }
 
-CiphertextVector Cardio::encode_and_encrypt(int32_t number) {
+BitVector Cardio::encode_and_encrypt(int32_t number) {
   const static int NUM_BITS = 8;
 
   // convert integer to binary
   std::string bin = std::bitset<NUM_BITS>(number).to_string();
 
-  seal::Plaintext zero_ptxt = encoder->encode(0);
-  seal::Ciphertext zero;
-  encryptor->encrypt(zero_ptxt, zero);
-  CiphertextVector result(NUM_BITS, zero);
+  BitVector result(NUM_BITS);
   for (int i = 0; i < NUM_BITS; ++i) {
     // transform char -> int32_t
     int32_t val = (int) bin.at(NUM_BITS - 1 - i) - 48;
     // encode bit as integer
     seal::Plaintext b = encoder->encode(val);
     // encrypt bit
-    encryptor->encrypt(b, result.at(i));
+    seal::Ciphertext ctxt;
+    encryptor->encrypt(b, ctxt);
+    result[i] = ctxt;
   }
 
   return result;
 }
 
-CiphertextVector Cardio::ctxt_to_ciphertextvector(seal::Ciphertext &ctxt) {
+BitVector Cardio::encode_constant(int32_t number) {
   const static int NUM_BITS = 8;
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
-  CiphertextVector result(8, zero);
-  result[0] = seal::Ciphertext(ctxt);
 
-  for (size_t i = 1; i < NUM_BITS; i++) {
-    encryptor->encrypt(encoder->encode(0), result.at(i));
+  BitVector result(NUM_BITS);
+  for (int i = 0; i < NUM_BITS; ++i) {
+    result[i] = Bit::constant((number >> i) & 1);
   }
+  return result;
+}
 
+BitVector Cardio::bit_to_bitvector(const Bit &bit) {
+  const static int NUM_BITS = 8;
+  BitVector result(NUM_BITS);
+  result[0] = bit;
   return result;
 }
 
-void Cardio::shift_left_inplace(CiphertextVector &ctxt) {
+void Cardio::shift_left_inplace(BitVector &ctxt) {
   for (std::size_t i = 1; i < ctxt.size(); ++i) {
     ctxt[i - 1] = ctxt[i];
   }
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
-  ctxt[7] = zero;
+  ctxt[7] = Bit();
 }
 
-void Cardio::shift_right_inplace(CiphertextVector &ctxt) {
+void Cardio::shift_right_inplace(BitVector &ctxt) {
   for (std::size_t i = ctxt.size() - 2; i > 0; --i) {
     ctxt[i + 1] = ctxt[i];
   }
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
-  ctxt[0] = zero;
+  ctxt[0] = Bit();
 }
 
-std::unique_ptr<seal::Ciphertext> Cardio::multvect(CiphertextVector bitvec) {
-  const int size = bitvec.size();
+void Cardio::multvect_inplace(BitView bits) {
+  const int size = bits.size();
   for (std::size_t k = 1; k < size; k *= 2) {
     for (std::size_t i = 0; i < size - k; i += 2*k) {
-      evaluator->multiply(bitvec[i], bitvec[i + k], bitvec[i]);
-      evaluator->relinearize(bitvec[i], *relinKeys, bitvec[i]);
+      bits[i] = bitEvaluator->AND(bits[i], bits[i + k]);
     }
   }
-  return std::make_unique<seal::Ciphertext>(bitvec[0]);
 }
 
-std::unique_ptr<seal::Ciphertext> Cardio::equal(CiphertextVector lhs,
-                                                CiphertextVector rhs) {
+Bit Cardio::equal(BitView lhs, BitView rhs) {
   assert(("equal supports same-sized inputs only!", lhs.size()==rhs.size()));
 
-  CiphertextVector comp;
+  BitVector comp;
   for (std::size_t i = 0; i < lhs.size(); ++i) {
-    seal::Ciphertext tmp;
-    evaluator->add(lhs[i], rhs[i], tmp);
-    seal::Ciphertext one;
-    encryptor->encrypt(encoder->encode(1), one);
-    evaluator->add(tmp, one, tmp); // negate tmp
-    comp.push_back(tmp);
+    // XNOR
+    comp.push_back(bitEvaluator->NOT(bitEvaluator->XOR(lhs[i], rhs[i])));
   }
-  return multvect(comp);
+  multvect_inplace(comp);
+  return std::move(comp[0]);
 }
 
-void Cardio::print_ciphertext(std::string name, seal::Ciphertext &ctxt) {
+int Cardio::decrypt_bit(Bit &bit) {
+  // constant bits are part of the (public) circuit, i.e., known to the
+  // client as well
+  if (bit.is_constant()) return bit.value();
   seal::Plaintext p;
-  decryptor->decrypt(ctxt, p);
-  std::cout << name << ": " << encoder->decode_int32(p) << std::flush
-            << std::endl;
+  decryptor->decrypt(bit.ciphertext(), p);
+  return encoder->decode_int32(p);
+}
+
+void Cardio::print_bit(std::string name, Bit &bit) {
+  std::cout << name << ": " << decrypt_bit(bit) << std::flush << std::endl;
 }
 
 /// Implements a ripple carry adder.
-CiphertextVector Cardio::add(CiphertextVector lhs, CiphertextVector rhs) {
+BitVector Cardio::add(BitView lhs, BitView rhs) {
   auto size = lhs.size();
 
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
+  // no carry into the least significant bit
+  Bit carry;
 
-  seal::Ciphertext carry;
-  encryptor->encrypt(encoder->encode(0), carry);
+  BitVector res;
 
-  CiphertextVector res;
-
-  //std::cout << "lhs: " << ciphertextvector_to_int(lhs) << std::endl;
-  //std::cout << "rhs: " << ciphertextvector_to_int(rhs) << std::endl;
+  //std::cout << "lhs: " << bitvector_to_int(lhs) << std::endl;
+  //std::cout << "rhs: " << bitvector_to_int(rhs) << std::endl;
 
   for (std::size_t i = 0; i < size; ++i) {
 
     // SUM
-    //print_ciphertext("lhs[i]:", lhs[i]);
-    //print_ciphertext("rhs[i]:", rhs[i]);
-    seal::Ciphertext sum;
-    encryptor->encrypt(encoder->encode(0), sum);
-    evaluator->add(lhs[i], rhs[i], sum);
-    //print_ciphertext("internal_sum (a+b):", sum);
-    evaluator->add(sum, carry, sum);
-    //print_ciphertext("internal_sum (a+b+carry):", sum);
+    //print_bit("lhs[i]:", lhs[i]);
+    //print_bit("rhs[i]:", rhs[i]);
+    Bit temp = bitEvaluator->XOR(lhs[i], rhs[i]);
+    //print_bit("temp (l+r):", temp);
+    Bit sum = bitEvaluator->XOR(temp, carry);
+    //print_bit("internal_sum (a+b+carry):", sum);
     res.push_back(sum);
 
     // CARRY
-    seal::Ciphertext p;
-    encryptor->encrypt(encoder->encode(0), p);
-    evaluator->multiply(lhs[i], rhs[i], p);
-    evaluator->relinearize(p, *relinKeys, p);
-
-    //print_ciphertext("p (lr):", p);
-
-    seal::Ciphertext temp;
-    encryptor->encrypt(encoder->encode(0), temp);
-    evaluator->add(lhs[i], rhs[i], temp);
+    Bit p = bitEvaluator->AND(lhs[i], rhs[i]);
 
-    //print_ciphertext("temp (l+r):", temp);
+    //print_bit("p (lr):", p);
 
-    seal::Ciphertext temp2;
-    encryptor->encrypt(encoder->encode(0), temp2);
-    evaluator->multiply(carry, temp, temp2);
-    evaluator->relinearize(temp2, *relinKeys, temp2);
+    Bit temp2 = bitEvaluator->AND(carry, temp);
 
-    //print_ciphertext("temp2 c(l+r):", temp2);
+    //print_bit("temp2 c(l+r):", temp2);
 
-    evaluator->add(p, temp2, carry);
+    carry = bitEvaluator->XOR(p, temp2);
 
-    //print_ciphertext("internal_carry (p + temp2):", carry);
+    //print_bit("internal_carry (p + temp2):", carry);
   }
 
-  //std::cout << "sum: " << ciphertextvector_to_int(res) << std::endl;
+  //std::cout << "sum: " << bitvector_to_int(res) << std::endl;
   return res;
 }
 
-CiphertextVector Cardio::slice(CiphertextVector ctxt, int idx_begin,
-                               int idx_end) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.begin() + idx_end);
-}
-
-CiphertextVector Cardio::slice(CiphertextVector ctxt, int idx_begin) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.end());
-}
-
 // return lhs < rhs
-std::unique_ptr<seal::Ciphertext> Cardio::lower(CiphertextVector &lhs,
-                                                CiphertextVector &rhs) {
-  std::unique_ptr<seal::Ciphertext> result =
-      std::make_unique<seal::Ciphertext>();
-
+Bit Cardio::lower(BitView lhs, BitView rhs) {
   const int len = lhs.size();
   if (len==1) {
-    seal::Ciphertext one;
-    encryptor->encrypt(encoder->encode(1), one);
-    seal::Ciphertext lhs_neg;
     // andNY(lhs[0], rhs[0]) = !(lhs[0]) & rhs[0]
-    evaluator->add(lhs[0], one, lhs_neg);
-    evaluator->multiply(lhs_neg, rhs[0], *result);
-    evaluator->relinearize(*result, *relinKeys, *result);
-    return result;
+    Bit lhs_neg = bitEvaluator->NOT(lhs[0]);
+    return bitEvaluator->AND(lhs_neg, rhs[0]);
   }
 
   const int len2 = len >> 1;
 
-  CiphertextVector lhs_l = slice(lhs, 0, len2);
-  CiphertextVector lhs_h = slice(lhs, len2);
+  // views, the halves are not copied
+  BitView lhs_l = lhs.slice(0, len2);
+  BitView lhs_h = lhs.slice(len2);
 
-  CiphertextVector rhs_l = slice(rhs, 0, len2);
-  CiphertextVector rhs_h = slice(rhs, len2);
+  BitView rhs_l = rhs.slice(0, len2);
+  BitView rhs_h = rhs.slice(len2);
 
-  seal::Ciphertext term1 = *lower(lhs_h, rhs_h);
-  seal::Ciphertext term2;
-  evaluator->multiply(*equal(lhs_h, rhs_h), *lower(lhs_l, rhs_l), term2);
-  evaluator->relinearize(term2, *relinKeys, term2);
-  evaluator->add(term1, term2, *result);
-  return result;
+  Bit term1 = lower(lhs_h, rhs_h);
+  Bit h_equal = equal(lhs_h, rhs_h);
+  Bit l_lower = lower(lhs_l, rhs_l);
+  Bit term2 = bitEvaluator->AND(h_equal, l_lower);
+  return bitEvaluator->XOR(term1, term2);
 }
 
-void Cardio::print_ciphertextvector(CiphertextVector &vec) {
+void Cardio::print_bitvector(BitView vec) {
   std::cout << "size: " << vec.size() << std::endl;
 
   std::cout << "idx:\t\t";
@@ -250,9 +219,7 @@ void Cardio::print_ciphertextvector(CiphertextVector &vec) {
   std::cout << std::endl << "val (bin):\t";
   std::stringstream ss;
   for (int i = vec.size() - 1; i >= 0; --i) {
-    seal::Plaintext p;
-    decryptor->decrypt(vec[i], p);
-    auto value = encoder->decode_int32(p);
+    auto value = decrypt_bit(vec[i]);
     std::cout << value << " " << std::flush;
     ss << value;
   }
@@ -262,12 +229,10 @@ void Cardio::print_ciphertextvector(CiphertextVector &vec) {
   std::cout << "val (dec):\t" << decimal_value << std::endl;
 }
 
-int Cardio::ciphertextvector_to_int(CiphertextVector &vec) {
+int Cardio::bitvector_to_int(BitView vec) {
   std::stringstream ss;
   for (int i = vec.size() - 1; i >= 0; --i) {
-    seal::Plaintext p;
-    decryptor->decrypt(vec[i], p);
-    ss << encoder->decode_int32(p);
+    ss << decrypt_bit(vec[i]);
   }
   return strtol(ss.str().c_str(), nullptr, 2);
 }
@@ -284,13 +249,18 @@ void log_time(std::stringstream &ss,
 
 void Cardio::run_cardio() {
   std::stringstream ss_time;
+  // allocation statistics per phase, only collected if MEMORY_PROFILE is set
+  PhaseProfiler phase_profiler;
 
   // set up the BFV schema
+  phase_profiler.begin();
   auto t0 = Time::now();
   setup_context_bfv(16384, 2);
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  phase_profiler.end("t_keygen");
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
+  phase_profiler.begin();
   auto t2 = Time::now();
   // // encode and encrypt keystream
   // int32_t keystream[] = {241, 210, 225, 219, 92, 43, 197};
@@ -322,12 +292,14 @@ void Cardio::run_cardio() {
   auto drinking = encode_and_encrypt(4);
 
   auto t3 = Time::now();
+  phase_profiler.end("t_input_encryption");
   log_time(ss_time, t2, t3, false);
 
   // transmit data to server...
 
   // === server-side computation ====================================
 
+  phase_profiler.begin();
   auto t4 = Time::now();
 
   // homomorphically execute the Kreyvium algorithm
@@ -351,97 +323,124 @@ void Cardio::run_cardio() {
 
 
   // cardiac risk factor assessment algorithm
-  seal::Plaintext zero_ptxt = encoder->encode(0);
-  seal::Ciphertext zero;
-  encryptor->encrypt(zero_ptxt, zero);
-
   //TODO: In the "optimized" versions, we can also significantly lower the depth here by doing a tree of additions
-  CiphertextVector risk_score(8, zero);
+  // The conditions are independent sub-circuits, which run in parallel (see
+  // task_graph.h). The inputs they share are fresh, i.e., relinearized,
+  // ciphertexts and are only read.
+  TaskGraph graph;
+  std::vector<Bit> conditions(11);
+  std::vector<std::vector<TaskGraph::TaskId>> condition_tasks(11);
 
   // (flags[SEX_FIELD] & (50 < age))
-  seal::Ciphertext condition1;
-  CiphertextVector fifty = encode_and_encrypt(50);
-  evaluator->multiply(flags[SEX_FIELD], *lower(fifty, age), condition1);
-  evaluator->relinearize_inplace(condition1, *relinKeys);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition1));
+  condition_tasks[0] = {graph.add([&]() {
+    BitVector fifty = encode_constant(50);
+    Bit lower1 = lower(fifty, age);
+    conditions[0] = bitEvaluator->AND(flags[SEX_FIELD], lower1);
+  })};
 
   // flags[SEX_FIELD]+1 & (60 < age)
   // expected: true
-  seal::Ciphertext sex_female;
   // !flags[SEX_FIELD] == flags[SEX_FIELD]+1
-  evaluator->add_plain(flags[SEX_FIELD], encoder->encode(1), sex_female);
-  CiphertextVector sixty = encode_and_encrypt(60);
-  seal::Ciphertext condition2;
-  evaluator->multiply(sex_female, *lower(sixty, age), condition2);
-  evaluator->relinearize_inplace(condition2, *relinKeys);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition2));
+  Bit sex_female = bitEvaluator->NOT(flags[SEX_FIELD]);
+  condition_tasks[1] = {graph.add([&]() {
+    BitVector sixty = encode_constant(60);
+    Bit lower2 = lower(sixty, age);
+    conditions[1] = bitEvaluator->AND(sex_female, lower2);
+  })};
 
   // flags[ANTECEDENT_FIELD]
   // expected: true
-  risk_score =
-      add(risk_score, ctxt_to_ciphertextvector(flags[ANTECEDENT_FIELD]));
+  conditions[2] = flags[ANTECEDENT_FIELD];
 
   // flags[SMOKER_FIELD]
   // expected: true
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(flags[SMOKER_FIELD]));
+  conditions[3] = flags[SMOKER_FIELD];
 
   // flags[DIABETES_FIELD]
   // expected: true
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(flags[DIABETES_FIELD]));
+  conditions[4] = flags[DIABETES_FIELD];
 
   // flags[PRESSURE_FIELD]
   // expected: false
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(flags[PRESSURE_FIELD]));
+  conditions[5] = flags[PRESSURE_FIELD];
 
   // hdl < 40
   // expected: false
-  CiphertextVector fourty = encode_and_encrypt(40);
-  seal::Ciphertext condition7 = *lower(hdl, fourty);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition7));
+  condition_tasks[6] = {graph.add([&]() {
+    BitVector fourty = encode_constant(40);
+    conditions[6] = lower(hdl, fourty);
+  })};
 
   // weight > height-90
   // iff. height < weight+90
   // expected: false
-  CiphertextVector ninety = encode_and_encrypt(90);
-  CiphertextVector weight90 = add(weight, ninety);
-  seal::Ciphertext condition8 = *lower(height, weight90);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition8));
+  condition_tasks[7] = {graph.add([&]() {
+    BitVector ninety = encode_constant(90);
+    BitVector weight90 = add(weight, ninety);
+    conditions[7] = lower(height, weight90);
+  })};
 
   // physical_act < 30
   // expected: false
-  CiphertextVector thirty = encode_and_encrypt(30);
-  seal::Ciphertext condition9 = *lower(physical_act, thirty);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition9));
+  condition_tasks[8] = {graph.add([&]() {
+    BitVector thirty = encode_constant(30);
+    conditions[8] = lower(physical_act, thirty);
+  })};
 
   // flags[SEX_FIELD] && (3 < drinking)
   // expected: true
-  seal::Ciphertext condition10;
-  CiphertextVector three = encode_and_encrypt(3);
-  evaluator->multiply(flags[SEX_FIELD], *lower(three, drinking), condition10);
-  evaluator->relinearize_inplace(condition10, *relinKeys);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition10));
+  condition_tasks[9] = {graph.add([&]() {
+    BitVector three = encode_constant(3);
+    Bit lower10 = lower(three, drinking);
+    conditions[9] = bitEvaluator->AND(flags[SEX_FIELD], lower10);
+  })};
 
   // !flags[SEX_FIELD] && (2 < drinking)
   // expected: true
-  CiphertextVector two = encode_and_encrypt(2);
-  seal::Ciphertext condition11;
-  evaluator->multiply(sex_female, *lower(two, drinking), condition11);
-  evaluator->relinearize_inplace(condition11, *relinKeys);
-  risk_score = add(risk_score, ctxt_to_ciphertextvector(condition11));
+  condition_tasks[10] = {graph.add([&]() {
+    BitVector two = encode_constant(2);
+    Bit lower11 = lower(two, drinking);
+    conditions[10] = bitEvaluator->AND(sex_female, lower11);
+  })};
+
+  // the conditions are summed up one after another, each addition runs as
+  // soon as the previous one and its condition are done
+  // all bits are (symbolic) zeros, which fold away in the first add
+  BitVector risk_score(8);
+  std::vector<TaskGraph::TaskId> previous;
+  for (std::size_t i = 0; i < conditions.size(); ++i) {
+    std::vector<TaskGraph::TaskId> dependencies = condition_tasks[i];
+    dependencies.insert(dependencies.end(), previous.begin(), previous.end());
+    previous = {graph.add(
+        [&, i]() {
+          BitVector condition = bit_to_bitvector(conditions[i]);
+          risk_score = add(risk_score, condition);
+        },
+        dependencies)};
+  }
+
+  const std::size_t num_threads = num_threads_from_env("CARDIO_THREADS");
+  graph.run(num_threads);
 
   auto t5 = Time::now();
+  phase_profiler.end("t_computation");
   log_time(ss_time, t4, t5, false);
 
   // === client-side computation ====================================
 
+  phase_profiler.begin();
   auto t6 = Time::now();
 
   // decrypt and check result
-  int result = ciphertextvector_to_int(risk_score);
+  int result = bitvector_to_int(risk_score);
   assert(("Cardio benchmark does not produce expected result!", result==6));
   std::cout << "Result: " << result << std::endl;
+  std::cout << "Multiplications: " << lazyEvaluator->multiplications()
+            << ", folded gates: " << bitEvaluator->folded_gates()
+            << ", threads: " << num_threads << std::endl;
 
   auto t7 = Time::now();
+  phase_profiler.end("t_decryption");
   log_time(ss_time, t6, t7, true);
 
   // write ss_time into file
@@ -451,6 +450,26 @@ void Cardio::run_cardio() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write allocation statistics per phase into file
+  if (phase_profiler.is_enabled()) {
+    std::ofstream memory_file = open_csv_file(
+        "MEMORY_FILENAME", "memory_cardio_naive.csv", PhaseProfiler::header());
+    phase_profiler.write_csv(memory_file);
+  }
+
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("cardio-bfv-naive");
+  add_encryption_parameters(record, context);
+  record.set_parameter("threads", num_threads);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.set_metric("multiplications", lazyEvaluator->multiplications());
+  record.set_metric("relinearizations", lazyEvaluator->relinearizations());
+  record.set_metric("folded_gates", bitEvaluator->folded_gates());
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters.txt");
 }
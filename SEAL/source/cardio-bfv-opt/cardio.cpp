@@ -1,5 +1,9 @@
 #include "cardio.h"
 #include "../common.h"
+#include "../key_store.h"
+#include "../sweep.h"
+#include "../task_graph.h"
+#include "../timing.h"
 
 #define SEX_FIELD 0
 #define ANTECEDENT_FIELD 1
@@ -52,12 +56,12 @@ void Cardio::setup_context_bfv(std::size_t poly_modulus_degree,
   // Instantiate context
   context = seal::SEALContext::Create(params);
 
-  /// Create keys
-  seal::KeyGenerator keyGenerator(context);
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeySet keys = KeyStore::from_env().get(context, KeyRequest());
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -66,148 +70,137 @@ void Cardio::setup_context_bfv(std::size_t poly_modulus_degree,
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
   encoder = std::make_unique<seal::IntegerEncoder>(context);
+  lazyEvaluator = std::make_unique<LazyEvaluator>(*evaluator, *relinKeys);
+  bitEvaluator = std::make_unique<BitEvaluator>(*evaluator, *lazyEvaluator,
+                                                encoder->encode(1));
 }
 
-CiphertextVector Cardio::encode_and_encrypt(int32_t number) {
-  const static int NUM_BITS = 8;
-
-  // convert integer to binary
-  std::string bin = std::bitset<NUM_BITS>(number).to_string();
-
-  seal::Ciphertext zero;
-  encryptor->encrypt_zero(zero);
-  CiphertextVector result(NUM_BITS, zero);
-  for (int i = 0; i < NUM_BITS; ++i) {
-    // transform char -> int32_t
-    int32_t val = (int) bin.at(NUM_BITS - 1 - i) - 48;
+BitVector Cardio::encode_and_encrypt(std::int64_t number, int num_bits) {
+  BitVector result(num_bits);
+  for (int i = 0; i < num_bits; ++i) {
     // encode bit as integer
-    seal::Plaintext b = encoder->encode(val);
+    seal::Plaintext b = encoder->encode((int32_t) ((number >> i) & 1));
     // encrypt bit
-    encryptor->encrypt(b, result.at(i));
+    seal::Ciphertext ctxt;
+    encryptor->encrypt(b, ctxt);
+    result[i] = ctxt;
   }
 
   return result;
 }
 
-CiphertextVector Cardio::ctxt_to_ciphertextvector(seal::Ciphertext &ctxt) {
+BitVector Cardio::encode_constant(int32_t number) {
   const static int NUM_BITS = 8;
 
-  seal::Ciphertext zero;
-  encryptor->encrypt_zero(zero);
-  CiphertextVector result(8, zero);
-  result[0] = seal::Ciphertext(ctxt);
-
-  for (size_t i = 1; i < NUM_BITS; i++) {
-    encryptor->encrypt_zero(result.at(i));
+  BitVector result(NUM_BITS);
+  for (int i = 0; i < NUM_BITS; ++i) {
+    result[i] = Bit::constant((number >> i) & 1);
   }
+  return result;
+}
 
+BitVector Cardio::bit_to_bitvector(const Bit &bit) {
+  const static int NUM_BITS = 8;
+  BitVector result(NUM_BITS);
+  result[0] = bit;
   return result;
 }
 
-void Cardio::shift_left_inplace(CiphertextVector &ctxt) {
+void Cardio::shift_left_inplace(BitVector &ctxt) {
   for (std::size_t i = 1; i < ctxt.size(); ++i) {
     ctxt[i - 1] = ctxt[i];
   }
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
-  ctxt[7] = zero;
+  ctxt[7] = Bit();
 }
 
-void Cardio::shift_right_inplace(CiphertextVector &ctxt) {
+void Cardio::shift_right_inplace(BitVector &ctxt) {
   for (std::size_t i = ctxt.size() - 2; i > 0; --i) {
     ctxt[i + 1] = ctxt[i];
   }
-  seal::Ciphertext zero;
-  encryptor->encrypt(encoder->encode(0), zero);
-  ctxt[0] = zero;
+  ctxt[0] = Bit();
 }
 
-std::unique_ptr<seal::Ciphertext> Cardio::multvect(CiphertextVector bitvec) {
-  const int size = bitvec.size();
+void Cardio::multvect_inplace(BitView bits) {
+  const int size = bits.size();
   for (std::size_t k = 1; k < size; k *= 2) {
     for (std::size_t i = 0; i < size - k; i += 2*k) {
-      evaluator->multiply_inplace(bitvec[i], bitvec[i + k]);
-      evaluator->relinearize_inplace(bitvec[i], *relinKeys);
+      bits[i] = bitEvaluator->AND(bits[i], bits[i + k]);
     }
   }
-  return std::make_unique<seal::Ciphertext>(bitvec[0]);
 }
 
-std::unique_ptr<seal::Ciphertext> Cardio::equal(CiphertextVector lhs,
-                                                CiphertextVector rhs) {
+Bit Cardio::equal(BitView lhs, BitView rhs) {
   assert(("equal supports same-sized inputs only!", lhs.size()==rhs.size()));
 
-  CiphertextVector comp;
+  BitVector comp;
   for (std::size_t i = 0; i < lhs.size(); ++i) {
-    seal::Ciphertext tmp;
-    evaluator->add(lhs[i], rhs[i], tmp);
-    evaluator->add_plain_inplace(tmp, encoder->encode(1));  // negate tmp
-    comp.push_back(tmp);
+    // XNOR
+    comp.push_back(bitEvaluator->NOT(bitEvaluator->XOR(lhs[i], rhs[i])));
   }
-  return multvect(comp);
+  multvect_inplace(comp);
+  return std::move(comp[0]);
 }
 
-void Cardio::pre_computation(std::vector<CiphertextVector> &P,
-                             std::vector<CiphertextVector> &G,
-                             CiphertextVector &lhs, CiphertextVector &rhs) {
+void Cardio::pre_computation(std::vector<BitVector> &P,
+                             std::vector<BitVector> &G, BitView lhs,
+                             BitView rhs) {
   const int size = lhs.size();
+  // the inputs are multiplied below, relinearizing them first also keeps P
+  // from being relinearized a second time
   for (size_t i = 0; i < size; ++i) {
-    evaluator->add(lhs[i], rhs[i], P[i][i]);
+    bitEvaluator->relinearize(lhs[i]);
+    bitEvaluator->relinearize(rhs[i]);
+    P[i][i] = bitEvaluator->XOR(lhs[i], rhs[i]);
   }
   for (size_t i = 0; i < size - 1; ++i) {
-    evaluator->multiply(lhs[i], rhs[i], G[i][i]);
-    evaluator->relinearize_inplace(G[i][i], *relinKeys);
+    G[i][i] = bitEvaluator->AND(lhs[i], rhs[i]);
   }
 }
 
-void Cardio::print_ciphertext(std::string name, seal::Ciphertext &ctxt) {
+int Cardio::decrypt_bit(Bit &bit) {
+  // constant bits are part of the (public) circuit, i.e., known to the
+  // client as well
+  if (bit.is_constant()) return bit.value();
   seal::Plaintext p;
-  decryptor->decrypt(ctxt, p);
-  std::cout << name << ": " << encoder->decode_int32(p) << std::flush
-            << std::endl;
+  decryptor->decrypt(bit.ciphertext(), p);
+  return encoder->decode_int32(p);
+}
+
+void Cardio::print_bit(std::string name, Bit &bit) {
+  std::cout << name << ": " << decrypt_bit(bit) << std::flush << std::endl;
 }
 
-void Cardio::evaluate_G(std::vector<CiphertextVector> &P,
-                        std::vector<CiphertextVector> &G, int row_idx,
-                        int col_idx, int step) {
+void Cardio::evaluate_G(std::vector<BitVector> &P, std::vector<BitVector> &G,
+                        int row_idx, int col_idx, int step) {
   int k = col_idx + (int) std::pow(2, step - 1);
-  seal::Ciphertext r;
-  encryptor->encrypt_zero(r);
-  evaluator->multiply(P[row_idx][k], G[k - 1][col_idx], r);
-  evaluator->relinearize_inplace(r, *relinKeys);
-  evaluator->add(G[row_idx][k], r, G[row_idx][col_idx]);
+  Bit r = bitEvaluator->AND(P[row_idx][k], G[k - 1][col_idx]);
+  G[row_idx][col_idx] = bitEvaluator->XOR(G[row_idx][k], r);
 }
 
-void Cardio::evaluate_P(std::vector<CiphertextVector> &P,
-                        std::vector<CiphertextVector> &G, int row_idx,
-                        int col_idx, int step) {
+void Cardio::evaluate_P(std::vector<BitVector> &P, std::vector<BitVector> &G,
+                        int row_idx, int col_idx, int step) {
   int k = col_idx + (int) std::pow(2, step - 1);
-  evaluator->multiply(P[row_idx][k], P[k - 1][col_idx], P[row_idx][col_idx]);
-  evaluator->relinearize_inplace(P[row_idx][col_idx], *relinKeys);
+  P[row_idx][col_idx] = bitEvaluator->AND(P[row_idx][k], P[k - 1][col_idx]);
 }
 
-CiphertextVector Cardio::post_computation(std::vector<CiphertextVector> &P,
-                                          std::vector<CiphertextVector> &G,
-                                          int size) {
-  seal::Ciphertext zero;
-  encryptor->encrypt_zero(zero);
-  CiphertextVector res(size, zero);
+BitVector Cardio::post_computation(std::vector<BitVector> &P,
+                                   std::vector<BitVector> &G, int size) {
+  BitVector res(size);
   res[0] = P[0][0];
   for (size_t i = 1; i < size; ++i) {
-    evaluator->add(P[i][i], G[i - 1][0], res[i]);
+    res[i] = bitEvaluator->XOR(P[i][i], G[i - 1][0]);
   }
   return res;
 }
 
-CiphertextVector Cardio::add(CiphertextVector lhs, CiphertextVector rhs) {
+BitVector Cardio::add(BitView lhs, BitView rhs) {
   /// Implements the Sklansky Adder.
-  CiphertextVector res;
+  BitVector res;
 
   int size = lhs.size();
-  seal::Ciphertext zero;
-  encryptor->encrypt_zero(zero);
-  std::vector<CiphertextVector> P(size, CiphertextVector(size, zero));
-  std::vector<CiphertextVector> G(size, CiphertextVector(size, zero));
+  // entries that are never computed stay (symbolic) zeros
+  std::vector<BitVector> P(size, BitVector(size));
+  std::vector<BitVector> G(size, BitVector(size));
 
   int num_steps = 0;
   if (size > 1) num_steps = (int) std::floor(std::log2((double) size - 1)) + 1;
@@ -235,53 +228,61 @@ CiphertextVector Cardio::add(CiphertextVector lhs, CiphertextVector rhs) {
       row += (int) std::pow(2, step - 1);
     }
   }
-  // compute results
+  // compute results, the bits are copied into further circuits and hence
+  // relinearized before they are returned
   res = post_computation(P, G, size);
+  for (auto &bit : res) bitEvaluator->relinearize(bit);
   return res;
 }
 
-CiphertextVector Cardio::slice(CiphertextVector ctxt, int idx_begin,
-                               int idx_end) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.begin() + idx_end);
-}
-
-CiphertextVector Cardio::slice(CiphertextVector ctxt, int idx_begin) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.end());
-}
-
 // return lhs < rhs
-std::unique_ptr<seal::Ciphertext> Cardio::lower(CiphertextVector &lhs,
-                                                CiphertextVector &rhs) {
-  std::unique_ptr<seal::Ciphertext> result =
-      std::make_unique<seal::Ciphertext>();
-
+Bit Cardio::lower(BitView lhs, BitView rhs) {
   const int len = lhs.size();
   if (len==1) {
-    seal::Ciphertext lhs_neg;
     // andNY(lhs[0], rhs[0]) = !(lhs[0]) & rhs[0]
-    evaluator->add_plain(lhs[0], encoder->encode(1), lhs_neg);
-    evaluator->multiply(lhs_neg, rhs[0], *result);
-    evaluator->relinearize_inplace(*result, *relinKeys);
-    return result;
+    Bit lhs_neg = bitEvaluator->NOT(lhs[0]);
+    return bitEvaluator->AND(lhs_neg, rhs[0]);
   }
 
   const int len2 = len >> 1;
 
-  CiphertextVector lhs_l = slice(lhs, 0, len2);
-  CiphertextVector lhs_h = slice(lhs, len2);
+  // views, the halves are not copied
+  BitView lhs_l = lhs.slice(0, len2);
+  BitView lhs_h = lhs.slice(len2);
 
-  CiphertextVector rhs_l = slice(rhs, 0, len2);
-  CiphertextVector rhs_h = slice(rhs, len2);
+  BitView rhs_l = rhs.slice(0, len2);
+  BitView rhs_h = rhs.slice(len2);
 
-  seal::Ciphertext term1 = *lower(lhs_h, rhs_h);
-  seal::Ciphertext term2;
-  evaluator->multiply(*equal(lhs_h, rhs_h), *lower(lhs_l, rhs_l), term2);
-  evaluator->relinearize_inplace(term2, *relinKeys);
-  evaluator->add(term1, term2, *result);
-  return result;
+  Bit term1 = lower(lhs_h, rhs_h);
+  Bit h_equal = equal(lhs_h, rhs_h);
+  Bit l_lower = lower(lhs_l, rhs_l);
+  Bit term2 = bitEvaluator->AND(h_equal, l_lower);
+  // both terms are relinearized at once, when the result is used next
+  return bitEvaluator->XOR(term1, term2);
 }
 
-void Cardio::print_ciphertextvector(CiphertextVector &vec) {
+Bit Cardio::lower_copying(BitVector lhs, BitVector rhs) {
+  const int len = lhs.size();
+  if (len==1) return lower(lhs, rhs);
+
+  const int len2 = len >> 1;
+
+  BitVector lhs_l(lhs.begin(), lhs.begin() + len2);
+  BitVector lhs_h(lhs.begin() + len2, lhs.end());
+
+  BitVector rhs_l(rhs.begin(), rhs.begin() + len2);
+  BitVector rhs_h(rhs.begin() + len2, rhs.end());
+
+  Bit term1 = lower_copying(lhs_h, rhs_h);
+  // equal() took its arguments by value
+  BitVector lhs_h_copy(lhs_h), rhs_h_copy(rhs_h);
+  Bit h_equal = equal(lhs_h_copy, rhs_h_copy);
+  Bit l_lower = lower_copying(lhs_l, rhs_l);
+  Bit term2 = bitEvaluator->AND(h_equal, l_lower);
+  return bitEvaluator->XOR(term1, term2);
+}
+
+void Cardio::print_bitvector(BitView vec) {
   std::cout << "size: " << vec.size() << std::endl;
 
   std::cout << "idx:\t\t";
@@ -292,9 +293,7 @@ void Cardio::print_ciphertextvector(CiphertextVector &vec) {
   std::cout << std::endl << "val (bin):\t";
   std::stringstream ss;
   for (int i = vec.size() - 1; i >= 0; --i) {
-    seal::Plaintext p;
-    decryptor->decrypt(vec[i], p);
-    auto value = encoder->decode_int32(p);
+    auto value = decrypt_bit(vec[i]);
     std::cout << value << " " << std::flush;
     ss << value;
   }
@@ -304,12 +303,10 @@ void Cardio::print_ciphertextvector(CiphertextVector &vec) {
   std::cout << "val (dec):\t" << decimal_value << std::endl;
 }
 
-int Cardio::ciphertextvector_to_int(CiphertextVector &vec) {
+int Cardio::bitvector_to_int(BitView vec) {
   std::stringstream ss;
   for (int i = vec.size() - 1; i >= 0; --i) {
-    seal::Plaintext p;
-    decryptor->decrypt(vec[i], p);
-    ss << encoder->decode_int32(p);
+    ss << decrypt_bit(vec[i]);
   }
   return strtol(ss.str().c_str(), nullptr, 2);
 }
@@ -326,13 +323,18 @@ void log_time(std::stringstream &ss,
 
 void Cardio::run_cardio() {
   std::stringstream ss_time;
+  // allocation statistics per phase, only collected if MEMORY_PROFILE is set
+  PhaseProfiler phase_profiler;
 
   // set up the BFV schema
+  phase_profiler.begin();
   auto t0 = Time::now();
   setup_context_bfv(16384, 2);
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  phase_profiler.end("t_keygen");
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
+  phase_profiler.begin();
   auto t2 = Time::now();
   // // encode and encrypt keystream
   // int32_t keystream[] = {241, 210, 225, 219, 92, 43, 197};
@@ -364,12 +366,14 @@ void Cardio::run_cardio() {
   auto drinking = encode_and_encrypt(4);
 
   auto t3 = Time::now();
+  phase_profiler.end("t_input_encryption");
   log_time(ss_time, t2, t3, false);
 
   // transmit data to server...
 
   // === server-side computation ====================================
 
+  phase_profiler.begin();
   auto t4 = Time::now();
 
   // homomorphically execute the Kreyvium algorithm
@@ -392,23 +396,41 @@ void Cardio::run_cardio() {
   // }
 
   // cardiac risk factor assessment algorithm
-  // (flags[SEX_FIELD] & (50 < age))
-  seal::Ciphertext condition1;
-  CiphertextVector fifty = encode_and_encrypt(50);
-  evaluator->multiply(flags[SEX_FIELD], *lower(fifty, age), condition1);
-  evaluator->relinearize_inplace(condition1, *relinKeys);
+  // The conditions are independent sub-circuits, which run in parallel and
+  // are merged in the addition tree (see task_graph.h). The inputs they
+  // share are fresh, i.e., relinearized, ciphertexts and are only read.
+  TaskGraph graph;
+  Bit condition1, condition2, condition7, condition8, condition9, condition10,
+      condition11;
+  BitVector risk_score_1_2, risk_score_3_4, risk_score_5_6, risk_score_7_8,
+      risk_score_9_10, risk_score_1_2_3_4, risk_score_5_6_7_8,
+      risk_score_9_10_11, risk_score_1_2_3_4_5_6_7_8, risk_score;
 
   // flags[SEX_FIELD]+1 & (60 < age)
   // expected: true
-  seal::Ciphertext sex_female;
   // !flags[SEX_FIELD] == flags[SEX_FIELD]+1
-  evaluator->add_plain(flags[SEX_FIELD], encoder->encode(1), sex_female);
-  CiphertextVector sixty = encode_and_encrypt(60);
-  seal::Ciphertext condition2;
-  evaluator->multiply(sex_female, *lower(sixty, age), condition2);
-  evaluator->relinearize_inplace(condition2, *relinKeys);
+  Bit sex_female = bitEvaluator->NOT(flags[SEX_FIELD]);
 
-  auto risk_score_1_2 = add(ctxt_to_ciphertextvector(condition2), ctxt_to_ciphertextvector(condition1));
+  // (flags[SEX_FIELD] & (50 < age))
+  auto task1 = graph.add([&]() {
+    BitVector fifty = encode_constant(50);
+    Bit lower1 = lower(fifty, age);
+    condition1 = bitEvaluator->AND(flags[SEX_FIELD], lower1);
+  });
+
+  auto task2 = graph.add([&]() {
+    BitVector sixty = encode_constant(60);
+    Bit lower2 = lower(sixty, age);
+    condition2 = bitEvaluator->AND(sex_female, lower2);
+  });
+
+  auto task1_2 = graph.add(
+      [&]() {
+        BitVector lhs = bit_to_bitvector(condition2);
+        BitVector rhs = bit_to_bitvector(condition1);
+        risk_score_1_2 = add(lhs, rhs);
+      },
+      {task1, task2});
 
   // flags[ANTECEDENT_FIELD]
   // expected: true
@@ -416,70 +438,128 @@ void Cardio::run_cardio() {
 
   // flags[SMOKER_FIELD]
   // expected: true
-  auto risk_score_3_4 =
-      add(ctxt_to_ciphertextvector(flags[ANTECEDENT_FIELD]), ctxt_to_ciphertextvector(flags[SMOKER_FIELD]));
+  auto task3_4 = graph.add([&]() {
+    BitVector lhs = bit_to_bitvector(flags[ANTECEDENT_FIELD]);
+    BitVector rhs = bit_to_bitvector(flags[SMOKER_FIELD]);
+    risk_score_3_4 = add(lhs, rhs);
+  });
 
   // flags[DIABETES_FIELD]
   // expected: true
 
   // flags[PRESSURE_FIELD]
   // expected: false
-  auto risk_score_5_6 =
-      add(ctxt_to_ciphertextvector(flags[DIABETES_FIELD]), ctxt_to_ciphertextvector(flags[PRESSURE_FIELD]));
+  auto task5_6 = graph.add([&]() {
+    BitVector lhs = bit_to_bitvector(flags[DIABETES_FIELD]);
+    BitVector rhs = bit_to_bitvector(flags[PRESSURE_FIELD]);
+    risk_score_5_6 = add(lhs, rhs);
+  });
 
   // hdl < 40
   // expected: false
-  CiphertextVector fourty = encode_and_encrypt(40);
-  seal::Ciphertext condition7 = *lower(hdl, fourty);
+  auto task7 = graph.add([&]() {
+    BitVector fourty = encode_constant(40);
+    condition7 = lower(hdl, fourty);
+  });
 
   // weight > height-90
   // iff. height < weight+90
   // expected: false
-  CiphertextVector ninety = encode_and_encrypt(90);
-  CiphertextVector weight90 = add(weight, ninety);
-  seal::Ciphertext condition8 = *lower(height, weight90);
-  auto risk_score_7_8 = add(ctxt_to_ciphertextvector(condition7), ctxt_to_ciphertextvector(condition8));
+  auto task8 = graph.add([&]() {
+    BitVector ninety = encode_constant(90);
+    BitVector weight90 = add(weight, ninety);
+    condition8 = lower(height, weight90);
+  });
+
+  auto task7_8 = graph.add(
+      [&]() {
+        BitVector lhs = bit_to_bitvector(condition7);
+        BitVector rhs = bit_to_bitvector(condition8);
+        risk_score_7_8 = add(lhs, rhs);
+      },
+      {task7, task8});
 
   // physical_act < 30
   // expected: false
-  CiphertextVector thirty = encode_and_encrypt(30);
-  seal::Ciphertext condition9 = *lower(physical_act, thirty);
+  auto task9 = graph.add([&]() {
+    BitVector thirty = encode_constant(30);
+    condition9 = lower(physical_act, thirty);
+  });
 
   // flags[SEX_FIELD] && (3 < drinking)
   // expected: true
-  seal::Ciphertext condition10;
-  CiphertextVector three = encode_and_encrypt(3);
-  evaluator->multiply(flags[SEX_FIELD], *lower(three, drinking), condition10);
-  evaluator->relinearize_inplace(condition10, *relinKeys);
-  auto risk_score_9_10 = add(ctxt_to_ciphertextvector(condition9), ctxt_to_ciphertextvector(condition10));
+  auto task10 = graph.add([&]() {
+    BitVector three = encode_constant(3);
+    Bit lower10 = lower(three, drinking);
+    condition10 = bitEvaluator->AND(flags[SEX_FIELD], lower10);
+  });
+
+  auto task9_10 = graph.add(
+      [&]() {
+        BitVector lhs = bit_to_bitvector(condition9);
+        BitVector rhs = bit_to_bitvector(condition10);
+        risk_score_9_10 = add(lhs, rhs);
+      },
+      {task9, task10});
 
   // !flags[SEX_FIELD] && (2 < drinking)
   // expected: true
-  CiphertextVector two = encode_and_encrypt(2);
-  seal::Ciphertext condition11;
-  evaluator->multiply(sex_female, *lower(two, drinking), condition11);
-  evaluator->relinearize_inplace(condition11, *relinKeys);
-
-  auto risk_score_1_2_3_4 = add(risk_score_1_2, risk_score_3_4);
-  auto risk_score_5_6_7_8 = add(risk_score_5_6, risk_score_7_8);
-  auto risk_score_9_10_11 = add(risk_score_9_10, ctxt_to_ciphertextvector(condition11));
-
-  auto risk_score_1_2_3_4_5_6_7_8 = add(risk_score_1_2_3_4, risk_score_5_6_7_8);
-  auto risk_score = add(risk_score_1_2_3_4_5_6_7_8, risk_score_9_10_11);
+  auto task11 = graph.add([&]() {
+    BitVector two = encode_constant(2);
+    Bit lower11 = lower(two, drinking);
+    condition11 = bitEvaluator->AND(sex_female, lower11);
+  });
+
+  auto task1_2_3_4 = graph.add(
+      [&]() { risk_score_1_2_3_4 = add(risk_score_1_2, risk_score_3_4); },
+      {task1_2, task3_4});
+  auto task5_6_7_8 = graph.add(
+      [&]() { risk_score_5_6_7_8 = add(risk_score_5_6, risk_score_7_8); },
+      {task5_6, task7_8});
+  auto task9_10_11 = graph.add(
+      [&]() {
+        BitVector rhs = bit_to_bitvector(condition11);
+        risk_score_9_10_11 = add(risk_score_9_10, rhs);
+      },
+      {task9_10, task11});
+
+  auto task1_2_3_4_5_6_7_8 = graph.add(
+      [&]() {
+        risk_score_1_2_3_4_5_6_7_8 =
+            add(risk_score_1_2_3_4, risk_score_5_6_7_8);
+      },
+      {task1_2_3_4, task5_6_7_8});
+  graph.add(
+      [&]() {
+        risk_score = add(risk_score_1_2_3_4_5_6_7_8, risk_score_9_10_11);
+      },
+      {task1_2_3_4_5_6_7_8, task9_10_11});
+
+  const std::size_t num_threads = num_threads_from_env("CARDIO_THREADS");
+  graph.run(num_threads);
 
   auto t5 = Time::now();
+  phase_profiler.end("t_computation");
   log_time(ss_time, t4, t5, false);
 
   // === client-side computation ====================================
 
+  phase_profiler.begin();
   auto t6 = Time::now();
 
   // decrypt and check result
-  int result = ciphertextvector_to_int(risk_score);
+  int result = bitvector_to_int(risk_score);
   assert(("Cardio benchmark does not produce expected result!", result==6));
   std::cout << "Result: " << result << std::endl;
+  std::cout << "Relinearizations: " << lazyEvaluator->relinearizations()
+            << " (" << lazyEvaluator->removed_relinearizations()
+            << " removed by lazy relinearization)" << std::endl;
+  std::cout << "Multiplications: " << lazyEvaluator->multiplications()
+            << ", folded gates: " << bitEvaluator->folded_gates()
+            << ", threads: " << num_threads << std::endl;
 
   auto t7 = Time::now();
+  phase_profiler.end("t_decryption");
   log_time(ss_time, t6, t7, true);
 
   // write ss_time into file
@@ -489,13 +569,114 @@ void Cardio::run_cardio() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write allocation statistics per phase into file
+  if (phase_profiler.is_enabled()) {
+    std::ofstream memory_file = open_csv_file(
+        "MEMORY_FILENAME", "memory_cardio.csv", PhaseProfiler::header());
+    phase_profiler.write_csv(memory_file);
+  }
+
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("cardio-bfv-opt");
+  add_encryption_parameters(record, context);
+  record.set_parameter("threads", num_threads);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.set_metric("multiplications", lazyEvaluator->multiplications());
+  record.set_metric("relinearizations", lazyEvaluator->relinearizations());
+  record.set_metric("relinearizations_removed",
+                    lazyEvaluator->removed_relinearizations());
+  record.set_metric("folded_gates", bitEvaluator->folded_gates());
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_cardio.txt");
 }
 
+void Cardio::run_comparisons() {
+  std::vector<int> bit_widths = {8, 16, 32};
+  if (auto v = std::getenv("COMPARISON_BITS")) {
+    bit_widths = parse_int_list(v, ',');
+  }
+
+  setup_context_bfv(16384, 2);
+  const TimingConfig timing_config = TimingConfig::from_env();
+
+  std::ofstream file = open_csv_file(
+      "COMPARISON_FILENAME", "cardio_comparison.csv",
+      parameters_csv_header() + ",bits,implementation,multiplications," +
+          timing_stats_header() + "," + memory_stats_header());
+
+  // random but reproducible operands
+  std::mt19937_64 gen(42);
+  for (int num_bits : bit_widths) {
+    std::uniform_int_distribution<std::int64_t> dist(
+        0, (std::int64_t(1) << num_bits) - 1);
+    const std::int64_t a = dist(gen), b = dist(gen);
+    BitVector lhs = encode_and_encrypt(a, num_bits);
+    BitVector rhs = encode_and_encrypt(b, num_bits);
+
+    for (bool copying : {false, true}) {
+      const std::string implementation = copying ? "copying" : "views";
+      // lower() only relinearizes its (fresh) inputs, which is a no-op, so
+      // all runs see the same inputs
+      Bit result;
+      lazyEvaluator->reset_counters();
+      auto op = [&]() {
+        result = copying ? lower_copying(lhs, rhs) : lower(lhs, rhs);
+      };
+      op();
+      const std::size_t multiplications = lazyEvaluator->multiplications();
+      if (decrypt_bit(result) != (a < b)) {
+        throw std::runtime_error("Wrong result of " + implementation + " " +
+                                 std::to_string(a) + " < " +
+                                 std::to_string(b));
+      }
+      OperationResult measured = measure_operation(
+          timing_config, implementation, []() {}, op);
+
+      std::cout << num_bits << "-bit lower (" << implementation
+                << "): " << measured.timing.mean_ns / 1e6 << " ms";
+      if (measured.memory.measured) {
+        std::cout << ", " << measured.memory.allocated_bytes
+                  << " bytes allocated";
+      }
+      std::cout << std::endl;
+
+      write_parameters_csv(file, context);
+      file << "," << num_bits << "," << implementation << ","
+           << multiplications << ",";
+      write_timing_stats(file, measured.timing);
+      file << ",";
+      write_memory_stats(file, measured.memory);
+      file << std::endl;
+
+      ResultRecord record("cardio-bfv-opt-comparison");
+      add_encryption_parameters(record, context);
+      record.set_parameter("bits", num_bits);
+      record.set_parameter("implementation", implementation);
+      record.add_timing("t_comparison",
+                        std::chrono::nanoseconds(
+                            (long long) measured.timing.mean_ns));
+      record.set_metric("multiplications", multiplications);
+      if (measured.memory.measured) {
+        record.set_metric("allocated_bytes", measured.memory.allocated_bytes);
+        record.set_metric("peak_heap_bytes", measured.memory.peak_heap_bytes);
+      }
+      record.write();
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'cardio-bfv'..." << std::endl;
-  Cardio().run_cardio();
+  if (has_flag(argc, argv, "--comparison")) {
+    Cardio().run_comparisons();
+  } else {
+    Cardio().run_cardio();
+  }
 
   return 0;
 }
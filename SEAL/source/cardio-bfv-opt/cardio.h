@@ -17,7 +17,8 @@
 #include <random>
 #include <vector>
 
-typedef std::vector<seal::Ciphertext> CiphertextVector;
+#include "../encrypted_bits.h"
+
 typedef std::chrono::high_resolution_clock Time;
 typedef std::chrono::milliseconds ms;
 
@@ -38,33 +39,42 @@ class Cardio {
   /// keys required to relinearize after multipliction (ptr for consistency)
   std::unique_ptr<seal::RelinKeys> relinKeys;
 
+  /// whether the keys were loaded from the key store instead of generated
+  bool keysLoaded = false;
+
   std::unique_ptr<seal::Encryptor> encryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::IntegerEncoder> encoder;
 
-  void pre_computation(std::vector<CiphertextVector> &P,
-                       std::vector<CiphertextVector> &G, CiphertextVector &lhs,
-                       CiphertextVector &rhs);
+  /// ciphertext-ciphertext multiplications, relinearized lazily
+  std::unique_ptr<LazyEvaluator> lazyEvaluator;
+
+  /// gates on bits, folds the constants of the server
+  std::unique_ptr<BitEvaluator> bitEvaluator;
 
-  void evaluate_G(std::vector<CiphertextVector> &P,
-                  std::vector<CiphertextVector> &G, int row_idx, int col_idx,
-                  int step);
+  void pre_computation(std::vector<BitVector> &P, std::vector<BitVector> &G,
+                       BitView lhs, BitView rhs);
 
-  void evaluate_P(std::vector<CiphertextVector> &P,
-                  std::vector<CiphertextVector> &G, int row_idx, int col_idx,
-                  int step);
+  void evaluate_G(std::vector<BitVector> &P, std::vector<BitVector> &G,
+                  int row_idx, int col_idx, int step);
 
-  CiphertextVector post_computation(std::vector<CiphertextVector> &P,
-                                    std::vector<CiphertextVector> &G, int size);
+  void evaluate_P(std::vector<BitVector> &P, std::vector<BitVector> &G,
+                  int row_idx, int col_idx, int step);
 
-  void print_ciphertext(std::string name, seal::Ciphertext &ctxt);
+  BitVector post_computation(std::vector<BitVector> &P,
+                             std::vector<BitVector> &G, int size);
 
-  void print_ciphertextvector(CiphertextVector &vec);
+  int decrypt_bit(Bit &bit);
 
-  int ciphertextvector_to_int(CiphertextVector &vec);
+  void print_bit(std::string name, Bit &bit);
 
-  CiphertextVector ctxt_to_ciphertextvector(seal::Ciphertext &ctxt);
+  void print_bitvector(BitView vec);
+
+  int bitvector_to_int(BitView vec);
+
+  /// The bit as least significant bit of an otherwise zero integer.
+  BitVector bit_to_bitvector(const Bit &bit);
 
  public:
   void setup_context_bfv(std::size_t poly_modulus_degree,
@@ -72,25 +82,31 @@ class Cardio {
 
   void run_cardio();
 
-  CiphertextVector encode_and_encrypt(int32_t number);
+  /// Times and profiles lower() against lower_copying() on random values of
+  /// COMPARISON_BITS bits (default: 8,16,32).
+  void run_comparisons();
+
+  BitVector encode_and_encrypt(std::int64_t number, int num_bits = 8);
 
-  std::unique_ptr<seal::Ciphertext> equal(CiphertextVector lhs,
-                                          CiphertextVector rhs);
+  /// A constant of the server, which is never encrypted.
+  BitVector encode_constant(int32_t number);
 
-  void shift_right_inplace(CiphertextVector &ctxt);
+  Bit equal(BitView lhs, BitView rhs);
 
-  void shift_left_inplace(CiphertextVector &ctxt);
+  void shift_right_inplace(BitVector &ctxt);
 
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin, int idx_end);
+  void shift_left_inplace(BitVector &ctxt);
 
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin);
+  /// ANDs all bits into bits[0].
+  void multvect_inplace(BitView bits);
 
-  std::unique_ptr<seal::Ciphertext> multvect(CiphertextVector bitvec);
+  Bit lower(BitView lhs, BitView rhs);
 
-  std::unique_ptr<seal::Ciphertext> lower(CiphertextVector &lhs,
-                                          CiphertextVector &rhs);
+  /// lower() as implemented before bit views, i.e., with deep copies of the
+  /// halves and of the arguments of equal(). Baseline of run_comparisons().
+  Bit lower_copying(BitVector lhs, BitVector rhs);
 
-  CiphertextVector add(CiphertextVector lhs, CiphertextVector rhs);
+  BitVector add(BitView lhs, BitView rhs);
 
   int main(int argc, char *argv[]);
 };
@@ -1,16 +1,29 @@
 #include "cardio-batched.h"
 #include "../common.h"
+#include "../key_store.h"
+#include "../sweep.h"
+#include "../targets.h"
+#include "../timing.h"
 
 /*
  * Batched CKKS implementation for cardio benchmark.
  */
 
-void CardioBatched::setup_context_ckks(std::size_t poly_modulus_degree) {
+void CardioBatched::setup_context_ckks() {
+  // Only generate those keys that are actually required/used
+  const TargetParameters &target = target_parameters("cardio_ckks_batched");
+  setup_context_ckks(target.parameters.poly_modulus_degree,
+                     target.parameters.coeff_modulus_bits,
+                     target.rotation_steps);
+}
+
+void CardioBatched::setup_context_ckks(
+    std::size_t poly_modulus_degree, const std::vector<int> &coeff_modulus_bits,
+    const std::vector<int> &galois_steps) {
   seal::EncryptionParameters params(seal::scheme_type::CKKS);
   params.set_poly_modulus_degree(poly_modulus_degree);
-  params.set_coeff_modulus(seal::CoeffModulus::Create(
-      poly_modulus_degree,
-      {60, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 60}));
+  params.set_coeff_modulus(
+      seal::CoeffModulus::Create(poly_modulus_degree, coeff_modulus_bits));
 
   // Instantiate context
   context = seal::SEALContext::Create(params);
@@ -18,32 +31,16 @@ void CardioBatched::setup_context_ckks(std::size_t poly_modulus_degree) {
   // Define initial ciphertext scale
   initial_scale = std::pow(2.0, 40);
 
-  // Create keys
-  seal::KeyGenerator keyGenerator(context);
-
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  // std::ofstream ofs_pk("public_key.dat", std::ios::binary);
-  // publicKey->save(ofs_pk);
-  // ofs_pk.close();
-
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  // std::ofstream ofs_sk("secret_key.dat", std::ios::binary);
-  // secretKey->save(ofs_sk);
-  // ofs_sk.close();
-
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
-  // std::ofstream ofs_rk("relin_keys.dat", std::ios::binary);
-  // relinKeys->save(ofs_rk);
-  // ofs_rk.close();
-
-  // Only generate those keys that are actually required/used
-  std::vector<int> steps = {-1, -2, -3, -4, -5, -6, -7, 8, 16, 32, 56, 64, 72};
-  galoisKeys =
-      std::make_unique<seal::GaloisKeys>(keyGenerator.galois_keys_local(steps));
-  // std::ofstream ofs_gk("galois_keys.dat", std::ios::binary);
-  // galoisKeys->save(ofs_gk);
-  // ofs_gk.close();
+  // Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeyRequest key_request;
+  key_request.galois_keys = true;
+  key_request.galois_steps = galois_steps;
+  KeySet keys = KeyStore::from_env().get(context, key_request);
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
+  galoisKeys = std::move(keys.galois_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -51,43 +48,30 @@ void CardioBatched::setup_context_ckks(std::size_t poly_modulus_degree) {
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
   encoder = std::make_unique<seal::CKKSEncoder>(context);
+  plaintextCache = std::make_unique<PlaintextCache>(context);
+  lazyEvaluator = std::make_unique<LazyEvaluator>(*evaluator, *relinKeys);
   // std::cout << "Number of slots: " << encoder->slot_count() << std::endl;
 }
 
-CiphertextVector CardioBatched::slice(CiphertextVector ctxt, int idx_begin,
-                                      int idx_end) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.begin() + idx_end);
-}
-
-CiphertextVector CardioBatched::slice(CiphertextVector ctxt, int idx_begin) {
-  return CiphertextVector(ctxt.begin() + idx_begin, ctxt.end());
-}
-
 // return lhs < rhs
-std::unique_ptr<seal::Ciphertext> CardioBatched::lower(CiphertextVector &lhs,
-                                                       CiphertextVector &rhs) {
-  std::unique_ptr<seal::Ciphertext> result =
-      std::make_unique<seal::Ciphertext>();
+seal::Ciphertext CardioBatched::lower(CiphertextView lhs,
+                                      CiphertextView rhs) {
+  seal::Ciphertext result;
 
   const int len = lhs.size();
   if (len == 1) {
     // andNY(lhs[0], rhs[0]) = !(lhs[0]) & rhs[0]
-    seal::Plaintext one;
-    encoder->encode(1.0, lhs[0].parms_id(), lhs[0].scale(), one);
+    const seal::Plaintext &one =
+        plaintextCache->ckks(1.0, lhs[0].parms_id(), lhs[0].scale());
     seal::Ciphertext lhs_neg = XOR(lhs[0], one);
     evaluator->rescale_to_next_inplace(lhs_neg);
     lhs_neg.scale() = initial_scale;
-    evaluator->mod_switch_to_inplace(rhs[0], lhs_neg.parms_id());
-    // print_info(lhs_neg);
-    // print_info(rhs[0]);
-    evaluator->multiply(lhs_neg, rhs[0], *result);
-    evaluator->relinearize_inplace(*result, *relinKeys);
-    // print_info(*result);
-    evaluator->rescale_to_next_inplace(*result);
-    // print_info(*result);
-
-    (*result).scale() = initial_scale;
-    // print_info(*result);
+    // switch a copy, rhs[0] is also an input of equal()
+    seal::Ciphertext rhs_switched;
+    evaluator->mod_switch_to(rhs[0], lhs_neg.parms_id(), rhs_switched);
+    lazyEvaluator->multiply(lhs_neg, rhs_switched, result);
+    evaluator->rescale_to_next_inplace(result);
+    result.scale() = initial_scale;
     return result;
   }
 
@@ -97,18 +81,15 @@ std::unique_ptr<seal::Ciphertext> CardioBatched::lower(CiphertextVector &lhs,
 
   const int len2 = len >> 1;
 
-  CiphertextVector lhs_l = slice(lhs, 0, len2);
-  CiphertextVector lhs_h = slice(lhs, len2);
-  CiphertextVector rhs_l = slice(rhs, 0, len2);
-  CiphertextVector rhs_h = slice(rhs, len2);
+  // views, the halves are not copied
+  CiphertextView lhs_l = lhs.slice(0, len2);
+  CiphertextView lhs_h = lhs.slice(len2);
+  CiphertextView rhs_l = rhs.slice(0, len2);
+  CiphertextView rhs_h = rhs.slice(len2);
 
-  seal::Ciphertext term1 = *lower(lhs_h, rhs_h);
-  // print_info(term1);
-  evaluator->mod_switch_to_inplace(lhs_h[0], rhs_h[0].parms_id());
-  seal::Ciphertext h_equal = *equal(lhs_h, rhs_h);
-  // print_info(h_equal);
-  seal::Ciphertext l_equal = *lower(lhs_l, rhs_l);
-  // print_info(l_equal);
+  seal::Ciphertext term1 = lower(lhs_h, rhs_h);
+  seal::Ciphertext h_equal = equal(lhs_h, rhs_h);
+  seal::Ciphertext l_equal = lower(lhs_l, rhs_l);
 
   seal::Ciphertext term2;
 
@@ -118,17 +99,16 @@ std::unique_ptr<seal::Ciphertext> CardioBatched::lower(CiphertextVector &lhs,
     evaluator->mod_switch_to_inplace(h_equal, l_equal.parms_id());
   }
 
-  evaluator->multiply(h_equal, l_equal, term2);
-  evaluator->relinearize_inplace(term2, *relinKeys);
+  lazyEvaluator->multiply(h_equal, l_equal, term2);
   evaluator->rescale_to_next_inplace(term2);
   term2.scale() = initial_scale;
-  // print_info(term2);
 
+  // rescaling and XOR work on unrelinearized terms, so that only their
+  // difference is relinearized
   evaluator->mod_switch_to_inplace(term1, term2.parms_id());
-  *result = XOR(term1, term2);
-  evaluator->rescale_to_next_inplace(*result);
-  (*result).scale() = initial_scale;
-  // print_info(*result);
+  result = XOR(term1, term2);
+  evaluator->rescale_to_next_inplace(result);
+  result.scale() = initial_scale;
   return result;
 }
 
@@ -153,19 +133,17 @@ seal::Ciphertext CardioBatched::XOR(seal::Ciphertext &lhs,
   // see https://stackoverflow.com/a/46674398
   seal::Ciphertext result;
   evaluator->sub(lhs, rhs, result);
-  evaluator->square_inplace(result);
-  evaluator->relinearize_inplace(result, *relinKeys);
+  lazyEvaluator->square_inplace(result);
   return result;
 }
 
 seal::Ciphertext CardioBatched::XOR(seal::Ciphertext &lhs,
-                                    seal::Plaintext &rhs) {
+                                    const seal::Plaintext &rhs) {
   // computes (a-b)^2 by assuming a,b are binary inputs
   // see https://stackoverflow.com/a/46674398
   seal::Ciphertext result;
   evaluator->sub_plain(lhs, rhs, result);
-  evaluator->square_inplace(result);
-  evaluator->relinearize_inplace(result, *relinKeys);
+  lazyEvaluator->square_inplace(result);
   return result;
 }
 
@@ -307,31 +285,9 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<ms>(end - start).count();
   if (!last) ss << ",";
 }
-}  // namespace
-
-void CardioBatched::run_cardio() {
-  std::stringstream ss_time;
-
-  auto t0 = Time::now();
-  // poly_modulus_degree:
-  // - must be a power of two
-  // - determines the number of ciphertext slots
-  // - determines the max. of the sum of coeff_moduli bits
-  setup_context_ckks(32768);
-
-  auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
-
-  auto t2 = Time::now();
-
-  // encode and encrypt keystream
-  // assumption: this keystream is known by client and server
-  std::vector<uint64_t> keystream = {121, 58,  242, 156, 29,  94,
-                                     136, 91,  227, 68,  251, 70,
-                                     212, 155, 223, 154, 221, 251};
-
-  // === client-side computation ====================================
 
+/// Inputs of the client, one value per condition operand.
+std::vector<uint64_t> cardio_inputs() {
   // define input values
   bool man = false;
   bool antecedent = true;
@@ -357,7 +313,6 @@ void CardioBatched::run_cardio() {
   // T  +1  if TRUE                                 && [height] < [weight+90]
   // F  +1  if TRUE                                 && [phy_act] < 30
 
-  // encode and encrypt the inputs
   std::vector<uint64_t> in;
   in.push_back(man);
   in.push_back(antecedent);
@@ -378,17 +333,32 @@ void CardioBatched::run_cardio() {
   in.push_back(phy_act);
   in.push_back(weight + 90);
 
-  seal::Ciphertext result = encode_and_encrypt(in);
-
-  auto t3 = Time::now();
-  log_time(ss_time, t2, t3, false);
-
-  // // transmit data to server...
-
-  // // === server-side computation ====================================
+  return in;
+}
 
-  auto t4 = Time::now();
+/// Largest deviation of a decrypted condition from 0/1 that the sign path
+/// accepts. The risk score sums ten conditions, so this keeps its rounding
+/// error below 0.5.
+const double max_condition_error_bound = 0.05;
+
+/// The conditions flags[i] & (b[i] < c[i]) on the plain inputs.
+std::vector<double> expected_conditions(const std::vector<uint64_t> &in) {
+  const std::vector<uint64_t> flags = {in[0], in[1], in[2], in[3], in[4],
+                                       in[5], in[6], 1,     1,     1};
+  const std::vector<uint64_t> b = {50, 0, 0, 0, 0, 3, 2,
+                                   in[14], in[15], in[16]};
+  const std::vector<uint64_t> c = {in[7],  in[8],  in[9], in[10], in[11],
+                                   in[12], in[13], 40,    in[17], 30};
+  std::vector<double> conditions;
+  for (std::size_t i = 0; i < flags.size(); ++i) {
+    conditions.push_back(flags[i] && b[i] < c[i]);
+  }
+  return conditions;
+}
+}  // namespace
 
+seal::Ciphertext CardioBatched::compute_risk_bitwise(
+    seal::Ciphertext &result) {
   // homomorphically execute the Kreyvium algorithm to decrypt data
   // seal::Plaintext ks = encode(keystream);
   // seal::Ciphertext result = XOR(inputs, ks);
@@ -416,10 +386,9 @@ void CardioBatched::run_cardio() {
   encoder->encode(mask_b, result.parms_id(), initial_scale, mask_b_enc);
   seal::Ciphertext b;
   evaluator->multiply_plain(result, mask_b_enc, b);
-  evaluator->relinearize_inplace(b, *relinKeys);
   evaluator->rescale_to_next_inplace(b);
   b.scale() = initial_scale;
-  evaluator->rotate_vector_inplace(b, 56, *galoisKeys);
+  lazyEvaluator->rotate_vector_inplace(b, 56, *galoisKeys);
   // merge with the constants that are not given as inputs
   seal::Plaintext const_b = encode({50, 0, 0, 0, 0, 3, 2}, b.parms_id());
   evaluator->add_plain_inplace(b, const_b);
@@ -432,10 +401,9 @@ void CardioBatched::run_cardio() {
   encoder->encode(mask_c, result.parms_id(), initial_scale, mask_c_enc);
   seal::Ciphertext c;
   evaluator->multiply_plain(result, mask_c_enc, c);
-  evaluator->relinearize_inplace(c, *relinKeys);
   evaluator->rescale_to_next_inplace(c);
   c.scale() = initial_scale;
-  evaluator->rotate_vector_inplace(c, 56, *galoisKeys);
+  lazyEvaluator->rotate_vector_inplace(c, 56, *galoisKeys);
   // merge with the constants that are not given as inputs
   seal::Plaintext const_c =
       encode({0, 0, 0, 0, 0, 0, 0, 40, 0, 30}, c.parms_id());
@@ -449,8 +417,7 @@ void CardioBatched::run_cardio() {
                   mask_weight90_enc);
   seal::Ciphertext weight90;
   evaluator->multiply_plain(result, mask_weight90_enc, weight90);
-  evaluator->relinearize_inplace(weight90, *relinKeys);
-  evaluator->rotate_vector_inplace(weight90, 72, *galoisKeys);
+  lazyEvaluator->rotate_vector_inplace(weight90, 72, *galoisKeys);
   evaluator->rescale_to_next_inplace(weight90);
   weight90.scale() = c.scale();
   evaluator->add_inplace(c, weight90);
@@ -461,17 +428,17 @@ void CardioBatched::run_cardio() {
   std::vector<seal::Ciphertext> c_encoded = split_by_binary_rep(c);
 
   // lower_result := b_encoded < c_encoded
-  seal::Ciphertext lower_result = *lower(b_encoded, c_encoded);
+  seal::Ciphertext lower_result = lower(b_encoded, c_encoded);
 
   // condition_result := bool_flags & lower_result
   seal::Ciphertext condition_result;
   evaluator->mod_switch_to_inplace(bool_flags, lower_result.parms_id());
-  evaluator->multiply(bool_flags, lower_result, condition_result);
-  evaluator->relinearize_inplace(condition_result, *relinKeys);
+  lazyEvaluator->multiply(bool_flags, lower_result, condition_result);
 
   // perform sum & rotate to compute the result of the cardio program
   seal::Ciphertext rot8, rot4, rot2, final_result;
-  evaluator->rotate_vector(condition_result, 8 * NUM_BITS, *galoisKeys, rot8);
+  lazyEvaluator->rotate_vector(condition_result, 8 * NUM_BITS, *galoisKeys,
+                               rot8);
   evaluator->add_inplace(rot8, condition_result);
   evaluator->rotate_vector(rot8, 4 * NUM_BITS, *galoisKeys, rot4);
   evaluator->add_inplace(rot4, rot8);
@@ -479,10 +446,55 @@ void CardioBatched::run_cardio() {
   evaluator->add_inplace(rot2, rot4);
   evaluator->rotate_vector(rot2, 1 * NUM_BITS, *galoisKeys, final_result);
   evaluator->add_inplace(final_result, rot2);
+  return final_result;
+}
+
+void CardioBatched::run_cardio() {
+  std::stringstream ss_time;
+  // allocation statistics per phase, only collected if MEMORY_PROFILE is set
+  PhaseProfiler phase_profiler;
+
+  phase_profiler.begin();
+  auto t0 = Time::now();
+  setup_context_ckks();
+
+  auto t1 = Time::now();
+  phase_profiler.end("t_keygen");
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
+
+  phase_profiler.begin();
+  auto t2 = Time::now();
+
+  // encode and encrypt keystream
+  // assumption: this keystream is known by client and server
+  std::vector<uint64_t> keystream = {121, 58,  242, 156, 29,  94,
+                                     136, 91,  227, 68,  251, 70,
+                                     212, 155, 223, 154, 221, 251};
+
+  // === client-side computation ====================================
+
+  // encode and encrypt the inputs
+  std::vector<uint64_t> in = cardio_inputs();
+  seal::Ciphertext result = encode_and_encrypt(in);
+
+  auto t3 = Time::now();
+  phase_profiler.end("t_input_encryption");
+  log_time(ss_time, t2, t3, false);
+
+  // // transmit data to server...
+
+  // // === server-side computation ====================================
+
+  phase_profiler.begin();
+  auto t4 = Time::now();
+
+  seal::Ciphertext final_result = compute_risk_bitwise(result);
 
   auto t5 = Time::now();
+  phase_profiler.end("t_computation");
   log_time(ss_time, t4, t5, false);
 
+  phase_profiler.begin();
   auto t6 = Time::now();
 
   // retrieve the final result (ciphertext slot 7)
@@ -491,8 +503,12 @@ void CardioBatched::run_cardio() {
   std::vector<double> dec;
   encoder->decode(p, dec);
   std::cout << "Result: " << (uint64_t)dec[7] << std::endl;
+  std::cout << "Relinearizations: " << lazyEvaluator->relinearizations()
+            << " (" << lazyEvaluator->removed_relinearizations()
+            << " removed by lazy relinearization)" << std::endl;
 
   auto t7 = Time::now();
+  phase_profiler.end("t_decryption");
   log_time(ss_time, t6, t7, true);
 
   // write ss_time into file
@@ -505,57 +521,292 @@ void CardioBatched::run_cardio() {
                   std::ifstream::badbit);
   myfile << ss_time.str() << std::endl;
 
+  // write allocation statistics per phase into file
+  if (phase_profiler.is_enabled()) {
+    std::ofstream memory_file = open_csv_file(
+        "MEMORY_FILENAME", "memory_cardio_ckks_batched.csv", PhaseProfiler::header());
+    phase_profiler.write_csv(memory_file);
+  }
+
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("cardio-ckks-batched");
+  add_encryption_parameters(record, context);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.set_metric("relinearizations", lazyEvaluator->relinearizations());
+  record.set_metric("relinearizations_removed",
+                    lazyEvaluator->removed_relinearizations());
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_cardio.txt");
 }
 
-std::unique_ptr<seal::Ciphertext> CardioBatched::multvect(
-    CiphertextVector bitvec) {
-  const int size = bitvec.size();
+void CardioBatched::multvect_inplace(CiphertextView bits) {
+  const std::size_t size = bits.size();
   for (std::size_t k = 1; k < size; k *= 2) {
     for (std::size_t i = 0; i < size - k; i += 2 * k) {
-      evaluator->multiply_inplace(bitvec[i], bitvec[i + k]);
-      evaluator->relinearize_inplace(bitvec[i], *relinKeys);
-      evaluator->rescale_to_next_inplace(bitvec[i]);
-      // print_info(bitvec[i]);
+      lazyEvaluator->multiply_inplace(bits[i], bits[i + k]);
+      evaluator->rescale_to_next_inplace(bits[i]);
     }
   }
-  return std::make_unique<seal::Ciphertext>(bitvec[0]);
 }
 
-std::unique_ptr<seal::Ciphertext> CardioBatched::equal(CiphertextVector &lhs,
-                                                       CiphertextVector &rhs) {
+seal::Ciphertext CardioBatched::equal(CiphertextView lhs,
+                                      CiphertextView rhs) {
   assert(("equal supports same-sized inputs only!", lhs.size() == rhs.size()));
 
   CiphertextVector comp;
   for (std::size_t i = 0; i < lhs.size(); ++i) {
     seal::Ciphertext tmp;
-    // evaluator->add(lhs[i], rhs[i], tmp);
-    // print_info(lhs[i]);
-    // print_info(rhs[i]);
     tmp = XOR(lhs[i], rhs[i]);
     evaluator->rescale_to_next_inplace(tmp);
-    // print_info(tmp);
     tmp.scale() = initial_scale;
-    // print_info(tmp);
 
-    seal::Plaintext one;
-    encoder->encode(1.0, tmp.parms_id(), tmp.scale(), one);
-    // print_info(tmp);
+    const seal::Plaintext &one =
+        plaintextCache->ckks(1.0, tmp.parms_id(), tmp.scale());
 
     tmp = XOR(tmp, one);
     evaluator->rescale_to_next_inplace(tmp);
-    // print_info(tmp);
     tmp.scale() = initial_scale;
-    comp.push_back(tmp);
+    comp.push_back(std::move(tmp));
+  }
+  multvect_inplace(comp);
+  return std::move(comp[0]);
+}
+
+seal::Ciphertext CardioBatched::compute_risk_sign(
+    seal::Ciphertext &inputs, const SignApproxConfig &config,
+    seal::Ciphertext &conditions) {
+  // The conditions are flags[i] & (b[i] < c[i]) in slots 0-9, where
+  //   flags = inputs[0-6], 1, 1, 1
+  //   b     = 50, 0, 0, 0, 0, 3, 2, inputs[14-16]
+  //   c     = inputs[7-13], 40, inputs[17], 30
+  // (see expected_conditions()). Instead of decomposing the values into
+  // bits, we approximate the sign of (c - b - 0.5) / 2^NUM_BITS, which is in
+  // [-1, 1]. The 0.5 separates c > b from c == b.
+  const std::size_t slot_count = encoder->slot_count();
+  const double norm = 1.0 / (1 << NUM_BITS);
+
+  // rot7[i] = inputs[i + 7], rot9[i] = inputs[i + 9]
+  seal::Ciphertext rot7, rot9;
+  lazyEvaluator->rotate_vector(inputs, 7, *galoisKeys, rot7);
+  lazyEvaluator->rotate_vector(inputs, 9, *galoisKeys, rot9);
+
+  // the masks select and normalize c (positive) and b (negative)
+  std::vector<double> mask7(slot_count, 0.0), mask9(slot_count, 0.0);
+  for (size_t i = 0; i < 7; ++i) mask7[i] = norm;
+  for (size_t i = 7; i < 10; ++i) mask7[i] = -norm;
+  mask9[8] = norm;
+  const std::vector<double> b_constants = {50, 0, 0, 0, 0, 3, 2, 0, 0, 0};
+  const std::vector<double> c_constants = {0, 0, 0, 0, 0, 0, 0, 40, 0, 30};
+  std::vector<double> constants(slot_count, 0.0);
+  for (size_t i = 0; i < 10; ++i) {
+    constants[i] = (c_constants[i] - b_constants[i] - 0.5) * norm;
+  }
+
+  seal::Ciphertext diff, diff9;
+  evaluator->multiply_plain(
+      rot7, plaintextCache->ckks(mask7, rot7.parms_id(), rot7.scale()), diff);
+  evaluator->multiply_plain(
+      rot9, plaintextCache->ckks(mask9, rot9.parms_id(), rot9.scale()),
+      diff9);
+  evaluator->add_inplace(diff, diff9);
+  evaluator->rescale_to_next_inplace(diff);
+  diff.scale() = initial_scale;
+  evaluator->add_plain_inplace(
+      diff, plaintextCache->ckks(constants, diff.parms_id(), diff.scale()));
+
+  // lower := b < c = (sign(c - b - 0.5) + 1) / 2
+  SignApprox sign(context, *evaluator, *lazyEvaluator, *plaintextCache,
+                  initial_scale, config);
+  seal::Ciphertext &lower_result = diff;
+  sign.sign_inplace(lower_result, 0.5);
+  evaluator->add_plain_inplace(
+      lower_result, plaintextCache->ckks(0.5, lower_result.parms_id(),
+                                         lower_result.scale()));
+
+  // mask the flags, the last three conditions have none
+  std::vector<double> mask_flags(slot_count, 0.0);
+  std::vector<double> addendum(slot_count, 0.0);
+  for (size_t i = 0; i < 7; ++i) mask_flags[i] = 1;
+  for (size_t i = 7; i < 10; ++i) addendum[i] = 1;
+  seal::Ciphertext bool_flags;
+  evaluator->multiply_plain(
+      inputs,
+      plaintextCache->ckks(mask_flags, inputs.parms_id(), inputs.scale()),
+      bool_flags);
+  evaluator->rescale_to_next_inplace(bool_flags);
+  bool_flags.scale() = initial_scale;
+  evaluator->add_plain_inplace(
+      bool_flags, plaintextCache->ckks(addendum, bool_flags.parms_id(),
+                                       bool_flags.scale()));
+
+  // conditions := bool_flags & lower_result
+  evaluator->mod_switch_to_inplace(bool_flags, lower_result.parms_id());
+  lazyEvaluator->multiply(bool_flags, lower_result, conditions);
+  evaluator->rescale_to_next_inplace(conditions);
+  conditions.scale() = initial_scale;
+  lazyEvaluator->relinearize_inplace(conditions);
+
+  // sum up slots 0-15, i.e., all conditions, into slot 0
+  seal::Ciphertext risk = conditions;
+  for (int step : {8, 4, 2, 1}) {
+    seal::Ciphertext rotated;
+    evaluator->rotate_vector(risk, step, *galoisKeys, rotated);
+    evaluator->add_inplace(risk, rotated);
+  }
+  return risk;
+}
+
+void CardioBatched::run_sign_comparison() {
+  std::vector<SignApproxConfig> configs;
+  const char *env_steps = std::getenv("SIGN_STEPS");
+  for (auto &token : split(env_steps ? env_steps : "4:1", ',')) {
+    configs.push_back(SignApproxConfig::parse(token));
+  }
+  const TimingConfig timing_config = TimingConfig::from_env();
+
+  std::ofstream file = open_csv_file(
+      "SIGN_FILENAME", "cardio_ckks_sign.csv",
+      parameters_csv_header() +
+          ",path,sign_steps,levels,values_per_ciphertext,t_keygen,"
+          "t_input_encryption," +
+          timing_stats_header() + ",result,error,max_condition_error");
+
+  const std::vector<uint64_t> in = cardio_inputs();
+  const std::vector<double> expected = expected_conditions(in);
+  const double expected_risk =
+      std::accumulate(expected.begin(), expected.end(), 0.0);
+  const std::size_t poly_modulus_degree =
+      target_parameters("cardio_ckks_batched").parameters.poly_modulus_degree;
+
+  auto level = [&](const seal::Ciphertext &ctxt) {
+    return context->get_context_data(ctxt.parms_id())->chain_index();
+  };
+  auto decode = [&](const seal::Ciphertext &ctxt) {
+    seal::Plaintext p;
+    decryptor->decrypt(ctxt, p);
+    std::vector<double> dec;
+    encoder->decode(p, dec);
+    return dec;
+  };
+
+  // the bitwise path, i.e., run_cardio(), and the sign path for each config
+  for (std::size_t run = 0; run <= configs.size(); ++run) {
+    const bool bitwise = (run == 0);
+    const std::string path = bitwise ? "bitwise" : "sign";
+    const std::string steps = bitwise ? "" : configs[run - 1].to_string();
+
+    auto t0 = Time::now();
+    if (bitwise) {
+      setup_context_ckks();
+    } else {
+      // one level for the masks, one for the flags
+      std::vector<int> coeff_modulus_bits(configs[run - 1].depth() + 4, 40);
+      coeff_modulus_bits.front() = 60;
+      coeff_modulus_bits.back() = 60;
+      const int total_bits = std::accumulate(coeff_modulus_bits.begin(),
+                                             coeff_modulus_bits.end(), 0);
+      if (total_bits > seal::CoeffModulus::MaxBitCount(poly_modulus_degree)) {
+        throw std::invalid_argument("sign approximation " + steps +
+                                    " needs too many levels for N = " +
+                                    std::to_string(poly_modulus_degree));
+      }
+      setup_context_ckks(poly_modulus_degree, coeff_modulus_bits,
+                         {1, 2, 4, 7, 8, 9});
+    }
+    auto t1 = Time::now();
+
+    seal::Ciphertext inputs(context);
+    if (bitwise) {
+      inputs = encode_and_encrypt(in);
+    } else {
+      // one value per slot
+      seal::Plaintext ptxt;
+      encoder->encode(std::vector<double>(in.begin(), in.end()),
+                      context->first_parms_id(), initial_scale, ptxt);
+      encryptor->encrypt(ptxt, inputs);
+    }
+    auto t2 = Time::now();
+
+    seal::Ciphertext risk, conditions;
+    auto op = [&]() {
+      if (bitwise) {
+        risk = compute_risk_bitwise(inputs);
+      } else {
+        risk = compute_risk_sign(inputs, configs[run - 1], conditions);
+      }
+    };
+    op();
+
+    // the bitwise path has the risk score in the slot of the last bit
+    const double result = decode(risk)[bitwise ? NUM_BITS - 1 : 0];
+    const double error = std::abs(result - expected_risk);
+    double max_condition_error = 0;
+    if (!bitwise) {
+      std::vector<double> dec = decode(conditions);
+      for (std::size_t i = 0; i < expected.size(); ++i) {
+        max_condition_error =
+            std::max(max_condition_error, std::abs(dec[i] - expected[i]));
+      }
+    }
+    if (std::nearbyint(result) != expected_risk ||
+        max_condition_error > max_condition_error_bound) {
+      throw std::runtime_error(
+          "Wrong result of " + path + (bitwise ? "" : " " + steps) + ": " +
+          std::to_string(result) + " (expected " +
+          std::to_string(expected_risk) + ", max condition error " +
+          std::to_string(max_condition_error) + ")");
+    }
+    const std::size_t levels = level(inputs) - level(risk);
+    const std::size_t values_per_ciphertext =
+        encoder->slot_count() / (bitwise ? NUM_BITS : 1);
+
+    // the inputs are not modified, so all runs see the same inputs
+    OperationResult measured = measure_operation(
+        timing_config, path + " " + steps, []() {}, op);
+
+    std::cout << path << (bitwise ? "" : " " + steps) << ": "
+              << measured.timing.mean_ns / 1e6 << " ms, " << levels
+              << " levels, result " << result << " (expected "
+              << expected_risk << ")" << std::endl;
+
+    write_parameters_csv(file, context);
+    file << "," << path << "," << steps << "," << levels << ","
+         << values_per_ciphertext << ","
+         << KeyStore::keygen_column(keysLoaded, t1 - t0) << ","
+         << std::chrono::duration_cast<ms>(t2 - t1).count() << ",";
+    write_timing_stats(file, measured.timing);
+    file << "," << result << "," << error << ",";
+    if (!bitwise) file << max_condition_error;
+    file << std::endl;
+
+    ResultRecord record("cardio-ckks-batched-sign");
+    add_encryption_parameters(record, context);
+    record.set_parameter("path", path);
+    if (!bitwise) record.set_parameter("sign_steps", steps);
+    record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+    record.add_timing("t_input_encryption", t2 - t1);
+    record.add_timing(
+        "t_computation",
+        std::chrono::nanoseconds((long long) measured.timing.mean_ns));
+    record.set_metric("levels", levels);
+    record.set_metric("values_per_ciphertext", values_per_ciphertext);
+    record.set_metric("error", error);
+    if (!bitwise) record.set_metric("max_condition_error", max_condition_error);
+    record.write();
   }
-  std::unique_ptr<seal::Ciphertext> mv_result = multvect(comp);
-  // print_info(*mv_result);
-  return mv_result;
 }
 
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'cardio-batched-ckks'..." << std::endl;
-  CardioBatched().run_cardio();
+  if (has_flag(argc, argv, "--sign")) {
+    CardioBatched().run_sign_comparison();
+  } else {
+    CardioBatched().run_cardio();
+  }
   return 0;
 }
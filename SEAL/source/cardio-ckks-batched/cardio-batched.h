@@ -19,7 +19,13 @@
 #include <random>
 #include <vector>
 
+#include "../lazy_relin.h"
+#include "../plaintext_cache.h"
+#include "../sign_approx.h"
+#include "../vector_view.h"
+
 typedef std::vector<seal::Ciphertext> CiphertextVector;
+typedef VectorView<seal::Ciphertext> CiphertextView;
 #define print_info(name) internal_print_info(#name, (name))
 #define NUM_BITS 8
 
@@ -123,11 +129,20 @@ class CardioBatched {
   /// keys required to relinearize after multipliction (ptr for consistency)
   std::unique_ptr<seal::RelinKeys> relinKeys;
 
+  /// whether the keys were loaded from the key store instead of generated
+  bool keysLoaded = false;
+
   std::unique_ptr<seal::Encryptor> encryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::CKKSEncoder> encoder;
 
+  /// encoded constants, e.g., the 1.0 used by every XNOR
+  std::unique_ptr<PlaintextCache> plaintextCache;
+
+  /// ciphertext-ciphertext multiplications, relinearized lazily
+  std::unique_ptr<LazyEvaluator> lazyEvaluator;
+
   double initial_scale;
 
   void print_vec(seal::Ciphertext &ctxt);
@@ -161,15 +176,38 @@ class CardioBatched {
 
   seal::Ciphertext XOR(seal::Ciphertext &lhs, seal::Ciphertext &rhs);
 
-  seal::Ciphertext XOR(seal::Ciphertext &lhs, seal::Plaintext &rhs);
+  seal::Ciphertext XOR(seal::Ciphertext &lhs, const seal::Plaintext &rhs);
 
   void internal_print_info(std::string variable_name, seal::Ciphertext &ctxt);
 
  public:
-  void setup_context_ckks(std::size_t poly_modulus_degree);
+  /// The parameters and rotation steps of cardio_ckks_batched in targets.h
+  void setup_context_ckks();
+
+  /// coeff_modulus_bits: bit sizes of the modulus chain incl. special prime
+  void setup_context_ckks(std::size_t poly_modulus_degree,
+                          const std::vector<int> &coeff_modulus_bits,
+                          const std::vector<int> &galois_steps);
 
   void run_cardio();
 
+  /// Server-side computation of the bitwise path on the bit-decomposed
+  /// inputs (NUM_BITS slots per value), risk score in slot 7.
+  seal::Ciphertext compute_risk_bitwise(seal::Ciphertext &inputs);
+
+  /// Server-side computation on inputs with one value per slot, comparing
+  /// the values with a sign approximation. Risk score in slot 0, the
+  /// conditions (0/1) in slots 0-9 of conditions.
+  seal::Ciphertext compute_risk_sign(seal::Ciphertext &inputs,
+                                     const SignApproxConfig &config,
+                                     seal::Ciphertext &conditions);
+
+  /// Times the bitwise path and the sign path for each configuration in
+  /// SIGN_STEPS (default: 4:1, the only configuration within the depth of
+  /// N = 32768 that resolves all 8-bit differences), incl. the accuracy of
+  /// the conditions. Throws if a path computes a wrong risk score.
+  void run_sign_comparison();
+
   seal::Ciphertext encode_and_encrypt(std::vector<uint64_t> number);
 
   seal::Plaintext encode(std::vector<uint64_t> numbers);
@@ -177,21 +215,18 @@ class CardioBatched {
   seal::Plaintext encode(std::vector<uint64_t> numbers,
                          seal::parms_id_type parms_id);
 
-  std::unique_ptr<seal::Ciphertext> equal(CiphertextVector &lhs,
-                                          CiphertextVector &rhs);
+  seal::Ciphertext equal(CiphertextView lhs, CiphertextView rhs);
 
   void shift_right_inplace(CiphertextVector &ctxt);
 
   void shift_left_inplace(CiphertextVector &ctxt);
 
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin, int idx_end);
-
-  CiphertextVector slice(CiphertextVector ctxt, int idx_begin);
-
-  std::unique_ptr<seal::Ciphertext> multvect(CiphertextVector bitvec);
+  /// ANDs all bits into bits[0].
+  void multvect_inplace(CiphertextView bits);
 
-  std::unique_ptr<seal::Ciphertext> lower(CiphertextVector &lhs,
-                                          CiphertextVector &rhs);
+  /// Does not modify its inputs, so that they can be views of the caller's
+  /// ciphertexts.
+  seal::Ciphertext lower(CiphertextView lhs, CiphertextView rhs);
 
   CiphertextVector add(CiphertextVector lhs, CiphertextVector rhs);
 
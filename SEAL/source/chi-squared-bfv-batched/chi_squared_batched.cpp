@@ -1,9 +1,117 @@
 #include "chi_squared_batched.h"
 
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "../bounded_queue.h"
 #include "../common.h"
+#include "../key_store.h"
+#include "../memory.h"
+#include "../sweep.h"
+#include "../task_graph.h"
+#include "../timing.h"
+
+namespace {
+/// value mod modulus, for negative values as well
+uint64_t reduce(__int128 value, uint64_t modulus) {
+  __int128 r = value % static_cast<__int128>(modulus);
+  return static_cast<uint64_t>(r < 0 ? r + modulus : r);
+}
+
+uint64_t mul_mod(uint64_t a, uint64_t b, uint64_t modulus) {
+  return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b %
+                               modulus);
+}
+}  // namespace
+
+ChiSquaredResult ChiSquaredResult::expected(const SnpCounts &counts,
+                                            uint64_t plain_modulus) {
+  const __int128 n0 = counts.n0, n1 = counts.n1, n2 = counts.n2;
+  const uint64_t t = plain_modulus;
+  const uint64_t diff = reduce(4 * n0 * n2 - n1 * n1, t);
+  const uint64_t sum_0 = reduce(2 * n0 + n1, t);
+  const uint64_t sum_2 = reduce(2 * n2 + n1, t);
+  ChiSquaredResult result;
+  result.alpha = mul_mod(diff, diff, t);
+  result.beta_1 = mul_mod(2, mul_mod(sum_0, sum_0, t), t);
+  result.beta_2 = mul_mod(sum_0, sum_2, t);
+  result.beta_3 = mul_mod(2, mul_mod(sum_2, sum_2, t), t);
+  return result;
+}
+
+SnpReader::SnpReader(const std::string &filename)
+    : filename(filename), file(std::make_unique<std::ifstream>(filename)) {
+  if (file->fail()) {
+    throw std::ios_base::failure("cannot open " + filename + ": " +
+                                 std::strerror(errno));
+  }
+}
+
+SnpReader::SnpReader(std::size_t num_snps, uint64_t max_count)
+    : remaining_random_snps(num_snps), count(0, max_count) {}
+
+std::vector<SnpCounts> SnpReader::next(std::size_t max_snps) {
+  std::vector<SnpCounts> snps;
+  if (!file) {
+    const std::size_t num_snps = std::min(max_snps, remaining_random_snps);
+    remaining_random_snps -= num_snps;
+    snps.resize(num_snps);
+    for (auto &snp : snps) snp = {count(gen), count(gen), count(gen)};
+    return snps;
+  }
+  std::string line;
+  while (snps.size() < max_snps && std::getline(*file, line)) {
+    line_number++;
+    if (line.empty() || line[0] == '#') continue;
+    const std::vector<std::string> fields = split(line, ',');
+    if (fields.size() != 3) {
+      throw std::runtime_error(filename + ":" + std::to_string(line_number) +
+                               ": expected n0,n1,n2");
+    }
+    snps.push_back({std::stoull(fields[0]), std::stoull(fields[1]),
+                    std::stoull(fields[2])});
+  }
+  return snps;
+}
+
+std::vector<SnpCounts> read_snp_counts(const std::string &filename) {
+  return SnpReader(filename).next(std::numeric_limits<std::size_t>::max());
+}
+
+std::vector<SnpCounts> random_snp_counts(std::size_t num_snps,
+                                         uint64_t max_count) {
+  return SnpReader(num_snps, max_count).next(num_snps);
+}
+
+int plain_modulus_bits_for(uint64_t max_count) {
+  // alpha <= (4 n0 n2)^2 and beta <= 2 (3 max_count)^2
+  const unsigned __int128 m = max_count;
+  const unsigned __int128 max_alpha = 16 * m * m * m * m;
+  const unsigned __int128 max_beta = 18 * m * m;
+  unsigned __int128 max_result = std::max(max_alpha, max_beta);
+  // the results must be below the smallest prime of that many bits
+  int bits = 1;
+  while (max_result > 0) {
+    max_result >>= 1;
+    bits++;
+  }
+  if (bits > 60) {
+    throw std::invalid_argument(
+        "counts up to " + std::to_string(max_count) +
+        " need a plaintext modulus of more than 60 bits");
+  }
+  return std::max(20, bits);
+}
 
 void ChiSquaredBatched::setup_context_bfv(std::size_t poly_modulus_degree,
-                                          std::uint64_t plain_modulus) {
+                                          int plain_modulus_bits) {
   /// Wrapper for parameters
   seal::EncryptionParameters params(seal::scheme_type::BFV);
   params.set_poly_modulus_degree(poly_modulus_degree);
@@ -12,17 +120,17 @@ void ChiSquaredBatched::setup_context_bfv(std::size_t poly_modulus_degree,
   params.set_coeff_modulus(seal::CoeffModulus::Create(
       poly_modulus_degree, {30, 40, 44, 50, 54, 60, 60}));
   params.set_plain_modulus(
-      seal::PlainModulus::Batching(poly_modulus_degree, 20));
+      seal::PlainModulus::Batching(poly_modulus_degree, plain_modulus_bits));
 
   // Instantiate context
   context = seal::SEALContext::Create(params);
 
-  /// Create keys
-  seal::KeyGenerator keyGenerator(context);
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeySet keys = KeyStore::from_env().get(context, KeyRequest());
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -31,6 +139,8 @@ void ChiSquaredBatched::setup_context_bfv(std::size_t poly_modulus_degree,
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
   encoder = std::make_unique<seal::BatchEncoder>(context);
+  fourAllSlots = encode_all_slots(4);
+  twoAllSlots = encode_all_slots(2);
 }
 
 namespace {
@@ -51,53 +161,172 @@ int64_t ChiSquaredBatched::get_first_decrypted_value(seal::Ciphertext value) {
   return tmp[0];
 }
 
+namespace {
+/// Forwards to a seal::Evaluator and counts the operations the way
+/// ExpressionCounts does. Relinearizations of ciphertexts of size 2 are not
+/// counted, as SEAL skips them.
+class CountingEvaluator {
+ public:
+  explicit CountingEvaluator(seal::Evaluator &evaluator)
+      : evaluator(evaluator) {}
+
+  const ExpressionCounts &counts() const { return op_counts; }
+
+  void add(const seal::Ciphertext &lhs, const seal::Ciphertext &rhs,
+           seal::Ciphertext &destination) {
+    op_counts.additions++;
+    evaluator.add(lhs, rhs, destination);
+  }
+
+  void sub_inplace(seal::Ciphertext &lhs, const seal::Ciphertext &rhs) {
+    op_counts.additions++;
+    evaluator.sub_inplace(lhs, rhs);
+  }
+
+  void multiply(const seal::Ciphertext &lhs, const seal::Ciphertext &rhs,
+                seal::Ciphertext &destination) {
+    op_counts.multiplications++;
+    evaluator.multiply(lhs, rhs, destination);
+  }
+
+  void multiply_inplace(seal::Ciphertext &lhs, const seal::Ciphertext &rhs) {
+    op_counts.multiplications++;
+    evaluator.multiply_inplace(lhs, rhs);
+  }
+
+  void multiply_plain(const seal::Ciphertext &lhs, const seal::Plaintext &rhs,
+                      seal::Ciphertext &destination) {
+    op_counts.plain_multiplications++;
+    evaluator.multiply_plain(lhs, rhs, destination);
+  }
+
+  void multiply_plain_inplace(seal::Ciphertext &lhs,
+                              const seal::Plaintext &rhs) {
+    op_counts.plain_multiplications++;
+    evaluator.multiply_plain_inplace(lhs, rhs);
+  }
+
+  void relinearize_inplace(seal::Ciphertext &encrypted,
+                           const seal::RelinKeys &relin_keys) {
+    if (encrypted.size() > 2) op_counts.relinearizations++;
+    evaluator.relinearize_inplace(encrypted, relin_keys);
+  }
+
+  /// exponent - 1 multiplications, each followed by a relinearization
+  void exponentiate(const seal::Ciphertext &encrypted, std::uint64_t exponent,
+                    const seal::RelinKeys &relin_keys,
+                    seal::Ciphertext &destination) {
+    destination = encrypted;
+    exponentiate_inplace(destination, exponent, relin_keys);
+  }
+
+  void exponentiate_inplace(seal::Ciphertext &encrypted,
+                            std::uint64_t exponent,
+                            const seal::RelinKeys &relin_keys) {
+    op_counts.multiplications += exponent - 1;
+    op_counts.relinearizations += exponent - 1;
+    evaluator.exponentiate_inplace(encrypted, exponent, relin_keys);
+  }
+
+ private:
+  seal::Evaluator &evaluator;
+  ExpressionCounts op_counts;
+};
+}  // namespace
+
 ResultCiphertexts ChiSquaredBatched::compute_alpha_betas(
     const seal::Ciphertext &N_0, const seal::Ciphertext &N_1,
     const seal::Ciphertext &N_2) {
-  seal::Plaintext four = encode_all_slots(4);
-  seal::Plaintext two = encode_all_slots(2);
+  return compute_alpha_betas(*evaluator, N_0, N_1, N_2);
+}
+
+template <typename Evaluator>
+ResultCiphertexts ChiSquaredBatched::compute_alpha_betas(
+    Evaluator &evaluator, const seal::Ciphertext &N_0,
+    const seal::Ciphertext &N_1, const seal::Ciphertext &N_2) {
+  const seal::Plaintext &four = fourAllSlots;
+  const seal::Plaintext &two = twoAllSlots;
 
   // compute alpha
   seal::Ciphertext alpha;
-  evaluator->multiply_plain(N_0, four, alpha);
-  evaluator->relinearize_inplace(alpha, *relinKeys);
-  evaluator->multiply_inplace(alpha, N_2);
-  evaluator->relinearize_inplace(alpha, *relinKeys);
+  evaluator.multiply_plain(N_0, four, alpha);
+  evaluator.relinearize_inplace(alpha, *relinKeys);
+  evaluator.multiply_inplace(alpha, N_2);
+  evaluator.relinearize_inplace(alpha, *relinKeys);
   seal::Ciphertext N_1_pow2;
-  evaluator->exponentiate(N_1, 2, *relinKeys, N_1_pow2);
-  evaluator->sub_inplace(alpha, N_1_pow2);
-  evaluator->exponentiate_inplace(alpha, 2, *relinKeys);
+  evaluator.exponentiate(N_1, 2, *relinKeys, N_1_pow2);
+  evaluator.sub_inplace(alpha, N_1_pow2);
+  evaluator.exponentiate_inplace(alpha, 2, *relinKeys);
 
   // compute beta_1
   seal::Ciphertext beta_1;
   seal::Ciphertext N_0_t2;
-  evaluator->multiply_plain(N_0, two, N_0_t2);
-  evaluator->relinearize_inplace(N_0_t2, *relinKeys);
+  evaluator.multiply_plain(N_0, two, N_0_t2);
+  evaluator.relinearize_inplace(N_0_t2, *relinKeys);
   seal::Ciphertext twot_N_0__plus__N_1;
-  evaluator->add(N_0_t2, N_1, twot_N_0__plus__N_1);
-  evaluator->exponentiate(twot_N_0__plus__N_1, 2, *relinKeys, beta_1);
-  evaluator->multiply_plain_inplace(beta_1, two);
-  evaluator->relinearize_inplace(beta_1, *relinKeys);
+  evaluator.add(N_0_t2, N_1, twot_N_0__plus__N_1);
+  evaluator.exponentiate(twot_N_0__plus__N_1, 2, *relinKeys, beta_1);
+  evaluator.multiply_plain_inplace(beta_1, two);
+  evaluator.relinearize_inplace(beta_1, *relinKeys);
 
   // compute beta_2
   seal::Ciphertext beta_2;
   seal::Ciphertext t2_N_2;
-  evaluator->multiply_plain(N_2, two, t2_N_2);
-  evaluator->relinearize_inplace(t2_N_2, *relinKeys);
+  evaluator.multiply_plain(N_2, two, t2_N_2);
+  evaluator.relinearize_inplace(t2_N_2, *relinKeys);
   seal::Ciphertext twot_N_2__plus__N_1;
-  evaluator->add(t2_N_2, N_1, twot_N_2__plus__N_1);
-  evaluator->multiply(twot_N_0__plus__N_1, twot_N_2__plus__N_1, beta_2);
-  evaluator->relinearize_inplace(beta_2, *relinKeys);
+  evaluator.add(t2_N_2, N_1, twot_N_2__plus__N_1);
+  evaluator.multiply(twot_N_0__plus__N_1, twot_N_2__plus__N_1, beta_2);
+  evaluator.relinearize_inplace(beta_2, *relinKeys);
 
   // compute beta_3
   seal::Ciphertext beta_3;
-  evaluator->exponentiate(twot_N_2__plus__N_1, 2, *relinKeys, beta_3);
-  evaluator->multiply_plain_inplace(beta_3, two);
-  evaluator->relinearize_inplace(beta_3, *relinKeys);
+  evaluator.exponentiate(twot_N_2__plus__N_1, 2, *relinKeys, beta_3);
+  evaluator.multiply_plain_inplace(beta_3, two);
+  evaluator.relinearize_inplace(beta_3, *relinKeys);
 
   return ResultCiphertexts(alpha, beta_1, beta_2, beta_3);
 }
 
+void ChiSquaredBatched::build_alpha_betas(ExpressionScheduler &scheduler) {
+  typedef ExpressionScheduler::NodeId Node;
+  const Node N_0 = scheduler.input(0);
+  const Node N_1 = scheduler.input(1);
+  const Node N_2 = scheduler.input(2);
+
+  // alpha = (4 N_0 N_2 - N_1^2)^2
+  const Node diff = scheduler.sub(
+      scheduler.multiply(scheduler.multiply_const(N_0, 4), N_2),
+      scheduler.square(N_1));
+  scheduler.output(scheduler.square(diff));
+
+  // beta_1 = 2 (2 N_0 + N_1)^2
+  scheduler.output(scheduler.multiply_const(
+      scheduler.square(
+          scheduler.add(scheduler.multiply_const(N_0, 2), N_1)),
+      2));
+
+  // beta_2 = (2 N_0 + N_1) (2 N_2 + N_1)
+  scheduler.output(scheduler.multiply(
+      scheduler.add(scheduler.multiply_const(N_0, 2), N_1),
+      scheduler.add(scheduler.multiply_const(N_2, 2), N_1)));
+
+  // beta_3 = 2 (2 N_2 + N_1)^2
+  scheduler.output(scheduler.multiply_const(
+      scheduler.square(
+          scheduler.add(scheduler.multiply_const(N_2, 2), N_1)),
+      2));
+}
+
+ResultCiphertexts ChiSquaredBatched::compute_alpha_betas_scheduled(
+    const ExpressionScheduler &scheduler, const seal::Ciphertext &N_0,
+    const seal::Ciphertext &N_1, const seal::Ciphertext &N_2,
+    std::size_t num_threads) {
+  std::vector<seal::Ciphertext> results =
+      scheduler.evaluate(*evaluator, *relinKeys, {N_0, N_1, N_2}, num_threads);
+  return ResultCiphertexts(results[0], results[1], results[2], results[3]);
+}
+
 seal::Ciphertext ChiSquaredBatched::encode_all_slots_and_encrypt(
     int64_t value) {
   seal::Ciphertext encrypted;
@@ -112,14 +341,63 @@ seal::Plaintext ChiSquaredBatched::encode_all_slots(int64_t value) {
   return temp;
 }
 
+seal::Ciphertext ChiSquaredBatched::encode_and_encrypt(
+    const std::vector<uint64_t> &values) {
+  std::vector<uint64_t> data(values);
+  data.resize(encoder->slot_count(), 0);
+  seal::Plaintext plain;
+  encoder->encode(data, plain);
+  seal::Ciphertext encrypted;
+  encryptor->encrypt(plain, encrypted);
+  return encrypted;
+}
+
+std::vector<uint64_t> ChiSquaredBatched::decrypt_all_slots(
+    const seal::Ciphertext &ctxt) {
+  seal::Plaintext plain;
+  decryptor->decrypt(ctxt, plain);
+  std::vector<uint64_t> values;
+  encoder->decode(plain, values);
+  return values;
+}
+
+std::size_t ChiSquaredBatched::snps_per_ciphertext() const {
+  return encoder->slot_count();
+}
+
+SnpCiphertexts ChiSquaredBatched::encrypt_snps(
+    const std::vector<SnpCounts> &snps, std::size_t first, std::size_t count) {
+  std::vector<uint64_t> n0, n1, n2;
+  for (std::size_t i = first; i < first + count; ++i) {
+    n0.push_back(snps[i].n0);
+    n1.push_back(snps[i].n1);
+    n2.push_back(snps[i].n2);
+  }
+  return {encode_and_encrypt(n0), encode_and_encrypt(n1),
+          encode_and_encrypt(n2)};
+}
+
+std::vector<ChiSquaredResult> ChiSquaredBatched::decrypt_results(
+    const ResultCiphertexts &results, std::size_t count) {
+  std::vector<uint64_t> alpha = decrypt_all_slots(results.alpha);
+  std::vector<uint64_t> beta_1 = decrypt_all_slots(results.beta_1);
+  std::vector<uint64_t> beta_2 = decrypt_all_slots(results.beta_2);
+  std::vector<uint64_t> beta_3 = decrypt_all_slots(results.beta_3);
+  std::vector<ChiSquaredResult> decoded(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    decoded[i] = {alpha[i], beta_1[i], beta_2[i], beta_3[i]};
+  }
+  return decoded;
+}
+
 void ChiSquaredBatched::run_chi_squared() {
   std::stringstream ss_time;
 
   // set up the BFV scheme
   auto t0 = Time::now();
-  setup_context_bfv(32768, 4096);
+  setup_context_bfv(32768);
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
   auto t2 = Time::now();
   int64_t n0_val = 2, n1_val = 7, n2_val = 9;
@@ -165,12 +443,493 @@ void ChiSquaredBatched::run_chi_squared() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("chi-squared-bfv-batched");
+  add_encryption_parameters(record, context);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_chi_squared.txt");
 }
 
+void ChiSquaredBatched::run_batch() {
+  std::vector<SnpCounts> snps;
+  std::string input = "random";
+  if (auto v = std::getenv("CHI_SQUARED_INPUT")) {
+    input = v;
+    snps = read_snp_counts(input);
+  } else {
+    std::size_t num_snps = 100000;
+    if (auto n = std::getenv("CHI_SQUARED_SNPS")) num_snps = std::stoul(n);
+    snps = random_snp_counts(num_snps, 100);
+  }
+  if (snps.empty()) throw std::invalid_argument("no SNPs in " + input);
+
+  // the plaintext modulus must hold the largest result
+  uint64_t max_count = 0;
+  for (auto &snp : snps) {
+    max_count = std::max({max_count, snp.n0, snp.n1, snp.n2});
+  }
+  const int plain_modulus_bits = plain_modulus_bits_for(max_count);
+
+  auto t0 = Time::now();
+  setup_context_bfv(32768, plain_modulus_bits);
+  auto t1 = Time::now();
+  const uint64_t plain_modulus =
+      context->first_context_data()->parms().plain_modulus().value();
+  const std::size_t capacity = snps_per_ciphertext();
+
+  // optionally, the results of all SNPs as alpha,beta_1,beta_2,beta_3
+  std::ofstream results_file;
+  if (auto v = std::getenv("CHI_SQUARED_OUTPUT")) {
+    results_file.open(v);
+    results_file << "alpha,beta_1,beta_2,beta_3" << std::endl;
+  }
+
+  // ciphertexts are processed one after another (and not kept), so that
+  // memory does not grow with the number of SNPs
+  Time::duration t_enc(0), t_comp(0), t_dec(0);
+  std::size_t num_ciphertexts = 0;
+  int min_noise_budget = std::numeric_limits<int>::max();
+  for (std::size_t first = 0; first < snps.size(); first += capacity) {
+    const std::size_t count = std::min(capacity, snps.size() - first);
+    num_ciphertexts++;
+
+    auto t2 = Time::now();
+    SnpCiphertexts inputs = encrypt_snps(snps, first, count);
+    auto t3 = Time::now();
+    ResultCiphertexts results =
+        compute_alpha_betas(inputs.n0, inputs.n1, inputs.n2);
+    auto t4 = Time::now();
+    std::vector<ChiSquaredResult> decoded = decrypt_results(results, count);
+    auto t5 = Time::now();
+    t_enc += t3 - t2;
+    t_comp += t4 - t3;
+    t_dec += t5 - t4;
+
+    // alpha is the deepest output
+    min_noise_budget = std::min(
+        min_noise_budget, decryptor->invariant_noise_budget(results.alpha));
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!(decoded[i] ==
+            ChiSquaredResult::expected(snps[first + i], plain_modulus))) {
+        throw std::runtime_error("Wrong result for SNP " +
+                                 std::to_string(first + i));
+      }
+      if (results_file.is_open()) {
+        results_file << decoded[i].alpha << "," << decoded[i].beta_1 << ","
+                     << decoded[i].beta_2 << "," << decoded[i].beta_3
+                     << std::endl;
+      }
+    }
+  }
+
+  // key generation is a one-time cost and hence not included
+  const double seconds =
+      std::chrono::duration<double>(t_enc + t_comp + t_dec).count();
+  const double snps_per_second = snps.size() / seconds;
+  std::cout << snps.size() << " SNPs in " << num_ciphertexts
+            << " ciphertexts: " << snps_per_second << " SNPs/s" << std::endl;
+
+  std::ofstream file = open_csv_file(
+      "BATCH_FILENAME", "chi_squared_batched_snps.csv",
+      parameters_csv_header() +
+          ",snps,snps_per_ciphertext,ciphertexts,t_keygen,t_input_encryption,"
+          "t_computation,t_decryption,snps_per_second,noise_budget_bits");
+  write_parameters_csv(file, context);
+  file << "," << snps.size() << "," << capacity << "," << num_ciphertexts
+       << "," << KeyStore::keygen_column(keysLoaded, t1 - t0) << ","
+       << std::chrono::duration_cast<ms>(t_enc).count() << ","
+       << std::chrono::duration_cast<ms>(t_comp).count() << ","
+       << std::chrono::duration_cast<ms>(t_dec).count() << ","
+       << snps_per_second << "," << min_noise_budget << std::endl;
+
+  ResultRecord record("chi-squared-bfv-batched-snps");
+  add_encryption_parameters(record, context);
+  record.set_parameter("input", input);
+  record.set_parameter("snps", snps.size());
+  record.set_parameter("snps_per_ciphertext", capacity);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t_enc);
+  record.add_timing("t_computation", t_comp);
+  record.add_timing("t_decryption", t_dec);
+  record.set_metric("ciphertexts", num_ciphertexts);
+  record.set_metric("snps_per_second", snps_per_second);
+  record.set_metric("noise_budget_bits", min_noise_budget);
+  record.write();
+}
+
+void ChiSquaredBatched::run_schedule() {
+  auto t0 = Time::now();
+  setup_context_bfv(32768);
+  auto t1 = Time::now();
+  const uint64_t plain_modulus =
+      context->first_context_data()->parms().plain_modulus().value();
+  const std::size_t num_threads = num_threads_from_env("SCHEDULE_THREADS");
+  const TimingConfig timing_config = TimingConfig::from_env();
+
+  // random but reproducible SNPs in all slots
+  const std::vector<SnpCounts> snps =
+      random_snp_counts(snps_per_ciphertext(), 100);
+  const SnpCiphertexts inputs = encrypt_snps(snps, 0, snps.size());
+
+  // the op counts of compute_alpha_betas() are counted on one run, its depth
+  // and critical path are derived from the circuit it computes: it shares
+  // the sums 2 N_0 + N_1 and 2 N_2 + N_1 but multiplies by the constants,
+  // i.e., it computes the deduplicated circuit without additions for
+  // constants
+  CountingEvaluator counting_evaluator(*evaluator);
+  compute_alpha_betas(counting_evaluator, inputs.n0, inputs.n1, inputs.n2);
+  ExpressionScheduler::Options hand_written_options;
+  hand_written_options.constants_as_additions = false;
+  ExpressionScheduler hand_written(hand_written_options);
+  build_alpha_betas(hand_written);
+  ExpressionCounts hand_written_counts = counting_evaluator.counts();
+  hand_written_counts.multiplicative_depth =
+      hand_written.counts().multiplicative_depth;
+  hand_written_counts.critical_path = hand_written.counts().critical_path;
+  ExpressionScheduler scheduled;
+  build_alpha_betas(scheduled);
+
+  struct Variant {
+    std::string name;
+    std::size_t threads;
+    ExpressionCounts counts;
+    std::function<ResultCiphertexts()> compute;
+  };
+  const std::vector<Variant> variants = {
+      {"hand_written", 1, hand_written_counts,
+       [&]() { return compute_alpha_betas(inputs.n0, inputs.n1, inputs.n2); }},
+      {"scheduled", 1, scheduled.counts(),
+       [&]() {
+         return compute_alpha_betas_scheduled(scheduled, inputs.n0, inputs.n1,
+                                              inputs.n2, 1);
+       }},
+      {"scheduled", num_threads, scheduled.counts(), [&]() {
+         return compute_alpha_betas_scheduled(scheduled, inputs.n0, inputs.n1,
+                                              inputs.n2, num_threads);
+       }}};
+
+  std::ofstream file = open_csv_file(
+      "SCHEDULE_FILENAME", "chi_squared_batched_schedule.csv",
+      parameters_csv_header() +
+          ",variant,threads,additions,multiplications,plain_multiplications,"
+          "relinearizations,multiplicative_depth,critical_path,"
+          "noise_budget_bits," +
+          timing_stats_header() + "," + memory_stats_header());
+
+  for (const Variant &variant : variants) {
+    const ResultCiphertexts results = variant.compute();
+    const std::vector<ChiSquaredResult> decoded =
+        decrypt_results(results, snps.size());
+    for (std::size_t i = 0; i < snps.size(); ++i) {
+      if (!(decoded[i] == ChiSquaredResult::expected(snps[i], plain_modulus))) {
+        throw std::runtime_error("Wrong result of " + variant.name +
+                                 " for SNP " + std::to_string(i));
+      }
+    }
+    const int noise_budget = decryptor->invariant_noise_budget(results.alpha);
+    OperationResult measured = measure_operation(
+        timing_config, variant.name, []() {}, [&]() { variant.compute(); });
+
+    const ExpressionCounts &counts = variant.counts;
+    std::cout << variant.name << " (" << variant.threads
+              << " threads): " << counts.multiplications << " mult, "
+              << counts.plain_multiplications << " mult_plain, "
+              << counts.additions << " add, depth "
+              << counts.multiplicative_depth << ", critical path "
+              << counts.critical_path << ", "
+              << measured.timing.mean_ns / 1e6 << " ms" << std::endl;
+
+    write_parameters_csv(file, context);
+    file << "," << variant.name << "," << variant.threads << ","
+         << counts.additions << "," << counts.multiplications << ","
+         << counts.plain_multiplications << "," << counts.relinearizations
+         << "," << counts.multiplicative_depth << "," << counts.critical_path
+         << "," << noise_budget << ",";
+    write_timing_stats(file, measured.timing);
+    file << ",";
+    write_memory_stats(file, measured.memory);
+    file << std::endl;
+
+    ResultRecord record("chi-squared-bfv-batched-schedule");
+    add_encryption_parameters(record, context);
+    record.set_parameter("variant", variant.name);
+    record.set_parameter("threads", variant.threads);
+    record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+    record.add_timing("t_computation",
+                      std::chrono::nanoseconds(
+                          (long long) measured.timing.mean_ns));
+    record.set_metric("additions", counts.additions);
+    record.set_metric("multiplications", counts.multiplications);
+    record.set_metric("plain_multiplications", counts.plain_multiplications);
+    record.set_metric("relinearizations", counts.relinearizations);
+    record.set_metric("multiplicative_depth", counts.multiplicative_depth);
+    record.set_metric("critical_path", counts.critical_path);
+    record.set_metric("noise_budget_bits", noise_budget);
+    record.write();
+  }
+}
+
+namespace {
+/// SNPs [first, first + snps.size()) on their way through run_stream().
+struct EncryptedBatch {
+  std::size_t first = 0;
+  std::vector<SnpCounts> snps;
+  SnpCiphertexts inputs;
+};
+
+struct ComputedBatch {
+  std::size_t first = 0;
+  std::vector<SnpCounts> snps;
+  ResultCiphertexts results;
+};
+
+/// Busy time and processed SNPs of a pipeline stage, summed over its threads.
+struct StageStats {
+  std::size_t threads = 1;
+  std::size_t snps = 0;
+  Time::duration busy{0};
+  std::mutex mutex;
+
+  void add(Time::duration duration, std::size_t num_snps) {
+    std::lock_guard<std::mutex> lock(mutex);
+    busy += duration;
+    snps += num_snps;
+  }
+
+  /// SNPs per second the stage sustains if it never waits for its queues.
+  double snps_per_second() const {
+    return snps * threads / std::chrono::duration<double>(busy).count();
+  }
+};
+}  // namespace
+
+void ChiSquaredBatched::run_stream() {
+  // SNPs are not known in advance, so the plaintext modulus is sized on the
+  // largest count allowed, and larger counts are rejected when read
+  uint64_t max_count = 100;
+  if (auto v = std::getenv("CHI_SQUARED_MAX_COUNT")) max_count = std::stoull(v);
+  std::string input = "random";
+  std::unique_ptr<SnpReader> reader;
+  if (auto v = std::getenv("CHI_SQUARED_INPUT")) {
+    input = v;
+    reader = std::make_unique<SnpReader>(input);
+  } else {
+    std::size_t num_snps = 100000;
+    if (auto n = std::getenv("CHI_SQUARED_SNPS")) num_snps = std::stoul(n);
+    reader = std::make_unique<SnpReader>(num_snps, max_count);
+  }
+  std::size_t queue_capacity = 2;
+  if (auto v = std::getenv("STREAM_QUEUE_CAPACITY")) {
+    queue_capacity = std::stoul(v);
+  }
+  const std::size_t num_workers = num_threads_from_env("STREAM_THREADS");
+
+  auto t0 = Time::now();
+  setup_context_bfv(32768, plain_modulus_bits_for(max_count));
+  auto t1 = Time::now();
+  const uint64_t plain_modulus =
+      context->first_context_data()->parms().plain_modulus().value();
+  const std::size_t capacity = snps_per_ciphertext();
+
+  std::ofstream results_file;
+  if (auto v = std::getenv("CHI_SQUARED_OUTPUT")) {
+    results_file.open(v);
+    results_file << "snp,alpha,beta_1,beta_2,beta_3" << std::endl;
+  }
+
+  BoundedQueue<EncryptedBatch> encrypted(queue_capacity);
+  BoundedQueue<ComputedBatch> computed(queue_capacity);
+  StageStats encrypt_stage, compute_stage, decrypt_stage;
+  compute_stage.threads = num_workers;
+
+  // the first error of any stage closes both queues, so that all stages stop
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto fail = [&]() {
+    {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) error = std::current_exception();
+    }
+    encrypted.close();
+    computed.close();
+  };
+
+  auto t2 = Time::now();
+  std::thread encrypt_thread([&]() {
+    try {
+      for (std::size_t first = 0;;) {
+        auto start = Time::now();
+        std::vector<SnpCounts> snps = reader->next(capacity);
+        if (snps.empty()) break;
+        for (std::size_t i = 0; i < snps.size(); ++i) {
+          if (std::max({snps[i].n0, snps[i].n1, snps[i].n2}) > max_count) {
+            throw std::invalid_argument(
+                "SNP " + std::to_string(first + i) +
+                " exceeds CHI_SQUARED_MAX_COUNT=" + std::to_string(max_count));
+          }
+        }
+        SnpCiphertexts inputs = encrypt_snps(snps, 0, snps.size());
+        encrypt_stage.add(Time::now() - start, snps.size());
+        const std::size_t count = snps.size();
+        if (!encrypted.push({first, std::move(snps), std::move(inputs)})) {
+          break;
+        }
+        first += count;
+      }
+    } catch (...) {
+      fail();
+    }
+    encrypted.close();
+  });
+
+  // the last worker to finish ends the stream of results
+  std::atomic<std::size_t> running_workers{num_workers};
+  std::vector<std::thread> workers;
+  for (std::size_t w = 0; w < num_workers; ++w) {
+    workers.emplace_back([&]() {
+      try {
+        EncryptedBatch batch;
+        while (encrypted.pop(batch)) {
+          auto start = Time::now();
+          ResultCiphertexts results = compute_alpha_betas(
+              batch.inputs.n0, batch.inputs.n1, batch.inputs.n2);
+          compute_stage.add(Time::now() - start, batch.snps.size());
+          if (!computed.push(
+                  {batch.first, std::move(batch.snps), std::move(results)})) {
+            break;
+          }
+        }
+      } catch (...) {
+        fail();
+      }
+      if (--running_workers == 0) computed.close();
+    });
+  }
+
+  // decryption runs on this thread; batches arrive in any order with more
+  // than one worker, hence the results file is keyed by the SNP index
+  int min_noise_budget = std::numeric_limits<int>::max();
+  std::size_t num_ciphertexts = 0;
+  try {
+    ComputedBatch batch;
+    while (computed.pop(batch)) {
+      auto start = Time::now();
+      std::vector<ChiSquaredResult> decoded =
+          decrypt_results(batch.results, batch.snps.size());
+      // alpha is the deepest output
+      min_noise_budget =
+          std::min(min_noise_budget,
+                   decryptor->invariant_noise_budget(batch.results.alpha));
+      decrypt_stage.add(Time::now() - start, batch.snps.size());
+      num_ciphertexts++;
+      for (std::size_t i = 0; i < decoded.size(); ++i) {
+        if (!(decoded[i] ==
+              ChiSquaredResult::expected(batch.snps[i], plain_modulus))) {
+          throw std::runtime_error("Wrong result for SNP " +
+                                   std::to_string(batch.first + i));
+        }
+        if (results_file.is_open()) {
+          results_file << batch.first + i << "," << decoded[i].alpha << ","
+                       << decoded[i].beta_1 << "," << decoded[i].beta_2
+                       << "," << decoded[i].beta_3 << std::endl;
+        }
+      }
+    }
+  } catch (...) {
+    fail();
+  }
+  encrypt_thread.join();
+  for (auto &worker : workers) worker.join();
+  auto t3 = Time::now();
+  if (error) std::rethrow_exception(error);
+  if (decrypt_stage.snps == 0) {
+    throw std::invalid_argument("no SNPs in " + input);
+  }
+
+  const std::size_t num_snps = decrypt_stage.snps;
+  const double snps_per_second =
+      num_snps / std::chrono::duration<double>(t3 - t2).count();
+  const QueueStats encrypted_stats = encrypted.stats();
+  const QueueStats computed_stats = computed.stats();
+  const std::size_t peak_rss = peak_rss_bytes();
+  std::cout << num_snps << " SNPs in " << num_ciphertexts
+            << " ciphertexts: " << snps_per_second << " SNPs/s (encryption "
+            << encrypt_stage.snps_per_second() << ", computation "
+            << compute_stage.snps_per_second() << " on " << num_workers
+            << " threads, decryption " << decrypt_stage.snps_per_second()
+            << "), queue occupancy " << encrypted_stats.mean_occupancy << "/"
+            << computed_stats.mean_occupancy << " of " << queue_capacity
+            << ", peak RSS " << peak_rss / (1024 * 1024) << " MiB"
+            << std::endl;
+
+  std::ofstream file = open_csv_file(
+      "STREAM_FILENAME", "chi_squared_batched_stream.csv",
+      parameters_csv_header() +
+          ",snps,snps_per_ciphertext,ciphertexts,threads,queue_capacity,"
+          "t_keygen,t_total,snps_per_second,encryption_snps_per_second,"
+          "computation_snps_per_second,decryption_snps_per_second,"
+          "encrypted_queue_mean,encrypted_queue_max,computed_queue_mean,"
+          "computed_queue_max,peak_rss_bytes,noise_budget_bits");
+  write_parameters_csv(file, context);
+  file << "," << num_snps << "," << capacity << "," << num_ciphertexts << ","
+       << num_workers << "," << queue_capacity << ","
+       << KeyStore::keygen_column(keysLoaded, t1 - t0) << ","
+       << std::chrono::duration_cast<ms>(t3 - t2).count() << ","
+       << snps_per_second << "," << encrypt_stage.snps_per_second() << ","
+       << compute_stage.snps_per_second() << ","
+       << decrypt_stage.snps_per_second() << ","
+       << encrypted_stats.mean_occupancy << ","
+       << encrypted_stats.max_occupancy << ","
+       << computed_stats.mean_occupancy << "," << computed_stats.max_occupancy
+       << "," << peak_rss << "," << min_noise_budget << std::endl;
+
+  ResultRecord record("chi-squared-bfv-batched-stream");
+  add_encryption_parameters(record, context);
+  record.set_parameter("input", input);
+  record.set_parameter("snps", num_snps);
+  record.set_parameter("snps_per_ciphertext", capacity);
+  record.set_parameter("threads", num_workers);
+  record.set_parameter("queue_capacity", queue_capacity);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_total", t3 - t2);
+  record.add_timing("t_input_encryption", encrypt_stage.busy);
+  record.add_timing("t_computation", compute_stage.busy);
+  record.add_timing("t_decryption", decrypt_stage.busy);
+  record.add_timing("t_encrypted_queue_push_wait", encrypted_stats.push_wait);
+  record.add_timing("t_computed_queue_push_wait", computed_stats.push_wait);
+  record.set_metric("ciphertexts", num_ciphertexts);
+  record.set_metric("snps_per_second", snps_per_second);
+  record.set_metric("encryption_snps_per_second",
+                    encrypt_stage.snps_per_second());
+  record.set_metric("computation_snps_per_second",
+                    compute_stage.snps_per_second());
+  record.set_metric("decryption_snps_per_second",
+                    decrypt_stage.snps_per_second());
+  record.set_metric("encrypted_queue_mean", encrypted_stats.mean_occupancy);
+  record.set_metric("encrypted_queue_max", encrypted_stats.max_occupancy);
+  record.set_metric("computed_queue_mean", computed_stats.mean_occupancy);
+  record.set_metric("computed_queue_max", computed_stats.max_occupancy);
+  record.set_metric("peak_rss_bytes", peak_rss);
+  record.set_metric("noise_budget_bits", min_noise_budget);
+  record.write();
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'chi-squared-bfv-batched'..." << std::endl;
-  ChiSquaredBatched().run_chi_squared();
+  if (has_flag(argc, argv, "--schedule")) {
+    ChiSquaredBatched().run_schedule();
+  } else if (has_flag(argc, argv, "--stream")) {
+    ChiSquaredBatched().run_stream();
+  } else if (has_flag(argc, argv, "--batch")) {
+    ChiSquaredBatched().run_batch();
+  } else {
+    ChiSquaredBatched().run_chi_squared();
+  }
   return 0;
 }
@@ -7,14 +7,18 @@
 #include <algorithm>
 #include <chrono>
 #include <math.h>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <numeric>
 #include <random>
+#include <string>
 #include <vector>
 #include <cassert>
 
+#include "../expression_scheduler.h"
+
 typedef std::chrono::high_resolution_clock Time;
 typedef std::chrono::milliseconds ms;
 
@@ -25,11 +29,79 @@ struct ResultCiphertexts {
   seal::Ciphertext beta_2;
   seal::Ciphertext beta_3;
 
+  ResultCiphertexts() = default;
+
   ResultCiphertexts(seal::Ciphertext alpha, seal::Ciphertext beta_1,
                     seal::Ciphertext beta_2, seal::Ciphertext beta_3)
       : alpha(alpha), beta_1(beta_1), beta_2(beta_2), beta_3(beta_3){};
 };
 
+/// Genotype counts of a SNP, i.e., the contingency triple of a chi-squared
+/// test.
+struct SnpCounts {
+  uint64_t n0;
+  uint64_t n1;
+  uint64_t n2;
+};
+
+/// The outputs of compute_alpha_betas() for a single SNP.
+struct ChiSquaredResult {
+  uint64_t alpha;
+  uint64_t beta_1;
+  uint64_t beta_2;
+  uint64_t beta_3;
+
+  /// Computed in plaintext (modulo plain_modulus), used to verify results.
+  static ChiSquaredResult expected(const SnpCounts &counts,
+                                   uint64_t plain_modulus);
+
+  bool operator==(const ChiSquaredResult &other) const {
+    return alpha == other.alpha && beta_1 == other.beta_1 &&
+           beta_2 == other.beta_2 && beta_3 == other.beta_3;
+  }
+};
+
+/// Reads one SNP per line as "n0,n1,n2", skipping empty lines and lines
+/// starting with '#'.
+std::vector<SnpCounts> read_snp_counts(const std::string &filename);
+
+/// Random but reproducible SNPs with counts of at most max_count.
+std::vector<SnpCounts> random_snp_counts(std::size_t num_snps,
+                                         uint64_t max_count);
+
+/// Reads SNPs chunk by chunk from a file (see read_snp_counts()) or draws
+/// random ones (see random_snp_counts()), so that a stream of SNPs never has
+/// to be in memory at once.
+class SnpReader {
+ public:
+  explicit SnpReader(const std::string &filename);
+
+  SnpReader(std::size_t num_snps, uint64_t max_count);
+
+  /// The next (up to) max_snps SNPs, empty once all SNPs were read.
+  std::vector<SnpCounts> next(std::size_t max_snps);
+
+ private:
+  std::string filename;
+  std::unique_ptr<std::ifstream> file;
+  std::size_t line_number = 0;
+
+  std::size_t remaining_random_snps = 0;
+  std::mt19937_64 gen{42};
+  std::uniform_int_distribution<uint64_t> count;
+};
+
+/// Bits of the smallest plaintext modulus that holds all results for counts
+/// of at most max_count (at least 20, the modulus of run_chi_squared()).
+int plain_modulus_bits_for(uint64_t max_count);
+
+/// The three input ciphertexts of compute_alpha_betas().
+struct SnpCiphertexts {
+  seal::Ciphertext n0;
+  seal::Ciphertext n1;
+  seal::Ciphertext n2;
+};
+
 class ChiSquaredBatched {
  private:
   /// the seal context, i.e. object that holds params/etc
@@ -47,25 +119,87 @@ class ChiSquaredBatched {
   /// keys required to relinearize after multipliction (ptr for consistency)
   std::unique_ptr<seal::RelinKeys> relinKeys;
 
+  /// whether the keys were loaded from the key store instead of generated
+  bool keysLoaded = false;
+
   std::unique_ptr<seal::Encryptor> encryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::BatchEncoder> encoder;
 
+  /// the constants of compute_alpha_betas() in all slots, encoded once
+  seal::Plaintext fourAllSlots;
+  seal::Plaintext twoAllSlots;
+
+  /// compute_alpha_betas() on any evaluator with the interface of
+  /// seal::Evaluator, e.g., one that counts the operations.
+  template <typename Evaluator>
+  ResultCiphertexts compute_alpha_betas(Evaluator &evaluator,
+                                        const seal::Ciphertext &N_0,
+                                        const seal::Ciphertext &N_1,
+                                        const seal::Ciphertext &N_2);
+
   seal::Ciphertext encode_all_slots_and_encrypt(int64_t value);
 
   seal::Plaintext encode_all_slots(int64_t value);
 
+  /// Encrypts values (at most one per slot, padded with zeros).
+  seal::Ciphertext encode_and_encrypt(const std::vector<uint64_t> &values);
+
+  /// Decrypts and decodes all slots.
+  std::vector<uint64_t> decrypt_all_slots(const seal::Ciphertext &ctxt);
+
  public:
   void run_chi_squared();
 
+  /// Evaluates many SNPs (CHI_SQUARED_INPUT, or CHI_SQUARED_SNPS random
+  /// ones) with one SNP per slot and reports SNPs per second in
+  /// BATCH_FILENAME.
+  void run_batch();
+
+  /// Like run_batch(), but streams the SNPs through three overlapping stages
+  /// (encryption, computation on STREAM_THREADS workers, decryption) that
+  /// are connected by queues of STREAM_QUEUE_CAPACITY ciphertexts, so that
+  /// memory stays constant however many SNPs there are. Reports the
+  /// throughput of each stage and the queue occupancy in STREAM_FILENAME.
+  void run_stream();
+
+  /// Compares compute_alpha_betas() with its ExpressionScheduler version,
+  /// sequentially and on SCHEDULE_THREADS threads, and reports op counts,
+  /// depth, and latency in SCHEDULE_FILENAME. The op counts of
+  /// compute_alpha_betas() are counted while it runs, its depth and critical
+  /// path are derived from the equivalent circuit.
+  void run_schedule();
+
   void setup_context_bfv(std::size_t poly_modulus_degree,
-                         std::uint64_t plain_modulus);
+                         int plain_modulus_bits = 20);
+
+  /// Number of SNPs per ciphertext, i.e., the number of slots.
+  std::size_t snps_per_ciphertext() const;
+
+  /// Encrypts SNPs [first, first + count), the i-th of them into slot i.
+  SnpCiphertexts encrypt_snps(const std::vector<SnpCounts> &snps,
+                              std::size_t first, std::size_t count);
+
+  /// Decrypts the results of the first count slots.
+  std::vector<ChiSquaredResult> decrypt_results(
+      const ResultCiphertexts &results, std::size_t count);
 
   ResultCiphertexts compute_alpha_betas(const seal::Ciphertext &N_0,
                                         const seal::Ciphertext &N_1,
                                         const seal::Ciphertext &N_2);
 
+  /// Adds alpha, beta_1, beta_2, and beta_3 (in this order) of the inputs
+  /// N_0, N_1, and N_2 (in this order) to the scheduler, each written down
+  /// from its formula.
+  static void build_alpha_betas(ExpressionScheduler &scheduler);
+
+  /// compute_alpha_betas() evaluated by a scheduler of build_alpha_betas().
+  ResultCiphertexts compute_alpha_betas_scheduled(
+      const ExpressionScheduler &scheduler, const seal::Ciphertext &N_0,
+      const seal::Ciphertext &N_1, const seal::Ciphertext &N_2,
+      std::size_t num_threads);
+
   int main(int argc, char *argv[]);
 
   int64_t get_first_decrypted_value(seal::Ciphertext value);
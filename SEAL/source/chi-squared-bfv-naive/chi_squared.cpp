@@ -1,6 +1,7 @@
 #include "chi_squared.h"
 
 #include "../common.h"
+#include "../key_store.h"
 
 void ChiSquared::setup_context_bfv(std::size_t poly_modulus_degree,
                                    std::uint64_t plain_modulus) {
@@ -26,12 +27,12 @@ void ChiSquared::setup_context_bfv(std::size_t poly_modulus_degree,
   // Instantiate context
   context = seal::SEALContext::Create(params);
 
-  /// Create keys
-  seal::KeyGenerator keyGenerator(context);
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeySet keys = KeyStore::from_env().get(context, KeyRequest());
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -147,7 +148,7 @@ void ChiSquared::run_chi_squared() {
   auto t0 = Time::now();
   setup_context_bfv(32768, 4096);
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
   auto t2 = Time::now();
   int32_t n0_val = 2, n1_val = 7, n2_val = 9;
@@ -194,6 +195,15 @@ void ChiSquared::run_chi_squared() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("chi-squared-bfv-naive");
+  add_encryption_parameters(record, context);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_chi_squared.txt");
 }
@@ -7,6 +7,8 @@
 #include <fstream>
 #include <iostream>
 
+#include "result_record.h"
+
 // This method is taken from SEAL's examples helper methods, see
 // https://github.com/microsoft/SEAL/blob/master/native/examples/examples.h.
 inline void write_parameters_to_file(std::shared_ptr<seal::SEALContext> context,
@@ -64,3 +66,72 @@ inline void write_parameters_to_file(std::shared_ptr<seal::SEALContext> context,
 
   outfile.close();
 }
+
+/// Column names matching write_parameters_csv().
+inline std::string parameters_csv_header() {
+  return "poly_modulus_degree,log_q,coeff_modulus,plain_modulus_bits";
+}
+
+/// Writes the encryption parameters of the context as comma-separated values,
+/// the coefficient modulus is given as the bit sizes of its primes (e.g.,
+/// 60:60:60:60) and the plaintext modulus bit size is 0 for CKKS.
+inline void write_parameters_csv(std::ostream &os,
+                                 std::shared_ptr<seal::SEALContext> context) {
+  if (!context) {
+    throw std::invalid_argument("context is not set");
+  }
+  auto &context_data = *context->key_context_data();
+  auto &parms = context_data.parms();
+
+  os << parms.poly_modulus_degree() << ","
+     << context_data.total_coeff_modulus_bit_count() << ",";
+  auto coeff_modulus = parms.coeff_modulus();
+  for (std::size_t i = 0; i < coeff_modulus.size(); i++) {
+    if (i > 0) os << ":";
+    os << coeff_modulus[i].bit_count();
+  }
+  os << ",";
+  if (parms.scheme() == seal::scheme_type::BFV) {
+    os << parms.plain_modulus().bit_count();
+  } else {
+    os << 0;
+  }
+}
+
+/// Name of the parameter set selected at compile time (see CMakeLists.txt).
+inline std::string parameter_set_name() {
+#if defined(MANUALPARAMS)
+  return "manualparams";
+#elif defined(CINGUPARAM)
+  return "cinguparam";
+#elif defined(SEALPARAMS)
+  return "sealparams";
+#else
+  return "default";
+#endif
+}
+
+/// Adds the encryption parameters of the context to the result record.
+inline void add_encryption_parameters(
+    ResultRecord &record, std::shared_ptr<seal::SEALContext> context) {
+  if (!context) {
+    throw std::invalid_argument("context is not set");
+  }
+  auto &context_data = *context->key_context_data();
+  auto &parms = context_data.parms();
+
+  bool is_bfv = parms.scheme() == seal::scheme_type::BFV;
+  record.set_parameter("library", "SEAL");
+  record.set_parameter("scheme", is_bfv ? "BFV" : "CKKS");
+  record.set_parameter("parameter_set", parameter_set_name());
+  record.set_parameter("poly_modulus_degree", parms.poly_modulus_degree());
+  record.set_parameter("log_q", context_data.total_coeff_modulus_bit_count());
+  std::vector<int> coeff_modulus_bits;
+  for (auto &modulus : parms.coeff_modulus()) {
+    coeff_modulus_bits.push_back(modulus.bit_count());
+  }
+  record.set_parameter("coeff_modulus_bits", coeff_modulus_bits);
+  if (is_bfv) {
+    record.set_parameter("plain_modulus", parms.plain_modulus().value());
+  }
+}
@@ -0,0 +1,321 @@
+#ifndef CONVOLUTION_H_
+#define CONVOLUTION_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "plaintext_cache.h"
+#include "sweep.h"
+
+/*
+ * Whole-image convolution of a batched BFV ciphertext with k x k kernels of
+ * integer weights (k odd), e.g., the Laplacian of the kernel benchmarks.
+ *
+ * An image of width x height pixels is stored row-major in the first slots
+ * of a batching row, i.e., width * height must not exceed half of the slots.
+ * Instead of computing pixel by pixel, the whole image is rotated once per
+ * kernel tap (dx, dy), which moves the neighbor (x + dx, y + dy) of every
+ * pixel into the slot of (x, y), and the rotated copies are summed up with
+ * their weights. The number of rotations hence depends on the kernel only,
+ * not on the size of the image. Copies with the same weight are added up
+ * first, so that each distinct weight other than +-1 takes one
+ * multiplication by a constant plaintext. The weight is the same in every
+ * slot, so it is encoded as a constant polynomial (see
+ * PlaintextCache::constant()) rather than batch-encoded.
+ *
+ * Rotations wrap around, so only the interior pixels, i.e., those at least
+ * the kernel radius away from the image border, are valid convolutions.
+ * convolve_keep_border() keeps the input pixels on the border, as the
+ * benchmarks do.
+ */
+
+/// Weights of a k x k kernel, k odd, as kernel[dy + r][dx + r] for radius r.
+typedef std::vector<std::vector<int>> ConvolutionKernel;
+
+/// Radius r of a k x k kernel, i.e., k = 2r + 1.
+inline int kernel_radius(const ConvolutionKernel &kernel) {
+  if (kernel.size() % 2 == 0) {
+    throw std::invalid_argument("kernel size must be odd");
+  }
+  for (auto &row : kernel) {
+    if (row.size() != kernel.size()) {
+      throw std::invalid_argument("kernel must be square");
+    }
+  }
+  return static_cast<int>(kernel.size() / 2);
+}
+
+/// Parses a kernel written row by row, e.g., "1,1,1;1,-8,1;1,1,1".
+inline ConvolutionKernel parse_convolution_kernel(const std::string &str) {
+  ConvolutionKernel kernel;
+  for (auto &row : split(str, ';')) kernel.push_back(parse_int_list(row, ','));
+  kernel_radius(kernel);
+  return kernel;
+}
+
+/// Convolution of a row-major image in plaintext, with the input pixels kept
+/// on the border (see ConvolutionEngine::convolve_keep_border()).
+inline std::vector<std::int64_t> convolve_plain(
+    const std::vector<std::int64_t> &image, std::size_t width,
+    std::size_t height, const ConvolutionKernel &kernel) {
+  const int r = kernel_radius(kernel);
+  std::vector<std::int64_t> result(image);
+  for (int y = r; y + r < static_cast<int>(height); ++y) {
+    for (int x = r; x + r < static_cast<int>(width); ++x) {
+      std::int64_t value = 0;
+      for (int dy = -r; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx) {
+          value += kernel[dy + r][dx + r] * image[(y + dy) * width + x + dx];
+        }
+      }
+      result[y * width + x] = value;
+    }
+  }
+  return result;
+}
+
+/// Convolution of a row-major image in plaintext with zeros outside of the
+/// image, i.e., defined on all pixels (see image_packing.h).
+inline std::vector<std::int64_t> convolve_plain_zero_padded(
+    const std::vector<std::int64_t> &image, std::size_t width,
+    std::size_t height, const ConvolutionKernel &kernel) {
+  const int r = kernel_radius(kernel);
+  const int w = static_cast<int>(width), h = static_cast<int>(height);
+  std::vector<std::int64_t> result(image.size(), 0);
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      std::int64_t value = 0;
+      for (int dy = -r; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx) {
+          if (x + dx < 0 || y + dy < 0 || x + dx >= w || y + dy >= h) continue;
+          value += kernel[dy + r][dx + r] * image[(y + dy) * w + x + dx];
+        }
+      }
+      result[y * w + x] = value;
+    }
+  }
+  return result;
+}
+
+class ConvolutionEngine {
+ public:
+  /// Engine for images of width x height pixels in ciphertexts with
+  /// slot_count slots.
+  ConvolutionEngine(seal::Evaluator &evaluator,
+                    const seal::GaloisKeys &galois_keys,
+                    PlaintextCache &plaintext_cache, std::size_t slot_count,
+                    std::size_t width, std::size_t height)
+      : evaluator(evaluator),
+        galois_keys(galois_keys),
+        plaintext_cache(plaintext_cache),
+        slot_count(slot_count),
+        width(width),
+        height(height) {
+    if (width * height > slot_count / 2) {
+      throw std::invalid_argument(
+          std::to_string(width) + "x" + std::to_string(height) +
+          " pixels exceed a batching row of " + std::to_string(slot_count / 2) +
+          " slots");
+    }
+  }
+
+  /// Rotation step that moves the neighbor (x + dx, y + dy) into (x, y).
+  static int step(int dx, int dy, std::size_t width) {
+    return dy * static_cast<int>(width) + dx;
+  }
+
+  /// Rotation steps of the taps of the kernels, i.e., the Galois keys the
+  /// engine needs.
+  static std::vector<int> galois_steps(
+      const std::vector<ConvolutionKernel> &kernels, std::size_t width) {
+    std::vector<int> steps;
+    for (auto &kernel : kernels) {
+      for (auto &tap : taps(kernel, width)) {
+        if (tap.first != 0) steps.push_back(tap.first);
+      }
+    }
+    std::sort(steps.begin(), steps.end());
+    steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+    return steps;
+  }
+
+  /// The image rotated by each step of the nonzero taps of the kernels, one
+  /// rotation per distinct step (step 0 is the image itself).
+  std::map<int, seal::Ciphertext> shift(
+      const seal::Ciphertext &image,
+      const std::vector<ConvolutionKernel> &kernels) {
+    std::map<int, seal::Ciphertext> shifted;
+    for (auto &kernel : kernels) {
+      for (auto &tap : taps(kernel, width)) {
+        if (shifted.count(tap.first)) continue;
+        if (tap.first == 0) {
+          shifted[0] = image;
+          continue;
+        }
+        evaluator.rotate_rows(image, tap.first, galois_keys,
+                              shifted[tap.first]);
+        num_rotations++;
+      }
+    }
+    return shifted;
+  }
+
+  /// Each distinct weight of the kernels other than +-1 as a constant
+  /// plaintext, e.g., encoded once for all tiles of an image (see tiling.h).
+  static std::map<int, seal::Plaintext> encode_weights(
+      const std::vector<ConvolutionKernel> &kernels,
+      PlaintextCache &plaintext_cache) {
+    std::map<int, seal::Plaintext> weights;
+    for (auto &kernel : kernels) {
+      for (auto &row : kernel) {
+        for (int weight : row) {
+          if (weight == 0 || weight == 1 || weight == -1) continue;
+          if (!weights.count(weight)) {
+            weights[weight] = plaintext_cache.constant(weight);
+          }
+        }
+      }
+    }
+    return weights;
+  }
+
+  /// Sum of the shifted copies (see shift()) weighted by the kernel.
+  seal::Ciphertext weighted_sum(
+      const std::map<int, seal::Ciphertext> &shifted,
+      const ConvolutionKernel &kernel) {
+    return weighted_sum(shifted, kernel,
+                        encode_weights({kernel}, plaintext_cache));
+  }
+
+  /// Sum of the shifted copies weighted by the kernel, with the weights
+  /// encoded by encode_weights().
+  seal::Ciphertext weighted_sum(
+      const std::map<int, seal::Ciphertext> &shifted,
+      const ConvolutionKernel &kernel,
+      const std::map<int, seal::Plaintext> &weights) {
+    // copies with the same weight are added up before the multiplication
+    std::map<int, seal::Ciphertext> sums;
+    for (auto &tap : taps(kernel, width)) {
+      auto copy = shifted.find(tap.first);
+      if (copy == shifted.end()) {
+        throw std::invalid_argument("kernel tap was not shifted");
+      }
+      auto sum = sums.find(tap.second);
+      if (sum == sums.end()) {
+        sums[tap.second] = copy->second;
+      } else {
+        evaluator.add_inplace(sum->second, copy->second);
+      }
+    }
+    if (sums.empty()) throw std::invalid_argument("kernel of zeros only");
+
+    seal::Ciphertext result;
+    bool first = true;
+    for (auto &sum : sums) {
+      const int weight = sum.first;
+      seal::Ciphertext &term = sum.second;
+      if (weight != 1 && weight != -1) {
+        auto plain = weights.find(weight);
+        if (plain == weights.end()) {
+          throw std::invalid_argument("weight " + std::to_string(weight) +
+                                      " was not encoded");
+        }
+        evaluator.multiply_plain_inplace(term, plain->second);
+        num_plain_multiplications++;
+      }
+      if (first) {
+        result = std::move(term);
+        if (weight == -1) evaluator.negate_inplace(result);
+        first = false;
+      } else if (weight == -1) {
+        evaluator.sub_inplace(result, term);
+      } else {
+        evaluator.add_inplace(result, term);
+      }
+    }
+    return result;
+  }
+
+  /// Convolution of the image with the kernel, valid on interior pixels.
+  seal::Ciphertext convolve(const seal::Ciphertext &image,
+                            const ConvolutionKernel &kernel) {
+    return weighted_sum(shift(image, {kernel}), kernel);
+  }
+
+  /// As above, with the weights encoded by encode_weights().
+  seal::Ciphertext convolve(const seal::Ciphertext &image,
+                            const ConvolutionKernel &kernel,
+                            const std::map<int, seal::Plaintext> &weights) {
+    return weighted_sum(shift(image, {kernel}), kernel, weights);
+  }
+
+  /// Convolution of the image with the kernel, with the input pixels kept
+  /// on the border: image + interior * (convolved - image).
+  seal::Ciphertext convolve_keep_border(const seal::Ciphertext &image,
+                                        const ConvolutionKernel &kernel) {
+    return merge(image, convolve(image, kernel),
+                 interior_mask(kernel_radius(kernel)));
+  }
+
+  /// image + mask * (convolved - image), i.e., the convolution on the slots
+  /// where the mask is 1 and the input pixels on those where it is 0.
+  seal::Ciphertext merge(const seal::Ciphertext &image,
+                         seal::Ciphertext convolved,
+                         const seal::Plaintext &mask) {
+    evaluator.sub_inplace(convolved, image);
+    evaluator.multiply_plain_inplace(convolved, mask);
+    num_plain_multiplications++;
+    evaluator.add_inplace(convolved, image);
+    return convolved;
+  }
+
+  /// 1 on the pixels at least radius away from the image border, else 0.
+  const seal::Plaintext &interior_mask(int radius) {
+    std::vector<std::int64_t> mask(slot_count, 0);
+    const int w = static_cast<int>(width), h = static_cast<int>(height);
+    for (int y = radius; y + radius < h; ++y) {
+      for (int x = radius; x + radius < w; ++x) mask[y * w + x] = 1;
+    }
+    return plaintext_cache.batch(mask);
+  }
+
+  std::size_t rotations() const { return num_rotations; }
+
+  std::size_t plain_multiplications() const {
+    return num_plain_multiplications;
+  }
+
+ private:
+  /// (rotation step, weight) of the nonzero taps of the kernel.
+  static std::vector<std::pair<int, int>> taps(const ConvolutionKernel &kernel,
+                                               std::size_t width) {
+    const int r = kernel_radius(kernel);
+    std::vector<std::pair<int, int>> taps;
+    for (int dy = -r; dy <= r; ++dy) {
+      for (int dx = -r; dx <= r; ++dx) {
+        const int weight = kernel[dy + r][dx + r];
+        if (weight != 0) taps.emplace_back(step(dx, dy, width), weight);
+      }
+    }
+    return taps;
+  }
+
+  seal::Evaluator &evaluator;
+  const seal::GaloisKeys &galois_keys;
+  PlaintextCache &plaintext_cache;
+  const std::size_t slot_count;
+  const std::size_t width;
+  const std::size_t height;
+
+  std::size_t num_rotations = 0;
+  std::size_t num_plain_multiplications = 0;
+};
+
+#endif
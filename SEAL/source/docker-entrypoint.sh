@@ -43,15 +43,181 @@ function run_microbenchmark() {
     done
 }
 
+# JSON-lines result records of all application benchmarks
+export RESULTS_FILENAME=${EVAL_BUILD_DIR}/seal_results.jsonl
+
+# Keys generated by the first run of a benchmark are stored and loaded by all
+# further runs (optional), the results record t_keygen vs. t_key_load and the
+# CSV files leave t_keygen empty for runs that loaded their keys
+if [ -n "${KEY_STORE}" ]
+then
+    export KEY_STORE_DIR=${EVAL_BUILD_DIR}/keys
+fi
+
 # Microbenchmark BFV
 export OUTPUT_FILENAME=seal_bfv_microbenchmark.csv
+export STATS_FILENAME=seal_bfv_microbenchmark_stats.csv
 run_microbenchmark microbenchmark-bfv
-upload_files SEAL-BFV ${OUTPUT_FILENAME} fhe_parameters_microbenchmark_bfv.txt
+upload_files SEAL-BFV ${OUTPUT_FILENAME} ${STATS_FILENAME} fhe_parameters_microbenchmark_bfv.txt
 
 # Microbenchmark CKKS
 export OUTPUT_FILENAME=seal_ckks_microbenchmark.csv
+export STATS_FILENAME=seal_ckks_microbenchmark_stats.csv
 run_microbenchmark microbenchmark-ckks
-upload_files SEAL-CKKS-Batched ${OUTPUT_FILENAME} fhe_parameters_microbenchmark_ckks.txt
+upload_files SEAL-CKKS-Batched ${OUTPUT_FILENAME} ${STATS_FILENAME} fhe_parameters_microbenchmark_ckks.txt
+
+# Microbenchmark parameter sweeps (optional, as they take considerably longer)
+if [ -n "${RUN_SWEEP}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export SWEEP_FILENAME=seal_bfv_microbenchmark_sweep.csv
+    export STATS_FILENAME=seal_bfv_microbenchmark_sweep_stats.csv
+    ./microbenchmark-bfv --sweep
+    upload_files SEAL-BFV ${SWEEP_FILENAME} ${STATS_FILENAME}
+
+    export SWEEP_FILENAME=seal_ckks_microbenchmark_sweep.csv
+    export STATS_FILENAME=seal_ckks_microbenchmark_sweep_stats.csv
+    ./microbenchmark-ckks --sweep
+    upload_files SEAL-CKKS-Batched ${SWEEP_FILENAME} ${STATS_FILENAME}
+    unset SWEEP_FILENAME
+fi
+
+# Microbenchmark multi-threaded throughput (optional, K = 1..nproc threads)
+if [ -n "${RUN_THROUGHPUT}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export THROUGHPUT_FILENAME=seal_bfv_microbenchmark_throughput.csv
+    ./microbenchmark-bfv --throughput
+    upload_files SEAL-BFV ${THROUGHPUT_FILENAME}
+
+    export THROUGHPUT_FILENAME=seal_ckks_microbenchmark_throughput.csv
+    ./microbenchmark-ckks --throughput
+    upload_files SEAL-CKKS-Batched ${THROUGHPUT_FILENAME}
+    unset THROUGHPUT_FILENAME
+fi
+
+unset STATS_FILENAME
+
+# Serialization of keys and ciphertexts for the targets' parameters (optional)
+if [ -n "${RUN_SERIALIZATION}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export OUTPUT_FILENAME=seal_serialization.csv
+    ./serialization
+    upload_files SEAL-Serialization ${OUTPUT_FILENAME}
+fi
+
+# Galois key sets (handpicked, default, powers of two) per target (optional)
+if [ -n "${RUN_GALOIS_KEYS}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export OUTPUT_FILENAME=seal_galois_keys.csv
+    export STATS_FILENAME=seal_galois_keys_stats.csv
+    ./galois_keys
+    upload_files SEAL-Galois-Keys ${OUTPUT_FILENAME} ${STATS_FILENAME}
+    unset STATS_FILENAME
+fi
+
+# Cardio BFV batched with many patients per ciphertext, cohorts of 1 to 100k
+# patients (optional)
+if [ -n "${RUN_COHORT}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export COHORT_FILENAME=seal_batched_bfv_cardio_cohort.csv
+    ./cardio_bfv_batched_sealparams --cohort
+    upload_files SEAL-BFV-Batched-Sealparams ${COHORT_FILENAME}
+fi
+
+# Cardio BFV comparison circuit on bit views vs. deep copies, 8 to 32-bit
+# values (optional)
+if [ -n "${RUN_COMPARISON}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export COMPARISON_FILENAME=seal_bfv_cardio_comparison.csv
+    MEMORY_PROFILE=1 ./cardio_bfv_sealparams --comparison
+    upload_files SEAL-BFV-Sealparams ${COMPARISON_FILENAME}
+fi
+
+# Cardio CKKS batched with comparisons via sign approximation vs. the bitwise
+# circuit (optional)
+if [ -n "${RUN_SIGN}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export SIGN_FILENAME=seal_batched_ckks_cardio_sign.csv
+    ./cardio_ckks_batched --sign
+    upload_files SEAL-CKKS-Batched ${SIGN_FILENAME}
+fi
+
+# Cardio BFV batched with the smallest parameters that still decrypt
+# correctly, as selected by the modulus planner (optional)
+if [ -n "${RUN_PLAN}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export PLAN_FILENAME=seal_batched_bfv_cardio_plan.csv
+    export OUTPUT_FILENAME=seal_batched_bfv_cardio_planned.csv
+    echo "t_keygen,t_input_encryption,t_computation,t_decryption" > $OUTPUT_FILENAME
+    ./cardio_bfv_batched_sealparams --plan
+    upload_files SEAL-BFV-Batched-Planned ${PLAN_FILENAME} ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
+fi
+
+# Chi-Squared BFV batched with one SNP per slot, 100k random SNPs (optional)
+if [ -n "${RUN_CHI_SQUARED_BATCH}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export BATCH_FILENAME=seal_bfv_batched_chi_squared_snps.csv
+    ./chi_squared_batched --batch
+    upload_files SEAL-BFV-Batched ${BATCH_FILENAME}
+fi
+
+# Chi-Squared BFV batched, streaming 1M random SNPs through the pipelined
+# encryption, computation, and decryption stages (optional)
+if [ -n "${RUN_CHI_SQUARED_STREAM}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export STREAM_FILENAME=seal_bfv_batched_chi_squared_stream.csv
+    CHI_SQUARED_SNPS=${CHI_SQUARED_SNPS:-1000000} ./chi_squared_batched --stream
+    upload_files SEAL-BFV-Batched ${STREAM_FILENAME}
+fi
+
+# Chi-Squared BFV batched, hand-written vs. scheduled alpha/beta circuit
+# (optional)
+if [ -n "${RUN_CHI_SQUARED_SCHEDULE}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export SCHEDULE_FILENAME=seal_bfv_batched_chi_squared_schedule.csv
+    ./chi_squared_batched --schedule
+    upload_files SEAL-BFV-Batched ${SCHEDULE_FILENAME}
+fi
+
+# Kernel BFV with the whole-image convolution, 8x8 to 128x128 pixels
+# (optional)
+if [ -n "${RUN_KERNEL_SWEEP}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export SWEEP_FILENAME=seal_bfv_kernel_sweep.csv
+    ./kernel --sweep
+    upload_files SEAL-BFV ${SWEEP_FILENAME}
+fi
+
+# Kernel BFV batched with tiles for images larger than a ciphertext,
+# 128x128 to 1024x1024 pixels (optional)
+if [ -n "${RUN_KERNEL_TILED}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export TILED_FILENAME=seal_bfv_kernel_tiled.csv
+    ./kernel_batched --tiled
+    upload_files SEAL-BFV ${TILED_FILENAME}
+fi
+
+# Kernel BFV batched with several images per ciphertext and several filters
+# sharing the rotations (optional)
+if [ -n "${RUN_KERNEL_MULTI}" ]
+then
+    cd $EVAL_BUILD_DIR
+    export MULTI_FILENAME=seal_bfv_kernel_multi.csv
+    ./kernel_batched --multi
+    upload_files SEAL-BFV ${MULTI_FILENAME}
+fi
 
 # Cardio BFV (using modified Cingulata parameters)
 export OUTPUT_FILENAME=seal_bfv_cardio_cinguparam.csv
@@ -60,8 +226,11 @@ upload_files SEAL-BFV-Cinguparam ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
 
 # Cardio BFV (using Seal's automatically determined moduli)
 export OUTPUT_FILENAME=seal_bfv_cardio_sealparams.csv
+export MEMORY_FILENAME=seal_bfv_cardio_sealparams_memory.csv
 run_benchmark cardio_bfv_sealparams
 upload_files SEAL-BFV-Sealparams ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
+if [ -n "${MEMORY_PROFILE}" ]; then upload_files SEAL-BFV-Sealparams ${MEMORY_FILENAME}; fi
+unset MEMORY_FILENAME
 
 # Cardio BFV (using manually determined parameters)
 export OUTPUT_FILENAME=seal_bfv_cardio_manaulparams.csv
@@ -71,8 +240,11 @@ upload_files SEAL-BFV-Manualparams ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
 
 # Cardio BFV Naive with seal default params
 export OUTPUT_FILENAME=seal_bfv_cardio_naive_sealparams.csv
+export MEMORY_FILENAME=seal_bfv_cardio_naive_sealparams_memory.csv
 run_benchmark cardio_bfv_naive_sealparams
 upload_files SEAL-BFV-Naive-Sealparams ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
+if [ -n "${MEMORY_PROFILE}" ]; then upload_files SEAL-BFV-Naive-Sealparams ${MEMORY_FILENAME}; fi
+unset MEMORY_FILENAME
 
 # Cardio BFV Naive with same manually selected params as manualparams
 export OUTPUT_FILENAME=seal_bfv_cardio_naive_manualparams.csv
@@ -86,8 +258,11 @@ upload_files SEAL-BFV-Naive-Cinguparam ${OUTPUT_FILENAME} fhe_parameters_cardio.
 
 # Cardio BFV batched with seal default params
 export OUTPUT_FILENAME=seal_batched_bfv_cardio_sealparams.csv
+export MEMORY_FILENAME=seal_batched_bfv_cardio_sealparams_memory.csv
 run_benchmark cardio_bfv_batched_sealparams
 upload_files SEAL-BFV-Batched-Sealparams ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
+if [ -n "${MEMORY_PROFILE}" ]; then upload_files SEAL-BFV-Batched-Sealparams ${MEMORY_FILENAME}; fi
+unset MEMORY_FILENAME
 
 # Cardio BFV batched with cinguparam
 export OUTPUT_FILENAME=seal_batched_bfv_cardio_cingupara.csv
@@ -101,13 +276,19 @@ upload_files SEAL-BFV-Batched-Manualparams ${OUTPUT_FILENAME} fhe_parameters_car
 
 # Cardio CKKS batched
 export OUTPUT_FILENAME=seal_batched_ckks_cardio.csv
+export MEMORY_FILENAME=seal_batched_ckks_cardio_memory.csv
 run_benchmark cardio_ckks_batched
 upload_files SEAL-CKKS-Batched ${OUTPUT_FILENAME} fhe_parameters_cardio.txt
+if [ -n "${MEMORY_PROFILE}" ]; then upload_files SEAL-CKKS-Batched ${MEMORY_FILENAME}; fi
+unset MEMORY_FILENAME
 
 # NN CKKS batched
 export OUTPUT_FILENAME=seal_batched_ckks_nn.csv
+export MEMORY_FILENAME=seal_batched_ckks_nn_memory.csv
 run_benchmark nn_ckks_batched
 upload_files SEAL-CKKS-Batched ${OUTPUT_FILENAME} fhe_parameters_nn.txt
+if [ -n "${MEMORY_PROFILE}" ]; then upload_files SEAL-CKKS-Batched ${MEMORY_FILENAME}; fi
+unset MEMORY_FILENAME
 
 # Chi-Squared BFV with manual params, reusing subexpressions, etc (OPT)
 export OUTPUT_FILENAME=seal_bfv_chi_squared_opt.csv
@@ -134,3 +315,5 @@ upload_files SEAL-BFV ${OUTPUT_FILENAME} fhe_parameters_kernel.txt
 export OUTPUT_FILENAME=seal_batched_bfv_kernel.csv
 run_benchmark kernel_batched
 upload_files SEAL-BFV-Batched ${OUTPUT_FILENAME} fhe_parameters_kernel.txt
+
+upload_files SEAL ${RESULTS_FILENAME}
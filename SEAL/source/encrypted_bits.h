@@ -0,0 +1,143 @@
+#ifndef ENCRYPTED_BITS_H_
+#define ENCRYPTED_BITS_H_
+
+#include <seal/seal.h>
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "lazy_relin.h"
+#include "vector_view.h"
+
+/*
+ * Bits of the unbatched BFV circuits, i.e., one bit per ciphertext with
+ * plain modulus 2, where addition is XOR and multiplication is AND.
+ *
+ * A Bit is either a ciphertext or a constant known to the server: the
+ * padding of a shifted or widened value, the initial carry of an adder, or a
+ * bit of a public threshold such as the 50 in (50 < age). BitEvaluator folds
+ * constants away (x ^ 0 = x, x & 0 = 0, x & 1 = x) and computes x ^ 1 with
+ * add_plain, so the server never encrypts a constant and gates with a
+ * constant input cost at most one plaintext addition.
+ */
+class Bit {
+ public:
+  /// The constant 0.
+  Bit() = default;
+
+  Bit(seal::Ciphertext ctxt) : encrypted(true), ctxt(std::move(ctxt)) {}
+
+  static Bit constant(bool value) {
+    Bit bit;
+    bit.constant_value = value;
+    return bit;
+  }
+
+  bool is_constant() const { return !encrypted; }
+
+  /// Value of a constant bit.
+  bool value() const {
+    if (encrypted) throw std::logic_error("bit is not a constant");
+    return constant_value;
+  }
+
+  seal::Ciphertext &ciphertext() {
+    if (!encrypted) throw std::logic_error("bit is a constant");
+    return ctxt;
+  }
+
+  const seal::Ciphertext &ciphertext() const {
+    if (!encrypted) throw std::logic_error("bit is a constant");
+    return ctxt;
+  }
+
+ private:
+  bool encrypted = false;
+  bool constant_value = false;
+  seal::Ciphertext ctxt;
+};
+
+/// Bits of an integer, least significant bit first.
+typedef std::vector<Bit> BitVector;
+
+/// Non-owning view of (a range of) the bits of an integer.
+typedef VectorView<Bit> BitView;
+
+class BitEvaluator {
+ public:
+  /// one: the plaintext 1. With relinearize_eagerly, the result of each AND
+  /// is relinearized right away, otherwise lazily (see LazyEvaluator).
+  BitEvaluator(seal::Evaluator &evaluator, LazyEvaluator &lazy_evaluator,
+               seal::Plaintext one, bool relinearize_eagerly = false)
+      : evaluator(evaluator),
+        lazy_evaluator(lazy_evaluator),
+        one(std::move(one)),
+        relinearize_eagerly(relinearize_eagerly) {}
+
+  Bit XOR(const Bit &lhs, const Bit &rhs) {
+    if (lhs.is_constant() && rhs.is_constant()) {
+      num_folded++;
+      return Bit::constant(lhs.value() != rhs.value());
+    }
+    if (lhs.is_constant()) return XOR(rhs, lhs);
+    if (rhs.is_constant()) {
+      if (!rhs.value()) {
+        num_folded++;
+        return lhs;
+      }
+      return NOT(lhs);
+    }
+    seal::Ciphertext result;
+    evaluator.add(lhs.ciphertext(), rhs.ciphertext(), result);
+    return result;
+  }
+
+  Bit NOT(const Bit &bit) {
+    if (bit.is_constant()) {
+      num_folded++;
+      return Bit::constant(!bit.value());
+    }
+    seal::Ciphertext result;
+    evaluator.add_plain(bit.ciphertext(), one, result);
+    return result;
+  }
+
+  /// The operands are non-const, as they may be relinearized in place.
+  Bit AND(Bit &lhs, Bit &rhs) {
+    if (lhs.is_constant() || rhs.is_constant()) {
+      num_folded++;
+      if (lhs.is_constant() && rhs.is_constant()) {
+        return Bit::constant(lhs.value() && rhs.value());
+      }
+      Bit &constant = lhs.is_constant() ? lhs : rhs;
+      Bit &other = lhs.is_constant() ? rhs : lhs;
+      return constant.value() ? other : Bit();
+    }
+    seal::Ciphertext result;
+    lazy_evaluator.multiply(lhs.ciphertext(), rhs.ciphertext(), result);
+    if (relinearize_eagerly) lazy_evaluator.relinearize_inplace(result);
+    return result;
+  }
+
+  void relinearize(Bit &bit) {
+    if (!bit.is_constant()) {
+      lazy_evaluator.relinearize_inplace(bit.ciphertext());
+    }
+  }
+
+  /// Number of gates that were folded, i.e., evaluated without any
+  /// homomorphic operation as an input was a constant.
+  std::size_t folded_gates() const { return num_folded; }
+
+ private:
+  seal::Evaluator &evaluator;
+  LazyEvaluator &lazy_evaluator;
+  seal::Plaintext one;
+  bool relinearize_eagerly;
+  std::atomic<std::size_t> num_folded{0};
+};
+
+#endif
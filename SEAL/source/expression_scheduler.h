@@ -0,0 +1,297 @@
+#ifndef EXPRESSION_SCHEDULER_H_
+#define EXPRESSION_SCHEDULER_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "task_graph.h"
+
+/*
+ * Expression-level scheduling of small arithmetic circuits, e.g., the
+ * alpha/beta outputs of the chi-squared benchmark.
+ *
+ * A circuit is written down as expressions of its input ciphertexts, output
+ * by output, and the scheduler
+ *  - deduplicates common subterms (hash-consing): an expression that was
+ *    built before, with operands in either order for additions and
+ *    multiplications, is returned instead of a new node, so that a subterm
+ *    shared by several outputs is computed once,
+ *  - turns multiplications by small constants into additions (double and
+ *    add, e.g., 4x = (x + x) + (x + x)) instead of plaintext multiplications,
+ *    which in turn exposes further common subterms (2x in 4x),
+ *  - evaluates the nodes on a TaskGraph, so that independent nodes and
+ *    outputs run concurrently.
+ *
+ * Ciphertext products are relinearized right away, so all nodes are of size
+ * 2. The counts of the scheduled circuit, i.e., the nodes that outputs depend
+ * on, are available before evaluation.
+ */
+
+/// Operation counts and depths of a scheduled circuit.
+struct ExpressionCounts {
+  /// additions and subtractions of ciphertexts
+  std::size_t additions = 0;
+
+  /// ciphertext-ciphertext multiplications, incl. squarings
+  std::size_t multiplications = 0;
+
+  /// multiplications by a constant plaintext
+  std::size_t plain_multiplications = 0;
+
+  /// one after each ciphertext-ciphertext multiplication
+  std::size_t relinearizations = 0;
+
+  /// largest number of ciphertext-ciphertext multiplications on a path from
+  /// an input to an output
+  std::size_t multiplicative_depth = 0;
+
+  /// largest number of operations on a path from an input to an output,
+  /// i.e., the latency of the circuit with unlimited threads in operations
+  std::size_t critical_path = 0;
+};
+
+class ExpressionScheduler {
+ public:
+  typedef std::size_t NodeId;
+
+  struct Options {
+    bool deduplicate = true;
+
+    bool constants_as_additions = true;
+
+    /// constants that need more additions are multiplied as plaintexts
+    std::size_t max_additions_per_constant = 4;
+  };
+
+  ExpressionScheduler() : ExpressionScheduler(Options()) {}
+
+  explicit ExpressionScheduler(Options options) : options(options) {}
+
+  /// The index-th input ciphertext of evaluate().
+  NodeId input(std::size_t index) {
+    return make({Op::Input, 0, 0, index});
+  }
+
+  NodeId add(NodeId lhs, NodeId rhs) {
+    return make({Op::Add, std::min(lhs, rhs), std::max(lhs, rhs), 0});
+  }
+
+  NodeId sub(NodeId lhs, NodeId rhs) { return make({Op::Sub, lhs, rhs, 0}); }
+
+  NodeId multiply(NodeId lhs, NodeId rhs) {
+    if (lhs == rhs) return square(lhs);
+    return make({Op::Multiply, std::min(lhs, rhs), std::max(lhs, rhs), 0});
+  }
+
+  NodeId square(NodeId operand) {
+    return make({Op::Square, operand, operand, 0});
+  }
+
+  /// operand * constant, as additions if the constant is small enough.
+  NodeId multiply_const(NodeId operand, std::uint64_t constant) {
+    if (constant == 0) {
+      throw std::invalid_argument("multiplication by zero");
+    }
+    if (constant == 1) return operand;
+    if (!options.constants_as_additions ||
+        additions_for(constant) > options.max_additions_per_constant) {
+      return make({Op::MultiplyPlain, operand, operand, constant});
+    }
+    // double and add, from the most significant bit
+    int bit = 63;
+    while (!((constant >> bit) & 1)) bit--;
+    NodeId result = operand;
+    for (bit--; bit >= 0; bit--) {
+      result = add(result, result);
+      if ((constant >> bit) & 1) result = add(result, operand);
+    }
+    return result;
+  }
+
+  /// Marks the node as the next output of evaluate().
+  void output(NodeId node) {
+    check(node);
+    outputs.push_back(node);
+  }
+
+  /// Number of additions the constant takes with double and add.
+  static std::size_t additions_for(std::uint64_t constant) {
+    std::size_t additions = 0;
+    for (; constant > 1; constant >>= 1) additions += 1 + (constant & 1);
+    return additions;
+  }
+
+  ExpressionCounts counts() const {
+    ExpressionCounts counts;
+    const std::vector<bool> needed = needed_nodes();
+    for (NodeId id = 0; id < nodes.size(); ++id) {
+      if (!needed[id]) continue;
+      switch (nodes[id].op) {
+        case Op::Input:
+          break;
+        case Op::Add:
+        case Op::Sub:
+          counts.additions++;
+          break;
+        case Op::Multiply:
+        case Op::Square:
+          counts.multiplications++;
+          counts.relinearizations++;
+          break;
+        case Op::MultiplyPlain:
+          counts.plain_multiplications++;
+          break;
+      }
+    }
+    for (NodeId id : outputs) {
+      counts.multiplicative_depth =
+          std::max(counts.multiplicative_depth, nodes[id].multiplicative_depth);
+      counts.critical_path =
+          std::max(counts.critical_path, nodes[id].critical_path);
+    }
+    return counts;
+  }
+
+  /// Evaluates the outputs on (at most) num_threads workers.
+  std::vector<seal::Ciphertext> evaluate(
+      seal::Evaluator &evaluator, const seal::RelinKeys &relin_keys,
+      const std::vector<seal::Ciphertext> &inputs,
+      std::size_t num_threads) const {
+    const std::vector<bool> needed = needed_nodes();
+    std::vector<seal::Ciphertext> values(nodes.size());
+    // inputs are read in place rather than copied into values
+    std::vector<const seal::Ciphertext *> operands(nodes.size());
+    std::vector<TaskGraph::TaskId> tasks(nodes.size());
+    TaskGraph graph;
+
+    for (NodeId id = 0; id < nodes.size(); ++id) {
+      if (!needed[id]) continue;
+      const Node &node = nodes[id];
+      if (node.op == Op::Input) {
+        if (node.constant >= inputs.size()) {
+          throw std::invalid_argument("missing input " +
+                                      std::to_string(node.constant));
+        }
+        operands[id] = &inputs[node.constant];
+        continue;
+      }
+      operands[id] = &values[id];
+      std::vector<TaskGraph::TaskId> dependencies;
+      for (NodeId operand : {node.lhs, node.rhs}) {
+        if (nodes[operand].op != Op::Input &&
+            (dependencies.empty() || tasks[operand] != dependencies[0])) {
+          dependencies.push_back(tasks[operand]);
+        }
+      }
+      tasks[id] = graph.add(
+          [&, id]() {
+            const Node &node = nodes[id];
+            const seal::Ciphertext &lhs = *operands[node.lhs];
+            const seal::Ciphertext &rhs = *operands[node.rhs];
+            seal::Ciphertext &result = values[id];
+            switch (node.op) {
+              case Op::Add:
+                evaluator.add(lhs, rhs, result);
+                break;
+              case Op::Sub:
+                evaluator.sub(lhs, rhs, result);
+                break;
+              case Op::Multiply:
+                evaluator.multiply(lhs, rhs, result);
+                evaluator.relinearize_inplace(result, relin_keys);
+                break;
+              case Op::Square:
+                evaluator.square(lhs, result);
+                evaluator.relinearize_inplace(result, relin_keys);
+                break;
+              case Op::MultiplyPlain: {
+                seal::Plaintext constant(1);
+                constant[0] = node.constant;
+                evaluator.multiply_plain(lhs, constant, result);
+                break;
+              }
+              case Op::Input:
+                break;
+            }
+          },
+          dependencies);
+    }
+    graph.run(num_threads);
+
+    std::vector<seal::Ciphertext> results;
+    for (NodeId id : outputs) results.push_back(*operands[id]);
+    return results;
+  }
+
+  /// Number of nodes built, incl. inputs and nodes no output depends on.
+  std::size_t size() const { return nodes.size(); }
+
+ private:
+  enum class Op { Input, Add, Sub, Multiply, Square, MultiplyPlain };
+
+  struct Node {
+    Op op;
+    NodeId lhs;
+    NodeId rhs;
+    /// the constant of MultiplyPlain, the index of Input
+    std::uint64_t constant;
+
+    std::size_t multiplicative_depth = 0;
+    std::size_t critical_path = 0;
+  };
+
+  NodeId make(Node node) {
+    if (node.op != Op::Input) {
+      check(node.lhs);
+      check(node.rhs);
+      const Node &lhs = nodes[node.lhs], &rhs = nodes[node.rhs];
+      const bool multiplication =
+          node.op == Op::Multiply || node.op == Op::Square;
+      node.multiplicative_depth =
+          std::max(lhs.multiplicative_depth, rhs.multiplicative_depth) +
+          (multiplication ? 1 : 0);
+      node.critical_path = std::max(lhs.critical_path, rhs.critical_path) + 1;
+    }
+    // inputs are always shared, one node per index
+    if (!options.deduplicate && node.op != Op::Input) {
+      nodes.push_back(node);
+      return nodes.size() - 1;
+    }
+    auto key = std::make_tuple(static_cast<int>(node.op), node.lhs, node.rhs,
+                               node.constant);
+    auto it = built.find(key);
+    if (it != built.end()) return it->second;
+    nodes.push_back(node);
+    built[key] = nodes.size() - 1;
+    return nodes.size() - 1;
+  }
+
+  void check(NodeId node) const {
+    if (node >= nodes.size()) throw std::invalid_argument("unknown node");
+  }
+
+  /// Nodes the outputs depend on (nodes are in topological order).
+  std::vector<bool> needed_nodes() const {
+    std::vector<bool> needed(nodes.size(), false);
+    for (NodeId id : outputs) needed[id] = true;
+    for (NodeId id = nodes.size(); id-- > 0;) {
+      if (!needed[id] || nodes[id].op == Op::Input) continue;
+      needed[nodes[id].lhs] = true;
+      needed[nodes[id].rhs] = true;
+    }
+    return needed;
+  }
+
+  Options options;
+  std::vector<Node> nodes;
+  std::vector<NodeId> outputs;
+  std::map<std::tuple<int, NodeId, NodeId, std::uint64_t>, NodeId> built;
+};
+
+#endif
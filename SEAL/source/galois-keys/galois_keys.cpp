@@ -0,0 +1,208 @@
+#include "galois_keys.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "../common.h"
+
+void GaloisKeyStudy::setup_context(const TargetParameters &target) {
+  // Instantiate context
+  context = seal::SEALContext::Create(target.encryption_parameters());
+  if (!context->parameters_set()) {
+    throw std::invalid_argument(context->parameter_error_message());
+  }
+
+  // Galois keys are created per key set in run_benchmark()
+  keyGenerator = std::make_unique<seal::KeyGenerator>(context);
+  secretKey = std::make_unique<seal::SecretKey>(keyGenerator->secret_key());
+  encryptor = std::make_unique<seal::Encryptor>(context, *secretKey);
+  evaluator = std::make_unique<seal::Evaluator>(context);
+}
+
+seal::Ciphertext GaloisKeyStudy::encrypt_ones(seal::scheme_type scheme) {
+  seal::Plaintext ptxt;
+  if (scheme == seal::scheme_type::BFV) {
+    seal::BatchEncoder encoder(context);
+    std::vector<std::uint64_t> ones(encoder.slot_count(), 1);
+    encoder.encode(ones, ptxt);
+  } else {
+    seal::CKKSEncoder encoder(context);
+    std::vector<double> ones(encoder.slot_count(), 1.0);
+    encoder.encode(ones, std::pow(2.0, 40), ptxt);
+  }
+  seal::Ciphertext ctxt;
+  encryptor->encrypt_symmetric(ptxt, ctxt);
+  return ctxt;
+}
+
+namespace {
+struct KeySet {
+  std::string name;
+  /// steps to generate keys for, ignored if use_default is set
+  std::vector<int> steps;
+  bool use_default;
+};
+
+// Returns +/- 2^i up to the smallest power of two that is not smaller than
+// any of the given steps, so that the NAF of each step is covered.
+std::vector<int> power_of_two_steps(const std::vector<int> &steps) {
+  int max_step = 0;
+  for (auto s : steps) max_step = std::max(max_step, std::abs(s));
+  std::vector<int> pow2_steps;
+  for (int i = 1; i < 2 * max_step; i <<= 1) {
+    pow2_steps.push_back(i);
+    pow2_steps.push_back(-i);
+  }
+  return pow2_steps;
+}
+
+// Number of nonzero digits of the non-adjacent form (NAF) of the step, i.e.,
+// the number of key switches if there is no key for the step itself.
+int naf_weight(int step) {
+  int value = std::abs(step);
+  int weight = 0;
+  while (value != 0) {
+    if (value & 1) {
+      // digit is 1 if value = 1 (mod 4), and -1 if value = 3 (mod 4)
+      value -= 2 - (value & 3);
+      weight++;
+    }
+    value >>= 1;
+  }
+  return weight;
+}
+
+int key_switches(int step, const KeySet &key_set) {
+  auto &steps = key_set.steps;
+  bool has_key = !key_set.use_default &&
+                 std::find(steps.begin(), steps.end(), step) != steps.end();
+  return has_key ? 1 : naf_weight(step);
+}
+
+// Size of the key data as held in memory, i.e., without any container
+// overhead.
+std::size_t resident_bytes(const seal::GaloisKeys &keys) {
+  std::size_t bytes = 0;
+  for (auto &key_vector : keys.data()) {
+    for (auto &key : key_vector) {
+      auto &ctxt = key.data();
+      bytes += ctxt.size() * ctxt.coeff_modulus_size() *
+               ctxt.poly_modulus_degree() * sizeof(std::uint64_t);
+    }
+  }
+  return bytes;
+}
+
+std::size_t serialized_bytes(const seal::GaloisKeys &keys,
+                             seal::compr_mode_type compr_mode) {
+  std::vector<std::byte> buffer(
+      static_cast<std::size_t>(keys.save_size(compr_mode)));
+  return static_cast<std::size_t>(
+      keys.save(buffer.data(), buffer.size(), compr_mode));
+}
+
+// Turns the timing header into "<prefix>repetitions,<prefix>mean_ns,...".
+std::string prefixed_timing_stats_header(const std::string &prefix) {
+  std::string header;
+  for (auto &column : split(timing_stats_header(), ',')) {
+    if (!header.empty()) header += ",";
+    header += prefix + column;
+  }
+  return header;
+}
+}  // namespace
+
+void GaloisKeyStudy::run_benchmark() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+  std::ofstream file = open_csv_file(
+      "OUTPUT_FILENAME", "galois_keys.csv",
+      "target," + parameters_csv_header() +
+          ",key_set,num_keys,resident_bytes,serialized_bytes,"
+          "compressed_bytes,rotation_mean_ns,extra_rotation_ns," +
+          prefixed_timing_stats_header("keygen_"));
+  std::ofstream stats_file = open_stats_file(
+      "galois_keys_stats.csv", "target," + parameters_csv_header() +
+                                   ",key_set,step,key_switches," +
+                                   timing_stats_header());
+
+  for (auto &target : target_parameter_sets()) {
+    std::cout << "Target: " << target.name << std::endl;
+    setup_context(target);
+    seal::Ciphertext ctxt = encrypt_ones(target.scheme);
+
+    // Step 0 swaps the rows in BFV (used for column rotations) but is a
+    // no-op in rotate_rows/rotate_vector
+    std::vector<int> rotation_steps;
+    for (auto s : target.rotation_steps) {
+      if (s != 0) rotation_steps.push_back(s);
+    }
+
+    // handpicked must come first, it is the baseline of the extra latency
+    std::vector<KeySet> key_sets = {
+        {"handpicked", target.rotation_steps, false},
+        {"default", {}, true},
+        {"pow2", power_of_two_steps(target.rotation_steps), false}};
+
+    double handpicked_rotation_ns = 0;
+    for (auto &key_set : key_sets) {
+      seal::GaloisKeys galoisKeys;
+      TimingStats keygen_stats = measure(
+          timing_config, [&]() { galoisKeys = seal::GaloisKeys(); },
+          [&]() {
+            galoisKeys = key_set.use_default
+                             ? keyGenerator->galois_keys_local()
+                             : keyGenerator->galois_keys_local(key_set.steps);
+          });
+
+      double rotation_sum_ns = 0;
+      for (auto step : rotation_steps) {
+        seal::Ciphertext result;
+        TimingStats stats = measure(timing_config, [&]() {
+          if (target.scheme == seal::scheme_type::BFV) {
+            evaluator->rotate_rows(ctxt, step, galoisKeys, result);
+          } else {
+            evaluator->rotate_vector(ctxt, step, galoisKeys, result);
+          }
+        });
+        rotation_sum_ns += stats.mean_ns;
+
+        stats_file << target.name << ",";
+        write_parameters_csv(stats_file, context);
+        stats_file << "," << key_set.name << "," << step << ","
+                   << key_switches(step, key_set) << ",";
+        write_timing_stats(stats_file, stats);
+        stats_file << std::endl;
+      }
+      double rotation_mean_ns =
+          rotation_steps.empty() ? 0 : rotation_sum_ns / rotation_steps.size();
+      if (key_set.name == "handpicked") {
+        handpicked_rotation_ns = rotation_mean_ns;
+      }
+
+      std::size_t resident = resident_bytes(galoisKeys);
+      std::cout << "  " << key_set.name << ": " << galoisKeys.size()
+                << " keys, " << resident / (1024 * 1024) << " MB, "
+                << keygen_stats.mean_ns / 1e6 << " ms keygen, "
+                << rotation_mean_ns / 1e3 << " us per rotation" << std::endl;
+
+      file << target.name << ",";
+      write_parameters_csv(file, context);
+      file << "," << key_set.name << "," << galoisKeys.size() << ","
+           << resident << ","
+           << serialized_bytes(galoisKeys, seal::compr_mode_type::none) << ","
+           << serialized_bytes(galoisKeys,
+                               seal::Serialization::compr_mode_default)
+           << "," << static_cast<long long>(rotation_mean_ns) << ","
+           << static_cast<long long>(rotation_mean_ns - handpicked_rotation_ns)
+           << ",";
+      write_timing_stats(file, keygen_stats);
+      file << std::endl;
+    }
+  }
+}
+
+int main() {
+  std::cout << "Starting 'galois_keys'..." << std::endl;
+  GaloisKeyStudy().run_benchmark();
+  return 0;
+}
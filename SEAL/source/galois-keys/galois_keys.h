@@ -0,0 +1,52 @@
+#ifndef GALOIS_KEYS_H_
+#define GALOIS_KEYS_H_
+#endif
+
+#include <seal/seal.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../targets.h"
+#include "../timing.h"
+
+/*
+ * Trade-off between the cost of Galois keys and the cost of rotations.
+ *
+ * For each target, Galois keys are generated for three sets of steps:
+ *  - handpicked: the steps the target rotates by (one key switch each),
+ *  - default:    SEAL's default keys, i.e., all powers of two,
+ *  - pow2:       the powers of two up to the largest handpicked step.
+ * Rotations by steps without a key are composed from the keys of the
+ * non-adjacent form (NAF) of the step, i.e., need several key switches.
+ */
+class GaloisKeyStudy {
+ private:
+  /// the seal context, i.e. object that holds params/etc
+  std::shared_ptr<seal::SEALContext> context;
+
+  std::unique_ptr<seal::KeyGenerator> keyGenerator;
+
+  // secret key, also used for (more efficient) encryption
+  std::unique_ptr<seal::SecretKey> secretKey;
+
+  std::unique_ptr<seal::Encryptor> encryptor;
+  std::unique_ptr<seal::Evaluator> evaluator;
+
+  /// Creates the context, keys, and helper objects for the target.
+  void setup_context(const TargetParameters &target);
+
+  /// Encrypts a vector of ones, i.e., a fully populated ciphertext.
+  seal::Ciphertext encrypt_ones(seal::scheme_type scheme);
+
+ public:
+  /// Writes one summary row per target and key set to OUTPUT_FILENAME, and
+  /// the latency of each of the target's rotations to STATS_FILENAME.
+  void run_benchmark();
+};
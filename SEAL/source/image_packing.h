@@ -0,0 +1,118 @@
+#ifndef IMAGE_PACKING_H_
+#define IMAGE_PACKING_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Several small images in one batched ciphertext, e.g., 101 images of 8x8
+ * pixels in a batching row of 8192 slots, so that each rotation of a
+ * whole-image convolution (see convolution.h) serves all of them.
+ *
+ * The images are placed side by side, each followed by guard columns of
+ * zeros as wide as the kernel radius, which makes the packed images one wide
+ * image. A rotation that moves a pixel's neighbor left or right of its image
+ * into its slot then moves in a guard zero instead of a pixel of the next
+ * image. Neighbors above and below the images wrap around to the unused
+ * slots at the end of the batching row, which hold zeros as well. Hence,
+ * every pixel of every image gets its convolution with zeros outside of the
+ * image (see convolve_plain_zero_padded()), border pixels included.
+ */
+
+class ImagePacking {
+ public:
+  /// Packing of as many images of width x height pixels as fit into a
+  /// batching row of a ciphertext with slot_count slots, with guard columns
+  /// for kernels of up to the given radius.
+  ImagePacking(std::size_t image_width, std::size_t image_height, int radius,
+               std::size_t slot_count)
+      : image_width(image_width),
+        image_height(image_height),
+        guard(static_cast<std::size_t>(radius)),
+        slot_count(slot_count) {
+    // the rows above the images wrap around to the last slots of the row,
+    // which must stay zero: (height + r) * width + r <= slot_count / 2
+    const std::size_t row = slot_count / 2;
+    const std::size_t cell_width = image_width + guard;
+    const std::size_t rows = image_height + guard;
+    images_per_ciphertext =
+        row > guard ? (row - guard) / rows / cell_width : 0;
+    if (images_per_ciphertext == 0) {
+      throw std::invalid_argument(
+          "a " + std::to_string(image_width) + "x" +
+          std::to_string(image_height) + " image with guards of " +
+          std::to_string(guard) + " does not fit into " + std::to_string(row) +
+          " slots");
+    }
+  }
+
+  std::size_t capacity() const { return images_per_ciphertext; }
+
+  /// Number of ciphertexts num_images images need.
+  std::size_t ciphertexts(std::size_t num_images) const {
+    return (num_images + capacity() - 1) / capacity();
+  }
+
+  /// Width of the packed images incl. guards, i.e., the stride of the rows.
+  std::size_t layout_width() const {
+    return capacity() * (image_width + guard);
+  }
+
+  /// Height of the packed images incl. the guard rows below them.
+  std::size_t layout_height() const { return image_height + guard; }
+
+  /// Slots of the images (at most capacity() many, row-major) packed side by
+  /// side with zeros in the guards.
+  std::vector<std::int64_t> pack(
+      const std::vector<std::vector<std::int64_t>> &images) const {
+    if (images.size() > capacity()) {
+      throw std::invalid_argument("cannot pack " +
+                                  std::to_string(images.size()) +
+                                  " images into " +
+                                  std::to_string(capacity()) + " cells");
+    }
+    std::vector<std::int64_t> slots(slot_count, 0);
+    for (std::size_t i = 0; i < images.size(); ++i) {
+      if (images[i].size() != image_width * image_height) {
+        throw std::invalid_argument("image " + std::to_string(i) +
+                                    " has the wrong size");
+      }
+      for (std::size_t y = 0; y < image_height; ++y) {
+        std::copy_n(images[i].begin() + y * image_width, image_width,
+                    slots.begin() + offset(i, y));
+      }
+    }
+    return slots;
+  }
+
+  /// The first num_images images of the slots, the inverse of pack().
+  std::vector<std::vector<std::int64_t>> unpack(
+      const std::vector<std::int64_t> &slots, std::size_t num_images) const {
+    std::vector<std::vector<std::int64_t>> images(
+        num_images, std::vector<std::int64_t>(image_width * image_height));
+    for (std::size_t i = 0; i < num_images; ++i) {
+      for (std::size_t y = 0; y < image_height; ++y) {
+        std::copy_n(slots.begin() + offset(i, y), image_width,
+                    images[i].begin() + y * image_width);
+      }
+    }
+    return images;
+  }
+
+ private:
+  /// Slot of the first pixel in row y of the i-th image.
+  std::size_t offset(std::size_t i, std::size_t y) const {
+    return y * layout_width() + i * (image_width + guard);
+  }
+
+  std::size_t image_width;
+  std::size_t image_height;
+  std::size_t guard;
+  std::size_t slot_count;
+  std::size_t images_per_ciphertext;
+};
+
+#endif
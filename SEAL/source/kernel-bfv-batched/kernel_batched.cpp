@@ -1,5 +1,12 @@
 #include "kernel_batched.h"
 
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "../targets.h"
+#include "../timing.h"
+
 namespace {
 void log_time(std::stringstream &ss,
               std::chrono::time_point<std::chrono::high_resolution_clock> start,
@@ -8,6 +15,15 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<ms>(end - start).count();
   if (!last) ss << ",";
 }
+
+Duration milliseconds(Timepoint start, Timepoint end) {
+  return std::chrono::duration_cast<ms>(end - start).count();
+}
+
+/// The ring dimension of kernel_batched in targets.h, i.e., the number of slots
+std::size_t default_num_slots() {
+  return target_parameters("kernel_batched").parameters.poly_modulus_degree;
+}
 }  // namespace
 
 Evaluation::Evaluation(int image_size) : image_size(image_size){};
@@ -79,26 +95,29 @@ std::vector<int64_t> Evaluation::generate_border_mask(bool invert) {
   return data;
 }
 
-std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
-  std::stringstream ss_time;
-  Timepoint t_start_keygen = Time::now();
-
+bool Evaluation::setup_context_bfv(std::size_t poly_modulus_degree,
+                                   const std::vector<int> &galois_steps) {
+  const ParameterSet parameters =
+      target_parameters("kernel_batched").parameters_at(poly_modulus_degree);
   seal::EncryptionParameters parms(seal::scheme_type::BFV);
-  parms.set_poly_modulus_degree(DEFAULT_NUM_SLOTS);  // = no. of ctxt slots
-  // Let SEAL select a "suitable" coefficient modulus (not necessarily maximal)
-  parms.set_coeff_modulus(
-      seal::CoeffModulus::BFVDefault(parms.poly_modulus_degree()));
+  parms.set_poly_modulus_degree(poly_modulus_degree);  // = no. of ctxt slots
+  // An empty chain lets SEAL select a "suitable" coefficient modulus (not
+  // necessarily maximal)
+  parms.set_coeff_modulus(parameters.coeff_modulus());
   // Let SEAL select a plaintext modulus that actually supports batching
-  parms.set_plain_modulus(
-      seal::PlainModulus::Batching(parms.poly_modulus_degree(), 20));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(
+      poly_modulus_degree, parameters.plain_modulus_bits));
   context = seal::SEALContext::Create(parms);
 
-  /// Create keys
-  seal::KeyGenerator keygen(context);
-  secret_key = std::make_unique<seal::SecretKey>(keygen.secret_key());
-  public_key = std::make_unique<seal::PublicKey>(keygen.public_key());
-  galois_keys = std::make_unique<seal::GaloisKeys>(keygen.galois_keys_local());
-  relin_keys = std::make_unique<seal::RelinKeys>(keygen.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeyRequest key_request;
+  key_request.galois_keys = true;
+  key_request.galois_steps = galois_steps;
+  KeySet keys = KeyStore::from_env().get(context, key_request);
+  secret_key = std::move(keys.secret_key);
+  public_key = std::move(keys.public_key);
+  galois_keys = std::move(keys.galois_keys);
+  relin_keys = std::move(keys.relin_keys);
 
   // Create helper objects
   encoder = std::make_unique<seal::BatchEncoder>(context);
@@ -106,9 +125,22 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
       std::make_unique<seal::Encryptor>(context, *public_key, *secret_key);
   decryptor = std::make_unique<seal::Decryptor>(context, *secret_key);
   evaluator = std::make_unique<seal::Evaluator>(context);
+  plaintext_cache = std::make_unique<PlaintextCache>(context);
+  return keys.loaded;
+}
+
+std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
+  std::stringstream ss_time;
+  Timepoint t_start_keygen = Time::now();
+
+  // Only generate those keys that are actually required/used
+  const bool keys_loaded = setup_context_bfv(
+      default_num_slots(), kernel_batched_rotation_steps(image_size));
 
   Timepoint t_end_keygen = Time::now();
-  log_time(ss_time, t_start_keygen, t_end_keygen, false);
+  ss_time << KeyStore::keygen_column(keys_loaded,
+                                     t_end_keygen - t_start_keygen)
+          << ",";
 
   // Encrypt input image
   Timepoint t_start_input_encryption = Time::now();
@@ -138,13 +170,15 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
                                 -(2 * image_size),
                                 -(2 * image_size + 1),
                                 -(2 * image_size + 2)};
-  seal::Plaintext w_ptxt;
+  // A weight in all slots is a constant polynomial, so that multiply_plain
+  // takes SEAL's fast path for monomials and the normal form is kept. The
+  // cache encodes each distinct weight once.
   std::vector<seal::Ciphertext> img_ctxts(weight_matrix.size(),
                                           seal::Ciphertext(context));
   for (size_t i = 0; i < weight_matrix.size(); ++i) {
     evaluator->rotate_rows(img_ctxt, rotations[i], *galois_keys, img_ctxts[i]);
-    encoder->encode(
-        std::vector<int64_t>(encoder->slot_count(), weight_matrix[i]), w_ptxt);
+    const seal::Plaintext &w_ptxt = plaintext_cache->batch(
+        std::vector<int64_t>(encoder->slot_count(), weight_matrix[i]));
     evaluator->multiply_plain_inplace(img_ctxts[i], w_ptxt);
   }
 
@@ -158,9 +192,8 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
 
   // result = 2*img_ctxt - value
   // (1) 2*img_ctxt
-  seal::Plaintext two;
   std::vector<int64_t> full_two(encoder->slot_count(), 2);
-  encoder->encode(full_two, two);
+  const seal::Plaintext &two = plaintext_cache->batch(full_two);
   seal::Ciphertext two_times_img_ctxt;
   evaluator->multiply_plain(img_ctxt, two, two_times_img_ctxt);
   // (2) [2*img_ctxt] - value
@@ -168,13 +201,12 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
 
   // Remove anything except the border from the input image
   std::vector<int64_t> data_border = generate_border_mask(false);
-  seal::Plaintext mask_border_only;
-  encoder->encode(data_border, mask_border_only);
+  const seal::Plaintext &mask_border_only =
+      plaintext_cache->batch(data_border);
   evaluator->multiply_plain_inplace(img_ctxt, mask_border_only);
   // Remove the border from the computed result
   std::vector<int64_t> data_inner = generate_border_mask(true);
-  seal::Plaintext mask_inner_only;
-  encoder->encode(data_inner, mask_inner_only);
+  const seal::Plaintext &mask_inner_only = plaintext_cache->batch(data_inner);
   evaluator->multiply_plain_inplace(two_times_img_ctxt, mask_inner_only);
   // Merge the input image (border-only) with the computed kernel (border = 0)
   evaluator->add_inplace(img_ctxt, two_times_img_ctxt);
@@ -194,6 +226,18 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("kernel-bfv-batched");
+  add_encryption_parameters(record, context);
+  record.set_parameter("image_size", image_size);
+  record.add_timing(KeyStore::timing_name(keys_loaded),
+                    t_end_keygen - t_start_keygen);
+  record.add_timing("t_input_encryption",
+                    t_end_input_encryption - t_start_input_encryption);
+  record.add_timing("t_computation", t_end_computation - t_start_computation);
+  record.add_timing("t_decryption", t_end_decryption - t_start_decryption);
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_kernel.txt");
 
@@ -201,9 +245,314 @@ std::vector<int64_t> Evaluation::run_kernel(VecInt2D img) {
   return final_result;
 }
 
+ConvolutionKernel Evaluation::sharpening_kernel() const {
+  ConvolutionKernel kernel(3, std::vector<int>(3));
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      kernel[i][j] = (i == 1 && j == 1 ? 2 : 0) - weight_matrix[i * 3 + j];
+    }
+  }
+  return kernel;
+}
+
+void Evaluation::run_tiled(const ConvolutionKernel &kernel,
+                           std::size_t num_threads) {
+  // random 8-bit pixels, reproducible across runs
+  const std::size_t num_pixels = image_size * image_size;
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int64_t> pixel(0, 255);
+  std::vector<int64_t> image(num_pixels);
+  for (auto &p : image) p = pixel(gen);
+
+  // each tile (incl. its halo) fills at most a batching row
+  TileGrid grid(image_size, image_size, default_num_slots() / 2,
+                kernel_radius(kernel));
+
+  Timepoint t_start_keygen = Time::now();
+  const bool keys_loaded = setup_context_bfv(
+      default_num_slots(),
+      ConvolutionEngine::galois_steps({kernel}, grid.layout_width()));
+  Timepoint t_end_keygen = Time::now();
+
+  Timepoint t_start_input_encryption = Time::now();
+  std::vector<seal::Ciphertext> tiles(grid.tiles().size());
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    seal::Plaintext tile_ptxt;
+    encoder->encode(grid.extract(image, grid.tiles()[i]), tile_ptxt);
+    encryptor->encrypt_symmetric(tile_ptxt, tiles[i]);
+  }
+  Timepoint t_end_input_encryption = Time::now();
+
+  Timepoint t_start_computation = Time::now();
+  TiledConvolution result =
+      convolve_tiles(context, *evaluator, *galois_keys, encoder->slot_count(),
+                     grid, tiles, kernel, num_threads);
+  Timepoint t_end_computation = Time::now();
+
+  Timepoint t_start_decryption = Time::now();
+  std::vector<int64_t> final_result(num_pixels);
+  for (std::size_t i = 0; i < tiles.size(); ++i) {
+    grid.stitch(decrypt_and_decode(result.tiles[i]), grid.tiles()[i],
+                final_result);
+  }
+  Timepoint t_end_decryption = Time::now();
+
+  if (final_result != convolve_plain(image, image_size, image_size, kernel)) {
+    throw std::runtime_error("Wrong result of the tiled kernel for a " +
+                             std::to_string(image_size) + "x" +
+                             std::to_string(image_size) + " image");
+  }
+
+  // throughput of the server (computation) and of the whole pipeline
+  const double megapixels = num_pixels / 1e6;
+  const double mp_per_s_computation =
+      megapixels /
+      std::chrono::duration<double>(t_end_computation - t_start_computation)
+          .count();
+  const double mp_per_s_end_to_end =
+      megapixels /
+      std::chrono::duration<double>(t_end_decryption - t_start_input_encryption)
+          .count();
+
+  std::ofstream file = open_csv_file(
+      "TILED_FILENAME", "kernel_batched_tiled.csv",
+      parameters_csv_header() +
+          ",image_size,kernel_size,tiles,tile_width,tile_height,threads,"
+          "rotations,plain_multiplications,t_keygen,t_input_encryption,"
+          "t_computation,t_decryption,mp_per_s_computation,"
+          "mp_per_s_end_to_end");
+  write_parameters_csv(file, context);
+  file << "," << image_size << "," << kernel.size() << "," << tiles.size()
+       << "," << grid.layout_width() << "," << grid.layout_height() << ","
+       << num_threads << "," << result.rotations << ","
+       << result.plain_multiplications << ","
+       << KeyStore::keygen_column(keys_loaded, t_end_keygen - t_start_keygen)
+       << ","
+       << milliseconds(t_start_input_encryption, t_end_input_encryption)
+       << "," << milliseconds(t_start_computation, t_end_computation) << ","
+       << milliseconds(t_start_decryption, t_end_decryption) << ","
+       << mp_per_s_computation << "," << mp_per_s_end_to_end << std::endl;
+
+  ResultRecord record("kernel-bfv-batched-tiled");
+  add_encryption_parameters(record, context);
+  record.set_parameter("image_size", image_size);
+  record.set_parameter("kernel_size", kernel.size());
+  record.set_parameter("tile_width", grid.layout_width());
+  record.set_parameter("tile_height", grid.layout_height());
+  record.set_parameter("threads", num_threads);
+  record.add_timing(KeyStore::timing_name(keys_loaded),
+                    t_end_keygen - t_start_keygen);
+  record.add_timing("t_input_encryption",
+                    t_end_input_encryption - t_start_input_encryption);
+  record.add_timing("t_computation", t_end_computation - t_start_computation);
+  record.add_timing("t_decryption", t_end_decryption - t_start_decryption);
+  record.set_metric("tiles", tiles.size());
+  record.set_metric("rotations", result.rotations);
+  record.set_metric("plain_multiplications", result.plain_multiplications);
+  record.set_metric("mp_per_s_computation", mp_per_s_computation);
+  record.set_metric("mp_per_s_end_to_end", mp_per_s_end_to_end);
+  record.write();
+
+  std::cout << image_size << "x" << image_size << ": " << tiles.size()
+            << " tiles, " << mp_per_s_computation << " MP/s" << std::endl;
+}
+
+FilterBank Evaluation::filter_bank() const {
+  ConvolutionKernel laplacian(3, std::vector<int>(3));
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) laplacian[i][j] = weight_matrix[i * 3 + j];
+  }
+  return {{"laplacian", laplacian},
+          {"sobel_x", {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}}},
+          {"sobel_y", {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}}},
+          {"box_blur", {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}}}};
+}
+
+void Evaluation::run_multi(const FilterBank &filters,
+                           std::size_t num_images) {
+  if (num_images == 0) throw std::invalid_argument("no images to filter");
+
+  // random 8-bit images, reproducible across runs
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int64_t> pixel(0, 255);
+  std::vector<std::vector<int64_t>> images(
+      num_images, std::vector<int64_t>(image_size * image_size));
+  for (auto &image : images) {
+    for (auto &p : image) p = pixel(gen);
+  }
+
+  std::vector<ConvolutionKernel> kernels;
+  int radius = 0;
+  for (auto &filter : filters) {
+    kernels.push_back(filter.second);
+    radius = std::max(radius, kernel_radius(filter.second));
+  }
+  ImagePacking packing(image_size, image_size, radius, default_num_slots());
+  const std::size_t num_ciphertexts = packing.ciphertexts(num_images);
+
+  Timepoint t_start_keygen = Time::now();
+  const bool keys_loaded = setup_context_bfv(
+      default_num_slots(),
+      ConvolutionEngine::galois_steps(kernels, packing.layout_width()));
+  Timepoint t_end_keygen = Time::now();
+
+  // the images [first(c), first(c + 1)) go into the c-th ciphertext
+  auto first = [&](std::size_t c) {
+    return std::min(num_images, c * packing.capacity());
+  };
+
+  Timepoint t_start_input_encryption = Time::now();
+  std::vector<seal::Ciphertext> packed(num_ciphertexts);
+  for (std::size_t c = 0; c < num_ciphertexts; ++c) {
+    seal::Plaintext packed_ptxt;
+    encoder->encode(packing.pack(std::vector<std::vector<int64_t>>(
+                        images.begin() + first(c),
+                        images.begin() + first(c + 1))),
+                    packed_ptxt);
+    encryptor->encrypt_symmetric(packed_ptxt, packed[c]);
+  }
+  Timepoint t_end_input_encryption = Time::now();
+
+  // rotate each ciphertext once for the taps of all filters, then weight the
+  // rotated copies per filter
+  Timepoint t_start_computation = Time::now();
+  ConvolutionEngine engine(*evaluator, *galois_keys, *plaintext_cache,
+                           encoder->slot_count(), packing.layout_width(),
+                           packing.layout_height());
+  std::vector<std::vector<seal::Ciphertext>> responses(num_ciphertexts);
+  for (std::size_t c = 0; c < num_ciphertexts; ++c) {
+    const std::map<int, seal::Ciphertext> shifted =
+        engine.shift(packed[c], kernels);
+    for (auto &kernel : kernels) {
+      responses[c].push_back(engine.weighted_sum(shifted, kernel));
+    }
+  }
+  Timepoint t_end_computation = Time::now();
+
+  Timepoint t_start_decryption = Time::now();
+  // response[f][i] is the response of filter f for image i
+  std::vector<std::vector<std::vector<int64_t>>> response(filters.size());
+  for (std::size_t c = 0; c < num_ciphertexts; ++c) {
+    for (std::size_t f = 0; f < filters.size(); ++f) {
+      auto unpacked = packing.unpack(decrypt_and_decode(responses[c][f]),
+                                     first(c + 1) - first(c));
+      response[f].insert(response[f].end(), unpacked.begin(), unpacked.end());
+    }
+  }
+  Timepoint t_end_decryption = Time::now();
+
+  for (std::size_t f = 0; f < filters.size(); ++f) {
+    for (std::size_t i = 0; i < num_images; ++i) {
+      if (response[f][i] != convolve_plain_zero_padded(images[i], image_size,
+                                                       image_size,
+                                                       kernels[f])) {
+        throw std::runtime_error("Wrong " + filters[f].first +
+                                 " response for image " + std::to_string(i));
+      }
+    }
+  }
+
+  // rotations if each image and filter took its own ciphertext
+  std::size_t unshared_rotations = 0;
+  for (auto &kernel : kernels) {
+    unshared_rotations +=
+        num_images *
+        ConvolutionEngine::galois_steps({kernel}, image_size).size();
+  }
+  const double rotations_per_response =
+      static_cast<double>(engine.rotations()) /
+      (num_images * filters.size());
+
+  std::string filter_names;
+  for (auto &filter : filters) {
+    filter_names += (filter_names.empty() ? "" : ";") + filter.first;
+  }
+
+  std::ofstream file = open_csv_file(
+      "MULTI_FILENAME", "kernel_batched_multi.csv",
+      parameters_csv_header() +
+          ",image_size,images,images_per_ciphertext,ciphertexts,filters,"
+          "rotations,unshared_rotations,rotations_per_response,"
+          "plain_multiplications,t_keygen,t_input_encryption,t_computation,"
+          "t_decryption");
+  write_parameters_csv(file, context);
+  file << "," << image_size << "," << num_images << "," << packing.capacity()
+       << "," << num_ciphertexts << "," << filter_names << ","
+       << engine.rotations() << "," << unshared_rotations << ","
+       << rotations_per_response << "," << engine.plain_multiplications()
+       << ","
+       << KeyStore::keygen_column(keys_loaded, t_end_keygen - t_start_keygen)
+       << ","
+       << milliseconds(t_start_input_encryption, t_end_input_encryption)
+       << "," << milliseconds(t_start_computation, t_end_computation) << ","
+       << milliseconds(t_start_decryption, t_end_decryption) << std::endl;
+
+  ResultRecord record("kernel-bfv-batched-multi");
+  add_encryption_parameters(record, context);
+  record.set_parameter("image_size", image_size);
+  record.set_parameter("images", num_images);
+  record.set_parameter("filters", filter_names);
+  record.add_timing(KeyStore::timing_name(keys_loaded),
+                    t_end_keygen - t_start_keygen);
+  record.add_timing("t_input_encryption",
+                    t_end_input_encryption - t_start_input_encryption);
+  record.add_timing("t_computation", t_end_computation - t_start_computation);
+  record.add_timing("t_decryption", t_end_decryption - t_start_decryption);
+  record.set_metric("images_per_ciphertext", packing.capacity());
+  record.set_metric("ciphertexts", num_ciphertexts);
+  record.set_metric("rotations", engine.rotations());
+  record.set_metric("unshared_rotations", unshared_rotations);
+  record.set_metric("rotations_per_response", rotations_per_response);
+  record.set_metric("plain_multiplications", engine.plain_multiplications());
+  record.write();
+
+  std::cout << num_images << " images of " << image_size << "x" << image_size
+            << " in " << num_ciphertexts << " ciphertexts: "
+            << engine.rotations() << " rotations for " << filters.size()
+            << " filters (" << unshared_rotations << " unshared)"
+            << std::endl;
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'kernel-bfv-batched'..." << std::endl;
 
+  // several small images per ciphertext (NUM_IMAGES images of each size in
+  // MULTI_IMAGE_SIZES), filtered by all filters of filter_bank() at once
+  if (has_flag(argc, argv, "--multi")) {
+    std::vector<int> image_sizes = {8, 16, 32};
+    if (auto v = std::getenv("MULTI_IMAGE_SIZES")) {
+      image_sizes = parse_int_list(v, ',');
+    }
+    std::size_t num_images = 256;
+    if (auto v = std::getenv("NUM_IMAGES")) {
+      num_images = std::strtoul(v, nullptr, 10);
+    }
+    for (auto img_size : image_sizes) {
+      Evaluation eval(img_size);
+      eval.run_multi(eval.filter_bank(), num_images);
+    }
+    return 0;
+  }
+
+  // images larger than a ciphertext, split into tiles (TILED_IMAGE_SIZES)
+  // that are convolved on TILE_THREADS threads with the sharpening kernel of
+  // run_kernel() or any other (KERNEL, e.g., "1,2,1;2,4,2;1,2,1")
+  if (has_flag(argc, argv, "--tiled")) {
+    std::vector<int> image_sizes = {128, 256, 512, 1024};
+    if (auto v = std::getenv("TILED_IMAGE_SIZES")) {
+      image_sizes = parse_int_list(v, ',');
+    }
+    const std::size_t num_threads = num_threads_from_env("TILE_THREADS");
+    for (auto img_size : image_sizes) {
+      Evaluation eval(img_size);
+      auto v = std::getenv("KERNEL");
+      eval.run_tiled(
+          v ? parse_convolution_kernel(v) : eval.sharpening_kernel(),
+          num_threads);
+    }
+    return 0;
+  }
+
   // std::vector<int> image_sizes = { 8, 16, 32, 64, 96, 128 };
   std::vector<int> image_sizes = {8};
 
@@ -4,20 +4,26 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <utility>
 #include <vector>
 #include <seal/seal.h>
 
 #include "../common.h"
+#include "../image_packing.h"
+#include "../key_store.h"
+#include "../plaintext_cache.h"
+#include "../tiling.h"
 
 typedef std::vector<std::vector<int>> VecInt2D;
 
 typedef std::vector<std::vector<int>> VecInt2D;
+typedef std::vector<std::pair<std::string, ConvolutionKernel>> FilterBank;
 typedef std::chrono::high_resolution_clock Time;
 typedef decltype(std::chrono::high_resolution_clock::now()) Timepoint;
 typedef long long Duration;
 typedef std::chrono::milliseconds ms;
 
-#define DEFAULT_NUM_SLOTS 16'384
 #define PRINT_LIMIT 70
 
 class Evaluation {
@@ -39,17 +45,43 @@ class Evaluation {
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
 
+  /// encoded weights and masks, most of them are used more than once
+  std::unique_ptr<PlaintextCache> plaintext_cache;
+
   std::vector<int64_t> decrypt_and_decode(seal::Ciphertext &ctxt);
 
   std::vector<int64_t> decode(seal::Plaintext &ptxt);
 
   std::vector<int64_t> generate_border_mask(bool invert);
 
+  /// Creates the context, keys (with the given rotation steps, empty = SEAL's
+  /// default set), and helper objects, returns whether the keys were loaded
+  /// from the key store.
+  bool setup_context_bfv(std::size_t poly_modulus_degree,
+                         const std::vector<int> &galois_steps);
+
  public:
   Evaluation(int image_size);
 
   std::vector<int64_t> run_kernel(VecInt2D img);
 
+  /// Convolves a random image of any size tile by tile (see tiling.h) on
+  /// num_threads threads and reports megapixels per second in
+  /// TILED_FILENAME.
+  void run_tiled(const ConvolutionKernel &kernel, std::size_t num_threads);
+
+  /// The kernel run_kernel() computes: 2 * img - weight_matrix * img.
+  ConvolutionKernel sharpening_kernel() const;
+
+  /// Applies all filters to num_images random images, packed side by side
+  /// into as few ciphertexts as possible (see image_packing.h). The rotated
+  /// copies of a ciphertext are shared by all filters and images in it, the
+  /// resulting rotations per image and filter go to MULTI_FILENAME.
+  void run_multi(const FilterBank &filters, std::size_t num_images);
+
+  /// Laplacian (weight_matrix), Sobel X and Y, and (unnormalized) box blur.
+  FilterBank filter_bank() const;
+
   void check_results(VecInt2D img, std::vector<int64_t> computed_values);
 
   int main(int argc, char *argv[]);
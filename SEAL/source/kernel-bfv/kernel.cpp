@@ -1,5 +1,10 @@
 #include "kernel.h"
 
+#include <stdexcept>
+
+#include "../targets.h"
+#include "../timing.h"
+
 namespace {
 void log_time(std::stringstream &ss,
               std::chrono::time_point<std::chrono::high_resolution_clock> start,
@@ -8,6 +13,11 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<ms>(end - start).count();
   if (!last) ss << ",";
 }
+
+/// The ring dimension of kernel in targets.h, i.e., the number of slots
+std::size_t default_num_slots() {
+  return target_parameters("kernel").parameters.poly_modulus_degree;
+}
 }  // namespace
 
 Evaluation::Evaluation(int image_size) : image_size(image_size){};
@@ -71,35 +81,29 @@ void Evaluation::print_all(std::vector<int64_t> &vector) {
   std::cout << "===================================" << std::endl;
 }
 
-std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
-  std::stringstream ss_time;
-
-  Timepoint t_start_keygen = Time::now();
-
+bool Evaluation::setup_context_bfv(std::size_t poly_modulus_degree,
+                                   const std::vector<int> &galois_steps) {
+  const ParameterSet parameters =
+      target_parameters("kernel").parameters_at(poly_modulus_degree);
   seal::EncryptionParameters parms =
       seal::EncryptionParameters(seal::scheme_type::BFV);
-  parms.set_poly_modulus_degree(DEFAULT_NUM_SLOTS);  // number of slots
-  // Let SEAL select a "suitable" coefficient modulus
-  parms.set_coeff_modulus(
-      seal::CoeffModulus::BFVDefault(parms.poly_modulus_degree()));
+  parms.set_poly_modulus_degree(poly_modulus_degree);  // number of slots
+  // An empty chain lets SEAL select a "suitable" coefficient modulus
+  parms.set_coeff_modulus(parameters.coeff_modulus());
   // Let SEAL select a plaintext modulus that actually supports batching
-  parms.set_plain_modulus(
-      seal::PlainModulus::Batching(parms.poly_modulus_degree(), 20));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(
+      poly_modulus_degree, parameters.plain_modulus_bits));
   context = seal::SEALContext::Create(parms);
 
-  /// Create keys
-  seal::KeyGenerator keygen(context);
-  secret_key = std::make_unique<seal::SecretKey>(keygen.secret_key());
-  public_key = std::make_unique<seal::PublicKey>(keygen.public_key());
-  // Only generate those keys that are actually required/used
-  std::vector<int> steps;
-  for (int j = -1; j < 2; ++j) { 
-    for (int i = -1; i < 2; ++i) {
-      steps.push_back(j + i * image_size);
-    }
-  }
-  galois_keys = std::make_unique<seal::GaloisKeys>(keygen.galois_keys_local(steps));
-  relin_keys = std::make_unique<seal::RelinKeys>(keygen.relin_keys_local());
+  /// Create keys, or load them from the key store (KEY_STORE_DIR)
+  KeyRequest key_request;
+  key_request.galois_keys = true;
+  key_request.galois_steps = galois_steps;
+  KeySet keys = KeyStore::from_env().get(context, key_request);
+  secret_key = std::move(keys.secret_key);
+  public_key = std::move(keys.public_key);
+  galois_keys = std::move(keys.galois_keys);
+  relin_keys = std::move(keys.relin_keys);
 
   // Create helper objects
   encoder = std::make_unique<seal::BatchEncoder>(context);
@@ -107,9 +111,23 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
       std::make_unique<seal::Encryptor>(context, *public_key, *secret_key);
   decryptor = std::make_unique<seal::Decryptor>(context, *secret_key);
   evaluator = std::make_unique<seal::Evaluator>(context);
+  plaintext_cache = std::make_unique<PlaintextCache>(context);
+  return keys.loaded;
+}
+
+std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
+  std::stringstream ss_time;
+
+  Timepoint t_start_keygen = Time::now();
+
+  // Only generate those keys that are actually required/used
+  const bool keys_loaded = setup_context_bfv(default_num_slots(),
+                                             kernel_rotation_steps(image_size));
 
   Timepoint t_end_keygen = Time::now();
-  log_time(ss_time, t_start_keygen, t_end_keygen, false);
+  ss_time << KeyStore::keygen_column(keys_loaded,
+                                     t_end_keygen - t_start_keygen)
+          << ",";
 
   // Encrypt input image
   Timepoint t_start_input_encryption = Time::now();
@@ -130,6 +148,11 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
 
   Timepoint t_start_computation = Time::now();
 
+  // The image is multiplied by many one-hot weight plaintexts, hence it is
+  // transformed into NTT form once and the plaintexts are cached in NTT form.
+  // As most weights are 1, a plaintext is reused by the neighboring pixels.
+  seal::Ciphertext img_ntt = to_ntt(*evaluator, img_ctxt);
+
   // Mask away (in a single mult) everything except borders because later we
   // need to overwrite these masked-away values using additions
   std::vector<int64_t> data(image_size * image_size, 0);
@@ -140,31 +163,29 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
               || (y == image_size - 1)  // bottom border
               || (x == 0 || x == 7);    // lhs and rhs borders
   }
-  seal::Plaintext mask;
-  encoder->encode(data, mask);
+  const seal::Plaintext &mask =
+      plaintext_cache->batch_ntt(data, img_ntt.parms_id());
   seal::Ciphertext img2_ctxt;
-  evaluator->multiply_plain(img_ctxt, mask, img2_ctxt);
+  multiply_plain_ntt(*evaluator, img_ntt, mask, img2_ctxt);
 
   for (int x = 1; x < image_size - 1; ++x) {
     for (int y = 1; y < img.at(x).size() - 1; ++y) {
       seal::Ciphertext value;
-      seal::Plaintext value_ptxt;
       std::vector<int64_t> zero(image_size * image_size, 0);
-      encoder->encode(zero, value_ptxt);
-      encryptor->encrypt(value_ptxt, value);
+      encryptor->encrypt(plaintext_cache->batch(zero), value);
 
       for (int j = -1; j < 2; ++j) {
         for (int i = -1; i < 2; ++i) {
           // set weight at index where input is
-          seal::Plaintext w;
           std::vector<int64_t> data(image_size * image_size, 0);
           data.at((y + j) + (x + i) * image_size) =
               weight_matrix.at(i + 1).at(j + 1);
-          encoder->encode(data, w);
+          const seal::Plaintext &w =
+              plaintext_cache->batch_ntt(data, img_ntt.parms_id());
 
           // temp = img_ctxt * w
           seal::Ciphertext temp;
-          evaluator->multiply_plain(img_ctxt, w, temp);
+          multiply_plain_ntt(*evaluator, img_ntt, w, temp);
 
           // rotate ciphertext temp so that the value is at index (x,y)
           evaluator->rotate_rows_inplace(temp, (j + i * image_size),
@@ -176,12 +197,12 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
       }
 
       // temp = img_ctxt[x][y] * 2
-      seal::Plaintext two;
       std::vector<int64_t> two_data(image_size * image_size, 0);
       two_data.at(y + x * image_size) = 2;
-      encoder->encode(two_data, two);
+      const seal::Plaintext &two =
+          plaintext_cache->batch_ntt(two_data, img_ntt.parms_id());
       seal::Ciphertext temp;
-      evaluator->multiply_plain(img_ctxt, two, temp);
+      multiply_plain_ntt(*evaluator, img_ntt, two, temp);
 
       // temp = temp - value
       evaluator->sub_inplace(temp, value);
@@ -206,6 +227,18 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("kernel-bfv");
+  add_encryption_parameters(record, context);
+  record.set_parameter("image_size", image_size);
+  record.add_timing(KeyStore::timing_name(keys_loaded),
+                    t_end_keygen - t_start_keygen);
+  record.add_timing("t_input_encryption",
+                    t_end_input_encryption - t_start_input_encryption);
+  record.add_timing("t_computation", t_end_computation - t_start_computation);
+  record.add_timing("t_decryption", t_end_decryption - t_start_decryption);
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_kernel.txt");
 
@@ -213,9 +246,117 @@ std::vector<int64_t> Evaluation::apply_kernel(VecInt2D &img) {
   return final_result;
 }
 
+ConvolutionKernel Evaluation::sharpening_kernel() const {
+  ConvolutionKernel kernel(3, std::vector<int>(3));
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      kernel[i][j] = (i == 1 && j == 1 ? 2 : 0) - weight_matrix[i][j];
+    }
+  }
+  return kernel;
+}
+
+std::vector<int64_t> Evaluation::apply_kernel_vectorized(
+    VecInt2D &img, const ConvolutionKernel &kernel) {
+  // the image must fit into a batching row, i.e., half of the slots
+  const std::size_t num_pixels = image_size * image_size;
+  std::size_t poly_modulus_degree = default_num_slots();
+  while (poly_modulus_degree / 2 < num_pixels) poly_modulus_degree *= 2;
+
+  Timepoint t_start_keygen = Time::now();
+  const bool keys_loaded = setup_context_bfv(
+      poly_modulus_degree,
+      ConvolutionEngine::galois_steps({kernel}, image_size));
+  Timepoint t_end_keygen = Time::now();
+
+  Timepoint t_start_input_encryption = Time::now();
+  std::vector<int64_t> img_as_vec;
+  img_as_vec.reserve(num_pixels);
+  for (auto &row : img) {
+    for (auto elem : row) img_as_vec.push_back(elem);
+  }
+  seal::Plaintext img_ptxt;
+  encoder->encode(img_as_vec, img_ptxt);
+  seal::Ciphertext img_ctxt;
+  encryptor->encrypt_symmetric(img_ptxt, img_ctxt);
+  Timepoint t_end_input_encryption = Time::now();
+
+  Timepoint t_start_computation = Time::now();
+  ConvolutionEngine engine(*evaluator, *galois_keys, *plaintext_cache,
+                           encoder->slot_count(), image_size, image_size);
+  seal::Ciphertext result = engine.convolve_keep_border(img_ctxt, kernel);
+  Timepoint t_end_computation = Time::now();
+
+  Timepoint t_start_decryption = Time::now();
+  std::vector<int64_t> final_result = decrypt_and_decode(result);
+  final_result.resize(num_pixels);
+  Timepoint t_end_decryption = Time::now();
+
+  if (final_result != convolve_plain(img_as_vec, image_size, image_size,
+                                     kernel)) {
+    throw std::runtime_error("Wrong result of the vectorized kernel for a " +
+                             std::to_string(image_size) + "x" +
+                             std::to_string(image_size) + " image");
+  }
+
+  std::ofstream file = open_csv_file(
+      "SWEEP_FILENAME", "kernel_sweep.csv",
+      parameters_csv_header() +
+          ",image_size,kernel_size,rotations,plain_multiplications,t_keygen,"
+          "t_input_encryption,t_computation,t_decryption");
+  write_parameters_csv(file, context);
+  file << "," << image_size << "," << kernel.size() << ","
+       << engine.rotations() << "," << engine.plain_multiplications() << ","
+       << KeyStore::keygen_column(keys_loaded, t_end_keygen - t_start_keygen)
+       << ","
+       << compute_duration(t_start_input_encryption, t_end_input_encryption)
+       << "," << compute_duration(t_start_computation, t_end_computation)
+       << "," << compute_duration(t_start_decryption, t_end_decryption)
+       << std::endl;
+
+  ResultRecord record("kernel-bfv-vectorized");
+  add_encryption_parameters(record, context);
+  record.set_parameter("image_size", image_size);
+  record.set_parameter("kernel_size", kernel.size());
+  record.add_timing(KeyStore::timing_name(keys_loaded),
+                    t_end_keygen - t_start_keygen);
+  record.add_timing("t_input_encryption",
+                    t_end_input_encryption - t_start_input_encryption);
+  record.add_timing("t_computation", t_end_computation - t_start_computation);
+  record.add_timing("t_decryption", t_end_decryption - t_start_decryption);
+  record.set_metric("rotations", engine.rotations());
+  record.set_metric("plain_multiplications", engine.plain_multiplications());
+  record.write();
+
+  return final_result;
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting benchmark 'kernel-bfv'..." << std::endl;
 
+  // whole-image convolution for a sweep of image sizes (IMAGE_SIZES) with
+  // the sharpening kernel of apply_kernel() or any other (KERNEL, e.g.,
+  // "1,2,1;2,4,2;1,2,1")
+  if (has_flag(argc, argv, "--sweep")) {
+    std::vector<int> image_sizes = {8, 16, 32, 64, 96, 128};
+    if (auto v = std::getenv("IMAGE_SIZES")) {
+      image_sizes = parse_int_list(v, ',');
+    }
+    for (auto img_size : image_sizes) {
+      std::vector<int> vec(img_size);
+      std::iota(vec.begin(), vec.end(), 0);
+      std::vector<std::vector<int>> img(img_size, vec);
+
+      Evaluation eval(img.size());
+      auto v = std::getenv("KERNEL");
+      const ConvolutionKernel kernel =
+          v ? parse_convolution_kernel(v) : eval.sharpening_kernel();
+      eval.apply_kernel_vectorized(img, kernel);
+      std::cout << img_size << "x" << img_size << ": correct" << std::endl;
+    }
+    return 0;
+  }
+
   // std::vector<int> image_sizes = {8, 16, 32, 64, 96, 128};
   std::vector<int> image_sizes = {8};
 
@@ -8,6 +8,9 @@
 #include <seal/seal.h>
 
 #include "../common.h"
+#include "../convolution.h"
+#include "../key_store.h"
+#include "../plaintext_cache.h"
 
 typedef std::vector<std::vector<int>> VecInt2D;
 typedef std::chrono::high_resolution_clock Time;
@@ -15,7 +18,6 @@ typedef decltype(std::chrono::high_resolution_clock::now()) Timepoint;
 typedef long long Duration;
 typedef std::chrono::milliseconds ms;
 
-#define DEFAULT_NUM_SLOTS 16'384
 #define PRINT_LIMIT 70
 
 class Evaluation {
@@ -37,6 +39,9 @@ class Evaluation {
   std::unique_ptr<seal::Decryptor> decryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
 
+  /// encoded weights and masks, most of them are used more than once
+  std::unique_ptr<PlaintextCache> plaintext_cache;
+
   std::vector<int64_t> decrypt_and_decode(seal::Ciphertext &ctxt);
 
   std::vector<int64_t> decode(seal::Plaintext &ptxt);
@@ -45,6 +50,11 @@ class Evaluation {
 
   void print_all(std::vector<int64_t> &vector);
 
+  /// Creates the context, keys (with the given rotation steps), and helper
+  /// objects, returns whether the keys were loaded from the key store.
+  bool setup_context_bfv(std::size_t poly_modulus_degree,
+                         const std::vector<int> &galois_steps);
+
  public:
   int main(int argc, char *argv[]);
 
@@ -52,5 +62,13 @@ class Evaluation {
 
   std::vector<int64_t> apply_kernel(VecInt2D &img);
 
+  /// Convolves the whole image at once (see convolution.h), with the input
+  /// pixels kept on the border, and reports the run in SWEEP_FILENAME.
+  std::vector<int64_t> apply_kernel_vectorized(VecInt2D &img,
+                                               const ConvolutionKernel &kernel);
+
+  /// The kernel apply_kernel() computes: 2 * img - weight_matrix * img.
+  ConvolutionKernel sharpening_kernel() const;
+
   void check_results(VecInt2D img, std::vector<int64_t> computed_values);
 };
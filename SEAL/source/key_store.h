@@ -0,0 +1,282 @@
+#ifndef KEY_STORE_H_
+#define KEY_STORE_H_
+
+#include <fcntl.h>
+#include <seal/seal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "key_store_base.h"
+
+/*
+ * On-disk cache of the keys of a benchmark, so that repeated runs (NUM_RUNS)
+ * load the keys instead of generating them again.
+ *
+ * Keys are stored per fingerprint of the encryption parameters (SEAL's
+ * parms_id of the key level) and the requested keys, including the Galois
+ * rotation steps, in KEY_STORE_DIR. A file holds a small header followed by
+ * the keys as saved by SEAL without compression:
+ *
+ *   "SEALKEYS" | version (u32) | #sections (u32) | fingerprint (u64) |
+ *   offset, size (u64 each) per section | sections
+ *
+ * with the sections secret key, public key, relinearization keys, and Galois
+ * keys (size 0 if not requested). The file is memory-mapped and each key is
+ * loaded straight from the mapping with unsafe_load(), i.e., without a copy
+ * into a stream, decompression, or SEAL's validity checks, which is as close
+ * to loading without parsing as SEAL's key classes allow. The directory, the
+ * fingerprint hash, and the atomic writes are shared with the TFHE and EVA
+ * key stores (shared/key_store_base.h).
+ *
+ * The store holds secret keys in plain; it is meant for benchmarking only.
+ */
+
+/// The keys a benchmark needs (the secret and public key are always made).
+struct KeyRequest {
+  bool relin_keys = true;
+
+  bool galois_keys = false;
+
+  /// rotation steps of the Galois keys, empty = SEAL's default set
+  std::vector<int> galois_steps;
+};
+
+struct KeySet {
+  std::unique_ptr<seal::SecretKey> secret_key;
+  std::unique_ptr<seal::PublicKey> public_key;
+
+  /// nullptr if not requested
+  std::unique_ptr<seal::RelinKeys> relin_keys;
+
+  /// nullptr if not requested
+  std::unique_ptr<seal::GaloisKeys> galois_keys;
+
+  /// whether the keys were loaded from the store rather than generated
+  bool loaded = false;
+};
+
+class KeyStore : public KeyStoreBase {
+ public:
+  static constexpr std::uint32_t version = 1;
+
+  using KeyStoreBase::KeyStoreBase;
+
+  /// Store in the directory given by the env var, disabled if it is unset.
+  static KeyStore from_env(const char *env_var = "KEY_STORE_DIR") {
+    return KeyStore(directory_from_env(env_var));
+  }
+
+  /// FNV-1a hash of the key-level parameters and the request.
+  static std::uint64_t fingerprint(std::shared_ptr<seal::SEALContext> context,
+                                   const KeyRequest &request) {
+    Fingerprint hash;
+    hash.mix(version);
+    for (std::uint64_t word : context->key_parms_id()) hash.mix(word);
+    hash.mix(request.relin_keys);
+    hash.mix(request.galois_keys);
+    hash.mix(request.galois_steps.size());
+    for (int step : request.galois_steps) {
+      hash.mix(static_cast<std::int64_t>(step));
+    }
+    return hash.value();
+  }
+
+  /// File holding the keys for the context and request.
+  std::string path(std::shared_ptr<seal::SEALContext> context,
+                   const KeyRequest &request) const {
+    return key_file(fingerprint(context, request), ".bin");
+  }
+
+  /// Loads the keys from the store, or generates them and, if the store is
+  /// enabled, adds them to it.
+  KeySet get(std::shared_ptr<seal::SEALContext> context,
+             const KeyRequest &request) const {
+    if (enabled()) {
+      KeySet keys;
+      if (load(context, request, keys)) return keys;
+    }
+    KeySet keys = generate(context, request);
+    if (enabled()) store(context, request, keys);
+    return keys;
+  }
+
+  static KeySet generate(std::shared_ptr<seal::SEALContext> context,
+                         const KeyRequest &request) {
+    seal::KeyGenerator keyGenerator(context);
+    KeySet keys;
+    keys.secret_key =
+        std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
+    keys.public_key =
+        std::make_unique<seal::PublicKey>(keyGenerator.public_key());
+    if (request.relin_keys) {
+      keys.relin_keys =
+          std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
+    }
+    if (request.galois_keys) {
+      keys.galois_keys = std::make_unique<seal::GaloisKeys>(
+          request.galois_steps.empty()
+              ? keyGenerator.galois_keys_local()
+              : keyGenerator.galois_keys_local(request.galois_steps));
+    }
+    return keys;
+  }
+
+  /// Loads the keys into keys, false if the store holds no (valid) file.
+  bool load(std::shared_ptr<seal::SEALContext> context,
+            const KeyRequest &request, KeySet &keys) const {
+    const std::string filename = path(context, request);
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < Header::size) {
+      close(fd);
+      return false;
+    }
+    const std::size_t file_size = static_cast<std::size_t>(st.st_size);
+    void *mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const auto *data = static_cast<const std::byte *>(mapping);
+    Header header;
+    bool valid = header.read(data, file_size) &&
+                 header.fingerprint == fingerprint(context, request);
+    if (valid) {
+      try {
+        keys.secret_key = load_section<seal::SecretKey>(context, data, header,
+                                                        0);
+        keys.public_key = load_section<seal::PublicKey>(context, data, header,
+                                                        1);
+        keys.relin_keys = load_section<seal::RelinKeys>(context, data, header,
+                                                        2);
+        keys.galois_keys = load_section<seal::GaloisKeys>(context, data,
+                                                          header, 3);
+        valid = keys.secret_key && keys.public_key &&
+                (keys.relin_keys != nullptr) == request.relin_keys &&
+                (keys.galois_keys != nullptr) == request.galois_keys;
+      } catch (const std::exception &) {
+        // e.g., a file of an older SEAL version, regenerated by the caller
+        valid = false;
+      }
+    }
+    munmap(mapping, file_size);
+    keys.loaded = valid;
+    return valid;
+  }
+
+  /// Writes the keys into the store.
+  void store(std::shared_ptr<seal::SEALContext> context,
+             const KeyRequest &request, const KeySet &keys) const {
+    std::vector<std::vector<std::byte>> sections(Header::num_sections);
+    sections[0] = save(*keys.secret_key);
+    sections[1] = save(*keys.public_key);
+    if (keys.relin_keys) sections[2] = save(*keys.relin_keys);
+    if (keys.galois_keys) sections[3] = save(*keys.galois_keys);
+
+    Header header;
+    header.fingerprint = fingerprint(context, request);
+    std::uint64_t offset = Header::size;
+    for (std::size_t i = 0; i < sections.size(); ++i) {
+      header.offsets[i] = offset;
+      header.sizes[i] = sections[i].size();
+      offset += sections[i].size();
+    }
+
+    create_directory();
+    write_file(path(context, request), [&](const std::string &filename) {
+      std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+      if (file.fail()) throw std::ios_base::failure(std::strerror(errno));
+      file.exceptions(std::ios::failbit | std::ios::badbit);
+      header.write(file);
+      for (auto &section : sections) {
+        file.write(reinterpret_cast<const char *>(section.data()),
+                   static_cast<std::streamsize>(section.size()));
+      }
+    });
+  }
+
+ private:
+  struct Header {
+    static constexpr std::size_t num_sections = 4;
+    static constexpr long size = 8 + 4 + 4 + 8 + num_sections * 16;
+
+    std::uint64_t fingerprint = 0;
+    std::uint64_t offsets[num_sections] = {};
+    std::uint64_t sizes[num_sections] = {};
+
+    void write(std::ostream &os) const {
+      os.write("SEALKEYS", 8);
+      write_value(os, version);
+      write_value(os, static_cast<std::uint32_t>(num_sections));
+      write_value(os, fingerprint);
+      for (std::size_t i = 0; i < num_sections; ++i) {
+        write_value(os, offsets[i]);
+        write_value(os, sizes[i]);
+      }
+    }
+
+    /// Parses the header, false if it is not a (complete) key file.
+    bool read(const std::byte *data, std::size_t file_size) {
+      if (std::memcmp(data, "SEALKEYS", 8) != 0) return false;
+      std::size_t pos = 8;
+      std::uint32_t file_version, file_sections;
+      read_value(data, pos, file_version);
+      read_value(data, pos, file_sections);
+      if (file_version != version || file_sections != num_sections) {
+        return false;
+      }
+      read_value(data, pos, fingerprint);
+      for (std::size_t i = 0; i < num_sections; ++i) {
+        read_value(data, pos, offsets[i]);
+        read_value(data, pos, sizes[i]);
+        if (offsets[i] > file_size || sizes[i] > file_size - offsets[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    template <typename T>
+    static void write_value(std::ostream &os, T value) {
+      os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void read_value(const std::byte *data, std::size_t &pos, T &value) {
+      std::memcpy(&value, data + pos, sizeof(T));
+      pos += sizeof(T);
+    }
+  };
+
+  template <typename T>
+  static std::vector<std::byte> save(const T &key) {
+    std::vector<std::byte> buffer(static_cast<std::size_t>(
+        key.save_size(seal::compr_mode_type::none)));
+    buffer.resize(static_cast<std::size_t>(
+        key.save(buffer.data(), buffer.size(), seal::compr_mode_type::none)));
+    return buffer;
+  }
+
+  template <typename T>
+  static std::unique_ptr<T> load_section(
+      std::shared_ptr<seal::SEALContext> context, const std::byte *data,
+      const Header &header, std::size_t section) {
+    if (header.sizes[section] == 0) return nullptr;
+    auto key = std::make_unique<T>();
+    key->unsafe_load(context, data + header.offsets[section],
+                     static_cast<std::size_t>(header.sizes[section]));
+    return key;
+  }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef LAZY_RELIN_H_
+#define LAZY_RELIN_H_
+
+#include <seal/seal.h>
+
+#include <atomic>
+#include <cstddef>
+
+/*
+ * Lazy relinearization for circuits of ciphertext-ciphertext multiplications,
+ * e.g., the binary circuits of the cardio benchmarks.
+ *
+ * multiply() and square_inplace() leave their result with three polynomials
+ * (size 3) instead of relinearizing it right away. Additions, subtractions,
+ * plaintext operations, and CKKS rescaling work on size-3 ciphertexts (use
+ * the seal::Evaluator for them), so a result is only relinearized once it is
+ *  - an operand of another multiplication: in place, so that an operand of
+ *    several multiplications is relinearized only once,
+ *  - rotated,
+ *  - returned by the circuit, see relinearize_inplace().
+ * The sum of several products is thus relinearized once instead of once per
+ * product.
+ *
+ * The counters compare against eager relinearization, i.e., one
+ * relinearization after each multiplication. They are atomic, so that
+ * independent sub-circuits can share an evaluator (see task_graph.h).
+ */
+class LazyEvaluator {
+ public:
+  LazyEvaluator(seal::Evaluator &evaluator, const seal::RelinKeys &relin_keys)
+      : evaluator(evaluator), relin_keys(relin_keys) {}
+
+  /// destination = lhs * rhs, of size 3.
+  void multiply(seal::Ciphertext &lhs, seal::Ciphertext &rhs,
+                seal::Ciphertext &destination) {
+    relinearize_inplace(lhs);
+    relinearize_inplace(rhs);
+    evaluator.multiply(lhs, rhs, destination);
+    num_multiplications++;
+  }
+
+  /// lhs = lhs * rhs, of size 3.
+  void multiply_inplace(seal::Ciphertext &lhs, seal::Ciphertext &rhs) {
+    relinearize_inplace(lhs);
+    relinearize_inplace(rhs);
+    evaluator.multiply_inplace(lhs, rhs);
+    num_multiplications++;
+  }
+
+  /// ctxt = ctxt^2, of size 3.
+  void square_inplace(seal::Ciphertext &ctxt) {
+    relinearize_inplace(ctxt);
+    evaluator.square_inplace(ctxt);
+    num_multiplications++;
+  }
+
+  /// Relinearizes the ciphertext if it is of size 3, e.g., before it is sent
+  /// back to the client.
+  void relinearize_inplace(seal::Ciphertext &ctxt) {
+    if (ctxt.size() <= 2) return;
+    evaluator.relinearize_inplace(ctxt, relin_keys);
+    num_relinearizations++;
+  }
+
+  void rotate_rows(seal::Ciphertext &ctxt, int steps,
+                   const seal::GaloisKeys &galois_keys,
+                   seal::Ciphertext &destination) {
+    relinearize_inplace(ctxt);
+    evaluator.rotate_rows(ctxt, steps, galois_keys, destination);
+  }
+
+  void rotate_rows_inplace(seal::Ciphertext &ctxt, int steps,
+                           const seal::GaloisKeys &galois_keys) {
+    relinearize_inplace(ctxt);
+    evaluator.rotate_rows_inplace(ctxt, steps, galois_keys);
+  }
+
+  void rotate_vector(seal::Ciphertext &ctxt, int steps,
+                     const seal::GaloisKeys &galois_keys,
+                     seal::Ciphertext &destination) {
+    relinearize_inplace(ctxt);
+    evaluator.rotate_vector(ctxt, steps, galois_keys, destination);
+  }
+
+  void rotate_vector_inplace(seal::Ciphertext &ctxt, int steps,
+                             const seal::GaloisKeys &galois_keys) {
+    relinearize_inplace(ctxt);
+    evaluator.rotate_vector_inplace(ctxt, steps, galois_keys);
+  }
+
+  /// Number of ciphertext-ciphertext multiplications (incl. squarings), i.e.,
+  /// of relinearizations with eager relinearization.
+  std::size_t multiplications() const { return num_multiplications; }
+
+  std::size_t relinearizations() const { return num_relinearizations; }
+
+  /// 0 if copies of a product were relinearized separately more often.
+  std::size_t removed_relinearizations() const {
+    const std::size_t multiplications = num_multiplications;
+    const std::size_t relinearizations = num_relinearizations;
+    return multiplications > relinearizations
+               ? multiplications - relinearizations
+               : 0;
+  }
+
+  void reset_counters() {
+    num_multiplications = 0;
+    num_relinearizations = 0;
+  }
+
+ private:
+  seal::Evaluator &evaluator;
+  const seal::RelinKeys &relin_keys;
+  std::atomic<std::size_t> num_multiplications{0};
+  std::atomic<std::size_t> num_relinearizations{0};
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "memory.h"
+
+#include <seal/seal.h>
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include "memory_pools.h"
+
+namespace {
+// Only threads with counters (the profiled thread and the threads it hands
+// its counters to, see AllocationCountingScope) count, so that allocations
+// of other threads (e.g., in the throughput mode) are not picked up.
+using memory_internal::thread_counters;
+
+// Each block starts with a header holding the profiling window it was
+// allocated in (0 if none), so that freeing a block allocated before the
+// window does not count against the live bytes of the window. The header
+// keeps the alignment of malloc().
+constexpr std::size_t header_size = alignof(std::max_align_t);
+std::atomic<std::uint64_t> last_window{0};
+
+void *counted_malloc(std::size_t size) {
+  void *block = std::malloc(header_size + size);
+  if (!block) throw std::bad_alloc();
+  AllocationCounters *counters = thread_counters;
+  *static_cast<std::uint64_t *>(block) = counters ? counters->window : 0;
+  if (counters) {
+    counters->allocations++;
+    counters->allocated_bytes += size;
+    const long long live =
+        counters->live_bytes += malloc_usable_size(block);
+    long long peak = counters->peak_bytes.load();
+    while (live > peak &&
+           !counters->peak_bytes.compare_exchange_weak(peak, live)) {
+    }
+  }
+  return static_cast<char *>(block) + header_size;
+}
+
+void counted_free(void *ptr) noexcept {
+  if (!ptr) return;
+  void *block = static_cast<char *>(ptr) - header_size;
+  AllocationCounters *counters = thread_counters;
+  if (counters && *static_cast<std::uint64_t *>(block) == counters->window) {
+    counters->live_bytes -= malloc_usable_size(block);
+  }
+  std::free(block);
+}
+}  // namespace
+
+void *operator new(std::size_t size) { return counted_malloc(size); }
+void *operator new[](std::size_t size) { return counted_malloc(size); }
+void operator delete(void *ptr) noexcept { counted_free(ptr); }
+void operator delete[](void *ptr) noexcept { counted_free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { counted_free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { counted_free(ptr); }
+
+struct MemoryProfiler::Impl {
+  explicit Impl(seal::MemoryPoolHandle pool)
+      : pool(pool), thread_pool(pool), pool_bytes_at_start(0) {}
+
+  seal::MemoryPoolHandle pool;
+  ThreadMemoryPool thread_pool;
+  std::size_t pool_bytes_at_start;
+  AllocationCounters counters;
+};
+
+MemoryProfiler::MemoryProfiler()
+    : impl(std::make_unique<Impl>(seal::MemoryPoolHandle::New())) {}
+
+MemoryProfiler::~MemoryProfiler() {
+  if (thread_counters == &impl->counters) thread_counters = nullptr;
+}
+
+void MemoryProfiler::start() {
+  impl->pool_bytes_at_start = impl->pool.alloc_byte_count();
+  AllocationCounters &counters = impl->counters;
+  counters.allocations = 0;
+  counters.allocated_bytes = 0;
+  counters.live_bytes = 0;
+  counters.peak_bytes = 0;
+  counters.window = ++last_window;
+  thread_counters = &counters;
+}
+
+MemoryStats MemoryProfiler::stop() {
+  thread_counters = nullptr;
+  const AllocationCounters &counters = impl->counters;
+  MemoryStats stats;
+  stats.measured = true;
+  stats.allocations = counters.allocations;
+  stats.allocated_bytes = counters.allocated_bytes;
+  stats.peak_heap_bytes = static_cast<std::size_t>(counters.peak_bytes);
+  stats.pool_bytes = impl->pool.alloc_byte_count() - impl->pool_bytes_at_start;
+  return stats;
+}
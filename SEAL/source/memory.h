@@ -0,0 +1,212 @@
+#ifndef MEMORY_H_
+#define MEMORY_H_
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Allocation and memory-pool instrumentation of single operations or phases.
+ *
+ * A MemoryProfiler redirects SEAL's default memory pool (MemoryManager::
+ * GetPool()) of the calling thread to a fresh MemoryPoolHandle::New() for its
+ * lifetime (see memory_pools.h), and counts the heap allocations of the
+ * calling thread through the replacements of the global operator new/delete
+ * in memory.cpp. Threads that work for the profiled one, such as the workers
+ * of a TaskGraph, count into its counters as well (see
+ * AllocationCountingScope). Hence, every target that profiles (MemoryProfiler,
+ * measure_memory(), PhaseProfiler, or measure_operation() of timing.h) must
+ * also compile memory.cpp. Targets that include this header only through
+ * timing.h do not, and keep the default operator new/delete.
+ *
+ * Profiling is enabled by setting the environment variable MEMORY_PROFILE.
+ */
+
+/// Allocation statistics of one operation or phase.
+struct MemoryStats {
+  /// false if profiling was disabled, all other fields are zero then
+  bool measured = false;
+
+  /// number of calls to operator new (incl. new[])
+  std::size_t allocations = 0;
+
+  /// sum of the sizes requested from operator new
+  std::size_t allocated_bytes = 0;
+
+  /// high-water mark of the heap blocks allocated since the start that were
+  /// live at the same time (freeing older blocks does not lower it)
+  std::size_t peak_heap_bytes = 0;
+
+  /// bytes SEAL's memory pool had to draw from the heap, i.e., the pool's
+  /// high-water mark as pools never release memory before destruction
+  std::size_t pool_bytes = 0;
+};
+
+/// Allocation counters of one profiling window, shared by all threads that
+/// count into it.
+struct AllocationCounters {
+  /// id of the window, stored in the blocks allocated in it
+  std::uint64_t window = 0;
+  std::atomic<std::size_t> allocations{0};
+  std::atomic<std::size_t> allocated_bytes{0};
+  std::atomic<long long> live_bytes{0};
+  std::atomic<long long> peak_bytes{0};
+};
+
+namespace memory_internal {
+/// Counters the allocations of the current thread go to, null if none.
+inline thread_local AllocationCounters *thread_counters = nullptr;
+}  // namespace memory_internal
+
+/// Makes the current thread count its allocations into the given counters
+/// (e.g., those of the thread that started it) for its lifetime. Without
+/// memory.cpp, nothing is counted and this is a no-op.
+class AllocationCountingScope {
+ public:
+  explicit AllocationCountingScope(AllocationCounters *counters)
+      : previous(memory_internal::thread_counters) {
+    memory_internal::thread_counters = counters;
+  }
+
+  /// Restores the previous counters of this thread.
+  ~AllocationCountingScope() { memory_internal::thread_counters = previous; }
+
+  /// Counters of the current thread, null if it is not profiled.
+  static AllocationCounters *current() {
+    return memory_internal::thread_counters;
+  }
+
+  AllocationCountingScope(const AllocationCountingScope &) = delete;
+  AllocationCountingScope &operator=(const AllocationCountingScope &) = delete;
+
+ private:
+  AllocationCounters *previous;
+};
+
+inline bool memory_profiling_enabled() {
+  return std::getenv("MEMORY_PROFILE") != nullptr;
+}
+
+/// Peak resident set size of the process so far, whether or not profiling is
+/// enabled (ru_maxrss, which Linux reports in KiB).
+inline std::size_t peak_rss_bytes() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+class MemoryProfiler {
+ public:
+  /// Switches SEAL's default memory pool to a fresh pool.
+  MemoryProfiler();
+
+  /// Restores the previous memory pool.
+  ~MemoryProfiler();
+
+  MemoryProfiler(const MemoryProfiler &) = delete;
+  MemoryProfiler &operator=(const MemoryProfiler &) = delete;
+
+  /// Resets the counters and starts counting allocations of this thread (and
+  /// of the threads it hands its counters to).
+  void start();
+
+  /// Stops counting and returns the statistics since the last start().
+  MemoryStats stop();
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl;
+};
+
+/// Runs setup() and op() once each with a fresh memory pool, but only counts
+/// the allocations of op(). Outputs that are (re-)created in setup() are
+/// allocated from the fresh pool, so that their buffers show up in
+/// pool_bytes once op() resizes them.
+template <typename Setup, typename Operation>
+MemoryStats measure_memory(Setup setup, Operation op) {
+  MemoryProfiler profiler;
+  setup();
+  profiler.start();
+  op();
+  return profiler.stop();
+}
+
+/// Column names matching write_memory_stats().
+inline std::string memory_stats_header() {
+  return "allocations,allocated_bytes,peak_heap_bytes,pool_bytes";
+}
+
+/// Writes the statistics, or empty columns if profiling was disabled.
+inline void write_memory_stats(std::ostream &os, const MemoryStats &stats) {
+  if (!stats.measured) {
+    os << ",,,";
+    return;
+  }
+  os << stats.allocations << "," << stats.allocated_bytes << ","
+     << stats.peak_heap_bytes << "," << stats.pool_bytes;
+}
+
+/// Profiles the consecutive phases (keygen, encryption, ...) of an
+/// application benchmark. All calls are no-ops if profiling is disabled.
+class PhaseProfiler {
+ public:
+  PhaseProfiler() : enabled(memory_profiling_enabled()) {}
+
+  bool is_enabled() const { return enabled; }
+
+  /// Starts profiling a phase with a fresh memory pool.
+  void begin() {
+    if (!enabled) return;
+    profiler = std::make_unique<MemoryProfiler>();
+    profiler->start();
+    start = std::chrono::steady_clock::now();
+  }
+
+  /// Stops profiling the current phase and records it under the given name.
+  void end(const std::string &phase) {
+    if (!enabled || !profiler) return;
+    auto stop = std::chrono::steady_clock::now();
+    MemoryStats stats = profiler->stop();
+    profiler.reset();
+    phases.push_back(
+        {phase,
+         std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
+             .count(),
+         stats});
+  }
+
+  /// Column names matching write_csv().
+  static std::string header() {
+    return "phase,time_ms," + memory_stats_header();
+  }
+
+  /// Writes one row per recorded phase.
+  void write_csv(std::ostream &os) const {
+    for (auto &p : phases) {
+      os << p.name << "," << p.time_ms << ",";
+      write_memory_stats(os, p.stats);
+      os << std::endl;
+    }
+  }
+
+ private:
+  struct Phase {
+    std::string name;
+    long long time_ms;
+    MemoryStats stats;
+  };
+
+  bool enabled;
+  std::unique_ptr<MemoryProfiler> profiler;
+  std::chrono::steady_clock::time_point start;
+  std::vector<Phase> phases;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef MEMORY_POOLS_H_
+#define MEMORY_POOLS_H_
+
+#include <seal/seal.h>
+
+#include <memory>
+#include <mutex>
+
+/*
+ * Per-thread SEAL memory pools.
+ *
+ * SEAL allocates from MemoryManager::GetPool(), i.e., from the pool the
+ * memory manager profile hands out. The profile is process-wide: an
+ * MMProfGuard switches it for all threads and holds SEAL's switch mutex
+ * until it is destroyed, so a guard per thread would serialize the threads
+ * (and a second guard on the same thread deadlocks). Instead, the first
+ * ThreadMemoryPool installs a profile that hands out the pool set for the
+ * calling thread, or SEAL's global pool if none is set, and each
+ * ThreadMemoryPool sets the pool of its thread for its lifetime.
+ *
+ * The pools are thread-safe and live as long as a ciphertext allocated from
+ * them, so a ciphertext can still be released by another thread.
+ */
+
+namespace memory_pools_internal {
+/// Pool of the current thread, empty if it uses SEAL's global pool.
+inline thread_local seal::MemoryPoolHandle thread_pool;
+
+class ThreadPoolProfile : public seal::MMProf {
+ public:
+  seal::MemoryPoolHandle get_pool(seal::mm_prof_opt_t) override {
+    return thread_pool ? thread_pool : seal::MemoryPoolHandle::Global();
+  }
+};
+
+inline void install_profile() {
+  static std::once_flag installed;
+  // the replaced profile is kept, as other threads may still be using it
+  static std::unique_ptr<seal::MMProf> replaced;
+  std::call_once(installed, []() {
+    replaced = seal::MemoryManager::SwitchProfile(
+        std::make_unique<ThreadPoolProfile>());
+  });
+}
+}  // namespace memory_pools_internal
+
+class ThreadMemoryPool {
+ public:
+  /// Makes MemoryManager::GetPool() return the given pool on this thread.
+  explicit ThreadMemoryPool(
+      seal::MemoryPoolHandle pool = seal::MemoryPoolHandle::New())
+      : previous(memory_pools_internal::thread_pool) {
+    memory_pools_internal::install_profile();
+    memory_pools_internal::thread_pool = std::move(pool);
+  }
+
+  /// Restores the previous pool of this thread.
+  ~ThreadMemoryPool() { memory_pools_internal::thread_pool = previous; }
+
+  /// Pool set for this thread, empty if it uses SEAL's global pool.
+  static seal::MemoryPoolHandle current() {
+    return memory_pools_internal::thread_pool;
+  }
+
+  ThreadMemoryPool(const ThreadMemoryPool &) = delete;
+  ThreadMemoryPool &operator=(const ThreadMemoryPool &) = delete;
+
+ private:
+  seal::MemoryPoolHandle previous;
+};
+
+#endif
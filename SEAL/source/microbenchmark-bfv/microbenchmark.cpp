@@ -21,8 +21,28 @@ void Microbenchmark::setup_context_bfv(std::size_t poly_modulus_degree,
     params.set_plain_modulus(plain_modulus);
   }
 
+  setup_keys(params, use_batching);
+}
+
+void Microbenchmark::setup_context_bfv(const ParameterSet &parameters) {
+  seal::EncryptionParameters params(seal::scheme_type::BFV);
+  params.set_poly_modulus_degree(parameters.poly_modulus_degree);
+  params.set_coeff_modulus(parameters.coeff_modulus());
+  params.set_plain_modulus(seal::PlainModulus::Batching(
+      parameters.poly_modulus_degree, parameters.plain_modulus_bits));
+
+  // a batching-compatible plaintext modulus supports both encoders, hence
+  // the whole op table can run on the same context
+  setup_keys(params, true);
+}
+
+void Microbenchmark::setup_keys(const seal::EncryptionParameters &params,
+                                bool use_batching) {
   // Instantiate context
   context = seal::SEALContext::Create(params);
+  if (!context->parameters_set()) {
+    throw std::invalid_argument(context->parameter_error_message());
+  }
 
   /// Create keys
   seal::KeyGenerator keyGenerator(context);
@@ -37,6 +57,7 @@ void Microbenchmark::setup_context_bfv(std::size_t poly_modulus_degree,
       std::make_unique<seal::Encryptor>(context, *publicKey, *secretKey);
   evaluator = std::make_unique<seal::Evaluator>(context);
   decryptor = std::make_unique<seal::Decryptor>(context, *secretKey);
+  intEncoder = std::make_unique<seal::IntegerEncoder>(context);
 
   if (use_batching) {
     batchEncoder = std::make_unique<seal::BatchEncoder>(context);
@@ -44,8 +65,6 @@ void Microbenchmark::setup_context_bfv(std::size_t poly_modulus_degree,
     std::vector<int> steps = {-4, 4};
     galoisKeys = std::make_unique<seal::GaloisKeys>(
         keyGenerator.galois_keys_local(steps));
-  } else {
-    intEncoder = std::make_unique<seal::IntegerEncoder>(context);
   }
 }
 
@@ -57,254 +76,322 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   if (!last) ss << ",";
 }
-}  // namespace
 
-void Microbenchmark::run_benchmark() {
-  const int NUM_REPETITIONS{100};
-  std::stringstream ss_time;
+// Writes the mean (in TARGET_TIME_UNIT, with fractional part) of each
+// operation into the legacy CSV line.
+void log_means(std::stringstream &ss_time, const OperationTimings &timings) {
+  for (std::size_t i = 0; i < timings.size(); ++i) {
+    ss_time << std::chrono::duration_cast<
+                   std::chrono::duration<double, TARGET_TIME_UNIT::period>>(
+                   std::chrono::duration<double, std::nano>(
+                       timings[i].timing.mean_ns))
+                   .count();
+    if (i + 1 < timings.size()) ss_time << ",";
+  }
+}
 
-  // set up the BFV scheme
-  auto t0 = Time::now();
-  setup_context_bfv(16384, 536903681, false);
-  auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+// Writes one row per operation, prefixed by the parameters of the context.
+// The allocation and counter columns stay empty unless MEMORY_PROFILE and
+// PERF_COUNTERS are set, respectively.
+void log_stats(std::stringstream &ss_stats,
+               std::shared_ptr<seal::SEALContext> context,
+               const OperationTimings &timings) {
+  for (auto &t : timings) {
+    write_parameters_csv(ss_stats, context);
+    ss_stats << "," << t.operation << "," << t.level << ",";
+    write_timing_stats(ss_stats, t.timing);
+    ss_stats << ",";
+    write_memory_stats(ss_stats, t.memory);
+    ss_stats << ",";
+    write_perf_counters(ss_stats, t.counters);
+    ss_stats << std::endl;
+  }
+}
 
-  // =======================================================
-  // Ctxt-Ctxt Multiplication with new ciphertext
-  // =======================================================
+const std::string stats_header =
+    parameters_csv_header() + ",operation,level," + timing_stats_header() +
+    "," + memory_stats_header() + "," + perf_counters_header();
+}  // namespace
 
-  size_t total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
+OperationTimings Microbenchmark::run_arithmetic_ops(
+    const TimingConfig &timing_config) {
+  OperationTimings timings;
+  auto time_operation = [&](const std::string &operation, auto setup,
+                            auto op) {
+    timings.push_back(measure_operation(timing_config, operation, setup, op));
+    timings.back().level = context->first_context_data()->chain_index();
+  };
+  auto no_setup = []() {};
+
+  // fresh inputs for every repetition, encrypted outside the timed region
+  seal::Ciphertext ctxtA, ctxtB, ctxtC;
+  seal::Plaintext ptxtA;
+  auto encrypt_ctxt_ctxt = [&]() {
     encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Ciphertext ctxtB;
     encryptor->encrypt(intEncoder->encode(28), ctxtB);
+    ctxtC = seal::Ciphertext();
+  };
+  auto encrypt_ctxt_ptxt = [&]() {
+    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
+    ptxtA = intEncoder->encode(28);
+    ctxtB = seal::Ciphertext();
+  };
 
-    auto start = Time::now();
-    seal::Ciphertext ctxtC;
+  // =======================================================
+  // Ctxt-Ctxt Multiplication with new ciphertext
+  // =======================================================
+
+  time_operation("t_mul_ct_ct", encrypt_ctxt_ctxt, [&]() {
     evaluator->multiply(ctxtA, ctxtB, ctxtC);
     evaluator->relinearize_inplace(ctxtC, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ctxt Multiplication in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Ciphertext ctxtB;
-    encryptor->encrypt(intEncoder->encode(28), ctxtB);
-
-    auto start = Time::now();
+  time_operation("t_mul_ct_ct_inplace", encrypt_ctxt_ctxt, [&]() {
     evaluator->multiply_inplace(ctxtA, ctxtB);
     evaluator->relinearize_inplace(ctxtA, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ptxt Multiplication with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Plaintext ptxtA = intEncoder->encode(28);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtB;
+  time_operation("t_mul_ct_pt", encrypt_ctxt_ptxt, [&]() {
     evaluator->multiply_plain(ctxtA, ptxtA, ctxtB);
     evaluator->relinearize_inplace(ctxtB, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ptxt Multiplication in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Plaintext ptxtA = intEncoder->encode(28);
-
-    auto start = Time::now();
+  time_operation("t_mul_ct_pt_inplace", encrypt_ctxt_ptxt, [&]() {
     evaluator->multiply_plain_inplace(ctxtA, ptxtA);
     evaluator->relinearize_inplace(ctxtA, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ctxt Addition time with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Ciphertext ctxtB;
-    encryptor->encrypt(intEncoder->encode(28), ctxtB);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtC;
-    evaluator->add(ctxtA, ctxtB, ctxtC);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_ct", encrypt_ctxt_ctxt,
+                 [&]() { evaluator->add(ctxtA, ctxtB, ctxtC); });
 
   // =======================================================
   // Ctxt-Ctxt Addition time in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Ciphertext ctxtB;
-    encryptor->encrypt(intEncoder->encode(28), ctxtB);
-
-    auto start = Time::now();
-    evaluator->add_inplace(ctxtA, ctxtB);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_ct_inplace", encrypt_ctxt_ctxt,
+                 [&]() { evaluator->add_inplace(ctxtA, ctxtB); });
 
   // =======================================================
   // Ctxt-Ptxt Addition with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Plaintext ptxtA = intEncoder->encode(28);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtB;
-    evaluator->add_plain(ctxtA, ptxtA, ctxtB);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_pt", encrypt_ctxt_ptxt,
+                 [&]() { evaluator->add_plain(ctxtA, ptxtA, ctxtB); });
 
   // =======================================================
   // Ctxt-Ptxt Addition in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA;
-    encryptor->encrypt(intEncoder->encode(4214), ctxtA);
-    seal::Plaintext ptxtA = intEncoder->encode(28);
-
-    auto start = Time::now();
-    evaluator->add_plain_inplace(ctxtA, ptxtA);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_pt_inplace", encrypt_ctxt_ptxt,
+                 [&]() { evaluator->add_plain_inplace(ctxtA, ptxtA); });
 
   // =======================================================
   // Sk Encryption time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    auto start = Time::now();
+  time_operation("t_enc_sk", no_setup, [&]() {
     seal::Ciphertext ctxt;
     encryptor->encrypt_symmetric(intEncoder->encode(23213), ctxt);
-    auto end = Time::now();
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Pk Encryption Time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    auto start = Time::now();
+  time_operation("t_enc_pk", no_setup, [&]() {
     seal::Ciphertext ctxt;
     encryptor->encrypt(intEncoder->encode(23213), ctxt);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Decryption time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxt;
-    encryptor->encrypt(intEncoder->encode(23213), ctxt);
+  time_operation(
+      "t_dec",
+      [&]() { encryptor->encrypt(intEncoder->encode(23213), ctxtA); },
+      [&]() {
+        seal::Plaintext ptxt;
+        decryptor->decrypt(ctxtA, ptxt);
+      });
 
-    auto start = Time::now();
-    seal::Plaintext ptxt;
-    decryptor->decrypt(ctxt, ptxt);
-    auto end = Time::now();
+  return timings;
+}
 
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS);
+OperationTimings Microbenchmark::run_rotation_ops(
+    const TimingConfig &timing_config) {
+  OperationTimings timings;
+  auto time_operation = [&](const std::string &operation, auto setup,
+                            auto op) {
+    timings.push_back(measure_operation(timing_config, operation, setup, op));
+    timings.back().level = context->first_context_data()->chain_index();
+  };
+  seal::Ciphertext ctxtA;
 
   // =======================================================
   // Rotation (native, i.e. single-key)
   // =======================================================
 
-  setup_context_bfv(16384, -1, true);
+  time_operation(
+      "t_rot",
+      [&]() {
+        std::vector<uint64_t> data = {43, 23, 54, 31, 341, 43, 34};
+        seal::Plaintext ptxt;
+        batchEncoder->encode(data, ptxt);
+        encryptor->encrypt(ptxt, ctxtA);
+      },
+      [&]() { evaluator->rotate_rows_inplace(ctxtA, 4, *galoisKeys); });
+
+  return timings;
+}
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxt;
-    std::vector<uint64_t> data = {43, 23, 54, 31, 341, 43, 34};
-    seal::Plaintext ptxt;
-    batchEncoder->encode(data, ptxt);
-    encryptor->encrypt(ptxt, ctxt);
+OperationTimings Microbenchmark::run_level_ops(
+    const TimingConfig &timing_config) {
+  OperationTimings timings;
+
+  // Power-of-two keys (SEAL's default set), so that an arbitrary step needs
+  // several key switches, and that column rotations are supported
+  seal::KeyGenerator keyGenerator(context, *secretKey);
+  seal::GaloisKeys pow2GaloisKeys = keyGenerator.galois_keys_local();
+
+  std::vector<uint64_t> data = {43, 23, 54, 31, 341, 43, 34};
+  seal::Plaintext ptxt;
+  batchEncoder->encode(data, ptxt);
+
+  // walk down the modulus chain, from the first data level to the last one
+  for (auto context_data = context->first_context_data(); context_data;
+       context_data = context_data->next_context_data()) {
+    const seal::parms_id_type parms_id = context_data->parms_id();
+    const bool is_last_level = !context_data->next_context_data();
+
+    auto time_operation = [&](const std::string &operation, auto setup,
+                              auto op) {
+      timings.push_back(
+          measure_operation(timing_config, operation, setup, op));
+      timings.back().level = context_data->chain_index();
+    };
+
+    // fresh inputs at the current level, encrypted outside the timed region
+    seal::Ciphertext ctxtA, ctxtB, ctxtC;
+    seal::Plaintext ptxtA;
+    auto encrypt_at_level = [&]() {
+      encryptor->encrypt(ptxt, ctxtA);
+      evaluator->mod_switch_to_inplace(ctxtA, parms_id);
+      ctxtB = ctxtA;
+      ctxtC = seal::Ciphertext();
+    };
+
+    // =======================================================
+    // Multiplication, squaring, and exponentiation
+    // =======================================================
+
+    time_operation("t_mul_ct_ct", encrypt_at_level, [&]() {
+      evaluator->multiply(ctxtA, ctxtB, ctxtC);
+      evaluator->relinearize_inplace(ctxtC, *relinKeys);
+    });
+
+    time_operation("t_square", encrypt_at_level, [&]() {
+      evaluator->square(ctxtA, ctxtC);
+      evaluator->relinearize_inplace(ctxtC, *relinKeys);
+    });
+
+    time_operation("t_exponentiate_4", encrypt_at_level, [&]() {
+      evaluator->exponentiate(ctxtA, 4, *relinKeys, ctxtC);
+    });
+
+    // =======================================================
+    // Rotations, i.e., key switching
+    // =======================================================
+
+    time_operation("t_rot_rows_4", encrypt_at_level, [&]() {
+      evaluator->rotate_rows(ctxtA, 4, *galoisKeys, ctxtC);
+    });
+
+    // 7 = 8 - 1 takes two key switches with power-of-two keys
+    time_operation("t_rot_rows_7_pow2_keys", encrypt_at_level, [&]() {
+      evaluator->rotate_rows(ctxtA, 7, pow2GaloisKeys, ctxtC);
+    });
+
+    time_operation("t_rot_columns", encrypt_at_level, [&]() {
+      evaluator->rotate_columns(ctxtA, pow2GaloisKeys, ctxtC);
+    });
+
+    // =======================================================
+    // Modulus switching
+    // =======================================================
+
+    if (!is_last_level) {
+      time_operation("t_mod_switch_ct", encrypt_at_level, [&]() {
+        evaluator->mod_switch_to_next(ctxtA, ctxtC);
+      });
+    }
+
+    // =======================================================
+    // NTT transforms
+    // =======================================================
+
+    time_operation("t_ntt_fwd_ct", encrypt_at_level, [&]() {
+      evaluator->transform_to_ntt(ctxtA, ctxtC);
+    });
+
+    time_operation(
+        "t_ntt_inv_ct",
+        [&]() {
+          encrypt_at_level();
+          evaluator->transform_to_ntt_inplace(ctxtA);
+        },
+        [&]() { evaluator->transform_from_ntt(ctxtA, ctxtC); });
+
+    // BFV plaintexts are lifted to the ciphertext modulus of the level, SEAL
+    // has no inverse transform for plaintexts
+    time_operation(
+        "t_ntt_fwd_pt", [&]() { ptxtA = seal::Plaintext(); },
+        [&]() { evaluator->transform_to_ntt(ptxt, parms_id, ptxtA); });
+  }
+  return timings;
+}
 
-    auto start = Time::now();
-    evaluator->rotate_rows_inplace(ctxt, 4, *galoisKeys);
-    auto end = Time::now();
+void Microbenchmark::run_benchmark() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+  std::stringstream ss_time;
+  std::stringstream ss_stats;
 
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS);
+  // set up the BFV scheme
+  auto t0 = Time::now();
+  setup_context_bfv(16384, 536903681, false);
+  auto t1 = Time::now();
+  log_time(ss_time, t0, t1, false);
+
+  OperationTimings timings = run_arithmetic_ops(timing_config);
+  log_stats(ss_stats, context, timings);
+
+  // rotations require a batching-compatible plaintext modulus
+  setup_context_bfv(16384, -1, true);
+  OperationTimings rotation_timings = run_rotation_ops(timing_config);
+  log_stats(ss_stats, context, rotation_timings);
+
+  // level-dependent operations only go into the statistics file
+  log_stats(ss_stats, context, run_level_ops(timing_config));
+
+  timings.insert(timings.end(), rotation_timings.begin(),
+                 rotation_timings.end());
+  log_means(ss_time, timings);
 
   // write ss_time into file
   std::ofstream myfile;
@@ -313,12 +400,136 @@ void Microbenchmark::run_benchmark() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write per-operation statistics into file
+  std::ofstream stats_file =
+      open_stats_file("microbenchmark_bfv_stats.csv", stats_header);
+  stats_file << ss_stats.str();
+  stats_file.close();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_microbenchmark_bfv.txt");
 }
 
+void Microbenchmark::run_sweep() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+
+  // ring dimensions x coefficient modulus chains x plaintext modulus sizes,
+  // where an empty chain stands for SEAL's default (128-bit secure) chain
+  auto grid = parameter_grid({4096, 8192, 16384, 32768},
+                             {{}, {60, 60}, {60, 60, 60, 60},
+                              {60, 60, 60, 60, 60, 60, 60, 60}},
+                             {20, 30, 40});
+
+  std::ofstream sweep_file = open_csv_file(
+      "SWEEP_FILENAME", "microbenchmark_bfv_sweep.csv",
+      parameters_csv_header() +
+          ",t_keygen,t_mul_ct_ct,t_mul_ct_ct_inplace,t_mul_ct_pt,"
+          "t_mul_ct_pt_inplace,t_add_ct_ct,t_add_ct_ct_inplace,t_add_ct_pt,"
+          "t_add_ct_pt_inplace,t_enc_sk,t_enc_pk,t_dec,t_rot");
+  std::ofstream stats_file =
+      open_stats_file("microbenchmark_bfv_stats.csv", stats_header);
+
+  for (auto &parameters : grid) {
+    std::stringstream ss_time;
+    std::stringstream ss_stats;
+    try {
+      auto t0 = Time::now();
+      setup_context_bfv(parameters);
+      auto t1 = Time::now();
+
+      OperationTimings timings = run_arithmetic_ops(timing_config);
+      OperationTimings rotation_timings = run_rotation_ops(timing_config);
+      timings.insert(timings.end(), rotation_timings.begin(),
+                     rotation_timings.end());
+
+      write_parameters_csv(ss_time, context);
+      ss_time << ",";
+      log_time(ss_time, t0, t1, false);
+      log_means(ss_time, timings);
+      log_stats(ss_stats, context, timings);
+      log_stats(ss_stats, context, run_level_ops(timing_config));
+    } catch (std::exception &e) {
+      // e.g., insecure parameters or a plaintext modulus without a prime
+      std::cerr << "Skipping N=" << parameters.poly_modulus_degree
+                << ", t=" << parameters.plain_modulus_bits << " bits: "
+                << e.what() << std::endl;
+      continue;
+    }
+    sweep_file << ss_time.str() << std::endl;
+    stats_file << ss_stats.str();
+  }
+}
+
+void Microbenchmark::run_throughput() {
+  const ThroughputConfig config = ThroughputConfig::from_env();
+
+  // rotations require batching, hence all operations use this context
+  setup_context_bfv(16384, -1, true);
+  seal::Plaintext ptxt;
+  batchEncoder->encode(std::vector<uint64_t>{43, 23, 54, 31, 341, 43, 34},
+                       ptxt);
+
+  // the output ciphertext is overwritten by every repetition, so that the
+  // inputs stay fresh and no per-operation setup is needed
+  std::vector<std::pair<std::string, std::function<void(WorkerState &)>>>
+      operations = {
+      {"t_mul_ct_ct",
+       [&](WorkerState &s) {
+         evaluator->multiply(s.ctxtA, s.ctxtB, s.ctxtC, s.pool);
+         evaluator->relinearize_inplace(s.ctxtC, *relinKeys, s.pool);
+       }},
+      {"t_add_ct_ct",
+       [&](WorkerState &s) { evaluator->add(s.ctxtA, s.ctxtB, s.ctxtC); }},
+      {"t_enc_pk",
+       [&](WorkerState &s) { encryptor->encrypt(s.ptxt, s.ctxtC, s.pool); }},
+      {"t_rot",
+       [&](WorkerState &s) {
+         evaluator->rotate_rows(s.ctxtA, 4, *galoisKeys, s.ctxtC, s.pool);
+       }},
+      };
+
+  std::ofstream throughput_file = open_csv_file(
+      "THROUGHPUT_FILENAME", "microbenchmark_bfv_throughput.csv",
+      parameters_csv_header() + ",operation,memory_pool," +
+          throughput_header());
+
+  for (auto &operation : operations) {
+    // SEAL's global memory pool is shared (and locked) by all threads, which
+    // we compare against a dedicated pool per thread
+    for (bool per_thread_pool : {false, true}) {
+      ThroughputResult single_thread;
+      for (std::size_t k = 1; k <= config.max_threads; ++k) {
+        auto result = measure_throughput(k, config.seconds, [&](std::size_t) {
+          auto state = std::make_shared<WorkerState>(
+              per_thread_pool ? seal::MemoryPoolHandle::New()
+                              : seal::MemoryManager::GetPool());
+          encryptor->encrypt(ptxt, state->ctxtA, state->pool);
+          encryptor->encrypt(ptxt, state->ctxtB, state->pool);
+          state->ptxt = ptxt;
+          auto &op = operation.second;
+          return [state, &op]() { op(*state); };
+        });
+        if (k == 1) single_thread = result;
+
+        write_parameters_csv(throughput_file, context);
+        throughput_file << "," << operation.first << ","
+                        << (per_thread_pool ? "per_thread" : "global") << ",";
+        write_throughput(throughput_file, result,
+                         scaling_efficiency(result, single_thread));
+        throughput_file << std::endl;
+      }
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting 'microbenchmark-bfv'..." << std::endl;
-  Microbenchmark().run_benchmark();
+  if (has_flag(argc, argv, "--sweep")) {
+    Microbenchmark().run_sweep();
+  } else if (has_flag(argc, argv, "--throughput")) {
+    Microbenchmark().run_throughput();
+  } else {
+    Microbenchmark().run_benchmark();
+  }
   return 0;
 }
@@ -17,6 +17,10 @@
 #include <random>
 #include <vector>
 
+#include "../sweep.h"
+#include "../throughput.h"
+#include "../timing.h"
+
 typedef std::vector<seal::Ciphertext> CiphertextVector;
 typedef std::chrono::high_resolution_clock Time;
 typedef std::chrono::milliseconds ms;
@@ -59,12 +63,37 @@ class Microbenchmark {
   CiphertextVector post_computation(std::vector<CiphertextVector> &P,
                                     std::vector<CiphertextVector> &G, int size);
 
+  /// Creates the context, keys, and helper objects for the given parameters.
+  void setup_keys(const seal::EncryptionParameters &params, bool use_batching);
+
+  /// Times all operations that only need the integer encoder.
+  OperationTimings run_arithmetic_ops(const TimingConfig &timing_config);
+
+  /// Times all operations that need batching and Galois keys.
+  OperationTimings run_rotation_ops(const TimingConfig &timing_config);
+
+  /// Times multiplication, rotations, modulus switching, and NTT transforms
+  /// at every level of the modulus chain (needs batching).
+  OperationTimings run_level_ops(const TimingConfig &timing_config);
+
  public:
   void setup_context_bfv(std::size_t poly_modulus_degree,
                          std::uint64_t plain_modulus,
                          bool use_batching);
 
+  /// Sets up a batching-enabled context for one point of the parameter sweep.
+  void setup_context_bfv(const ParameterSet &parameters);
+
   void run_benchmark();
 
+  /// Runs the full op table once for each point of the parameter grid and
+  /// writes one result row per configuration (enabled by --sweep).
+  void run_sweep();
+
+  /// Runs selected operations concurrently on K = 1..max_threads threads that
+  /// share the context and keys, and writes ops/sec and scaling efficiency
+  /// per thread count (enabled by --throughput).
+  void run_throughput();
+
   int main(int argc, char *argv[]);
 };
@@ -11,8 +11,22 @@ void Microbenchmark::setup_context_ckks(std::size_t poly_modulus_degree) {
       poly_modulus_degree,
       {60, 32})); //to match log2 q = 92 in Palisade CKKS
 
+  setup_keys(params);
+}
+
+void Microbenchmark::setup_context_ckks(const ParameterSet &parameters) {
+  seal::EncryptionParameters params(seal::scheme_type::CKKS);
+  params.set_poly_modulus_degree(parameters.poly_modulus_degree);
+  params.set_coeff_modulus(parameters.coeff_modulus());
+  setup_keys(params);
+}
+
+void Microbenchmark::setup_keys(const seal::EncryptionParameters &params) {
   // Instantiate context
   context = seal::SEALContext::Create(params);
+  if (!context->parameters_set()) {
+    throw std::invalid_argument(context->parameter_error_message());
+  }
 
   // Define initial ciphertext scale
   initial_scale = std::pow(2.0, 40);
@@ -62,6 +76,41 @@ void log_time(std::stringstream &ss,
   ss << std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
   if (!last) ss << ",";
 }
+
+// Writes the mean (in TARGET_TIME_UNIT, with fractional part) of each
+// operation into the legacy CSV line.
+void log_means(std::stringstream &ss_time, const OperationTimings &timings) {
+  for (std::size_t i = 0; i < timings.size(); ++i) {
+    ss_time << std::chrono::duration_cast<
+                   std::chrono::duration<double, TARGET_TIME_UNIT::period>>(
+                   std::chrono::duration<double, std::nano>(
+                       timings[i].timing.mean_ns))
+                   .count();
+    if (i + 1 < timings.size()) ss_time << ",";
+  }
+}
+
+// Writes one row per operation, prefixed by the parameters of the context.
+// The allocation and counter columns stay empty unless MEMORY_PROFILE and
+// PERF_COUNTERS are set, respectively.
+void log_stats(std::stringstream &ss_stats,
+               std::shared_ptr<seal::SEALContext> context,
+               const OperationTimings &timings) {
+  for (auto &t : timings) {
+    write_parameters_csv(ss_stats, context);
+    ss_stats << "," << t.operation << "," << t.level << ",";
+    write_timing_stats(ss_stats, t.timing);
+    ss_stats << ",";
+    write_memory_stats(ss_stats, t.memory);
+    ss_stats << ",";
+    write_perf_counters(ss_stats, t.counters);
+    ss_stats << std::endl;
+  }
+}
+
+const std::string stats_header =
+    parameters_csv_header() + ",operation,level," + timing_stats_header() +
+    "," + memory_stats_header() + "," + perf_counters_header();
 }  // namespace
 
 seal::Ciphertext Microbenchmark::encode_and_encrypt(double numbers) {
@@ -72,247 +121,263 @@ seal::Ciphertext Microbenchmark::encode_and_encrypt(double numbers) {
   return encrypted_numbers;
 }
 
-void Microbenchmark::run_benchmark() {
-  const int NUM_REPETITIONS{100};
-  std::stringstream ss_time;
-
-  // set up the CKKS scheme
-  auto t0 = Time::now();
-  setup_context_ckks(65536);
-  auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+OperationTimings Microbenchmark::run_ops(const TimingConfig &timing_config) {
+  OperationTimings timings;
+  auto time_operation = [&](const std::string &operation, auto setup,
+                            auto op) {
+    timings.push_back(measure_operation(timing_config, operation, setup, op));
+    timings.back().level = context->first_context_data()->chain_index();
+  };
+  auto no_setup = []() {};
+
+  // fresh inputs for every repetition, encrypted outside the timed region
+  seal::Ciphertext ctxtA, ctxtB, ctxtC;
+  seal::Plaintext ptxtA;
+  auto encrypt_ctxt_ctxt = [&]() {
+    ctxtA = encode_and_encrypt(4214);
+    ctxtB = encode_and_encrypt(28);
+    ctxtC = seal::Ciphertext();
+  };
+  auto encrypt_ctxt_ptxt = [&]() {
+    ctxtA = encode_and_encrypt(4214);
+    encoder->encode(28, initial_scale, ptxtA);
+    ctxtB = seal::Ciphertext();
+  };
 
   // =======================================================
   // Ctxt-Ctxt Multiplication with new ciphertext
   // =======================================================
 
-  size_t total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Ciphertext ctxtB = encode_and_encrypt(28);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtC;
+  time_operation("t_mul_ct_ct", encrypt_ctxt_ctxt, [&]() {
     evaluator->multiply(ctxtA, ctxtB, ctxtC);
     evaluator->relinearize_inplace(ctxtC, *relinKeys);
     evaluator->rescale_to_next_inplace(ctxtC);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ctxt Multiplication in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Ciphertext ctxtB = encode_and_encrypt(28);
-
-    auto start = Time::now();
+  time_operation("t_mul_ct_ct_inplace", encrypt_ctxt_ctxt, [&]() {
     evaluator->multiply_inplace(ctxtA, ctxtB);
     evaluator->relinearize_inplace(ctxtA, *relinKeys);
     evaluator->rescale_to_next_inplace(ctxtA);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ptxt Multiplication with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Plaintext ptxtA;
-    encoder->encode(28, initial_scale, ptxtA);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtB;
+  time_operation("t_mul_ct_pt", encrypt_ctxt_ptxt, [&]() {
     evaluator->multiply_plain(ctxtA, ptxtA, ctxtB);
     evaluator->relinearize_inplace(ctxtB, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ptxt Multiplication in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Plaintext ptxtA;
-    encoder->encode(28, initial_scale, ptxtA);
-
-    auto start = Time::now();
+  time_operation("t_mul_ct_pt_inplace", encrypt_ctxt_ptxt, [&]() {
     evaluator->multiply_plain_inplace(ctxtA, ptxtA);
     evaluator->relinearize_inplace(ctxtA, *relinKeys);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  });
 
   // =======================================================
   // Ctxt-Ctxt Addition time with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Ciphertext ctxtB = encode_and_encrypt(28);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtC;
-    evaluator->add(ctxtA, ctxtB, ctxtC);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_ct", encrypt_ctxt_ctxt,
+                 [&]() { evaluator->add(ctxtA, ctxtB, ctxtC); });
 
   // =======================================================
   // Ctxt-Ctxt Addition time in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Ciphertext ctxtB = encode_and_encrypt(28);
-
-    auto start = Time::now();
-    evaluator->add_inplace(ctxtA, ctxtB);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_ct_inplace", encrypt_ctxt_ctxt,
+                 [&]() { evaluator->add_inplace(ctxtA, ctxtB); });
 
   // =======================================================
   // Ctxt-Ptxt Addition with new ciphertext
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Plaintext ptxtA;
-    encoder->encode(28, initial_scale, ptxtA);
-
-    auto start = Time::now();
-    seal::Ciphertext ctxtB;
-    evaluator->add_plain(ctxtA, ptxtA, ctxtB);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_pt", encrypt_ctxt_ptxt,
+                 [&]() { evaluator->add_plain(ctxtA, ptxtA, ctxtB); });
 
   // =======================================================
   // Ctxt-Ptxt Addition in-place
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxtA = encode_and_encrypt(4214);
-    seal::Plaintext ptxtA;
-    encoder->encode(28, initial_scale, ptxtA);
-
-    auto start = Time::now();
-    evaluator->add_plain_inplace(ctxtA, ptxtA);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+  time_operation("t_add_ct_pt_inplace", encrypt_ctxt_ptxt,
+                 [&]() { evaluator->add_plain_inplace(ctxtA, ptxtA); });
 
   // =======================================================
   // Sk Encryption time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    auto start = Time::now();
-    seal::Plaintext ptxtA;
-    encoder->encode(2321, initial_scale, ptxtA);
+  time_operation("t_enc_sk", no_setup, [&]() {
+    seal::Plaintext ptxt;
+    encoder->encode(2321, initial_scale, ptxt);
     seal::Ciphertext ctxt;
-    encryptor->encrypt_symmetric(ptxtA, ctxt);
-    auto end = Time::now();
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+    encryptor->encrypt_symmetric(ptxt, ctxt);
+  });
 
   // =======================================================
   // Pk Encryption Time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    auto start = Time::now();
-    seal::Plaintext ptxtA;
-    encoder->encode(2321, initial_scale, ptxtA);
+  time_operation("t_enc_pk", no_setup, [&]() {
+    seal::Plaintext ptxt;
+    encoder->encode(2321, initial_scale, ptxt);
     seal::Ciphertext ctxt;
-    encryptor->encrypt(ptxtA, ctxt);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS) << ",";
+    encryptor->encrypt(ptxt, ctxt);
+  });
 
   // =======================================================
   // Decryption time
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Ciphertext ctxt = encode_and_encrypt(2321);
-
-    auto start = Time::now();
-    seal::Plaintext ptxt;
-    decryptor->decrypt(ctxt, ptxt);
-    auto end = Time::now();
-
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
-  }
-  ss_time << (total_time / NUM_REPETITIONS);
+  time_operation(
+      "t_dec", [&]() { ctxtA = encode_and_encrypt(2321); },
+      [&]() {
+        seal::Plaintext ptxt;
+        decryptor->decrypt(ctxtA, ptxt);
+      });
 
   // =======================================================
   // Rotation (native, i.e. single-key)
   // =======================================================
 
-  total_time = 0;
-  for (size_t i = 0; i < NUM_REPETITIONS; i++) {
-    seal::Plaintext ptxt;
-    std::vector<double> data = {43, 23, 54, 31, 341, 43, 34};
-    encoder->encode(data, context->first_parms_id(), initial_scale, ptxt);
-    seal::Ciphertext ctxt;
-    encryptor->encrypt(ptxt, ctxt);
-
-    auto start = Time::now();
-    evaluator->rotate_vector_inplace(ctxt, 4, *galoisKeys);
-    auto end = Time::now();
+  time_operation(
+      "t_rot",
+      [&]() {
+        seal::Plaintext ptxt;
+        std::vector<double> data = {43, 23, 54, 31, 341, 43, 34};
+        encoder->encode(data, context->first_parms_id(), initial_scale, ptxt);
+        encryptor->encrypt(ptxt, ctxtA);
+      },
+      [&]() { evaluator->rotate_vector_inplace(ctxtA, 4, *galoisKeys); });
+
+  return timings;
+}
 
-    total_time +=
-        std::chrono::duration_cast<TARGET_TIME_UNIT>(end - start).count();
+OperationTimings Microbenchmark::run_level_ops(
+    const TimingConfig &timing_config) {
+  OperationTimings timings;
+
+  // Power-of-two keys (SEAL's default set), so that an arbitrary step needs
+  // several key switches
+  seal::KeyGenerator keyGenerator(context, *secretKey);
+  seal::GaloisKeys pow2GaloisKeys = keyGenerator.galois_keys_local();
+
+  std::vector<double> data = {43, 23, 54, 31, 341, 43, 34};
+
+  // walk down the modulus chain, from the first data level to the last one
+  for (auto context_data = context->first_context_data(); context_data;
+       context_data = context_data->next_context_data()) {
+    const seal::parms_id_type parms_id = context_data->parms_id();
+    const bool is_last_level = !context_data->next_context_data();
+
+    auto time_operation = [&](const std::string &operation, auto setup,
+                              auto op) {
+      timings.push_back(
+          measure_operation(timing_config, operation, setup, op));
+      timings.back().level = context_data->chain_index();
+    };
+
+    // fresh inputs at the current level, encrypted outside the timed region
+    seal::Ciphertext ctxtA, ctxtB, ctxtC;
+    seal::Plaintext ptxtA, ptxtB;
+    auto encrypt_at_level = [&]() {
+      seal::Plaintext ptxt;
+      encoder->encode(data, parms_id, initial_scale, ptxt);
+      encryptor->encrypt(ptxt, ctxtA);
+      ctxtB = ctxtA;
+      ctxtC = seal::Ciphertext();
+    };
+
+    // =======================================================
+    // Multiplication and squaring (exponentiate is BFV only)
+    // =======================================================
+
+    time_operation("t_mul_ct_ct", encrypt_at_level, [&]() {
+      evaluator->multiply(ctxtA, ctxtB, ctxtC);
+      evaluator->relinearize_inplace(ctxtC, *relinKeys);
+    });
+
+    time_operation("t_square", encrypt_at_level, [&]() {
+      evaluator->square(ctxtA, ctxtC);
+      evaluator->relinearize_inplace(ctxtC, *relinKeys);
+    });
+
+    // =======================================================
+    // Rotations, i.e., key switching
+    // =======================================================
+
+    time_operation("t_rot_vector_4", encrypt_at_level, [&]() {
+      evaluator->rotate_vector(ctxtA, 4, *galoisKeys, ctxtC);
+    });
+
+    // 7 = 8 - 1 takes two key switches with power-of-two keys
+    time_operation("t_rot_vector_7_pow2_keys", encrypt_at_level, [&]() {
+      evaluator->rotate_vector(ctxtA, 7, pow2GaloisKeys, ctxtC);
+    });
+
+    // =======================================================
+    // Rescaling and modulus switching
+    // =======================================================
+
+    if (!is_last_level) {
+      time_operation("t_rescale", encrypt_at_level, [&]() {
+        evaluator->rescale_to_next(ctxtA, ctxtC);
+      });
+
+      time_operation("t_mod_switch_ct", encrypt_at_level, [&]() {
+        evaluator->mod_switch_to_next(ctxtA, ctxtC);
+      });
+
+      time_operation(
+          "t_mod_switch_pt",
+          [&]() { encoder->encode(data, parms_id, initial_scale, ptxtA); },
+          [&]() { evaluator->mod_switch_to_next(ptxtA, ptxtB); });
+    }
+
+    // =======================================================
+    // NTT transforms (CKKS ciphertexts are kept in NTT form, and encoded
+    // plaintexts already are in NTT form, hence there is no plaintext case)
+    // =======================================================
+
+    time_operation(
+        "t_ntt_inv_ct", encrypt_at_level,
+        [&]() { evaluator->transform_from_ntt(ctxtA, ctxtC); });
+
+    time_operation(
+        "t_ntt_fwd_ct",
+        [&]() {
+          encrypt_at_level();
+          evaluator->transform_from_ntt_inplace(ctxtA);
+        },
+        [&]() { evaluator->transform_to_ntt(ctxtA, ctxtC); });
   }
-  ss_time << (total_time / NUM_REPETITIONS);
+  return timings;
+}
+
+void Microbenchmark::run_benchmark() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+  std::stringstream ss_time;
+  std::stringstream ss_stats;
+
+  // set up the CKKS scheme
+  auto t0 = Time::now();
+  setup_context_ckks(65536);
+  auto t1 = Time::now();
+  log_time(ss_time, t0, t1, false);
+
+  OperationTimings timings = run_ops(timing_config);
+  log_means(ss_time, timings);
+  log_stats(ss_stats, context, timings);
+
+  // level-dependent operations only go into the statistics file
+  log_stats(ss_stats, context, run_level_ops(timing_config));
 
   // write ss_time into file
   std::ofstream myfile;
@@ -321,12 +386,134 @@ void Microbenchmark::run_benchmark() {
   myfile << ss_time.str() << std::endl;
   myfile.close();
 
+  // write per-operation statistics into file
+  std::ofstream stats_file =
+      open_stats_file("microbenchmark_ckks_stats.csv", stats_header);
+  stats_file << ss_stats.str();
+  stats_file.close();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_microbenchmark_ckks.txt");
 }
 
+void Microbenchmark::run_sweep() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+
+  // ring dimensions x coefficient modulus chains, where an empty chain stands
+  // for SEAL's default (128-bit secure) chain; the multiplications rescale,
+  // hence each chain needs at least two primes besides the special prime
+  auto grid = parameter_grid({4096, 8192, 16384, 32768},
+                             {{}, {40, 30, 40}, {60, 40, 60},
+                              {60, 40, 40, 40, 40, 60},
+                              {60, 40, 40, 40, 40, 40, 40, 40, 40, 60}},
+                             {});
+
+  std::ofstream sweep_file = open_csv_file(
+      "SWEEP_FILENAME", "microbenchmark_ckks_sweep.csv",
+      parameters_csv_header() +
+          ",t_keygen,t_mul_ct_ct,t_mul_ct_ct_inplace,t_mul_ct_pt,"
+          "t_mul_ct_pt_inplace,t_add_ct_ct,t_add_ct_ct_inplace,t_add_ct_pt,"
+          "t_add_ct_pt_inplace,t_enc_sk,t_enc_pk,t_dec,t_rot");
+  std::ofstream stats_file =
+      open_stats_file("microbenchmark_ckks_stats.csv", stats_header);
+
+  for (auto &parameters : grid) {
+    std::stringstream ss_time;
+    std::stringstream ss_stats;
+    try {
+      auto t0 = Time::now();
+      setup_context_ckks(parameters);
+      auto t1 = Time::now();
+
+      OperationTimings timings = run_ops(timing_config);
+
+      write_parameters_csv(ss_time, context);
+      ss_time << ",";
+      log_time(ss_time, t0, t1, false);
+      log_means(ss_time, timings);
+      log_stats(ss_stats, context, timings);
+      log_stats(ss_stats, context, run_level_ops(timing_config));
+    } catch (std::exception &e) {
+      // e.g., insecure parameters or a chain too short for rescaling
+      std::cerr << "Skipping N=" << parameters.poly_modulus_degree << ": "
+                << e.what() << std::endl;
+      continue;
+    }
+    sweep_file << ss_time.str() << std::endl;
+    stats_file << ss_stats.str();
+  }
+}
+
+void Microbenchmark::run_throughput() {
+  const ThroughputConfig config = ThroughputConfig::from_env();
+
+  setup_context_ckks(65536);
+  seal::Plaintext ptxt;
+  encoder->encode(std::vector<double>{43, 23, 54, 31, 341, 43, 34},
+                  initial_scale, ptxt);
+
+  // the output ciphertext is overwritten by every repetition, so that the
+  // inputs stay fresh and no per-operation setup is needed
+  std::vector<std::pair<std::string, std::function<void(WorkerState &)>>>
+      operations = {
+      {"t_mul_ct_ct",
+       [&](WorkerState &s) {
+         evaluator->multiply(s.ctxtA, s.ctxtB, s.ctxtC, s.pool);
+         evaluator->relinearize_inplace(s.ctxtC, *relinKeys, s.pool);
+         evaluator->rescale_to_next_inplace(s.ctxtC, s.pool);
+       }},
+      {"t_add_ct_ct",
+       [&](WorkerState &s) { evaluator->add(s.ctxtA, s.ctxtB, s.ctxtC); }},
+      {"t_enc_pk",
+       [&](WorkerState &s) { encryptor->encrypt(s.ptxt, s.ctxtC, s.pool); }},
+      {"t_rot",
+       [&](WorkerState &s) {
+         evaluator->rotate_vector(s.ctxtA, 4, *galoisKeys, s.ctxtC, s.pool);
+       }},
+      };
+
+  std::ofstream throughput_file = open_csv_file(
+      "THROUGHPUT_FILENAME", "microbenchmark_ckks_throughput.csv",
+      parameters_csv_header() + ",operation,memory_pool," +
+          throughput_header());
+
+  for (auto &operation : operations) {
+    // SEAL's global memory pool is shared (and locked) by all threads, which
+    // we compare against a dedicated pool per thread
+    for (bool per_thread_pool : {false, true}) {
+      ThroughputResult single_thread;
+      for (std::size_t k = 1; k <= config.max_threads; ++k) {
+        auto result = measure_throughput(k, config.seconds, [&](std::size_t) {
+          auto state = std::make_shared<WorkerState>(
+              per_thread_pool ? seal::MemoryPoolHandle::New()
+                              : seal::MemoryManager::GetPool());
+          encryptor->encrypt(ptxt, state->ctxtA, state->pool);
+          encryptor->encrypt(ptxt, state->ctxtB, state->pool);
+          state->ptxt = ptxt;
+          auto &op = operation.second;
+          return [state, &op]() { op(*state); };
+        });
+        if (k == 1) single_thread = result;
+
+        write_parameters_csv(throughput_file, context);
+        throughput_file << "," << operation.first << ","
+                        << (per_thread_pool ? "per_thread" : "global") << ",";
+        write_throughput(throughput_file, result,
+                         scaling_efficiency(result, single_thread));
+        throughput_file << std::endl;
+      }
+    }
+  }
+}
+
 int main(int argc, char *argv[]) {
   std::cout << "Starting 'microbenchmark-ckks'..." << std::endl;
-  Microbenchmark().run_benchmark();
+  if (has_flag(argc, argv, "--sweep")) {
+    Microbenchmark().run_sweep();
+  } else if (has_flag(argc, argv, "--throughput")) {
+    Microbenchmark().run_throughput();
+  } else {
+    Microbenchmark().run_benchmark();
+  }
   return 0;
 }
@@ -17,6 +17,10 @@
 #include <random>
 #include <vector>
 
+#include "../sweep.h"
+#include "../throughput.h"
+#include "../timing.h"
+
 typedef std::vector<seal::Ciphertext> CiphertextVector;
 typedef std::chrono::high_resolution_clock Time;
 typedef std::chrono::milliseconds ms;
@@ -62,10 +66,32 @@ class Microbenchmark {
   
   seal::Ciphertext encode_and_encrypt(double numbers);
 
+  /// Creates the context, keys, and helper objects for the given parameters.
+  void setup_keys(const seal::EncryptionParameters &params);
+
+  /// Times all operations of the op table on the current context.
+  OperationTimings run_ops(const TimingConfig &timing_config);
+
+  /// Times multiplication, rotations, rescaling, modulus switching, and NTT
+  /// transforms at every level of the modulus chain.
+  OperationTimings run_level_ops(const TimingConfig &timing_config);
+
  public:
   void setup_context_ckks(std::size_t poly_modulus_degree);
 
+  /// Sets up the context for one point of the parameter sweep.
+  void setup_context_ckks(const ParameterSet &parameters);
+
   void run_benchmark();
 
+  /// Runs the full op table once for each point of the parameter grid and
+  /// writes one result row per configuration (enabled by --sweep).
+  void run_sweep();
+
+  /// Runs selected operations concurrently on K = 1..max_threads threads that
+  /// share the context and keys, and writes ops/sec and scaling efficiency
+  /// per thread count (enabled by --throughput).
+  void run_throughput();
+
   int main(int argc, char *argv[]);
 };
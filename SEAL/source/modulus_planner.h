@@ -0,0 +1,173 @@
+#ifndef MODULUS_PLANNER_H_
+#define MODULUS_PLANNER_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sweep.h"
+
+/*
+ * Planner for the smallest BFV encryption parameters that a circuit still
+ * decrypts correctly with, instead of a manual search over coefficient
+ * moduli (see CardioBatched::setup_context_bfv).
+ *
+ * SEAL has no symbolic noise estimation, so the planner measures the noise:
+ * for each ring degree (smallest first), the circuit is run once with the
+ * largest secure coefficient modulus (the probe). The noise of BFV grows
+ * (almost) independently of the coefficient modulus q, hence the noise budget
+ * left at the outputs of the probe is by how many bits q can shrink. The
+ * planner keeps margin_bits of it to cover the variance of the noise, rounds
+ * the remaining bits up to a chain of equally sized primes and verifies the
+ * chain with a second run. If that run fails, the chain grows by step_bits
+ * until it succeeds or is as large as the probe, which is used then. Only if
+ * the probe itself fails, the next ring degree is tried.
+ *
+ * The smallest ring degree wins, even if a larger one allowed a smaller q,
+ * as the latency of all operations grows at least linearly with the degree.
+ */
+
+/// Outcome of running the circuit once.
+struct CircuitTrial {
+  /// whether all outputs decrypted to the expected values
+  bool correct = false;
+
+  /// noise budget of a freshly encrypted input (bits)
+  int fresh_noise_budget = 0;
+
+  /// remaining noise budget of each output ciphertext (bits)
+  std::vector<int> output_noise_budgets;
+
+  /// Budget of the noisiest output, 0 if there are no outputs.
+  int min_output_noise_budget() const {
+    if (output_noise_budgets.empty()) return 0;
+    return *std::min_element(output_noise_budgets.begin(),
+                             output_noise_budgets.end());
+  }
+
+  /// Noise budget consumed by the circuit (along its deepest path).
+  int consumed_noise_budget() const {
+    return fresh_noise_budget - min_output_noise_budget();
+  }
+
+  /// Correct and with noise budget to spare.
+  bool succeeded() const { return correct && min_output_noise_budget() > 0; }
+};
+
+/// A run of the circuit by the planner.
+struct PlannerStep {
+  ParameterSet parameters;
+
+  /// probe (largest secure modulus) or verification of a planned modulus
+  bool probe;
+
+  CircuitTrial trial;
+};
+
+struct ModulusPlan {
+  /// the selected parameters
+  ParameterSet parameters;
+
+  /// all runs of the circuit, including the one that verified the selected
+  /// parameters
+  std::vector<PlannerStep> steps;
+};
+
+/// Total bit count of a coefficient modulus chain.
+inline int total_bits(const std::vector<int> &bit_sizes) {
+  return std::accumulate(bit_sizes.begin(), bit_sizes.end(), 0);
+}
+
+/// A chain of equally sized primes (at most 60 bits each) with at least
+/// data_bits bits, followed by a special prime of the same size that is only
+/// used for key switching.
+inline std::vector<int> chain_bit_sizes(int data_bits) {
+  // smaller primes would bring q close to the plaintext modulus
+  const int min_prime_bits = 30;
+  const int num_primes = std::max(1, (data_bits + 59) / 60);
+  const int prime_bits =
+      std::max(min_prime_bits, (data_bits + num_primes - 1) / num_primes);
+  return std::vector<int>(num_primes + 1, prime_bits);
+}
+
+/// The largest secure chain of equally sized primes for the ring degree.
+inline std::vector<int> max_chain_bit_sizes(
+    std::size_t poly_modulus_degree,
+    seal::sec_level_type sec_level = seal::sec_level_type::tc128) {
+  const int max_bits =
+      seal::CoeffModulus::MaxBitCount(poly_modulus_degree, sec_level);
+  const int num_primes = std::max(2, (max_bits + 59) / 60);
+  return std::vector<int>(num_primes, max_bits / num_primes);
+}
+
+class ModulusPlanner {
+ public:
+  /// Sets up the given parameters and runs the circuit once.
+  typedef std::function<CircuitTrial(const ParameterSet &)> Circuit;
+
+  ModulusPlanner(Circuit circuit, int plain_modulus_bits, int margin_bits = 10,
+                 int step_bits = 10)
+      : circuit(std::move(circuit)),
+        plain_modulus_bits(plain_modulus_bits),
+        margin_bits(margin_bits),
+        step_bits(step_bits) {
+    if (step_bits <= 0) {
+      throw std::invalid_argument("step_bits must be positive");
+    }
+  }
+
+  /// Smallest secure parameters with the first of the given ring degrees
+  /// that the circuit succeeds with. Throws if there are none.
+  ModulusPlan plan(const std::vector<std::size_t> &poly_modulus_degrees = {
+                       4096, 8192, 16384, 32768}) {
+    ModulusPlan plan;
+    for (std::size_t degree : poly_modulus_degrees) {
+      const std::vector<int> probe = max_chain_bit_sizes(degree);
+      const CircuitTrial probe_trial = run(plan, degree, probe, true);
+      if (!probe_trial.succeeded()) continue;
+      const ParameterSet probe_parameters = plan.steps.back().parameters;
+
+      // the budget beyond the margin is not needed, nor is the special prime
+      int data_bits = total_bits(probe) - probe.back() -
+                      probe_trial.min_output_noise_budget() + margin_bits;
+      for (;;) {
+        const std::vector<int> bits = chain_bit_sizes(data_bits);
+        if (total_bits(bits) >= total_bits(probe)) {
+          // no smaller chain, the probe is verified already
+          plan.parameters = probe_parameters;
+          return plan;
+        }
+        if (run(plan, degree, bits, false).succeeded()) {
+          plan.parameters = plan.steps.back().parameters;
+          return plan;
+        }
+        data_bits += step_bits;
+      }
+    }
+    throw std::runtime_error(
+        "circuit does not decrypt correctly with any secure parameters");
+  }
+
+ private:
+  CircuitTrial run(ModulusPlan &plan, std::size_t poly_modulus_degree,
+                   const std::vector<int> &bits, bool probe) {
+    PlannerStep step;
+    step.parameters = {poly_modulus_degree, bits, plain_modulus_bits};
+    step.probe = probe;
+    step.trial = circuit(step.parameters);
+    plan.steps.push_back(std::move(step));
+    return plan.steps.back().trial;
+  }
+
+  Circuit circuit;
+  int plain_modulus_bits;
+  int margin_bits;
+  int step_bits;
+};
+
+#endif
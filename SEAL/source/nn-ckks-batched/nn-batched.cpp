@@ -1,37 +1,17 @@
 #include "nn-batched.h"
 #include "../common.h"
+#include "../key_store.h"
+#include "../targets.h"
+#include "../timing.h"
 #include "matrix_vector_crypto.h"
 
-/// Create only the required power-of-two rotations
-/// This can save quite a bit, for example for poly_modulus_degree = 16384
-/// The default galois keys (with zlib compression) are 247 MB large
-/// Whereas with dimension = 256, they are only 152 MB
-/// For poly_modulus_degree = 32768, the default keys are 532 MB large
-/// while with dimension = 256, they are only 304 MB
-std::vector<int> custom_steps(size_t dimension) {
-  if (dimension==256) {
-    // Slight further optimization: No -128, no -256
-    return {1, -1, 2, -2, 4, -4, 8, -8, 16, -16, 32, -32, 64, -64, 128, 256};
-  } else {
-    std::vector<int> steps{};
-    for (int i = 1; i <= dimension; i <<= 1) {
-      steps.push_back(i);
-      steps.push_back(-i);
-    }
-    return steps;
-  }
-}
-
 /*
  * Batched CKKS implementation for nn benchmark.
  */
 
-void NNBatched::setup_context_ckks(std::size_t poly_modulus_degree) {
-  seal::EncryptionParameters params(seal::scheme_type::CKKS);
-  params.set_poly_modulus_degree(poly_modulus_degree);
-  params.set_coeff_modulus(seal::CoeffModulus::Create(
-      poly_modulus_degree,
-      {60, 40, 40, 40, 40, 40,  40, 40, 60}));
+void NNBatched::setup_context_ckks() {
+  const TargetParameters &target = target_parameters("nn_ckks_batched");
+  seal::EncryptionParameters params = target.encryption_parameters();
 
   // Instantiate context
   context = seal::SEALContext::Create(params);
@@ -39,32 +19,17 @@ void NNBatched::setup_context_ckks(std::size_t poly_modulus_degree) {
   // Define initial ciphertext scale
   initial_scale = std::pow(2.0, 40);
 
-  // Create keys
-  seal::KeyGenerator keyGenerator(context);
-
-  publicKey = std::make_unique<seal::PublicKey>(keyGenerator.public_key());
-  // std::ofstream ofs_pk("public_key.dat", std::ios::binary);
-  // publicKey->save(ofs_pk);
-  // ofs_pk.close();
-
-  secretKey = std::make_unique<seal::SecretKey>(keyGenerator.secret_key());
-  // std::ofstream ofs_sk("secret_key.dat", std::ios::binary);
-  // secretKey->save(ofs_sk);
-  // ofs_sk.close();
-
-  relinKeys =
-      std::make_unique<seal::RelinKeys>(keyGenerator.relin_keys_local());
-  // std::ofstream ofs_rk("relin_keys.dat", std::ios::binary);
-  // relinKeys->save(ofs_rk);
-  // ofs_rk.close();
-
-  // Only generate those keys that are actually required/used
-  std::vector<int> steps = custom_steps(1024);
-  galoisKeys =
-      std::make_unique<seal::GaloisKeys>(keyGenerator.galois_keys_local(steps));
-  // std::ofstream ofs_gk("galois_keys.dat", std::ios::binary);
-  // galoisKeys->save(ofs_gk);
-  // ofs_gk.close();
+  // Create keys, or load them from the key store (KEY_STORE_DIR). Only
+  // generate those keys that are actually required/used
+  KeyRequest key_request;
+  key_request.galois_keys = true;
+  key_request.galois_steps = target.rotation_steps;
+  KeySet keys = KeyStore::from_env().get(context, key_request);
+  keysLoaded = keys.loaded;
+  publicKey = std::move(keys.public_key);
+  secretKey = std::move(keys.secret_key);
+  relinKeys = std::move(keys.relin_keys);
+  galoisKeys = std::move(keys.galois_keys);
 
   // Provide both public and secret key, however, we will use public-key
   // encryption as this is the one used in a typical client-server scenario.
@@ -122,16 +87,16 @@ void log_time(std::stringstream &ss,
 
 void NNBatched::run_nn() {
   std::stringstream ss_time;
+  // allocation statistics per phase, only collected if MEMORY_PROFILE is set
+  PhaseProfiler phase_profiler;
 
+  phase_profiler.begin();
   auto t0 = Time::now();
-  // poly_modulus_degree:
-  // - must be a power of two
-  // - determines the number of ciphertext slots
-  // - determines the max. of the sum of coeff_moduli bits
-  setup_context_ckks(16384);
+  setup_context_ckks();
 
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  phase_profiler.end("t_keygen");
+  ss_time << KeyStore::keygen_column(keysLoaded, t1 - t0) << ",";
 
   // === client-side computation ====================================
 
@@ -149,16 +114,19 @@ void NNBatched::run_nn() {
   // encode and encrypt the input
   // We duplicate because we require rotations to work consistently
   // (see documentation of fast mvp method)
+  phase_profiler.begin();
   auto t2 = Time::now();
   seal::Ciphertext image_ctxt = encode_and_encrypt(duplicate(image));
 
   auto t3 = Time::now();
+  phase_profiler.end("t_input_encryption");
   log_time(ss_time, t2, t3, false);
 
   // // transmit data to server...
 
   // // === server-side computation ====================================
 
+  phase_profiler.begin();
   auto t4 = Time::now();
 
   // Create the Weights and Biases for the first dense layer
@@ -232,9 +200,11 @@ void NNBatched::run_nn() {
   // No rescale or relinearize here, as we're done with the computation
 
   auto t5 = Time::now();
+  phase_profiler.end("t_computation");
   log_time(ss_time, t4, t5, false);
 
   // // === retrieve final result ====================================
+  phase_profiler.begin();
   auto t6 = Time::now();
   seal::Plaintext p;
   decryptor->decrypt(result, p);
@@ -246,6 +216,7 @@ void NNBatched::run_nn() {
     std::cout << (double) dec[i] << std::endl;
   }
   auto t7 = Time::now();
+  phase_profiler.end("t_decryption");
   log_time(ss_time, t6, t7, true);
 
   // write ss_time into file
@@ -258,6 +229,22 @@ void NNBatched::run_nn() {
       std::ifstream::badbit);
   myfile << ss_time.str() << std::endl;
 
+  // write allocation statistics per phase into file
+  if (phase_profiler.is_enabled()) {
+    std::ofstream memory_file = open_csv_file(
+        "MEMORY_FILENAME", "memory_nn_batched.csv", PhaseProfiler::header());
+    phase_profiler.write_csv(memory_file);
+  }
+
+  // write a self-describing record of this run into RESULTS_FILENAME
+  ResultRecord record("nn-ckks-batched");
+  add_encryption_parameters(record, context);
+  record.add_timing(KeyStore::timing_name(keysLoaded), t1 - t0);
+  record.add_timing("t_input_encryption", t3 - t2);
+  record.add_timing("t_computation", t5 - t4);
+  record.add_timing("t_decryption", t7 - t6);
+  record.write();
+
   // write FHE parameters into file
   write_parameters_to_file(context, "fhe_parameters_nn.txt");
 }
@@ -41,6 +41,9 @@ class NNBatched {
   /// keys required to relinearize after multipliction (ptr for consistency)
   std::unique_ptr<seal::RelinKeys> relinKeys;
 
+  /// whether the keys were loaded from the key store instead of generated
+  bool keysLoaded = false;
+
   std::unique_ptr<seal::Encryptor> encryptor;
   std::unique_ptr<seal::Evaluator> evaluator;
   std::unique_ptr<seal::Decryptor> decryptor;
@@ -51,7 +54,8 @@ class NNBatched {
   void internal_print_info(std::string variable_name, seal::Ciphertext &ctxt);
 
  public:
-  void setup_context_ckks(std::size_t poly_modulus_degree);
+  /// The parameters and rotation steps of nn_ckks_batched in targets.h
+  void setup_context_ckks();
 
   void run_nn();
 
@@ -87,12 +91,5 @@ class DenseLayer {
   /// Get size of input
   size_t input_size();
 };
-/// Create only the required power-of-two rotations
-/// This can save quite a bit, for example for poly_modulus_degree = 16384
-/// The default galois keys (with zlib compression) are 247 MB large
-/// Whereas with dimension = 256, they are only 152 MB
-/// For poly_modulus_degree = 32768, the default keys are 532 MB large
-/// while with dimension = 256, they are only 304 MB
-std::vector<int> custom_steps(size_t dimension);
 
 int main(int argc, char *argv[]);
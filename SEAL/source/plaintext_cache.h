@@ -0,0 +1,195 @@
+#ifndef PLAINTEXT_CACHE_H_
+#define PLAINTEXT_CACHE_H_
+
+#include <seal/seal.h>
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+/*
+ * Cache of encoded plaintext constants (masks, weights, constant vectors)
+ * used by the server side of the benchmarks. Entries are keyed by (values,
+ * parms_id, scale), so each distinct constant is encoded only once per run.
+ *
+ * BFV constants are available in three forms:
+ *  - batch():     as encoded, for add_plain/sub_plain and multiply_plain with
+ *                 a ciphertext in normal form,
+ *  - constant():  a value in all slots as the constant polynomial it encodes
+ *                 to, without running the batch encoder,
+ *  - batch_ntt(): in NTT form at the given parms_id, for multiply_plain with
+ *                 a ciphertext in NTT form (see multiply_plain_ntt()), which
+ *                 skips the per-multiplication NTT of the plaintext.
+ * CKKS plaintexts are in NTT form anyway.
+ */
+class PlaintextCache {
+ public:
+  explicit PlaintextCache(std::shared_ptr<seal::SEALContext> context)
+      : context(context), evaluator(context) {}
+
+  const seal::Plaintext &batch(const std::vector<std::uint64_t> &values) {
+    return lookup(Key(BATCH_UNSIGNED, seal::parms_id_zero, 0.0,
+                      to_key_values(values)),
+                  [&](seal::Plaintext &ptxt) {
+                    batch_encoder().encode(values, ptxt);
+                  });
+  }
+
+  const seal::Plaintext &batch(const std::vector<std::int64_t> &values) {
+    return lookup(Key(BATCH_SIGNED, seal::parms_id_zero, 0.0,
+                      to_key_values(values)),
+                  [&](seal::Plaintext &ptxt) {
+                    batch_encoder().encode(values, ptxt);
+                  });
+  }
+
+  const seal::Plaintext &batch_ntt(const std::vector<std::uint64_t> &values,
+                                   seal::parms_id_type parms_id) {
+    return lookup(
+        Key(BATCH_UNSIGNED_NTT, parms_id, 0.0, to_key_values(values)),
+        [&](seal::Plaintext &ptxt) {
+          batch_encoder().encode(values, ptxt);
+          evaluator.transform_to_ntt_inplace(ptxt, parms_id);
+        });
+  }
+
+  const seal::Plaintext &batch_ntt(const std::vector<std::int64_t> &values,
+                                   seal::parms_id_type parms_id) {
+    return lookup(Key(BATCH_SIGNED_NTT, parms_id, 0.0, to_key_values(values)),
+                  [&](seal::Plaintext &ptxt) {
+                    batch_encoder().encode(values, ptxt);
+                    evaluator.transform_to_ntt_inplace(ptxt, parms_id);
+                  });
+  }
+
+  /// Encodes the value into all slots, i.e., as the constant polynomial
+  /// value mod t, which multiply_plain takes on SEAL's fast path for
+  /// monomials.
+  const seal::Plaintext &constant(std::int64_t value) {
+    return lookup(Key(BFV_CONSTANT, seal::parms_id_zero, 0.0,
+                      to_key_values(std::vector<std::int64_t>{value})),
+                  [&](seal::Plaintext &ptxt) {
+                    const std::uint64_t t = context->first_context_data()
+                                                ->parms()
+                                                .plain_modulus()
+                                                .value();
+                    const std::uint64_t magnitude =
+                        value < 0 ? 0 - static_cast<std::uint64_t>(value)
+                                  : static_cast<std::uint64_t>(value);
+                    ptxt.resize(1);
+                    ptxt[0] = value < 0 ? (t - magnitude % t) % t
+                                        : magnitude % t;
+                  });
+  }
+
+  const seal::Plaintext &ckks(const std::vector<double> &values,
+                              seal::parms_id_type parms_id, double scale) {
+    return lookup(Key(CKKS_VECTOR, parms_id, scale, to_key_values(values)),
+                  [&](seal::Plaintext &ptxt) {
+                    ckks_encoder().encode(values, parms_id, scale, ptxt);
+                  });
+  }
+
+  /// Encodes the value into all slots.
+  const seal::Plaintext &ckks(double value, seal::parms_id_type parms_id,
+                              double scale) {
+    return lookup(Key(CKKS_SCALAR, parms_id, scale,
+                      to_key_values(std::vector<double>{value})),
+                  [&](seal::Plaintext &ptxt) {
+                    ckks_encoder().encode(value, parms_id, scale, ptxt);
+                  });
+  }
+
+  std::size_t hits() const { return num_hits; }
+
+  std::size_t misses() const { return entries.size(); }
+
+ private:
+  enum Encoding {
+    BATCH_UNSIGNED,
+    BATCH_SIGNED,
+    BATCH_UNSIGNED_NTT,
+    BATCH_SIGNED_NTT,
+    BFV_CONSTANT,
+    CKKS_VECTOR,
+    CKKS_SCALAR
+  };
+
+  /// (encoding, parms_id, scale, values as raw 64-bit words)
+  typedef std::tuple<Encoding, seal::parms_id_type, double,
+                     std::vector<std::uint64_t>>
+      Key;
+
+  template <typename T>
+  static std::vector<std::uint64_t> to_key_values(
+      const std::vector<T> &values) {
+    static_assert(sizeof(T) == sizeof(std::uint64_t), "64-bit values only");
+    std::vector<std::uint64_t> key_values(values.size());
+    if (!values.empty()) {
+      std::memcpy(key_values.data(), values.data(),
+                  values.size() * sizeof(std::uint64_t));
+    }
+    return key_values;
+  }
+
+  template <typename Encode>
+  const seal::Plaintext &lookup(Key key, Encode encode) {
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+      num_hits++;
+      return it->second;
+    }
+    seal::Plaintext &ptxt = entries[std::move(key)];
+    encode(ptxt);
+    return ptxt;
+  }
+
+  // encoders are created on first use, as BatchEncoder requires a BFV
+  // context with batching and CKKSEncoder a CKKS context
+  seal::BatchEncoder &batch_encoder() {
+    if (!batchEncoder) {
+      batchEncoder = std::make_unique<seal::BatchEncoder>(context);
+    }
+    return *batchEncoder;
+  }
+
+  seal::CKKSEncoder &ckks_encoder() {
+    if (!ckksEncoder) {
+      ckksEncoder = std::make_unique<seal::CKKSEncoder>(context);
+    }
+    return *ckksEncoder;
+  }
+
+  std::shared_ptr<seal::SEALContext> context;
+  seal::Evaluator evaluator;
+  std::unique_ptr<seal::BatchEncoder> batchEncoder;
+  std::unique_ptr<seal::CKKSEncoder> ckksEncoder;
+
+  /// std::map, as references to its elements stay valid on insertion
+  std::map<Key, seal::Plaintext> entries;
+  std::size_t num_hits = 0;
+};
+
+/// Transforms a (BFV) ciphertext into NTT form, e.g., once before it is
+/// multiplied with several plaintexts from PlaintextCache::batch_ntt().
+inline seal::Ciphertext to_ntt(seal::Evaluator &evaluator,
+                               const seal::Ciphertext &encrypted) {
+  seal::Ciphertext encrypted_ntt;
+  evaluator.transform_to_ntt(encrypted, encrypted_ntt);
+  return encrypted_ntt;
+}
+
+/// destination = encrypted_ntt * plain_ntt, in normal (non-NTT) form. Both
+/// inputs must be in NTT form at the same parms_id.
+inline void multiply_plain_ntt(seal::Evaluator &evaluator,
+                               const seal::Ciphertext &encrypted_ntt,
+                               const seal::Plaintext &plain_ntt,
+                               seal::Ciphertext &destination) {
+  evaluator.multiply_plain(encrypted_ntt, plain_ntt, destination);
+  evaluator.transform_from_ntt_inplace(destination);
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "serialization.h"
+
+#include "../common.h"
+
+void SerializationBenchmark::setup_context(const TargetParameters &target) {
+  // Instantiate context
+  context = seal::SEALContext::Create(target.encryption_parameters());
+  if (!context->parameters_set()) {
+    throw std::invalid_argument(context->parameter_error_message());
+  }
+
+  // Create keys
+  keyGenerator = std::make_unique<seal::KeyGenerator>(context);
+  publicKey = std::make_unique<seal::PublicKey>(keyGenerator->public_key());
+  secretKey = std::make_unique<seal::SecretKey>(keyGenerator->secret_key());
+  encryptor =
+      std::make_unique<seal::Encryptor>(context, *publicKey, *secretKey);
+}
+
+seal::Plaintext SerializationBenchmark::encode_ones(seal::scheme_type scheme) {
+  seal::Plaintext ptxt;
+  if (scheme == seal::scheme_type::BFV) {
+    seal::BatchEncoder encoder(context);
+    std::vector<std::uint64_t> ones(encoder.slot_count(), 1);
+    encoder.encode(ones, ptxt);
+  } else {
+    seal::CKKSEncoder encoder(context);
+    std::vector<double> ones(encoder.slot_count(), 1.0);
+    encoder.encode(ones, std::pow(2.0, 40), ptxt);
+  }
+  return ptxt;
+}
+
+namespace {
+struct CompressionMode {
+  std::string name;
+  seal::compr_mode_type mode;
+};
+
+/// All compression modes that SEAL was built with.
+std::vector<CompressionMode> compression_modes() {
+  return {
+      {"none", seal::compr_mode_type::none},
+#ifdef SEAL_USE_ZLIB
+      {"zlib", seal::compr_mode_type::zlib},
+#endif
+#ifdef SEAL_USE_ZSTD
+      {"zstd", seal::compr_mode_type::zstd},
+#endif
+  };
+}
+
+void write_row(std::ostream &os, const std::string &target,
+               std::shared_ptr<seal::SEALContext> context,
+               const std::string &object, bool seeded,
+               const std::string &compr_mode, const std::string &direction,
+               std::size_t bytes, const TimingStats &stats) {
+  os << target << ",";
+  write_parameters_csv(os, context);
+  os << "," << object << "," << seeded << "," << compr_mode << ","
+     << direction << "," << bytes << ",";
+  write_timing_stats(os, stats);
+  os << std::endl;
+}
+
+// Times object.save() for each compression mode and T::load() of the result.
+// For seeded objects (Serializable<T>), load() includes expanding the seed.
+template <typename T, typename Object>
+void benchmark_object(std::ostream &os, const TimingConfig &config,
+                      const std::string &target,
+                      std::shared_ptr<seal::SEALContext> context,
+                      const std::string &name, bool seeded,
+                      const Object &object) {
+  for (auto &compression : compression_modes()) {
+    // save_size() is an upper bound on the size of the compressed output
+    std::vector<std::byte> buffer(
+        static_cast<std::size_t>(object.save_size(compression.mode)));
+    std::size_t bytes = 0;
+    TimingStats save_stats = measure(config, [&]() {
+      bytes = static_cast<std::size_t>(
+          object.save(buffer.data(), buffer.size(), compression.mode));
+    });
+
+    T loaded;
+    TimingStats load_stats = measure(config, [&]() {
+      loaded.load(context, buffer.data(), bytes);
+    });
+
+    std::cout << "  " << name << (seeded ? " (seeded)" : "") << ", "
+              << compression.name << ": " << bytes << " bytes" << std::endl;
+    write_row(os, target, context, name, seeded, compression.name, "save",
+              bytes, save_stats);
+    write_row(os, target, context, name, seeded, compression.name, "load",
+              bytes, load_stats);
+  }
+}
+}  // namespace
+
+void SerializationBenchmark::run_benchmark() {
+  const TimingConfig timing_config = TimingConfig::from_env();
+  std::ofstream file = open_csv_file(
+      "OUTPUT_FILENAME", "serialization.csv",
+      "target," + parameters_csv_header() +
+          ",object,seeded,compr_mode,direction,bytes," +
+          timing_stats_header());
+
+  for (auto &target : target_parameter_sets()) {
+    std::cout << "Target: " << target.name << std::endl;
+    setup_context(target);
+    seal::Plaintext ptxt = encode_ones(target.scheme);
+
+    // Objects as they are kept in memory, i.e., with both polynomials
+    benchmark_object<seal::PublicKey>(file, timing_config, target.name,
+                                      context, "public_key", false,
+                                      *publicKey);
+    benchmark_object<seal::RelinKeys>(file, timing_config, target.name,
+                                      context, "relin_keys", false,
+                                      keyGenerator->relin_keys_local());
+    benchmark_object<seal::GaloisKeys>(
+        file, timing_config, target.name, context, "galois_keys", false,
+        keyGenerator->galois_keys_local(target.rotation_steps));
+
+    seal::Ciphertext ctxt;
+    encryptor->encrypt(ptxt, ctxt);
+    benchmark_object<seal::Ciphertext>(file, timing_config, target.name,
+                                       context, "ciphertext_pk", false, ctxt);
+    encryptor->encrypt_symmetric(ptxt, ctxt);
+    benchmark_object<seal::Ciphertext>(file, timing_config, target.name,
+                                       context, "ciphertext_sk", false, ctxt);
+
+    // Seeded objects replace the uniformly random polynomial by the seed it
+    // was generated from, which roughly halves their size. SEAL only offers
+    // this for objects created with the secret key, hence not for the public
+    // key or public-key encryptions.
+    benchmark_object<seal::RelinKeys>(file, timing_config, target.name,
+                                      context, "relin_keys", true,
+                                      keyGenerator->relin_keys());
+    benchmark_object<seal::GaloisKeys>(
+        file, timing_config, target.name, context, "galois_keys", true,
+        keyGenerator->galois_keys(target.rotation_steps));
+    benchmark_object<seal::Ciphertext>(file, timing_config, target.name,
+                                       context, "ciphertext_sk", true,
+                                       encryptor->encrypt_symmetric(ptxt));
+  }
+}
+
+int main() {
+  std::cout << "Starting 'serialization'..." << std::endl;
+  SerializationBenchmark().run_benchmark();
+  return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef SERIALIZATION_H_
+#define SERIALIZATION_H_
+#endif
+
+#include <seal/seal.h>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../targets.h"
+#include "../timing.h"
+
+/*
+ * Measures save/load time and the serialized (wire) size of keys and
+ * ciphertexts, i.e., what a client and server exchange, for the parameters of
+ * the application targets and each compression mode SEAL was built with.
+ *
+ * Objects are (de)serialized from/to a preallocated byte buffer, so that the
+ * results do not include disk or stream overhead.
+ */
+class SerializationBenchmark {
+ private:
+  /// the seal context, i.e. object that holds params/etc
+  std::shared_ptr<seal::SEALContext> context;
+
+  std::unique_ptr<seal::KeyGenerator> keyGenerator;
+
+  // secret key, also used for (seeded) symmetric encryption
+  std::unique_ptr<seal::SecretKey> secretKey;
+
+  /// public key (ptr because PublicKey() segfaults)
+  std::unique_ptr<seal::PublicKey> publicKey;
+
+  std::unique_ptr<seal::Encryptor> encryptor;
+
+  /// Creates the context and the keys required to create the other objects.
+  void setup_context(const TargetParameters &target);
+
+  /// Encodes a vector of ones, i.e., a fully populated plaintext.
+  seal::Plaintext encode_ones(seal::scheme_type scheme);
+
+ public:
+  /// Runs the benchmark for all targets and writes one row per object,
+  /// compression mode and direction (save/load).
+  void run_benchmark();
+};
@@ -0,0 +1,177 @@
+#ifndef SIGN_APPROX_H_
+#define SIGN_APPROX_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "lazy_relin.h"
+#include "plaintext_cache.h"
+
+/*
+ * Comparison of CKKS-encoded real values with a composite polynomial
+ * approximation of sign(x) on [-1, 1], see Cheon et al., "Efficient
+ * Homomorphic Comparison Methods with Optimal Complexity" (ASIACRYPT 2020).
+ *
+ * sign_inplace() first applies the degree-7 polynomial g_3 g_steps times,
+ * which moves small inputs away from 0 by a factor of about 4.5 per step, and
+ * then the degree-7 polynomial f_3 f_steps times, which pulls values close to
+ * +-1 onto them. Each step consumes 3 levels and 6 ciphertext
+ * multiplications, so the number of steps trades accuracy for latency (and
+ * modulus size). With the defaults (4 g-steps, 1 f-step), inputs with
+ * |x| >= 2^-9, e.g., the difference of two 8-bit integers scaled by 2^-8 and
+ * shifted by 2^-9 (to separate x < y from x == y), end up within 0.025 of
+ * sign(x).
+ *
+ * Like the cardio benchmark, the evaluation resets the scale to the initial
+ * scale after each rescaling, which assumes primes close to that scale.
+ */
+
+/// Accuracy/latency knobs of the sign approximation.
+struct SignApproxConfig {
+  /// applications of g_3, determine the smallest |x| that is resolved
+  int g_steps = 4;
+
+  /// applications of f_3, determine how close the result gets to +-1
+  int f_steps = 1;
+
+  /// Levels consumed by sign_inplace().
+  int depth() const { return 3 * (g_steps + f_steps); }
+
+  std::string to_string() const {
+    return std::to_string(g_steps) + ":" + std::to_string(f_steps);
+  }
+
+  /// Parses "<g_steps>:<f_steps>", e.g., "4:1".
+  static SignApproxConfig parse(const std::string &str) {
+    SignApproxConfig config;
+    const auto colon = str.find(':');
+    if (colon == std::string::npos) {
+      throw std::invalid_argument("expected <g_steps>:<f_steps>: " + str);
+    }
+    config.g_steps = std::stoi(str.substr(0, colon));
+    config.f_steps = std::stoi(str.substr(colon + 1));
+    if (config.g_steps < 0 || config.f_steps < 0 ||
+        config.g_steps + config.f_steps == 0) {
+      throw std::invalid_argument("invalid number of sign steps: " + str);
+    }
+    return config;
+  }
+};
+
+class SignApprox {
+ public:
+  SignApprox(std::shared_ptr<seal::SEALContext> context,
+             seal::Evaluator &evaluator, LazyEvaluator &lazy_evaluator,
+             PlaintextCache &plaintext_cache, double scale,
+             SignApproxConfig config)
+      : context(std::move(context)),
+        evaluator(evaluator),
+        lazy_evaluator(lazy_evaluator),
+        plaintext_cache(plaintext_cache),
+        scale(scale),
+        config(config) {}
+
+  /// ctxt = factor * sign(ctxt) for values in [-1, 1]. The factor is folded
+  /// into the last polynomial, i.e., costs no level.
+  void sign_inplace(seal::Ciphertext &ctxt, double factor = 1.0) {
+    const int levels = static_cast<int>(level(ctxt));
+    if (levels < config.depth()) {
+      throw std::invalid_argument(
+          "sign approximation " + config.to_string() + " needs " +
+          std::to_string(config.depth()) + " levels, ciphertext has " +
+          std::to_string(levels));
+    }
+    const int steps = config.g_steps + config.f_steps;
+    for (int i = 0; i < steps; ++i) {
+      std::vector<double> coeffs(i < config.g_steps ? g3() : f3());
+      if (i == steps - 1) {
+        for (auto &c : coeffs) c *= factor;
+      }
+      odd_polynomial_inplace(ctxt, coeffs);
+    }
+  }
+
+  /// x = coeffs[0] x + coeffs[1] x^3 + coeffs[2] x^5 + coeffs[3] x^7 (at
+  /// most four coefficients), using 3 levels for degree 5 and 7. Each
+  /// coefficient is multiplied into x first, so that the constant
+  /// multiplications do not add to the depth.
+  void odd_polynomial_inplace(seal::Ciphertext &x,
+                              const std::vector<double> &coeffs) {
+    if (coeffs.empty() || coeffs.size() > 4) {
+      throw std::invalid_argument("odd polynomials of degree 1 to 7 only");
+    }
+
+    // powers of y = x^2
+    seal::Ciphertext y, y2;
+    if (coeffs.size() > 1) {
+      lazy_evaluator.multiply(x, x, y);
+      rescale(y);
+    }
+    if (coeffs.size() > 2) {
+      lazy_evaluator.multiply(y, y, y2);
+      rescale(y2);
+    }
+
+    std::vector<seal::Ciphertext> terms;
+    for (std::size_t k = 0; k < coeffs.size(); ++k) {
+      seal::Ciphertext term;
+      evaluator.multiply_plain(
+          x, plaintext_cache.ckks(coeffs[k], x.parms_id(), x.scale()), term);
+      rescale(term);
+      if (k == 1 || k == 3) {
+        lazy_evaluator.multiply_inplace(term, y);
+        rescale(term);
+      }
+      if (k == 2 || k == 3) {
+        evaluator.mod_switch_to_inplace(term, y2.parms_id());
+        lazy_evaluator.multiply_inplace(term, y2);
+        rescale(term);
+      }
+      terms.push_back(std::move(term));
+    }
+
+    // the terms of the highest degree are the deepest
+    x = std::move(terms.back());
+    for (std::size_t k = 0; k + 1 < terms.size(); ++k) {
+      evaluator.mod_switch_to_inplace(terms[k], x.parms_id());
+      evaluator.add_inplace(x, terms[k]);
+    }
+  }
+
+  /// Remaining levels of the ciphertext, i.e., its chain index.
+  std::size_t level(const seal::Ciphertext &ctxt) const {
+    return context->get_context_data(ctxt.parms_id())->chain_index();
+  }
+
+  /// g_3 of Cheon et al., coefficients of x, x^3, x^5, x^7.
+  static std::vector<double> g3() {
+    return {4589.0 / 1024, -16577.0 / 1024, 25614.0 / 1024,
+            -12860.0 / 1024};
+  }
+
+  /// f_3 of Cheon et al., coefficients of x, x^3, x^5, x^7.
+  static std::vector<double> f3() {
+    return {35.0 / 16, -35.0 / 16, 21.0 / 16, -5.0 / 16};
+  }
+
+ private:
+  void rescale(seal::Ciphertext &ctxt) {
+    evaluator.rescale_to_next_inplace(ctxt);
+    ctxt.scale() = scale;
+  }
+
+  std::shared_ptr<seal::SEALContext> context;
+  seal::Evaluator &evaluator;
+  LazyEvaluator &lazy_evaluator;
+  PlaintextCache &plaintext_cache;
+  double scale;
+  SignApproxConfig config;
+};
+
+#endif
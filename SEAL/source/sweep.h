@@ -0,0 +1,103 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include <seal/seal.h>
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Grid of encryption parameters for the parameter-sweep mode of the
+ * microbenchmarks. The default grid is given by the caller and can be
+ * overridden at runtime, so that no rebuild is required per data point:
+ *
+ *   SWEEP_POLY_MODULUS_DEGREES  e.g. "4096,8192,16384,32768"
+ *   SWEEP_COEFF_MODULI          e.g. "default,60:60:60:60,60:40:40:60"
+ *   SWEEP_PLAIN_MODULUS_BITS    e.g. "20,30" (ignored by CKKS)
+ *
+ * A coefficient modulus chain is written as the bit sizes of its primes
+ * separated by ':', or "default" for SEAL's BFVDefault(poly_modulus_degree).
+ */
+
+struct ParameterSet {
+  std::size_t poly_modulus_degree;
+
+  /// bit sizes of the coefficient modulus primes, empty = SEAL's default
+  std::vector<int> coeff_modulus_bits;
+
+  /// bit size of the (batching-compatible) plaintext modulus, 0 for CKKS
+  int plain_modulus_bits;
+
+  std::vector<seal::Modulus> coeff_modulus() const {
+    if (coeff_modulus_bits.empty()) {
+      return seal::CoeffModulus::BFVDefault(poly_modulus_degree);
+    }
+    return seal::CoeffModulus::Create(poly_modulus_degree, coeff_modulus_bits);
+  }
+};
+
+inline std::vector<std::string> split(const std::string &str, char delim) {
+  std::vector<std::string> tokens;
+  std::stringstream ss(str);
+  std::string token;
+  while (std::getline(ss, token, delim)) {
+    if (!token.empty()) tokens.push_back(token);
+  }
+  return tokens;
+}
+
+inline std::vector<int> parse_int_list(const std::string &str, char delim) {
+  std::vector<int> values;
+  for (auto &token : split(str, delim)) values.push_back(std::stoi(token));
+  return values;
+}
+
+inline std::vector<std::vector<int>> parse_coeff_moduli(const std::string &str) {
+  std::vector<std::vector<int>> chains;
+  for (auto &token : split(str, ',')) {
+    chains.push_back(token == "default" ? std::vector<int>()
+                                        : parse_int_list(token, ':'));
+  }
+  return chains;
+}
+
+/// Builds the cartesian product of the given (or env-overridden) values.
+/// Insecure or invalid combinations are not filtered here; the caller skips
+/// them once SEAL rejects the parameters.
+inline std::vector<ParameterSet> parameter_grid(
+    std::vector<int> poly_modulus_degrees,
+    std::vector<std::vector<int>> coeff_moduli,
+    std::vector<int> plain_modulus_bits) {
+  if (auto v = std::getenv("SWEEP_POLY_MODULUS_DEGREES")) {
+    poly_modulus_degrees = parse_int_list(v, ',');
+  }
+  if (auto v = std::getenv("SWEEP_COEFF_MODULI")) {
+    coeff_moduli = parse_coeff_moduli(v);
+  }
+  if (auto v = std::getenv("SWEEP_PLAIN_MODULUS_BITS")) {
+    plain_modulus_bits = parse_int_list(v, ',');
+  }
+  if (plain_modulus_bits.empty()) plain_modulus_bits = {0};
+
+  std::vector<ParameterSet> grid;
+  for (auto n : poly_modulus_degrees) {
+    for (auto &chain : coeff_moduli) {
+      for (auto t : plain_modulus_bits) {
+        grid.push_back({static_cast<std::size_t>(n), chain, t});
+      }
+    }
+  }
+  return grid;
+}
+
+/// Returns true if the program was started with the given flag, e.g. --sweep.
+inline bool has_flag(int argc, char *argv[], const std::string &flag) {
+  for (int i = 1; i < argc; ++i) {
+    if (flag == argv[i]) return true;
+  }
+  return false;
+}
+
+#endif
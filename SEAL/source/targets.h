@@ -0,0 +1,139 @@
+#ifndef TARGETS_H_
+#define TARGETS_H_
+
+#include <seal/seal.h>
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sweep.h"
+
+/*
+ * Encryption parameters and rotation steps of the application targets
+ * (cardio, nn, kernel). The targets' setup_context_* read their parameters
+ * from here, and benchmarks of cross-cutting concerns such as serialization
+ * or key generation iterate over the same table, so that they run on exactly
+ * the parameters the targets use.
+ */
+
+struct TargetParameters {
+  /// name of the CMake target (or group of targets) using these parameters
+  std::string name;
+
+  seal::scheme_type scheme;
+
+  ParameterSet parameters;
+
+  /// rotation steps the target generates Galois keys for
+  std::vector<int> rotation_steps;
+
+  /// The parameters at another ring dimension, e.g., in a sweep or for an
+  /// input that needs more slots (an empty chain is SEAL's default for it).
+  ParameterSet parameters_at(std::size_t poly_modulus_degree) const {
+    ParameterSet result = parameters;
+    result.poly_modulus_degree = poly_modulus_degree;
+    return result;
+  }
+
+  seal::EncryptionParameters encryption_parameters() const {
+    seal::EncryptionParameters params(scheme);
+    params.set_poly_modulus_degree(parameters.poly_modulus_degree);
+    params.set_coeff_modulus(parameters.coeff_modulus());
+    if (scheme == seal::scheme_type::BFV) {
+      params.set_plain_modulus(seal::PlainModulus::Batching(
+          parameters.poly_modulus_degree, parameters.plain_modulus_bits));
+    }
+    return params;
+  }
+};
+
+/// cardio-bfv-batched and cardio-ckks-batched: the shifts of the prefix
+/// comparison and the sums over the fields of a record
+inline std::vector<int> cardio_rotation_steps() {
+  return {-1, -2, -3, -4, -5, -6, -7, 8, 16, 32, 56, 64, 72};
+}
+
+/// Create only the required power-of-two rotations
+/// This can save quite a bit, for example for poly_modulus_degree = 16384
+/// The default galois keys (with zlib compression) are 247 MB large
+/// Whereas with dimension = 256, they are only 152 MB
+/// For poly_modulus_degree = 32768, the default keys are 532 MB large
+/// while with dimension = 256, they are only 304 MB
+inline std::vector<int> nn_rotation_steps(std::size_t dimension) {
+  if (dimension == 256) {
+    // Slight further optimization: No -128, no -256
+    return {1, -1, 2, -2, 4, -4, 8, -8, 16, -16, 32, -32, 64, -64, 128, 256};
+  }
+  std::vector<int> steps;
+  for (std::size_t i = 1; i <= dimension; i <<= 1) {
+    steps.push_back(static_cast<int>(i));
+    steps.push_back(-static_cast<int>(i));
+  }
+  return steps;
+}
+
+/// kernel-bfv: the taps j + i * image_size of a 3x3 kernel
+inline std::vector<int> kernel_rotation_steps(int image_size) {
+  std::vector<int> steps;
+  for (int j = -1; j < 2; ++j) {
+    for (int i = -1; i < 2; ++i) steps.push_back(j + i * image_size);
+  }
+  return steps;
+}
+
+/// kernel-bfv-batched: the taps of a 3x3 kernel anchored at its top left
+/// corner, and the shift that moves the result back to the center
+inline std::vector<int> kernel_batched_rotation_steps(int image_size) {
+  return {-1,
+          -2,
+          -image_size,
+          -(image_size + 1),
+          -(image_size + 2),
+          -(2 * image_size),
+          -(2 * image_size + 1),
+          -(2 * image_size + 2),
+          image_size + 1};
+}
+
+inline const std::vector<TargetParameters> &target_parameter_sets() {
+  // the kernel targets run on 8x8 images
+  const int image_size = 8;
+
+  const auto BFV = seal::scheme_type::BFV;
+  const auto CKKS = seal::scheme_type::CKKS;
+  static const std::vector<TargetParameters> targets = {
+      // cardio-bfv-batched, selected at build time. MANUALPARAMS is the chain
+      // ModulusPlanner selects (run with --plan): the prefix comparator leaves
+      // 50 bits of noise budget with {30, 60, 60, 60, 60, 60}, and 12 bits
+      // with one prime less. SEALPARAMS: an empty chain selects
+      // CoeffModulus::BFVDefault.
+      {"cardio_bfv_batched_manualparams", BFV,
+       {16384, {58, 58, 58, 58, 58}, 20}, cardio_rotation_steps()},
+      {"cardio_bfv_batched_cinguparam", BFV,
+       {16384, {30, 40, 44, 50, 54, 60, 60}, 20}, cardio_rotation_steps()},
+      {"cardio_bfv_batched_sealparams", BFV, {16384, {}, 20},
+       cardio_rotation_steps()},
+      {"cardio_ckks_batched", CKKS,
+       {32768, {60, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 60}, 0},
+       cardio_rotation_steps()},
+      {"nn_ckks_batched", CKKS,
+       {16384, {60, 40, 40, 40, 40, 40, 40, 40, 60}, 0},
+       nn_rotation_steps(1024)},
+      {"kernel", BFV, {16384, {}, 20}, kernel_rotation_steps(image_size)},
+      {"kernel_batched", BFV, {16384, {}, 20},
+       kernel_batched_rotation_steps(image_size)},
+  };
+  return targets;
+}
+
+/// The entry of the target (or group of targets) with the given name.
+inline const TargetParameters &target_parameters(const std::string &name) {
+  for (auto &target : target_parameter_sets()) {
+    if (target.name == name) return target;
+  }
+  throw std::invalid_argument("no parameters for target " + name);
+}
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef TASK_GRAPH_H_
+#define TASK_GRAPH_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "memory.h"
+#include "memory_pools.h"
+
+/*
+ * Parallel execution of independent sub-circuits, e.g., the risk factor
+ * conditions of the cardio benchmark.
+ *
+ * A TaskGraph holds tasks and the tasks they depend on. run() executes every
+ * task once all of its dependencies have finished, on worker threads that
+ * each own a deque of ready tasks (work stealing): a worker runs its newest
+ * task and, if it has none, steals the oldest task of another worker. A task
+ * that becomes ready is pushed onto the deque of the worker that finished its
+ * last dependency, so that a merge of two sub-circuits tends to run on the
+ * thread that computed (and still caches) one of its inputs. Workers without
+ * a task wait until a task is pushed or the graph finished, rather than
+ * spinning on the deques of the others.
+ *
+ * Each worker allocates from its own SEAL memory pool (see memory_pools.h)
+ * rather than from SEAL's global pool, whose lock would otherwise be
+ * contended by all workers. If the calling thread has a pool of its own,
+ * e.g., in a phase profiled by a MemoryProfiler (see memory.h), the workers
+ * share it instead, and they count their heap allocations into the counters
+ * of the calling thread, so that the profile covers their allocations.
+ *
+ * Tasks must not modify data that concurrently running tasks use. With lazy
+ * relinearization, this includes relinearizing a shared input in place, so
+ * inputs shared by several tasks must be relinearized before run().
+ */
+
+/// Number of worker threads from the given env var, by default the number of
+/// hardware threads.
+inline std::size_t num_threads_from_env(const char *env_var) {
+  if (auto v = std::getenv(env_var)) {
+    return std::max(1ul, std::strtoul(v, nullptr, 10));
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+class TaskGraph {
+ public:
+  typedef std::size_t TaskId;
+
+  /// Adds a task that runs once all given (previously added) tasks finished.
+  TaskId add(std::function<void()> task,
+             const std::vector<TaskId> &dependencies = {}) {
+    const TaskId id = tasks.size();
+    for (TaskId dependency : dependencies) {
+      if (dependency >= id) {
+        throw std::invalid_argument("dependency on a task not yet added");
+      }
+      dependents[dependency].push_back(id);
+    }
+    tasks.push_back(std::move(task));
+    dependents.emplace_back();
+    num_dependencies.push_back(dependencies.size());
+    return id;
+  }
+
+  std::size_t size() const { return tasks.size(); }
+
+  /// Executes all tasks on (at most) num_threads workers and returns once
+  /// all of them finished. If a task throws, the remaining tasks are skipped
+  /// and the first exception is rethrown.
+  void run(std::size_t num_threads) {
+    if (tasks.empty()) return;
+    num_threads = std::max<std::size_t>(1, std::min(num_threads, size()));
+
+    std::vector<std::atomic<std::size_t>> pending(size());
+    for (TaskId id = 0; id < size(); ++id) pending[id] = num_dependencies[id];
+
+    std::vector<WorkerQueue> queues(num_threads);
+    std::size_t next_queue = 0, num_ready = 0;
+    for (TaskId id = 0; id < size(); ++id) {
+      if (num_dependencies[id] == 0) {
+        queues[next_queue].push(id);
+        next_queue = (next_queue + 1) % num_threads;
+        num_ready++;
+      }
+    }
+
+    std::atomic<std::size_t> unfinished{size()};
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    // idle workers wait for a queued task, the end of the graph, or an error;
+    // queued is only increased (and failed and unfinished only finalized)
+    // while holding idle_mutex, so that no wake-up gets lost
+    std::atomic<std::size_t> queued{num_ready};
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    auto done = [&]() { return unfinished.load() == 0 || failed.load(); };
+
+    const seal::MemoryPoolHandle caller_pool = ThreadMemoryPool::current();
+    AllocationCounters *const caller_counters =
+        AllocationCountingScope::current();
+    auto worker = [&](std::size_t self) {
+      ThreadMemoryPool pool(caller_pool ? caller_pool
+                                        : seal::MemoryPoolHandle::New());
+      AllocationCountingScope counting(caller_counters);
+      while (!done()) {
+        TaskId id;
+        if (!queues[self].pop_newest(id) && !steal(queues, self, id)) {
+          std::unique_lock<std::mutex> lock(idle_mutex);
+          idle.wait(lock, [&]() { return queued.load() > 0 || done(); });
+          continue;
+        }
+        queued--;
+        try {
+          tasks[id]();
+        } catch (...) {
+          {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            if (!error) error = std::current_exception();
+            failed = true;
+          }
+          // the dependents of a failed task are never released
+          idle.notify_all();
+          break;
+        }
+        std::size_t released = 0;
+        for (TaskId dependent : dependents[id]) {
+          if (--pending[dependent] == 0) {
+            queues[self].push(dependent);
+            released++;
+          }
+        }
+        bool finished;
+        {
+          std::lock_guard<std::mutex> lock(idle_mutex);
+          queued += released;
+          finished = --unfinished == 0;
+        }
+        // this worker takes one of the released tasks itself
+        if (finished) {
+          idle.notify_all();
+        } else {
+          for (std::size_t i = 1; i < released; ++i) idle.notify_one();
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < num_threads; ++i) {
+      threads.emplace_back(worker, i);
+    }
+    for (auto &t : threads) t.join();
+
+    if (error) std::rethrow_exception(error);
+  }
+
+ private:
+  class WorkerQueue {
+   public:
+    void push(TaskId id) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ids.push_back(id);
+    }
+
+    bool pop_newest(TaskId &id) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ids.empty()) return false;
+      id = ids.back();
+      ids.pop_back();
+      return true;
+    }
+
+    bool pop_oldest(TaskId &id) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ids.empty()) return false;
+      id = ids.front();
+      ids.pop_front();
+      return true;
+    }
+
+   private:
+    std::mutex mutex;
+    std::deque<TaskId> ids;
+  };
+
+  static bool steal(std::vector<WorkerQueue> &queues, std::size_t self,
+                    TaskId &id) {
+    for (std::size_t i = 1; i < queues.size(); ++i) {
+      if (queues[(self + i) % queues.size()].pop_oldest(id)) return true;
+    }
+    return false;
+  }
+
+  std::vector<std::function<void()>> tasks;
+  std::vector<std::vector<TaskId>> dependents;
+  std::vector<std::size_t> num_dependencies;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+#include "../bounded_queue.h"
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace BoundedQueueTests {
+
+TEST(BoundedQueue, DrainsItemsInOrderAfterClose) {
+  BoundedQueue<int> queue(4);
+  for (int i = 0; i < 3; ++i) EXPECT_TRUE(queue.push(i));
+  queue.close();
+  EXPECT_FALSE(queue.push(3));
+  EXPECT_EQ(queue.size(), 3);
+
+  int item;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(item, i);
+  }
+  EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(BoundedQueue, NeverExceedsCapacity) {
+  BoundedQueue<int> queue(2);
+  const int num_items = 1000;
+  thread producer([&]() {
+    for (int i = 0; i < num_items; ++i) queue.push(i);
+    queue.close();
+  });
+
+  int item, expected = 0;
+  while (queue.pop(item)) EXPECT_EQ(item, expected++);
+  producer.join();
+  EXPECT_EQ(expected, num_items);
+
+  const QueueStats stats = queue.stats();
+  EXPECT_EQ(stats.capacity, 2);
+  EXPECT_EQ(stats.pushes, num_items);
+  EXPECT_TRUE(stats.max_occupancy >= 1 && stats.max_occupancy <= 2);
+  EXPECT_TRUE(stats.mean_occupancy >= 1 && stats.mean_occupancy <= 2);
+}
+
+TEST(BoundedQueue, CloseWakesUpBlockedProducersAndConsumers) {
+  BoundedQueue<int> full(1), empty(1);
+  full.push(0);
+  bool pushed = true, popped = true;
+  thread producer([&]() { pushed = full.push(1); });
+  thread consumer([&]() {
+    int item;
+    popped = empty.pop(item);
+  });
+  full.close();
+  empty.close();
+  producer.join();
+  consumer.join();
+  EXPECT_FALSE(pushed);
+  EXPECT_FALSE(popped);
+}
+
+TEST(BoundedQueue, RejectsZeroCapacity) {
+  EXPECT_THROW(BoundedQueue<int>(0), invalid_argument);
+}
+
+}  // namespace BoundedQueueTests
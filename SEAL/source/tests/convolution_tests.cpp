@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "../convolution.h"
+
+using namespace std;
+
+namespace ConvolutionTests {
+
+TEST(Convolution, ParsesKernels) {
+  EXPECT_EQ(parse_convolution_kernel("1,1,1;1,-8,1;1,1,1"),
+            ConvolutionKernel({{1, 1, 1}, {1, -8, 1}, {1, 1, 1}}));
+  EXPECT_EQ(kernel_radius(parse_convolution_kernel("1")), 0);
+  EXPECT_THROW(parse_convolution_kernel("1,2;3,4"), invalid_argument);
+  EXPECT_THROW(parse_convolution_kernel("1,2,3;4,5,6"), invalid_argument);
+}
+
+TEST(Convolution, KeepsBorderInPlaintext) {
+  // 4x3 image, only (1, 1) and (2, 1) are interior pixels
+  const vector<int64_t> image = {1, 2, 3, 4,  //
+                                 5, 6, 7, 8,  //
+                                 9, 10, 11, 12};
+  const ConvolutionKernel laplacian = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
+  vector<int64_t> expected = image;
+  expected[5] = 2 + 5 + 7 + 10 - 4 * 6;
+  expected[6] = 3 + 6 + 8 + 11 - 4 * 7;
+  EXPECT_EQ(convolve_plain(image, 4, 3, laplacian), expected);
+}
+
+TEST(Convolution, NeedsOneRotationPerTap) {
+  const ConvolutionKernel sobel_x = {{1, 0, -1}, {2, 0, -2}, {1, 0, -1}};
+  const ConvolutionKernel sobel_y = {{1, 2, 1}, {0, 0, 0}, {-1, -2, -1}};
+  EXPECT_EQ(ConvolutionEngine::galois_steps({sobel_x}, 10),
+            vector<int>({-11, -9, -1, 1, 9, 11}));
+  // the corners are shared by both kernels
+  EXPECT_EQ(ConvolutionEngine::galois_steps({sobel_x, sobel_y}, 10).size(), 8);
+}
+
+TEST(Convolution, ConvolvesEncryptedImage) {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  auto context = seal::SEALContext::Create(parms);
+  seal::BatchEncoder encoder(context);
+  seal::Evaluator evaluator(context);
+  PlaintextCache plaintext_cache(context);
+
+  const size_t width = 12, height = 9;
+  const ConvolutionKernel kernel = {{-1, -1, -1}, {-1, 10, -1}, {-1, -1, -1}};
+  seal::KeyGenerator keygen(context);
+  seal::GaloisKeys galois_keys = keygen.galois_keys_local(
+      ConvolutionEngine::galois_steps({kernel}, width));
+  seal::Encryptor encryptor(context, keygen.public_key());
+  seal::Decryptor decryptor(context, keygen.secret_key());
+
+  vector<int64_t> image(width * height);
+  for (size_t i = 0; i < image.size(); ++i) image[i] = (i * 7) % 31;
+  vector<int64_t> slots(image);
+  slots.resize(encoder.slot_count(), 0);
+  seal::Plaintext plain;
+  encoder.encode(slots, plain);
+  seal::Ciphertext encrypted;
+  encryptor.encrypt(plain, encrypted);
+
+  ConvolutionEngine engine(evaluator, galois_keys, plaintext_cache,
+                           encoder.slot_count(), width, height);
+  seal::Ciphertext result = engine.convolve_keep_border(encrypted, kernel);
+  EXPECT_EQ(engine.rotations(), 8);
+
+  decryptor.decrypt(result, plain);
+  vector<int64_t> decoded;
+  encoder.decode(plain, decoded);
+  decoded.resize(image.size());
+  EXPECT_EQ(decoded, convolve_plain(image, width, height, kernel));
+
+  EXPECT_THROW(ConvolutionEngine(evaluator, galois_keys, plaintext_cache,
+                                 encoder.slot_count(), 64, 64),
+               invalid_argument);
+}
+
+}  // namespace ConvolutionTests
@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "../encrypted_bits.h"
+
+using namespace std;
+
+namespace EncryptedBitsTests {
+
+class BitEvaluatorTest : public ::testing::Test {
+ protected:
+  BitEvaluatorTest() {
+    seal::EncryptionParameters parms(seal::scheme_type::BFV);
+    parms.set_poly_modulus_degree(4096);
+    parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+    parms.set_plain_modulus(2);
+    context = seal::SEALContext::Create(parms);
+    keygen = make_unique<seal::KeyGenerator>(context);
+    relin_keys = keygen->relin_keys_local();
+    encryptor = make_unique<seal::Encryptor>(context, keygen->secret_key());
+    decryptor = make_unique<seal::Decryptor>(context, keygen->secret_key());
+    evaluator = make_unique<seal::Evaluator>(context);
+    encoder = make_unique<seal::IntegerEncoder>(context);
+    lazy = make_unique<LazyEvaluator>(*evaluator, relin_keys);
+    bits = make_unique<BitEvaluator>(*evaluator, *lazy, encoder->encode(1));
+  }
+
+  Bit encrypt(int32_t value) {
+    seal::Ciphertext ctxt;
+    encryptor->encrypt_symmetric(encoder->encode(value), ctxt);
+    return ctxt;
+  }
+
+  int32_t decrypt(Bit &bit) {
+    seal::Plaintext ptxt;
+    decryptor->decrypt(bit.ciphertext(), ptxt);
+    return encoder->decode_int32(ptxt);
+  }
+
+  shared_ptr<seal::SEALContext> context;
+  unique_ptr<seal::KeyGenerator> keygen;
+  seal::RelinKeys relin_keys;
+  unique_ptr<seal::Encryptor> encryptor;
+  unique_ptr<seal::Decryptor> decryptor;
+  unique_ptr<seal::Evaluator> evaluator;
+  unique_ptr<seal::IntegerEncoder> encoder;
+  unique_ptr<LazyEvaluator> lazy;
+  unique_ptr<BitEvaluator> bits;
+};
+
+TEST_F(BitEvaluatorTest, FoldsConstants) {
+  Bit zero, one = Bit::constant(true);
+  EXPECT_TRUE(zero.is_constant());
+  EXPECT_FALSE(zero.value());
+  EXPECT_TRUE(bits->XOR(one, zero).value());
+  EXPECT_FALSE(bits->XOR(one, one).value());
+  EXPECT_FALSE(bits->NOT(one).value());
+  EXPECT_FALSE(bits->AND(one, zero).value());
+  EXPECT_TRUE(bits->AND(one, one).value());
+  EXPECT_EQ(bits->folded_gates(), 5);
+}
+
+TEST_F(BitEvaluatorTest, FoldsConstantOperandsWithoutMultiplication) {
+  Bit zero, one = Bit::constant(true);
+  Bit x = encrypt(1);
+
+  Bit x_and_zero = bits->AND(x, zero);
+  EXPECT_TRUE(x_and_zero.is_constant());
+  EXPECT_FALSE(x_and_zero.value());
+
+  Bit x_and_one = bits->AND(one, x);
+  Bit x_xor_zero = bits->XOR(zero, x);
+  EXPECT_EQ(decrypt(x_and_one), 1);
+  EXPECT_EQ(decrypt(x_xor_zero), 1);
+  EXPECT_EQ(lazy->multiplications(), 0);
+
+  // x ^ 1 is a plaintext addition
+  Bit not_x = bits->XOR(x, one);
+  EXPECT_FALSE(not_x.is_constant());
+  EXPECT_EQ(decrypt(not_x), 0);
+  EXPECT_EQ(bits->folded_gates(), 3);
+}
+
+TEST_F(BitEvaluatorTest, EvaluatesEncryptedGates) {
+  Bit x = encrypt(1), y = encrypt(1);
+  Bit x_and_y = bits->AND(x, y);
+  Bit x_xor_y = bits->XOR(x, y);
+  EXPECT_EQ(decrypt(x_and_y), 1);
+  EXPECT_EQ(decrypt(x_xor_y), 0);
+  EXPECT_EQ(lazy->multiplications(), 1);
+  EXPECT_EQ(bits->folded_gates(), 0);
+}
+
+TEST_F(BitEvaluatorTest, ThrowsOnWrongKind) {
+  Bit zero;
+  Bit x = encrypt(0);
+  EXPECT_THROW(zero.ciphertext(), logic_error);
+  EXPECT_THROW(x.value(), logic_error);
+}
+
+}  // namespace EncryptedBitsTests
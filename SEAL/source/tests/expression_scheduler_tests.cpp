@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+#include "../expression_scheduler.h"
+
+using namespace std;
+
+namespace ExpressionSchedulerTests {
+
+typedef ExpressionScheduler::NodeId Node;
+
+ExpressionScheduler::Options options(bool deduplicate, bool additions) {
+  ExpressionScheduler::Options options;
+  options.deduplicate = deduplicate;
+  options.constants_as_additions = additions;
+  return options;
+}
+
+/// (2x + y)^2 and (2x + y) * x, each written down from its formula.
+void build(ExpressionScheduler &scheduler) {
+  const Node x = scheduler.input(0), y = scheduler.input(1);
+  scheduler.output(
+      scheduler.square(scheduler.add(scheduler.multiply_const(x, 2), y)));
+  scheduler.output(
+      scheduler.multiply(scheduler.add(y, scheduler.multiply_const(x, 2)), x));
+}
+
+TEST(ExpressionScheduler, DeduplicatesCommonSubterms) {
+  ExpressionScheduler naive(options(false, false));
+  build(naive);
+  ExpressionCounts counts = naive.counts();
+  EXPECT_EQ(counts.plain_multiplications, 2);
+  EXPECT_EQ(counts.additions, 2);
+  EXPECT_EQ(counts.multiplications, 2);
+
+  // 2x + y and y + 2x are the same node
+  ExpressionScheduler deduplicated(options(true, false));
+  build(deduplicated);
+  counts = deduplicated.counts();
+  EXPECT_EQ(counts.plain_multiplications, 1);
+  EXPECT_EQ(counts.additions, 1);
+  EXPECT_EQ(counts.multiplications, 2);
+  EXPECT_EQ(counts.relinearizations, 2);
+  EXPECT_EQ(counts.multiplicative_depth, 1);
+  EXPECT_EQ(counts.critical_path, 3);
+}
+
+TEST(ExpressionScheduler, TurnsConstantsIntoAdditions) {
+  ExpressionScheduler scheduler;
+  build(scheduler);
+  const ExpressionCounts counts = scheduler.counts();
+  EXPECT_EQ(counts.plain_multiplications, 0);
+  EXPECT_EQ(counts.additions, 2);
+
+  // 4x = (x + x) + (x + x) reuses 2x
+  const Node x = scheduler.input(0);
+  const Node four_x = scheduler.multiply_const(x, 4);
+  EXPECT_EQ(scheduler.multiply_const(x, 4), four_x);
+  const size_t size = scheduler.size();
+  scheduler.add(scheduler.multiply_const(x, 2), scheduler.multiply_const(x, 2));
+  EXPECT_EQ(scheduler.size(), size);
+  EXPECT_EQ(scheduler.multiply_const(x, 1), x);
+}
+
+TEST(ExpressionScheduler, MultipliesLargeConstantsAsPlaintexts) {
+  EXPECT_EQ(ExpressionScheduler::additions_for(2), 1);
+  EXPECT_EQ(ExpressionScheduler::additions_for(4), 2);
+  EXPECT_EQ(ExpressionScheduler::additions_for(5), 3);
+  EXPECT_EQ(ExpressionScheduler::additions_for(255), 14);
+
+  ExpressionScheduler scheduler;
+  scheduler.output(scheduler.multiply_const(scheduler.input(0), 255));
+  EXPECT_EQ(scheduler.counts().plain_multiplications, 1);
+  EXPECT_EQ(scheduler.counts().additions, 0);
+  EXPECT_THROW(scheduler.multiply_const(scheduler.input(0), 0),
+               invalid_argument);
+}
+
+TEST(ExpressionScheduler, CountsOnlyNodesOutputsDependOn) {
+  ExpressionScheduler scheduler;
+  const Node x = scheduler.input(0);
+  scheduler.square(x);
+  scheduler.output(scheduler.add(x, x));
+  EXPECT_EQ(scheduler.counts().multiplications, 0);
+  EXPECT_EQ(scheduler.counts().additions, 1);
+  EXPECT_THROW(scheduler.output(100), invalid_argument);
+}
+
+TEST(ExpressionScheduler, EvaluatesOutputsConcurrently) {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  auto context = seal::SEALContext::Create(parms);
+  seal::KeyGenerator keygen(context);
+  seal::RelinKeys relin_keys = keygen.relin_keys_local();
+  seal::Encryptor encryptor(context, keygen.public_key());
+  seal::Evaluator evaluator(context);
+  seal::Decryptor decryptor(context, keygen.secret_key());
+  seal::BatchEncoder encoder(context);
+
+  vector<seal::Ciphertext> inputs(2);
+  for (uint64_t i = 0; i < 2; ++i) {
+    seal::Plaintext plain;
+    encoder.encode(vector<uint64_t>(encoder.slot_count(), 3 + i), plain);
+    encryptor.encrypt(plain, inputs[i]);
+  }
+
+  ExpressionScheduler scheduler;
+  build(scheduler);
+  // x = 3, y = 4
+  const vector<uint64_t> expected = {100, 30};
+  for (size_t threads : {1, 4}) {
+    vector<seal::Ciphertext> outputs =
+        scheduler.evaluate(evaluator, relin_keys, inputs, threads);
+    ASSERT_EQ(outputs.size(), 2);
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      seal::Plaintext plain;
+      decryptor.decrypt(outputs[i], plain);
+      vector<uint64_t> values;
+      encoder.decode(plain, values);
+      EXPECT_EQ(values[0], expected[i]);
+      EXPECT_EQ(outputs[i].size(), 2);
+    }
+  }
+}
+
+}  // namespace ExpressionSchedulerTests
@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+#include "../convolution.h"
+#include "../image_packing.h"
+
+using namespace std;
+
+namespace ImagePackingTests {
+
+TEST(ImagePacking, FitsImagesWithGuards) {
+  // 9x9 cells incl. guards, (9 * 9) * 101 + 1 <= 8192
+  ImagePacking packing(8, 8, 1, 16384);
+  EXPECT_EQ(packing.capacity(), 101);
+  EXPECT_EQ(packing.layout_width(), 909);
+  EXPECT_EQ(packing.layout_height(), 9);
+  EXPECT_EQ(packing.ciphertexts(256), 3);
+
+  EXPECT_THROW(ImagePacking(64, 64, 1, 4096), invalid_argument);
+}
+
+TEST(ImagePacking, PacksSideBySide) {
+  // 3x3 cells incl. guards, (3 * 3) * 3 + 1 <= 32
+  ImagePacking packing(2, 2, 1, 64);
+  ASSERT_EQ(packing.capacity(), 3);
+  ASSERT_EQ(packing.layout_width(), 9);
+  const vector<vector<int64_t>> images = {{1, 2, 3, 4}, {5, 6, 7, 8}};
+  const vector<int64_t> slots = packing.pack(images);
+  vector<int64_t> expected(64, 0);
+  expected[0] = 1, expected[1] = 2, expected[9] = 3, expected[10] = 4;
+  expected[3] = 5, expected[4] = 6, expected[12] = 7, expected[13] = 8;
+  EXPECT_EQ(slots, expected);
+  EXPECT_EQ(packing.unpack(slots, 2), images);
+
+  EXPECT_THROW(packing.pack(vector<vector<int64_t>>(4, {1, 2, 3, 4})),
+               invalid_argument);
+  EXPECT_THROW(packing.pack({{1, 2, 3}}), invalid_argument);
+}
+
+TEST(ImagePacking, ConvolvesWithZeroPadding) {
+  const vector<int64_t> image = {1, 2, 3,  //
+                                 4, 5, 6};
+  const ConvolutionKernel box = {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}};
+  EXPECT_EQ(convolve_plain_zero_padded(image, 3, 2, box),
+            vector<int64_t>({12, 21, 16, 12, 21, 16}));
+}
+
+TEST(ImagePacking, SharesRotationsAcrossImagesAndFilters) {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  auto context = seal::SEALContext::Create(parms);
+  seal::BatchEncoder encoder(context);
+  seal::Evaluator evaluator(context);
+  PlaintextCache plaintext_cache(context);
+
+  const vector<ConvolutionKernel> filters = {
+      {{1, 1, 1}, {1, -8, 1}, {1, 1, 1}},
+      {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}},
+      {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}}};
+  ImagePacking packing(6, 5, 1, encoder.slot_count());
+  seal::KeyGenerator keygen(context);
+  seal::GaloisKeys galois_keys = keygen.galois_keys_local(
+      ConvolutionEngine::galois_steps(filters, packing.layout_width()));
+  seal::Encryptor encryptor(context, keygen.public_key());
+  seal::Decryptor decryptor(context, keygen.secret_key());
+
+  vector<vector<int64_t>> images(packing.capacity(), vector<int64_t>(30));
+  for (size_t i = 0; i < images.size(); ++i) {
+    for (size_t j = 0; j < 30; ++j) images[i][j] = (i * 30 + j * 7) % 31;
+  }
+  seal::Plaintext plain;
+  encoder.encode(packing.pack(images), plain);
+  seal::Ciphertext encrypted;
+  encryptor.encrypt(plain, encrypted);
+
+  ConvolutionEngine engine(evaluator, galois_keys, plaintext_cache,
+                           encoder.slot_count(), packing.layout_width(),
+                           packing.layout_height());
+  const auto shifted = engine.shift(encrypted, filters);
+  for (auto &filter : filters) {
+    seal::Ciphertext result = engine.weighted_sum(shifted, filter);
+    decryptor.decrypt(result, plain);
+    vector<int64_t> decoded;
+    encoder.decode(plain, decoded);
+    const auto responses = packing.unpack(decoded, images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+      EXPECT_EQ(responses[i],
+                convolve_plain_zero_padded(images[i], 6, 5, filter));
+    }
+  }
+  // the 8 neighbors, once for all images and filters
+  EXPECT_EQ(engine.rotations(), 8);
+}
+
+}  // namespace ImagePackingTests
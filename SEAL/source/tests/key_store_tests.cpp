@@ -0,0 +1,120 @@
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "../key_store.h"
+
+using namespace std;
+
+namespace KeyStoreTests {
+
+shared_ptr<seal::SEALContext> small_context() {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  return seal::SEALContext::Create(parms);
+}
+
+template <typename T>
+vector<byte> bytes(const T &key) {
+  vector<byte> buffer(static_cast<size_t>(
+      key.save_size(seal::compr_mode_type::none)));
+  buffer.resize(static_cast<size_t>(
+      key.save(buffer.data(), buffer.size(), seal::compr_mode_type::none)));
+  return buffer;
+}
+
+class KeyStoreTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/key_store_testXXXXXX";
+    directory = mkdtemp(tmpl);
+    context = small_context();
+  }
+
+  void TearDown() override {
+    for (auto &file : files) std::remove(file.c_str());
+    rmdir(directory.c_str());
+  }
+
+  string directory;
+  vector<string> files;
+  shared_ptr<seal::SEALContext> context;
+};
+
+TEST_F(KeyStoreTest, DisabledStoreGenerates) {
+  KeyStore store("");
+  EXPECT_FALSE(store.enabled());
+  KeySet keys = store.get(context, KeyRequest());
+  EXPECT_FALSE(keys.loaded);
+  EXPECT_TRUE(keys.secret_key && keys.public_key && keys.relin_keys);
+  EXPECT_FALSE(keys.galois_keys);
+}
+
+TEST_F(KeyStoreTest, LoadsStoredKeys) {
+  KeyStore store(directory);
+  KeyRequest request;
+  request.galois_keys = true;
+  request.galois_steps = {1, -1};
+  files.push_back(store.path(context, request));
+
+  KeySet generated = store.get(context, request);
+  EXPECT_FALSE(generated.loaded);
+  KeySet loaded = store.get(context, request);
+  EXPECT_TRUE(loaded.loaded);
+
+  EXPECT_EQ(bytes(*loaded.secret_key), bytes(*generated.secret_key));
+  EXPECT_EQ(bytes(*loaded.public_key), bytes(*generated.public_key));
+  EXPECT_EQ(bytes(*loaded.relin_keys), bytes(*generated.relin_keys));
+  EXPECT_EQ(bytes(*loaded.galois_keys), bytes(*generated.galois_keys));
+}
+
+TEST_F(KeyStoreTest, FingerprintDependsOnRequest) {
+  KeyRequest a, b;
+  a.galois_keys = b.galois_keys = true;
+  a.galois_steps = {1};
+  b.galois_steps = {1};
+  EXPECT_EQ(KeyStore::fingerprint(context, a),
+            KeyStore::fingerprint(context, b));
+  b.galois_steps = {2};
+  EXPECT_NE(KeyStore::fingerprint(context, a),
+            KeyStore::fingerprint(context, b));
+  EXPECT_NE(KeyStore::fingerprint(context, KeyRequest()),
+            KeyStore::fingerprint(context, a));
+}
+
+TEST_F(KeyStoreTest, RegeneratesInvalidFile) {
+  KeyStore store(directory);
+  const string path = store.path(context, KeyRequest());
+  files.push_back(path);
+  {
+    ofstream file(path, ios::binary);
+    file << "SEALKEYS but not a key file";
+  }
+  EXPECT_FALSE(store.get(context, KeyRequest()).loaded);
+  EXPECT_TRUE(store.get(context, KeyRequest()).loaded);
+}
+
+TEST(KeyStore, TimingNames) {
+  EXPECT_EQ(string(KeyStore::timing_name(false)), "t_keygen");
+  EXPECT_EQ(string(KeyStore::timing_name(true)), "t_key_load");
+}
+
+TEST(KeyStore, LeavesKeygenColumnEmptyOnLoad) {
+  EXPECT_EQ(KeyStore::keygen_column(false, chrono::microseconds(2500)), "2");
+  EXPECT_EQ(KeyStore::keygen_column(true, chrono::microseconds(2500)), "");
+}
+
+TEST(Fingerprint, HashesLittleEndianWordsWithFnv1a) {
+  // the key files of all stores are named by this hash, so it must not change
+  Fingerprint hash;
+  EXPECT_EQ(hash.value(), 14695981039346656037ULL);
+  hash.mix(0x61);
+  EXPECT_EQ(hash.value(), 0x6926124a7b1433c4ULL);
+}
+
+}  // namespace KeyStoreTests
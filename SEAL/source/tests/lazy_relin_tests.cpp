@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "../lazy_relin.h"
+
+using namespace std;
+
+namespace LazyRelinTests {
+
+class LazyEvaluatorTest : public ::testing::Test {
+ protected:
+  LazyEvaluatorTest() {
+    seal::EncryptionParameters parms(seal::scheme_type::BFV);
+    // depth 2 (see RelinearizesSharedOperandOnce) exceeds the noise budget
+    // of 4096 with a 20 bit plain modulus
+    parms.set_poly_modulus_degree(8192);
+    parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(8192));
+    parms.set_plain_modulus(seal::PlainModulus::Batching(8192, 20));
+    context = seal::SEALContext::Create(parms);
+    keygen = make_unique<seal::KeyGenerator>(context);
+    relin_keys = keygen->relin_keys_local();
+    encryptor = make_unique<seal::Encryptor>(context, keygen->secret_key());
+    decryptor = make_unique<seal::Decryptor>(context, keygen->secret_key());
+    evaluator = make_unique<seal::Evaluator>(context);
+    encoder = make_unique<seal::BatchEncoder>(context);
+  }
+
+  seal::Ciphertext encrypt(uint64_t value) {
+    seal::Plaintext ptxt;
+    encoder->encode(vector<uint64_t>(encoder->slot_count(), value), ptxt);
+    seal::Ciphertext ctxt;
+    encryptor->encrypt_symmetric(ptxt, ctxt);
+    return ctxt;
+  }
+
+  uint64_t decrypt(const seal::Ciphertext &ctxt) {
+    seal::Plaintext ptxt;
+    decryptor->decrypt(ctxt, ptxt);
+    vector<uint64_t> values;
+    encoder->decode(ptxt, values);
+    return values[0];
+  }
+
+  shared_ptr<seal::SEALContext> context;
+  unique_ptr<seal::KeyGenerator> keygen;
+  seal::RelinKeys relin_keys;
+  unique_ptr<seal::Encryptor> encryptor;
+  unique_ptr<seal::Decryptor> decryptor;
+  unique_ptr<seal::Evaluator> evaluator;
+  unique_ptr<seal::BatchEncoder> encoder;
+};
+
+TEST_F(LazyEvaluatorTest, RelinearizesSumOfProductsOnce) {
+  LazyEvaluator lazy(*evaluator, relin_keys);
+  seal::Ciphertext a = encrypt(2), b = encrypt(3), c = encrypt(5),
+                   d = encrypt(7);
+  seal::Ciphertext ab, cd;
+  lazy.multiply(a, b, ab);
+  lazy.multiply(c, d, cd);
+  EXPECT_EQ(ab.size(), 3);
+  evaluator->add_inplace(ab, cd);
+  lazy.relinearize_inplace(ab);
+  EXPECT_EQ(ab.size(), 2);
+  EXPECT_EQ(decrypt(ab), 2 * 3 + 5 * 7);
+  EXPECT_EQ(lazy.multiplications(), 2);
+  EXPECT_EQ(lazy.relinearizations(), 1);
+  EXPECT_EQ(lazy.removed_relinearizations(), 1);
+}
+
+TEST_F(LazyEvaluatorTest, RelinearizesSharedOperandOnce) {
+  LazyEvaluator lazy(*evaluator, relin_keys);
+  seal::Ciphertext a = encrypt(2), b = encrypt(3), c = encrypt(5);
+  seal::Ciphertext ab, abc, abab;
+  lazy.multiply(a, b, ab);
+  lazy.multiply(ab, c, abc);
+  lazy.multiply(ab, ab, abab);
+  EXPECT_EQ(ab.size(), 2);
+  EXPECT_EQ(decrypt(abc), 2 * 3 * 5);
+  EXPECT_EQ(decrypt(abab), 6 * 6);
+  EXPECT_EQ(lazy.multiplications(), 3);
+  EXPECT_EQ(lazy.relinearizations(), 1);
+}
+
+TEST_F(LazyEvaluatorTest, RelinearizesBeforeRotation) {
+  LazyEvaluator lazy(*evaluator, relin_keys);
+  seal::GaloisKeys galois_keys = keygen->galois_keys_local(vector<int>{1});
+  seal::Ciphertext a = encrypt(2), b = encrypt(3), rotated;
+  lazy.square_inplace(a);
+  evaluator->add_inplace(a, b);
+  lazy.rotate_rows(a, 1, galois_keys, rotated);
+  EXPECT_EQ(a.size(), 2);
+  EXPECT_EQ(decrypt(rotated), 2 * 2 + 3);
+  EXPECT_EQ(lazy.relinearizations(), 1);
+
+  // already relinearized
+  lazy.rotate_rows_inplace(a, 1, galois_keys);
+  EXPECT_EQ(lazy.relinearizations(), 1);
+  EXPECT_EQ(lazy.removed_relinearizations(), 0);
+}
+
+}  // namespace LazyRelinTests
@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+#include "../modulus_planner.h"
+
+using namespace std;
+
+namespace ModulusPlannerTests {
+
+/// Noise model of a circuit that consumes the given budget: the budget of a
+/// fresh ciphertext is the data bits of q minus the plaintext modulus and
+/// the noise of the encryption.
+ModulusPlanner::Circuit fake_circuit(int consumed, int min_data_bits = 0) {
+  return [=](const ParameterSet &parameters) {
+    const auto &bits = parameters.coeff_modulus_bits;
+    const int data_bits = total_bits(bits) - bits.back();
+    CircuitTrial trial;
+    trial.fresh_noise_budget =
+        max(0, data_bits - parameters.plain_modulus_bits - 5);
+    trial.output_noise_budgets = {
+        max(0, trial.fresh_noise_budget - consumed)};
+    trial.correct =
+        trial.output_noise_budgets[0] > 0 && data_bits >= min_data_bits;
+    return trial;
+  };
+}
+
+TEST(ModulusPlanner, ChainBitSizes) {
+  EXPECT_EQ(chain_bit_sizes(100), vector<int>({50, 50, 50}));
+  EXPECT_EQ(chain_bit_sizes(120), vector<int>({60, 60, 60}));
+  EXPECT_EQ(chain_bit_sizes(121), vector<int>({41, 41, 41, 41}));
+  // never below 30 bits per prime
+  EXPECT_EQ(chain_bit_sizes(10), vector<int>({30, 30}));
+}
+
+TEST(ModulusPlanner, MaxChainIsSecure) {
+  for (size_t degree : {4096, 8192, 16384, 32768}) {
+    const auto bits = max_chain_bit_sizes(degree);
+    EXPECT_GE(bits.size(), 2);
+    EXPECT_LE(bits.front(), 60);
+    EXPECT_LE(total_bits(bits), seal::CoeffModulus::MaxBitCount(degree));
+  }
+  EXPECT_EQ(max_chain_bit_sizes(16384), vector<int>(8, 54));
+}
+
+TEST(ModulusPlanner, SelectsSmallestDegreeAndModulus) {
+  ModulusPlanner planner(fake_circuit(150), 20);
+  const ModulusPlan plan = planner.plan();
+
+  // 4096 and 8192 cannot fit the circuit, the probe of 16384 leaves 203 bits
+  // of which all but the 10-bit margin are removed
+  EXPECT_EQ(plan.parameters.poly_modulus_degree, 16384);
+  EXPECT_EQ(plan.parameters.coeff_modulus_bits, vector<int>(5, 47));
+  EXPECT_EQ(plan.parameters.plain_modulus_bits, 20);
+  ASSERT_EQ(plan.steps.size(), 4);
+  EXPECT_TRUE(plan.steps[0].probe);
+  EXPECT_FALSE(plan.steps[0].trial.succeeded());
+  EXPECT_EQ(plan.steps[2].trial.min_output_noise_budget(), 203);
+  EXPECT_FALSE(plan.steps[3].probe);
+  EXPECT_EQ(plan.steps[3].trial.consumed_noise_budget(), 150);
+}
+
+TEST(ModulusPlanner, GrowsChainUntilCorrect) {
+  ModulusPlanner planner(fake_circuit(150, 200), 20, 10, 10);
+  const ModulusPlan plan = planner.plan();
+
+  // 188 and 196 data bits fail, 208 succeed
+  EXPECT_EQ(plan.parameters.poly_modulus_degree, 16384);
+  EXPECT_EQ(plan.parameters.coeff_modulus_bits, vector<int>(5, 52));
+  ASSERT_EQ(plan.steps.size(), 6);
+  EXPECT_FALSE(plan.steps[3].trial.succeeded());
+  EXPECT_FALSE(plan.steps[4].trial.succeeded());
+  EXPECT_TRUE(plan.steps[5].trial.succeeded());
+}
+
+TEST(ModulusPlanner, FallsBackToProbe) {
+  // the margin exceeds the remaining budget, i.e., no chain is smaller
+  ModulusPlanner planner(fake_circuit(150), 20, 300);
+  const ModulusPlan plan = planner.plan();
+
+  EXPECT_EQ(plan.parameters.poly_modulus_degree, 16384);
+  EXPECT_EQ(plan.parameters.coeff_modulus_bits, max_chain_bit_sizes(16384));
+  EXPECT_EQ(plan.steps.size(), 3);
+}
+
+TEST(ModulusPlanner, ThrowsIfNoParametersFit) {
+  ModulusPlanner planner(fake_circuit(150), 20);
+  EXPECT_THROW(planner.plan({4096, 8192}), runtime_error);
+  EXPECT_THROW(ModulusPlanner(fake_circuit(150), 20, 10, 0), invalid_argument);
+}
+
+}  // namespace ModulusPlannerTests
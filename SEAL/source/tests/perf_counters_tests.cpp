@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+#include "perf_counters.h"
+
+#include <sstream>
+
+using namespace std;
+
+namespace PerfCountersTests {
+
+size_t count_columns(const string &line) {
+  size_t columns = 1;
+  for (auto c : line) {
+    if (c == ',') columns++;
+  }
+  return columns;
+}
+
+TEST(PerfCounters, MeasuresEveryRegion) {
+  PerfCounters counters;
+  size_t setups = 0, ops = 0;
+  const auto values = measure_counters(counters, 4, [&]() { setups++; },
+                                       [&]() { ops++; });
+  EXPECT_EQ(setups, 4);
+  EXPECT_EQ(ops, 4);
+  EXPECT_EQ(values.regions, 4);
+}
+
+TEST(PerfCounters, UnmeasuredValuesAreEmptyColumns) {
+  PerfCounterValues values;
+  stringstream ss;
+  write_perf_counters(ss, values);
+  EXPECT_EQ(ss.str(), ",,,,,");
+  EXPECT_EQ(count_columns(ss.str()), count_columns(perf_counters_header()));
+}
+
+TEST(PerfCounters, UnavailableCountersAreEmptyColumns) {
+  PerfCounterValues values;
+  values.measured = true;
+  values.available[PerfCounterValues::CYCLES] = true;
+  values.values[PerfCounterValues::CYCLES] = 200;
+  values.available[PerfCounterValues::INSTRUCTIONS] = true;
+  values.values[PerfCounterValues::INSTRUCTIONS] = 300;
+  stringstream ss;
+  write_perf_counters(ss, values);
+  EXPECT_EQ(ss.str(), "200,300,1.5,,,");
+  EXPECT_DOUBLE_EQ(values.ipc(), 1.5);
+}
+
+}  // namespace PerfCountersTests
@@ -0,0 +1,91 @@
+#include "gtest/gtest.h"
+#include "../plaintext_cache.h"
+
+using namespace std;
+
+namespace PlaintextCacheTests {
+
+shared_ptr<seal::SEALContext> bfv_context() {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  return seal::SEALContext::Create(parms);
+}
+
+TEST(PlaintextCache, EncodesEachConstantOnce) {
+  PlaintextCache cache(bfv_context());
+  const seal::Plaintext &first = cache.batch(vector<uint64_t>{1, 2, 3});
+  const seal::Plaintext &second = cache.batch(vector<uint64_t>{1, 2, 3});
+  EXPECT_EQ(&first, &second);
+  cache.batch(vector<uint64_t>{1, 2, 4});
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 2);
+}
+
+TEST(PlaintextCache, DistinguishesEncodings) {
+  auto context = bfv_context();
+  PlaintextCache cache(context);
+  const seal::Plaintext &normal = cache.batch(vector<uint64_t>{1, 2, 3});
+  const seal::Plaintext &ntt =
+      cache.batch_ntt(vector<uint64_t>{1, 2, 3}, context->first_parms_id());
+  EXPECT_NE(&normal, &ntt);
+  EXPECT_FALSE(normal.is_ntt_form());
+  EXPECT_TRUE(ntt.is_ntt_form());
+  EXPECT_EQ(ntt.parms_id(), context->first_parms_id());
+  // same words, but signed values are a different entry
+  cache.batch(vector<int64_t>{1, 2, 3});
+  EXPECT_EQ(cache.hits(), 0);
+  EXPECT_EQ(cache.misses(), 3);
+}
+
+TEST(PlaintextCache, ConstantMatchesBatchOfEqualValues) {
+  auto context = bfv_context();
+  PlaintextCache cache(context);
+  seal::BatchEncoder encoder(context);
+  for (int64_t value : {5, -3, 0}) {
+    const seal::Plaintext &constant = cache.constant(value);
+    EXPECT_EQ(constant.coeff_count(), 1);
+    vector<int64_t> decoded;
+    encoder.decode(constant, decoded);
+    EXPECT_EQ(decoded, vector<int64_t>(encoder.slot_count(), value));
+  }
+  cache.constant(5);
+  EXPECT_EQ(cache.hits(), 1);
+  EXPECT_EQ(cache.misses(), 3);
+}
+
+TEST(PlaintextCache, NttMultiplicationMatchesNormalForm) {
+  auto context = bfv_context();
+  PlaintextCache cache(context);
+  seal::KeyGenerator keygen(context);
+  seal::Encryptor encryptor(context, keygen.secret_key());
+  seal::Decryptor decryptor(context, keygen.secret_key());
+  seal::Evaluator evaluator(context);
+  seal::BatchEncoder encoder(context);
+
+  seal::Plaintext input;
+  encoder.encode(vector<int64_t>{1, 2, 3, 4}, input);
+  seal::Ciphertext ctxt;
+  encryptor.encrypt_symmetric(input, ctxt);
+
+  const vector<int64_t> weights = {5, -1, 0, 2};
+  seal::Ciphertext expected, result;
+  evaluator.multiply_plain(ctxt, cache.batch(weights), expected);
+  seal::Ciphertext ctxt_ntt = to_ntt(evaluator, ctxt);
+  multiply_plain_ntt(evaluator, ctxt_ntt,
+                     cache.batch_ntt(weights, ctxt_ntt.parms_id()), result);
+  EXPECT_FALSE(result.is_ntt_form());
+
+  seal::Plaintext expected_ptxt, result_ptxt;
+  decryptor.decrypt(expected, expected_ptxt);
+  decryptor.decrypt(result, result_ptxt);
+  vector<int64_t> expected_values, result_values;
+  encoder.decode(expected_ptxt, expected_values);
+  encoder.decode(result_ptxt, result_values);
+  EXPECT_EQ(result_values, expected_values);
+  EXPECT_EQ(vector<int64_t>(result_values.begin(), result_values.begin() + 4),
+            vector<int64_t>({5, -2, 0, 8}));
+}
+
+}  // namespace PlaintextCacheTests
@@ -0,0 +1,44 @@
+#include "gtest/gtest.h"
+#include "result_record.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace ResultRecordTests {
+
+TEST(ResultRecord, EscapesStrings) {
+  EXPECT_EQ(to_json_value("a\"b\\c\nd"), "\"a\\\"b\\\\c\\nd\"");
+  EXPECT_EQ(to_json_value(string("\x01")), "\"\\u0001\"");
+}
+
+TEST(ResultRecord, SerializesValues) {
+  EXPECT_EQ(to_json_value(true), "true");
+  EXPECT_EQ(to_json_value(16384), "16384");
+  EXPECT_EQ(to_json_value(0.5), "0.5");
+  EXPECT_EQ(to_json_value(numeric_limits<double>::quiet_NaN()), "null");
+  EXPECT_EQ(to_json_value(vector<int>{60, 40, 60}), "[60,40,60]");
+}
+
+TEST(ResultRecord, KeepsInsertionOrderAndOverwrites) {
+  JsonObject object;
+  object.set("b", 1);
+  object.set("a", "x");
+  object.set("b", 2);
+  EXPECT_EQ(object.str(), "{\"b\":2,\"a\":\"x\"}");
+}
+
+TEST(ResultRecord, ContainsParametersAndTimings) {
+  ResultRecord record("cardio");
+  record.set_parameter("poly_modulus_degree", 16384);
+  record.add_timing("t_keygen", chrono::microseconds(1500));
+  const string json = record.to_json();
+  EXPECT_EQ(json.find("{\"benchmark\":\"cardio\","), 0);
+  EXPECT_NE(json.find("\"parameters\":{\"poly_modulus_degree\":16384}"),
+            string::npos);
+  EXPECT_NE(json.find("\"timings_ms\":{\"t_keygen\":1.5}"), string::npos);
+  EXPECT_EQ(json.find("\"metrics\""), string::npos);
+  EXPECT_EQ(json.find('\n'), string::npos);
+}
+
+}  // namespace ResultRecordTests
@@ -0,0 +1,80 @@
+#include "gtest/gtest.h"
+#include "../sign_approx.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace SignApproxTests {
+
+double eval_odd(const vector<double> &coeffs, double x) {
+  double result = 0;
+  for (size_t k = 0; k < coeffs.size(); ++k) {
+    result += coeffs[k] * pow(x, 2 * k + 1);
+  }
+  return result;
+}
+
+TEST(SignApproxConfig, ParsesSteps) {
+  SignApproxConfig config = SignApproxConfig::parse("3:2");
+  EXPECT_EQ(config.g_steps, 3);
+  EXPECT_EQ(config.f_steps, 2);
+  EXPECT_EQ(config.depth(), 15);
+  EXPECT_EQ(config.to_string(), "3:2");
+  EXPECT_THROW(SignApproxConfig::parse("3"), invalid_argument);
+  EXPECT_THROW(SignApproxConfig::parse("0:0"), invalid_argument);
+}
+
+TEST(SignApproxConfig, DefaultResolvesEightBitDifferences) {
+  // (c - b - 0.5) / 2^8 for integers c, b in [0, 255]
+  SignApproxConfig config;
+  for (int d = -255; d <= 256; ++d) {
+    double x = (d - 0.5) / 256;
+    for (int i = 0; i < config.g_steps; ++i) x = eval_odd(SignApprox::g3(), x);
+    for (int i = 0; i < config.f_steps; ++i) x = eval_odd(SignApprox::f3(), x);
+    EXPECT_NEAR(x, d > 0 ? 1.0 : -1.0, 0.025);
+  }
+}
+
+TEST(SignApprox, EvaluatesCompositePolynomial) {
+  seal::EncryptionParameters parms(seal::scheme_type::CKKS);
+  parms.set_poly_modulus_degree(16384);
+  parms.set_coeff_modulus(seal::CoeffModulus::Create(
+      16384, {60, 40, 40, 40, 40, 40, 40, 60}));
+  auto context = seal::SEALContext::Create(parms);
+  seal::KeyGenerator keygen(context);
+  seal::RelinKeys relin_keys = keygen.relin_keys_local();
+  seal::Encryptor encryptor(context, keygen.secret_key());
+  seal::Decryptor decryptor(context, keygen.secret_key());
+  seal::Evaluator evaluator(context);
+  seal::CKKSEncoder encoder(context);
+  LazyEvaluator lazy(evaluator, relin_keys);
+  PlaintextCache cache(context);
+
+  const double scale = pow(2.0, 40);
+  const vector<double> values = {0.3, -0.6, 0.05, -1.0};
+  seal::Plaintext ptxt;
+  encoder.encode(values, scale, ptxt);
+  seal::Ciphertext ctxt;
+  encryptor.encrypt_symmetric(ptxt, ctxt);
+
+  SignApproxConfig config = SignApproxConfig::parse("1:1");
+  SignApprox sign(context, evaluator, lazy, cache, scale, config);
+  sign.sign_inplace(ctxt, 0.5);
+  EXPECT_EQ(sign.level(ctxt), 0);
+  EXPECT_EQ(lazy.multiplications(), 12);
+
+  decryptor.decrypt(ctxt, ptxt);
+  vector<double> decoded;
+  encoder.decode(ptxt, decoded);
+  for (size_t i = 0; i < values.size(); ++i) {
+    double expected = eval_odd(SignApprox::f3(),
+                               eval_odd(SignApprox::g3(), values[i]));
+    EXPECT_NEAR(decoded[i], 0.5 * expected, 1e-3);
+  }
+
+  // no levels left for another step
+  EXPECT_THROW(sign.sign_inplace(ctxt), invalid_argument);
+}
+
+}  // namespace SignApproxTests
@@ -0,0 +1,45 @@
+#include "gtest/gtest.h"
+#include "../sweep.h"
+
+using namespace std;
+
+namespace SweepTests {
+
+TEST(ParameterGrid, ParsesCoeffModuli) {
+  const auto chains = parse_coeff_moduli("default,60:40:60,30");
+  ASSERT_EQ(chains.size(), 3);
+  EXPECT_TRUE(chains[0].empty());
+  EXPECT_EQ(chains[1], vector<int>({60, 40, 60}));
+  EXPECT_EQ(chains[2], vector<int>({30}));
+}
+
+TEST(ParameterGrid, CartesianProduct) {
+  unsetenv("SWEEP_POLY_MODULUS_DEGREES");
+  unsetenv("SWEEP_COEFF_MODULI");
+  unsetenv("SWEEP_PLAIN_MODULUS_BITS");
+  const auto grid = parameter_grid({4096, 8192}, {{}, {60, 60}}, {20, 30, 40});
+  ASSERT_EQ(grid.size(), 12);
+  EXPECT_EQ(grid.front().poly_modulus_degree, 4096);
+  EXPECT_TRUE(grid.front().coeff_modulus_bits.empty());
+  EXPECT_EQ(grid.front().plain_modulus_bits, 20);
+  EXPECT_EQ(grid.back().poly_modulus_degree, 8192);
+  EXPECT_EQ(grid.back().coeff_modulus_bits, vector<int>({60, 60}));
+  EXPECT_EQ(grid.back().plain_modulus_bits, 40);
+}
+
+TEST(ParameterGrid, EnvironmentOverrides) {
+  setenv("SWEEP_POLY_MODULUS_DEGREES", "32768", 1);
+  setenv("SWEEP_COEFF_MODULI", "60:60:60:60", 1);
+  unsetenv("SWEEP_PLAIN_MODULUS_BITS");
+  // CKKS passes no plaintext moduli, which yields a single 0 entry
+  const auto grid = parameter_grid({4096, 8192}, {{}}, {});
+  unsetenv("SWEEP_POLY_MODULUS_DEGREES");
+  unsetenv("SWEEP_COEFF_MODULI");
+
+  ASSERT_EQ(grid.size(), 1);
+  EXPECT_EQ(grid[0].poly_modulus_degree, 32768);
+  EXPECT_EQ(grid[0].coeff_modulus_bits, vector<int>({60, 60, 60, 60}));
+  EXPECT_EQ(grid[0].plain_modulus_bits, 0);
+}
+
+}  // namespace SweepTests
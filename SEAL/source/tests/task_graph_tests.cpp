@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+#include "../task_graph.h"
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+
+using namespace std;
+
+namespace TaskGraphTests {
+
+TEST(TaskGraph, RunsTasksAfterTheirDependencies) {
+  TaskGraph graph;
+  vector<int> values(7, 0);
+  // (0 + 1) + (2 + 3), each leaf sets its value to 1
+  vector<TaskGraph::TaskId> leaves;
+  for (int i = 0; i < 4; ++i) {
+    leaves.push_back(graph.add([&, i]() { values[i] = 1; }));
+  }
+  auto left = graph.add([&]() { values[4] = values[0] + values[1]; },
+                        {leaves[0], leaves[1]});
+  auto right = graph.add([&]() { values[5] = values[2] + values[3]; },
+                         {leaves[2], leaves[3]});
+  graph.add([&]() { values[6] = values[4] + values[5]; }, {left, right});
+
+  graph.run(4);
+  EXPECT_EQ(values[6], 4);
+}
+
+TEST(TaskGraph, RunsEachTaskOnce) {
+  TaskGraph graph;
+  atomic<size_t> runs{0};
+  for (int i = 0; i < 100; ++i) graph.add([&]() { runs++; });
+  graph.run(8);
+  EXPECT_EQ(graph.size(), 100);
+  EXPECT_EQ(runs, 100);
+}
+
+TEST(TaskGraph, PropagatesTaskErrors) {
+  TaskGraph graph;
+  bool dependent_ran = false;
+  auto failing = graph.add([]() { throw runtime_error("task"); });
+  graph.add([&]() { dependent_ran = true; }, {failing});
+  EXPECT_THROW(graph.run(2), runtime_error);
+  EXPECT_FALSE(dependent_ran);
+}
+
+TEST(TaskGraph, AllocatesFromWorkerPools) {
+  TaskGraph graph;
+  atomic<size_t> worker_pools{0};
+  for (int i = 0; i < 16; ++i) {
+    graph.add([&]() {
+      if (seal::MemoryManager::GetPool() != seal::MemoryPoolHandle::Global()) {
+        worker_pools++;
+      }
+    });
+  }
+  graph.run(4);
+  EXPECT_EQ(worker_pools, 16);
+  EXPECT_TRUE(seal::MemoryManager::GetPool() ==
+              seal::MemoryPoolHandle::Global());
+}
+
+TEST(TaskGraph, CountsIntoCallerCounters) {
+  AllocationCounters counters;
+  TaskGraph graph;
+  atomic<size_t> counted{0};
+  for (int i = 0; i < 8; ++i) {
+    graph.add([&]() {
+      if (AllocationCountingScope::current() == &counters) counted++;
+    });
+  }
+  {
+    AllocationCountingScope counting(&counters);
+    graph.run(4);
+  }
+  EXPECT_EQ(counted, 8);
+  EXPECT_EQ(AllocationCountingScope::current(), nullptr);
+}
+
+TEST(TaskGraph, IdleWorkersWait) {
+  // a chain keeps one worker busy, the other seven have nothing to do
+  TaskGraph graph;
+  TaskGraph::TaskId previous = graph.add([]() {});
+  for (int i = 0; i < 20; ++i) {
+    previous = graph.add(
+        []() { this_thread::sleep_for(chrono::milliseconds(5)); }, {previous});
+  }
+  for (int i = 0; i < 7; ++i) graph.add([]() {});
+
+  const clock_t cpu_start = clock();
+  const auto start = chrono::steady_clock::now();
+  graph.run(8);
+  const double cpu_seconds = double(clock() - cpu_start) / CLOCKS_PER_SEC;
+  const double seconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  // spinning workers would take a CPU second per second and core (up to 8)
+  EXPECT_LT(cpu_seconds, seconds / 2);
+}
+
+TEST(TaskGraph, RejectsUnknownDependencies) {
+  TaskGraph graph;
+  EXPECT_THROW(graph.add([]() {}, {0}), invalid_argument);
+}
+
+}  // namespace TaskGraphTests
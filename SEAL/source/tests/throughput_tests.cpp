@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+#include "../throughput.h"
+
+#include <atomic>
+
+using namespace std;
+
+namespace ThroughputTests {
+
+TEST(Throughput, CountsOperationsOfAllThreads) {
+  atomic<size_t> workers{0};
+  atomic<size_t> ops{0};
+  const auto result = measure_throughput(3, 0.05, [&](size_t) {
+    workers++;
+    return [&]() { ops++; };
+  });
+
+  EXPECT_EQ(workers, 3);
+  EXPECT_EQ(result.threads, 3);
+  EXPECT_EQ(result.operations, ops);
+  EXPECT_GT(result.operations, 0);
+  EXPECT_GE(result.seconds, 0.05);
+  EXPECT_DOUBLE_EQ(result.ops_per_second, result.operations / result.seconds);
+}
+
+TEST(Throughput, PropagatesWorkerErrors) {
+  EXPECT_THROW(measure_throughput(2, 0.01,
+                                  [](size_t i) -> function<void()> {
+                                    if (i == 1) throw runtime_error("setup");
+                                    return []() {};
+                                  }),
+               runtime_error);
+}
+
+TEST(Throughput, ScalingEfficiency) {
+  ThroughputResult single;
+  single.threads = 1;
+  single.ops_per_second = 100;
+  ThroughputResult quad;
+  quad.threads = 4;
+  quad.ops_per_second = 300;
+  EXPECT_DOUBLE_EQ(scaling_efficiency(single, single), 1.0);
+  EXPECT_DOUBLE_EQ(scaling_efficiency(quad, single), 0.75);
+}
+
+}  // namespace ThroughputTests
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "../tiling.h"
+
+using namespace std;
+
+namespace TilingTests {
+
+TEST(Tiling, CoversEveryPixelOnce) {
+  // 10x10 tiles incl. a halo of 1, i.e., 8x8 cores
+  TileGrid grid(20, 13, 100, 1);
+  EXPECT_EQ(grid.layout_width(), 10);
+  EXPECT_EQ(grid.layout_height(), 10);
+  EXPECT_EQ(grid.tiles().size(), 6);
+
+  vector<int> covered(20 * 13, 0);
+  for (auto &tile : grid.tiles()) {
+    for (size_t y = tile.y; y < tile.y + tile.height; ++y) {
+      for (size_t x = tile.x; x < tile.x + tile.width; ++x) {
+        covered[y * 20 + x]++;
+      }
+    }
+  }
+  EXPECT_EQ(covered, vector<int>(20 * 13, 1));
+
+  EXPECT_THROW(TileGrid(20, 13, 4, 1), invalid_argument);
+}
+
+TEST(Tiling, ShrinksTilesToSmallImages) {
+  TileGrid grid(5, 3, 8192, 2);
+  ASSERT_EQ(grid.tiles().size(), 1);
+  EXPECT_EQ(grid.layout_width(), 9);
+  EXPECT_EQ(grid.layout_height(), 7);
+}
+
+TEST(Tiling, ExtractsHaloAndStitchesCore) {
+  TileGrid grid(6, 6, 25, 1);
+  vector<int64_t> image(36);
+  for (size_t i = 0; i < image.size(); ++i) image[i] = i + 1;
+
+  // the second tile has its core at (3, 0), its halo above is outside
+  const Tile &tile = grid.tiles()[1];
+  EXPECT_EQ(tile.x, 3);
+  EXPECT_EQ(tile.y, 0);
+  const vector<int64_t> pixels = grid.extract(image, tile);
+  EXPECT_EQ(pixels, vector<int64_t>({0, 0, 0, 0, 0,       //
+                                     3, 4, 5, 6, 0,       //
+                                     9, 10, 11, 12, 0,    //
+                                     15, 16, 17, 18, 0,   //
+                                     21, 22, 23, 24, 0}));
+
+  // only the core of the tile that is interior to the image is convolved
+  const vector<int64_t> mask = grid.interior_mask(tile, 32);
+  vector<int64_t> expected(32, 0);
+  expected[11] = expected[12] = expected[16] = expected[17] = 1;
+  EXPECT_EQ(mask, expected);
+
+  vector<int64_t> stitched(36, 0);
+  for (auto &t : grid.tiles()) grid.stitch(grid.extract(image, t), t, stitched);
+  EXPECT_EQ(stitched, image);
+}
+
+TEST(Tiling, ConvolvesEncryptedTiles) {
+  seal::EncryptionParameters parms(seal::scheme_type::BFV);
+  parms.set_poly_modulus_degree(4096);
+  parms.set_coeff_modulus(seal::CoeffModulus::BFVDefault(4096));
+  parms.set_plain_modulus(seal::PlainModulus::Batching(4096, 20));
+  auto context = seal::SEALContext::Create(parms);
+  seal::BatchEncoder encoder(context);
+  seal::Evaluator evaluator(context);
+
+  // 100 pixel tiles, i.e., 12 tiles for a 25x20 image
+  const size_t width = 25, height = 20;
+  const ConvolutionKernel kernel = {{-1, -1, -1}, {-1, 10, -1}, {-1, -1, -1}};
+  TileGrid grid(width, height, 100, kernel_radius(kernel));
+  seal::KeyGenerator keygen(context);
+  seal::GaloisKeys galois_keys = keygen.galois_keys_local(
+      ConvolutionEngine::galois_steps({kernel}, grid.layout_width()));
+  seal::Encryptor encryptor(context, keygen.public_key());
+  seal::Decryptor decryptor(context, keygen.secret_key());
+
+  vector<int64_t> image(width * height);
+  for (size_t i = 0; i < image.size(); ++i) image[i] = (i * 7) % 31;
+  vector<seal::Ciphertext> tiles(grid.tiles().size());
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    seal::Plaintext plain;
+    encoder.encode(grid.extract(image, grid.tiles()[i]), plain);
+    encryptor.encrypt(plain, tiles[i]);
+  }
+
+  TiledConvolution result = convolve_tiles(
+      context, evaluator, galois_keys, encoder.slot_count(), grid, tiles,
+      kernel, 4);
+  // the 1 pixel wide tiles of the last column hold border pixels only
+  EXPECT_EQ(result.rotations, 8 * (tiles.size() - 3));
+
+  vector<int64_t> stitched(image.size(), 0);
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    seal::Plaintext plain;
+    decryptor.decrypt(result.tiles[i], plain);
+    vector<int64_t> decoded;
+    encoder.decode(plain, decoded);
+    grid.stitch(decoded, grid.tiles()[i], stitched);
+  }
+  EXPECT_EQ(stitched, convolve_plain(image, width, height, kernel));
+}
+
+}  // namespace TilingTests
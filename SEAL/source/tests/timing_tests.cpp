@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "../timing.h"
+
+using namespace std;
+
+namespace TimingTests {
+
+TEST(Statistics, Empty) {
+  const auto stats = compute_timing_stats({});
+  EXPECT_EQ(stats.repetitions, 0);
+  EXPECT_EQ(stats.mean_ns, 0);
+  EXPECT_EQ(stats.rse, 0);
+}
+
+TEST(Statistics, Percentiles) {
+  // 1..100 in reverse order to make sure samples are sorted internally
+  vector<double> samples;
+  for (int i = 100; i >= 1; --i) samples.push_back(i);
+  const auto stats = compute_timing_stats(samples);
+
+  EXPECT_EQ(stats.repetitions, 100);
+  EXPECT_DOUBLE_EQ(stats.min_ns, 1);
+  EXPECT_DOUBLE_EQ(stats.max_ns, 100);
+  EXPECT_DOUBLE_EQ(stats.mean_ns, 50.5);
+  EXPECT_DOUBLE_EQ(stats.median_ns, 50.5);
+  EXPECT_DOUBLE_EQ(stats.p90_ns, 90.1);
+  EXPECT_DOUBLE_EQ(stats.p99_ns, 99.01);
+  EXPECT_NEAR(stats.stddev_ns, 29.011, 1e-3);
+  EXPECT_NEAR(stats.rse, 29.011 / 10 / 50.5, 1e-5);
+  EXPECT_EQ(stats.outliers_low, 0);
+  EXPECT_EQ(stats.outliers_high, 0);
+}
+
+TEST(Statistics, Outliers) {
+  vector<double> samples(20, 1000);
+  samples[3] = 10;
+  samples[7] = 50000;
+  samples[8] = 60000;
+  const auto stats = compute_timing_stats(samples);
+
+  EXPECT_EQ(stats.outliers_low, 1);
+  EXPECT_EQ(stats.outliers_high, 2);
+  EXPECT_DOUBLE_EQ(stats.median_ns, 1000);
+}
+
+TEST(Measure, RespectsRepetitionBounds) {
+  TimingConfig config;
+  config.warmup_iterations = 3;
+  config.min_repetitions = 7;
+  config.max_repetitions = 7;
+  config.target_rse = 0;
+
+  int setups = 0, ops = 0;
+  const auto stats =
+      measure(config, [&]() { setups++; }, [&]() { ops++; });
+
+  EXPECT_EQ(stats.repetitions, 7);
+  EXPECT_EQ(setups, 10);
+  EXPECT_EQ(ops, 10);
+}
+
+TEST(Measure, StopsAtTargetRse) {
+  TimingConfig config;
+  config.warmup_iterations = 0;
+  config.min_repetitions = 5;
+  config.max_repetitions = 100000;
+  // any sample set satisfies this target, so we stop at min_repetitions
+  config.target_rse = 1e9;
+
+  const auto stats = measure(config, []() {});
+  EXPECT_EQ(stats.repetitions, 5);
+}
+
+}  // namespace TimingTests
@@ -0,0 +1,41 @@
+#include "gtest/gtest.h"
+#include "../vector_view.h"
+
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace VectorViewTests {
+
+TEST(VectorViewTest, SlicesReferToTheVector) {
+  vector<int> values = {1, 2, 3, 4, 5, 6, 7, 8};
+  VectorView<int> view(values);
+  VectorView<int> low = view.slice(0, 4);
+  VectorView<int> high = view.slice(4);
+  EXPECT_EQ(low.size(), 4);
+  EXPECT_EQ(high.size(), 4);
+  EXPECT_EQ(high[0], 5);
+  EXPECT_TRUE(high.begin() == values.data() + 4);
+
+  // elements are mutable through a view
+  high.slice(2)[0] = 42;
+  EXPECT_EQ(values[6], 42);
+}
+
+TEST(VectorViewTest, CopiesOnlyOnRequest) {
+  vector<int> values = {1, 2, 3};
+  VectorView<int> view(values);
+  vector<int> copy = view.slice(1).to_vector();
+  copy[0] = 0;
+  EXPECT_EQ(values[1], 2);
+  EXPECT_EQ(copy.size(), 2);
+  EXPECT_TRUE(view.slice(3).empty());
+}
+
+TEST(VectorViewTest, RejectsTemporaries) {
+  EXPECT_TRUE((is_constructible<VectorView<int>, vector<int> &>::value));
+  EXPECT_FALSE((is_constructible<VectorView<int>, vector<int> &&>::value));
+}
+
+}  // namespace VectorViewTests
@@ -0,0 +1,154 @@
+#ifndef THROUGHPUT_H_
+#define THROUGHPUT_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Multi-threaded throughput measurement of single operations.
+ *
+ * measure_throughput() starts K worker threads, lets each of them prepare its
+ * own inputs, releases all of them at once, and counts how many operations
+ * they complete within a fixed wall-clock window. Comparing the throughput
+ * for K threads with K times the single-thread throughput (scaling
+ * efficiency) shows where shared resources, e.g., memory bandwidth or a shared
+ * memory pool, prevent an operation from scaling.
+ */
+
+/// Configuration of the throughput mode.
+struct ThroughputConfig {
+  /// wall-clock duration of the measurement window per thread count
+  double seconds = 2.0;
+
+  /// largest number of worker threads, the mode runs K = 1..max_threads
+  std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  /// Reads overrides from the environment (THROUGHPUT_SECONDS,
+  /// THROUGHPUT_MAX_THREADS).
+  static ThroughputConfig from_env() {
+    ThroughputConfig config;
+    if (auto v = std::getenv("THROUGHPUT_SECONDS")) {
+      config.seconds = std::strtod(v, nullptr);
+    }
+    if (auto v = std::getenv("THROUGHPUT_MAX_THREADS")) {
+      config.max_threads = std::max(1ul, std::strtoul(v, nullptr, 10));
+    }
+    return config;
+  }
+};
+
+struct ThroughputResult {
+  std::size_t threads = 0;
+  /// operations completed by all threads together
+  std::size_t operations = 0;
+  double seconds = 0;
+  double ops_per_second = 0;
+};
+
+/// Runs num_threads workers for the given duration. make_worker(thread_index)
+/// is called on each worker thread before the common start signal, so that
+/// inputs (and memory pools) are thread-local and their creation is not timed.
+/// It returns the operation that the thread then executes repeatedly.
+template <typename WorkerFactory>
+ThroughputResult measure_throughput(std::size_t num_threads, double seconds,
+                                    WorkerFactory make_worker) {
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> start{false};
+  std::atomic<bool> stop{false};
+  std::vector<std::size_t> counts(num_threads, 0);
+
+  std::exception_ptr error;
+  std::mutex error_mutex;
+
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&, i]() {
+      try {
+        auto op = make_worker(i);
+        ready++;
+        while (!start.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+        std::size_t count = 0;
+        while (!stop.load(std::memory_order_acquire)) {
+          op();
+          count++;
+        }
+        counts[i] = count;
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) error = std::current_exception();
+        // release the main thread even if the setup failed
+        ready++;
+      }
+    });
+  }
+
+  while (ready.load() < num_threads) std::this_thread::yield();
+  auto t0 = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop.store(true, std::memory_order_release);
+  // operations still in flight are counted, hence we stop the clock only
+  // once all threads have finished them
+  for (auto &t : threads) t.join();
+  auto t1 = std::chrono::steady_clock::now();
+
+  if (error) std::rethrow_exception(error);
+
+  ThroughputResult result;
+  result.threads = num_threads;
+  for (auto c : counts) result.operations += c;
+  result.seconds = std::chrono::duration<double>(t1 - t0).count();
+  result.ops_per_second = result.operations / result.seconds;
+  return result;
+}
+
+/// Inputs and memory pool owned by a single worker thread. All buffers are
+/// allocated from the given pool, which is either SEAL's global pool (shared
+/// by all threads) or a fresh pool created per thread.
+struct WorkerState {
+  explicit WorkerState(seal::MemoryPoolHandle pool)
+      : pool(pool), ctxtA(pool), ctxtB(pool), ctxtC(pool), ptxt(pool) {}
+
+  seal::MemoryPoolHandle pool;
+  seal::Ciphertext ctxtA, ctxtB, ctxtC;
+  seal::Plaintext ptxt;
+};
+
+/// Throughput relative to perfect linear scaling of the single-thread result.
+inline double scaling_efficiency(const ThroughputResult &result,
+                                 const ThroughputResult &single_thread) {
+  if (single_thread.ops_per_second == 0 || result.threads == 0) return 0;
+  return result.ops_per_second /
+         (result.threads * single_thread.ops_per_second);
+}
+
+/// Column names matching write_throughput().
+inline std::string throughput_header() {
+  return "threads,operations,seconds,ops_per_second,efficiency";
+}
+
+inline void write_throughput(std::ostream &os, const ThroughputResult &result,
+                             double efficiency) {
+  auto old_flags = os.flags();
+  auto old_precision = os.precision();
+  os << std::fixed;
+  os.precision(3);
+  os << result.threads << "," << result.operations << "," << result.seconds
+     << "," << result.ops_per_second << "," << efficiency;
+  os.flags(old_flags);
+  os.precision(old_precision);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef TILING_H_
+#define TILING_H_
+
+#include <seal/seal.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "convolution.h"
+#include "plaintext_cache.h"
+#include "task_graph.h"
+
+/*
+ * Convolution of images larger than a ciphertext, e.g., 512x512 medical
+ * images with 8192 slots per batching row.
+ *
+ * A TileGrid splits the image into tiles whose cores cover every pixel
+ * exactly once. Each tile is stored with a halo of kernel-radius pixels of
+ * its neighbors around its core (zeros outside of the image), in a layout of
+ * the same width for all tiles, so that all tiles need the same rotations
+ * (and Galois keys). A tile is convolved on its own: the halo supplies the
+ * neighbors of the core pixels at the tile edge, and its own (wrong) results
+ * are dropped. Stitching copies the core of each result into the output
+ * image, so no pixel is computed twice and no tile depends on another,
+ * which lets convolve_tiles() process the tiles in parallel.
+ */
+
+/// The core of a tile, i.e., the pixels of the image it outputs.
+struct Tile {
+  std::size_t x;
+  std::size_t y;
+  std::size_t width;
+  std::size_t height;
+};
+
+class TileGrid {
+ public:
+  /// Grid of tiles of at most max_tile_pixels pixels each, incl. the halo.
+  TileGrid(std::size_t image_width, std::size_t image_height,
+           std::size_t max_tile_pixels, int halo)
+      : image_width(image_width),
+        image_height(image_height),
+        halo(static_cast<std::size_t>(halo)) {
+    // square tiles, at most as large as the image
+    const std::size_t border = 2 * this->halo;
+    const std::size_t side = static_cast<std::size_t>(
+        std::sqrt(static_cast<double>(max_tile_pixels)));
+    if (side <= border) {
+      throw std::invalid_argument("a tile of " +
+                                  std::to_string(max_tile_pixels) +
+                                  " pixels cannot hold a halo of " +
+                                  std::to_string(halo));
+    }
+    core_width = std::min(image_width, side - border);
+    core_height = std::min(image_height,
+                           max_tile_pixels / (core_width + border) - border);
+    for (std::size_t y = 0; y < image_height; y += core_height) {
+      for (std::size_t x = 0; x < image_width; x += core_width) {
+        grid.push_back({x, y, std::min(core_width, image_width - x),
+                        std::min(core_height, image_height - y)});
+      }
+    }
+  }
+
+  const std::vector<Tile> &tiles() const { return grid; }
+
+  /// Width of a tile incl. halo, i.e., the stride of its rows in the slots.
+  std::size_t layout_width() const { return core_width + 2 * halo; }
+
+  std::size_t layout_height() const { return core_height + 2 * halo; }
+
+  /// Pixels of the tile incl. halo in the layout, zeros outside the image.
+  std::vector<std::int64_t> extract(const std::vector<std::int64_t> &image,
+                                    const Tile &tile) const {
+    std::vector<std::int64_t> pixels(layout_width() * layout_height(), 0);
+    for (std::size_t ly = 0; ly < layout_height(); ++ly) {
+      for (std::size_t lx = 0; lx < layout_width(); ++lx) {
+        long x, y;
+        if (to_image(tile, lx, ly, x, y)) {
+          pixels[ly * layout_width() + lx] = image[y * image_width + x];
+        }
+      }
+    }
+    return pixels;
+  }
+
+  /// 1 on the core pixels of the tile that are interior pixels of the
+  /// image, i.e., those the convolution changes, else 0.
+  std::vector<std::int64_t> interior_mask(const Tile &tile,
+                                          std::size_t slot_count) const {
+    std::vector<std::int64_t> mask(slot_count, 0);
+    const long w = static_cast<long>(image_width);
+    const long h = static_cast<long>(image_height);
+    const long r = static_cast<long>(halo);
+    for (std::size_t ly = halo; ly < halo + tile.height; ++ly) {
+      for (std::size_t lx = halo; lx < halo + tile.width; ++lx) {
+        long x, y;
+        to_image(tile, lx, ly, x, y);
+        mask[ly * layout_width() + lx] =
+            x >= r && y >= r && x + r < w && y + r < h;
+      }
+    }
+    return mask;
+  }
+
+  /// Copies the core of the tile's result (in the layout) into the image.
+  void stitch(const std::vector<std::int64_t> &result, const Tile &tile,
+              std::vector<std::int64_t> &image) const {
+    for (std::size_t y = 0; y < tile.height; ++y) {
+      std::copy_n(result.begin() + (y + halo) * layout_width() + halo,
+                  tile.width,
+                  image.begin() + (tile.y + y) * image_width + tile.x);
+    }
+  }
+
+ private:
+  /// Image coordinates of a layout position, false if outside the image.
+  bool to_image(const Tile &tile, std::size_t lx, std::size_t ly, long &x,
+                long &y) const {
+    x = static_cast<long>(tile.x + lx) - static_cast<long>(halo);
+    y = static_cast<long>(tile.y + ly) - static_cast<long>(halo);
+    return x >= 0 && y >= 0 && x < static_cast<long>(image_width) &&
+           y < static_cast<long>(image_height);
+  }
+
+  std::size_t image_width;
+  std::size_t image_height;
+  std::size_t halo;
+  std::size_t core_width;
+  std::size_t core_height;
+  std::vector<Tile> grid;
+};
+
+/// Encrypted results of convolve_tiles() and the work they took.
+struct TiledConvolution {
+  std::vector<seal::Ciphertext> tiles;
+  std::size_t rotations = 0;
+  std::size_t plain_multiplications = 0;
+};
+
+/// Convolves the encrypted tiles (see TileGrid::extract()) of the grid on
+/// (at most) num_threads threads, with the input pixels kept on the image
+/// border. The kernel weights are encoded once for all tiles; each tile gets
+/// its own engine and plaintext cache (for its interior mask), as neither is
+/// thread-safe.
+inline TiledConvolution convolve_tiles(
+    std::shared_ptr<seal::SEALContext> context, seal::Evaluator &evaluator,
+    const seal::GaloisKeys &galois_keys, std::size_t slot_count,
+    const TileGrid &grid, const std::vector<seal::Ciphertext> &tiles,
+    const ConvolutionKernel &kernel, std::size_t num_threads) {
+  const std::size_t num_tiles = grid.tiles().size();
+  if (tiles.size() != num_tiles) {
+    throw std::invalid_argument("expected " + std::to_string(num_tiles) +
+                                " tiles");
+  }
+  TiledConvolution result;
+  result.tiles.resize(num_tiles);
+  std::vector<std::size_t> rotations(num_tiles);
+  std::vector<std::size_t> plain_multiplications(num_tiles);
+
+  // the tasks only read the encoded weights
+  PlaintextCache weight_cache(context);
+  const std::map<int, seal::Plaintext> weights =
+      ConvolutionEngine::encode_weights({kernel}, weight_cache);
+
+  TaskGraph graph;
+  for (std::size_t i = 0; i < num_tiles; ++i) {
+    graph.add([&, i]() {
+      const std::vector<std::int64_t> interior =
+          grid.interior_mask(grid.tiles()[i], slot_count);
+      if (std::none_of(interior.begin(), interior.end(),
+                       [](std::int64_t m) { return m != 0; })) {
+        // border pixels only, which the convolution keeps (and a zero mask
+        // would make the product transparent)
+        result.tiles[i] = tiles[i];
+        return;
+      }
+      PlaintextCache plaintext_cache(context);
+      ConvolutionEngine engine(evaluator, galois_keys, plaintext_cache,
+                               slot_count, grid.layout_width(),
+                               grid.layout_height());
+      const seal::Plaintext &mask = plaintext_cache.batch(interior);
+      result.tiles[i] =
+          engine.merge(tiles[i], engine.convolve(tiles[i], kernel, weights),
+                       mask);
+      rotations[i] = engine.rotations();
+      plain_multiplications[i] = engine.plain_multiplications();
+    });
+  }
+  graph.run(num_threads);
+
+  for (std::size_t i = 0; i < num_tiles; ++i) {
+    result.rotations += rotations[i];
+    result.plain_multiplications += plain_multiplications[i];
+  }
+  return result;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+#include "perf_counters.h"
+
+/*
+ * Statistically robust timing of single operations.
+ *
+ * measure() runs a number of untimed warm-up iterations and then repeats the
+ * timed operation until the relative standard error (RSE) of the mean drops
+ * below a target value, or a repetition/time budget is exhausted. All samples
+ * are kept at nanosecond resolution so that sub-microsecond operations (e.g.,
+ * add_inplace) do not round to zero.
+ */
+
+typedef std::chrono::steady_clock TimingClock;
+
+/// Configuration of the adaptive repetition loop used by measure().
+struct TimingConfig {
+  /// untimed iterations before sampling starts (warms caches and memory pools)
+  std::size_t warmup_iterations = 5;
+
+  /// minimum number of timed repetitions, also required for a stable RSE
+  std::size_t min_repetitions = 10;
+
+  /// hard upper bound on the number of timed repetitions
+  std::size_t max_repetitions = 1000;
+
+  /// stop once stddev / (sqrt(n) * mean) falls below this value
+  double target_rse = 0.01;
+
+  /// stop once the timed regions of one operation exceed this budget
+  double max_total_seconds = 30.0;
+
+  /// Reads overrides from the environment (TIMING_WARMUP, TIMING_MIN_REPS,
+  /// TIMING_MAX_REPS, TIMING_TARGET_RSE, TIMING_MAX_SECONDS).
+  static TimingConfig from_env() {
+    TimingConfig config;
+    if (auto v = std::getenv("TIMING_WARMUP")) {
+      config.warmup_iterations = std::strtoul(v, nullptr, 10);
+    }
+    if (auto v = std::getenv("TIMING_MIN_REPS")) {
+      config.min_repetitions = std::max(2ul, std::strtoul(v, nullptr, 10));
+    }
+    if (auto v = std::getenv("TIMING_MAX_REPS")) {
+      config.max_repetitions = std::strtoul(v, nullptr, 10);
+    }
+    if (auto v = std::getenv("TIMING_TARGET_RSE")) {
+      config.target_rse = std::strtod(v, nullptr);
+    }
+    if (auto v = std::getenv("TIMING_MAX_SECONDS")) {
+      config.max_total_seconds = std::strtod(v, nullptr);
+    }
+    config.max_repetitions =
+        std::max(config.max_repetitions, config.min_repetitions);
+    return config;
+  }
+};
+
+/// Summary statistics of the timed samples of one operation (all in ns).
+struct TimingStats {
+  std::size_t repetitions = 0;
+  double mean_ns = 0;
+  double min_ns = 0;
+  double median_ns = 0;
+  double p90_ns = 0;
+  double p99_ns = 0;
+  double max_ns = 0;
+  double stddev_ns = 0;
+  /// relative standard error of the mean
+  double rse = 0;
+  /// samples outside of Tukey's fences, i.e., [Q1 - 1.5 IQR, Q3 + 1.5 IQR]
+  std::size_t outliers_low = 0;
+  std::size_t outliers_high = 0;
+};
+
+/// Returns the p-th percentile (0 <= p <= 1) of already sorted samples using
+/// linear interpolation between the closest ranks.
+inline double percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0;
+  double rank = p * (sorted.size() - 1);
+  std::size_t lower = static_cast<std::size_t>(std::floor(rank));
+  std::size_t upper = static_cast<std::size_t>(std::ceil(rank));
+  double weight = rank - lower;
+  return sorted[lower] * (1 - weight) + sorted[upper] * weight;
+}
+
+inline TimingStats compute_timing_stats(std::vector<double> samples_ns) {
+  TimingStats stats;
+  stats.repetitions = samples_ns.size();
+  if (samples_ns.empty()) return stats;
+
+  std::sort(samples_ns.begin(), samples_ns.end());
+  const double n = samples_ns.size();
+
+  double sum = 0;
+  for (auto s : samples_ns) sum += s;
+  stats.mean_ns = sum / n;
+
+  double sq_diff = 0;
+  for (auto s : samples_ns) {
+    sq_diff += (s - stats.mean_ns) * (s - stats.mean_ns);
+  }
+  stats.stddev_ns = (n > 1) ? std::sqrt(sq_diff / (n - 1)) : 0;
+  stats.rse =
+      (stats.mean_ns > 0) ? stats.stddev_ns / std::sqrt(n) / stats.mean_ns : 0;
+
+  stats.min_ns = samples_ns.front();
+  stats.max_ns = samples_ns.back();
+  stats.median_ns = percentile(samples_ns, 0.5);
+  stats.p90_ns = percentile(samples_ns, 0.9);
+  stats.p99_ns = percentile(samples_ns, 0.99);
+
+  double q1 = percentile(samples_ns, 0.25);
+  double q3 = percentile(samples_ns, 0.75);
+  double iqr = q3 - q1;
+  for (auto s : samples_ns) {
+    if (s < q1 - 1.5 * iqr) stats.outliers_low++;
+    if (s > q3 + 1.5 * iqr) stats.outliers_high++;
+  }
+  return stats;
+}
+
+/// Times op() repeatedly, calling setup() before each repetition outside of
+/// the timed region (e.g., to encrypt fresh inputs for in-place operations).
+template <typename Setup, typename Operation>
+TimingStats measure(const TimingConfig &config, Setup setup, Operation op) {
+  for (std::size_t i = 0; i < config.warmup_iterations; ++i) {
+    setup();
+    op();
+  }
+
+  std::vector<double> samples;
+  samples.reserve(config.min_repetitions);
+
+  // Welford's online algorithm to decide when to stop sampling
+  double mean = 0, m2 = 0, total = 0;
+  while (samples.size() < config.max_repetitions) {
+    setup();
+    auto start = TimingClock::now();
+    op();
+    auto end = TimingClock::now();
+
+    double sample =
+        std::chrono::duration<double, std::nano>(end - start).count();
+    samples.push_back(sample);
+    total += sample;
+
+    double n = samples.size();
+    double delta = sample - mean;
+    mean += delta / n;
+    m2 += delta * (sample - mean);
+
+    if (samples.size() < config.min_repetitions) continue;
+    double rse =
+        (mean > 0) ? std::sqrt(m2 / (n - 1)) / std::sqrt(n) / mean : 0;
+    if (rse <= config.target_rse || total >= config.max_total_seconds * 1e9) {
+      break;
+    }
+  }
+  return compute_timing_stats(samples);
+}
+
+/// Times op() repeatedly, for operations that do not need per-repetition setup.
+template <typename Operation>
+TimingStats measure(const TimingConfig &config, Operation op) {
+  return measure(config, []() {}, op);
+}
+
+/// Timing (and, if profiled, allocation and counter) results of one
+/// operation.
+struct OperationResult {
+  std::string operation;
+  /// chain index of the input ciphertexts, 0 being the last level
+  std::size_t level = 0;
+  TimingStats timing;
+  MemoryStats memory;
+  PerfCounterValues counters;
+};
+
+/// Results of an op table, in the order the operations were measured.
+typedef std::vector<OperationResult> OperationTimings;
+
+/// Times op() and, if memory profiling is enabled, profiles the allocations
+/// of one additional, untimed run. If hardware counters are enabled, they
+/// are averaged over min_repetitions further runs, so that reading them does
+/// not distort the timing.
+template <typename Setup, typename Operation>
+OperationResult measure_operation(const TimingConfig &config,
+                                  const std::string &operation, Setup setup,
+                                  Operation op) {
+  OperationResult result;
+  result.operation = operation;
+  result.timing = measure(config, setup, op);
+  if (memory_profiling_enabled()) result.memory = measure_memory(setup, op);
+  if (perf_counters_enabled()) {
+    PerfCounters counters;
+    result.counters =
+        measure_counters(counters, config.min_repetitions, setup, op);
+  }
+  return result;
+}
+
+/// Column names matching write_timing_stats().
+inline std::string timing_stats_header() {
+  return "repetitions,mean_ns,min_ns,median_ns,p90_ns,p99_ns,max_ns,"
+         "stddev_ns,rse,outliers_low,outliers_high";
+}
+
+inline void write_timing_stats(std::ostream &os, const TimingStats &stats) {
+  auto old_flags = os.flags();
+  auto old_precision = os.precision();
+  os << std::fixed;
+  os.precision(1);
+  os << stats.repetitions << "," << stats.mean_ns << "," << stats.min_ns << ","
+     << stats.median_ns << "," << stats.p90_ns << "," << stats.p99_ns << ","
+     << stats.max_ns << "," << stats.stddev_ns << ",";
+  os.precision(5);
+  os << stats.rse << "," << stats.outliers_low << "," << stats.outliers_high;
+  os.flags(old_flags);
+  os.precision(old_precision);
+}
+
+/// Opens the CSV file named by the given env var (or the given fallback) in
+/// append mode and writes the header if the file is still empty.
+inline std::ofstream open_csv_file(const char *env_var,
+                                   const std::string &fallback_filename,
+                                   const std::string &header) {
+  auto env_filename = std::getenv(env_var);
+  std::string filename = env_filename ? env_filename : fallback_filename;
+  std::ofstream file(filename, std::ios::out | std::ios::app | std::ios::ate);
+  if (file.tellp() == 0) file << header << std::endl;
+  return file;
+}
+
+/// Opens the statistics file named by the env var STATS_FILENAME.
+inline std::ofstream open_stats_file(const std::string &fallback_filename,
+                                     const std::string &header) {
+  return open_csv_file("STATS_FILENAME", fallback_filename, header);
+}
+
+#endif
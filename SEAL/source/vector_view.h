@@ -0,0 +1,67 @@
+#ifndef VECTOR_VIEW_H_
+#define VECTOR_VIEW_H_
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Non-owning view of a contiguous range of vector elements, e.g., the bits
+ * of an encrypted integer (C++17 has no std::span).
+ *
+ * The recursive circuits (comparison, equality) split their inputs into
+ * halves. With views, the halves refer to the caller's ciphertexts instead of
+ * being deep copies, which are multiple megabytes each. Elements are mutable
+ * through a view, e.g., to relinearize a shared input in place, so circuits
+ * must not modify an input in a way that other parts of the circuit do not
+ * expect (such as switching it to a lower level).
+ *
+ * A view does not extend the lifetime of the viewed vector and must not be
+ * stored beyond it. Views of temporary vectors are not allowed.
+ */
+template <typename T>
+class VectorView {
+ public:
+  VectorView() = default;
+
+  VectorView(T *data, std::size_t size) : first(data), count(size) {}
+
+  VectorView(std::vector<T> &vec) : first(vec.data()), count(vec.size()) {}
+
+  /// A temporary vector would be destroyed at the end of the full-expression
+  /// and leave the view dangling.
+  VectorView(std::vector<T> &&vec) = delete;
+
+  std::size_t size() const { return count; }
+
+  bool empty() const { return count == 0; }
+
+  T &operator[](std::size_t idx) const {
+    assert(idx < count);
+    return first[idx];
+  }
+
+  T *begin() const { return first; }
+
+  T *end() const { return first + count; }
+
+  /// Elements [idx_begin, idx_end).
+  VectorView slice(std::size_t idx_begin, std::size_t idx_end) const {
+    assert(idx_begin <= idx_end && idx_end <= count);
+    return VectorView(first + idx_begin, idx_end - idx_begin);
+  }
+
+  /// Elements [idx_begin, size()).
+  VectorView slice(std::size_t idx_begin) const {
+    return slice(idx_begin, count);
+  }
+
+  /// Deep copy of the elements.
+  std::vector<T> to_vector() const { return std::vector<T>(begin(), end()); }
+
+ private:
+  T *first = nullptr;
+  std::size_t count = 0;
+};
+
+#endif
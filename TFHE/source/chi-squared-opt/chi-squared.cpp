@@ -9,6 +9,9 @@
 #include <functional>
 #include <queue>
 
+#include "../key_store.h"
+#include "result_record.h"
+
 typedef std::chrono::milliseconds ms;
 typedef std::chrono::high_resolution_clock Time;
 
@@ -27,6 +30,11 @@ int and_gates = 0;
 int xor_gates = 0;
 
 std::stringstream ss_time;
+ResultRecord record("tfhe-chi-squared-opt");
+
+// files holding the keys, set by client()
+std::string secret_key_file = "secret.key";
+std::string cloud_key_file = "cloud.key";
 
 void client();
 void cloud();
@@ -51,6 +59,13 @@ int main() {
   myfile.open(out_filename, std::ios_base::app);
   myfile << ss_time.str() << std::endl;
   myfile.close();
+
+  // write a self-describing record into RESULTS_FILENAME
+  record.set_parameter("library", "TFHE");
+  record.set_parameter("minimum_lambda", 100);
+  record.set_metric("and_gates", and_gates);
+  record.set_metric("xor_gates", xor_gates);
+  record.write();
   return 0;
 }
 
@@ -81,23 +96,15 @@ void client() {
   const int minimum_lambda = 100;
   TFheGateBootstrappingParameterSet *params = new_default_gate_bootstrapping_parameters(minimum_lambda);
 
-  //generate a random key
-  uint32_t seed[] = {314, 1592, 657};
-  tfhe_random_generator_setSeed(seed, 3);
-  TFheGateBootstrappingSecretKeySet *key = new_random_gate_bootstrapping_secret_keyset(params);
-
-  //export the secret key to file for later use
-  FILE *secret_key = fopen("secret.key", "wb");
-  export_tfheGateBootstrappingSecretKeySet_toFile(secret_key, key);
-  fclose(secret_key);
-
-  //export the cloud key to a file (for the cloud)
-  FILE *cloud_key = fopen("cloud.key", "wb");
-  export_tfheGateBootstrappingCloudKeySet_toFile(cloud_key, &key->cloud);
-  fclose(cloud_key);
+  //generate a random key, or load it from the key store
+  KeySet keys = KeyStore::from_env().get(params, {314, 1592, 657});
+  TFheGateBootstrappingSecretKeySet *key = keys.key;
+  secret_key_file = keys.secret_key_file;
+  cloud_key_file = keys.cloud_key_file;
 
   auto t1 = Time::now();
-  log_time(ss_time, t0, t1, false);
+  ss_time << KeyStore::keygen_column(keys.loaded, t1 - t0) << ",";
+  record.add_timing(KeyStore::timing_name(keys.loaded), t1 - t0);
 
   auto t2 = Time::now();
   //generate and encrypt the three input values
@@ -144,6 +151,7 @@ void client() {
 
   auto t3 = Time::now();
   log_time(ss_time, t2, t3, false);
+  record.add_timing("t_input_encryption", t3 - t2);
 
 }
 
@@ -332,7 +340,7 @@ void cloud() {
   auto t4 = Time::now();
 
   //reads the cloud key from file
-  FILE *cloud_key = fopen("cloud.key", "rb");
+  FILE *cloud_key = fopen(cloud_key_file.c_str(), "rb");
   TFheGateBootstrappingCloudKeySet *bk = new_tfheGateBootstrappingCloudKeySet_fromFile(cloud_key);
   fclose(cloud_key);
 
@@ -550,6 +558,7 @@ void cloud() {
 
   auto t5 = Time::now();
   log_time(ss_time, t4, t5, false);
+  record.add_timing("t_computation", t5 - t4);
 }
 
 void verify() {
@@ -557,7 +566,7 @@ void verify() {
   auto t6 = Time::now();
 
   //reads the secret key from file
-  FILE *secret_key = fopen("secret.key", "rb");
+  FILE *secret_key = fopen(secret_key_file.c_str(), "rb");
   TFheGateBootstrappingSecretKeySet *key = new_tfheGateBootstrappingSecretKeySet_fromFile(secret_key);
   fclose(secret_key);
 
@@ -604,4 +613,5 @@ void verify() {
 
   auto t7 = Time::now();
   log_time(ss_time, t6, t7, true);
+  record.add_timing("t_decryption", t7 - t6);
 }
@@ -11,6 +11,17 @@ upload_files() {
 EVAL_BUILD_DIR=/root/eval/build
 cd $EVAL_BUILD_DIR || exit
 
+# JSON-lines result records of all application benchmarks
+export RESULTS_FILENAME=${EVAL_BUILD_DIR}/tfhe_results.jsonl
+
+# Keys generated by the first run of a benchmark are stored and loaded by all
+# further runs (optional), the results record t_keygen vs. t_key_load and the
+# CSV files leave t_keygen empty for runs that loaded their keys
+if [ -n "${KEY_STORE}" ]
+then
+    export KEY_STORE_DIR=${EVAL_BUILD_DIR}/keys
+fi
+
 # Cardio Opt
 export OUTPUT_FILENAME=tfhe_cardio_opt.csv
 ./run_cardio_opt.sh
@@ -29,4 +40,6 @@ upload_files TFHE-Naive ${OUTPUT_FILENAME}
 # Chi-Squared Opt
 export OUTPUT_FILENAME=tfhe_chi_squared_opt.csv
 ./run_chi_squared_opt.sh
-upload_files TFHE-Opt ${OUTPUT_FILENAME}
\ No newline at end of file
+upload_files TFHE-Opt ${OUTPUT_FILENAME}
+
+upload_files TFHE ${RESULTS_FILENAME}
@@ -0,0 +1,158 @@
+#ifndef KEY_STORE_H_
+#define KEY_STORE_H_
+
+#include <tfhe/tfhe.h>
+#include <tfhe/tfhe_io.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "key_store_base.h"
+
+/*
+ * On-disk cache of the TFHE keys of a benchmark, so that repeated runs
+ * (NUM_RUNS) load the keys instead of generating them again.
+ *
+ * This is the TFHE counterpart of SEAL's key store (SEAL/source/key_store.h)
+ * and uses the same directory (KEY_STORE_DIR). Keys are stored per
+ * fingerprint of the gate bootstrapping parameters and the seed of the key
+ * generation as two files, keys-<fingerprint>.secret.key and
+ * keys-<fingerprint>.cloud.key, in TFHE's own format. TFHE has no API to load
+ * keys from memory, so a warm run reads the secret key with TFHE's import and
+ * the cloud part reads the cached cloud key file instead of a fresh one. The
+ * secret key is written last, so that concurrent runs never see a partial
+ * pair. The directory, the fingerprint hash, and the atomic writes are shared
+ * with the SEAL and EVA key stores (shared/key_store_base.h).
+ *
+ * The store holds secret keys in plain; it is meant for benchmarking only.
+ */
+
+struct KeySet {
+  TFheGateBootstrappingSecretKeySet *key = nullptr;
+
+  /// files holding the secret and the cloud key
+  std::string secret_key_file = "secret.key";
+  std::string cloud_key_file = "cloud.key";
+
+  /// whether the keys were loaded from the store rather than generated
+  bool loaded = false;
+};
+
+class KeyStore : public KeyStoreBase {
+ public:
+  static constexpr std::uint32_t version = 1;
+
+  using KeyStoreBase::KeyStoreBase;
+
+  /// Store in the directory given by the env var, disabled if it is unset.
+  static KeyStore from_env(const char *env_var = "KEY_STORE_DIR") {
+    return KeyStore(directory_from_env(env_var));
+  }
+
+  /// FNV-1a hash of the parameters and the seed of the key generation.
+  static std::uint64_t fingerprint(
+      const TFheGateBootstrappingParameterSet *params,
+      const std::vector<std::uint32_t> &seed) {
+    Fingerprint hash;
+    hash.mix(version);
+    hash.mix(static_cast<std::uint64_t>(params->ks_t));
+    hash.mix(static_cast<std::uint64_t>(params->ks_basebit));
+    hash.mix(static_cast<std::uint64_t>(params->in_out_params->n));
+    hash.mix_double(params->in_out_params->alpha_min);
+    hash.mix_double(params->in_out_params->alpha_max);
+    hash.mix(static_cast<std::uint64_t>(params->tgsw_params->l));
+    hash.mix(static_cast<std::uint64_t>(params->tgsw_params->Bgbit));
+    hash.mix(static_cast<std::uint64_t>(params->tgsw_params->tlwe_params->N));
+    hash.mix(static_cast<std::uint64_t>(params->tgsw_params->tlwe_params->k));
+    hash.mix_double(params->tgsw_params->tlwe_params->alpha_min);
+    hash.mix_double(params->tgsw_params->tlwe_params->alpha_max);
+    hash.mix(seed.size());
+    for (std::uint32_t s : seed) hash.mix(s);
+    return hash.value();
+  }
+
+  /// File holding the given key (secret or cloud) for the parameters.
+  std::string path(const TFheGateBootstrappingParameterSet *params,
+                   const std::vector<std::uint32_t> &seed,
+                   const char *name) const {
+    return key_file(fingerprint(params, seed),
+                    std::string(".") + name + ".key");
+  }
+
+  /// Loads the keys from the store, or generates them from the seed and
+  /// exports them, into the store if it is enabled and into secret.key and
+  /// cloud.key otherwise.
+  KeySet get(const TFheGateBootstrappingParameterSet *params,
+             std::vector<std::uint32_t> seed) const {
+    tfhe_random_generator_setSeed(seed.data(), static_cast<int>(seed.size()));
+    KeySet keys;
+    if (!enabled()) {
+      keys.key = new_random_gate_bootstrapping_secret_keyset(params);
+      export_keys(keys.key, keys.secret_key_file, keys.cloud_key_file);
+      return keys;
+    }
+
+    keys.secret_key_file = path(params, seed, "secret");
+    keys.cloud_key_file = path(params, seed, "cloud");
+    if (load(keys)) return keys;
+
+    keys.key = new_random_gate_bootstrapping_secret_keyset(params);
+    create_directory();
+    write_file(keys.cloud_key_file, [&](const std::string &filename) {
+      export_cloud_key(keys.key, filename);
+    });
+    write_file(keys.secret_key_file, [&](const std::string &filename) {
+      export_secret_key(keys.key, filename);
+    });
+    return keys;
+  }
+
+ private:
+  /// Loads the secret key into keys, false if the store holds no key pair.
+  static bool load(KeySet &keys) {
+    if (access(keys.cloud_key_file.c_str(), R_OK) != 0) return false;
+    FILE *secret_key = fopen(keys.secret_key_file.c_str(), "rb");
+    if (!secret_key) return false;
+    keys.key = new_tfheGateBootstrappingSecretKeySet_fromFile(secret_key);
+    fclose(secret_key);
+    keys.loaded = keys.key != nullptr;
+    return keys.loaded;
+  }
+
+  static void export_keys(const TFheGateBootstrappingSecretKeySet *key,
+                          const std::string &secret_key_file,
+                          const std::string &cloud_key_file) {
+    export_secret_key(key, secret_key_file);
+    export_cloud_key(key, cloud_key_file);
+  }
+
+  //export the secret key to file for later use
+  static void export_secret_key(const TFheGateBootstrappingSecretKeySet *key,
+                                const std::string &filename) {
+    FILE *secret_key = open(filename);
+    export_tfheGateBootstrappingSecretKeySet_toFile(secret_key, key);
+    fclose(secret_key);
+  }
+
+  //export the cloud key to a file (for the cloud)
+  static void export_cloud_key(const TFheGateBootstrappingSecretKeySet *key,
+                               const std::string &filename) {
+    FILE *cloud_key = open(filename);
+    export_tfheGateBootstrappingCloudKeySet_toFile(cloud_key, &key->cloud);
+    fclose(cloud_key);
+  }
+
+  static FILE *open(const std::string &filename) {
+    FILE *file = fopen(filename.c_str(), "wb");
+    if (!file) throw std::runtime_error(filename + ": " + std::strerror(errno));
+    return file;
+  }
+};
+
+#endif
@@ -77,6 +77,7 @@ for TOOLNAME in "$@"; do
     ;;
   esac
 
+  # the image is built from the repository root, so that it can copy shared/
   (cd ../../${tooldir} &&
     echo "Building eval image for ${tooldir} and running benchmark programs ..." &&
     docker run -d -e S3_URL=s3://sok-repository-eval-benchmarks \
@@ -85,5 +86,5 @@ for TOOLNAME in "$@"; do
       -e AWS_SECRET_ACCESS_KEY=${AWS_SECRET_ACCESS_KEY} \
       -e AWS_DEFAULT_REGION=us-east-2 \
       -e NUM_RUNS=1 \
-      -it $(docker build -q .))
+      -it $(docker build -q -f Dockerfile ..))
 done
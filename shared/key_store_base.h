@@ -0,0 +1,124 @@
+#ifndef KEY_STORE_BASE_H_
+#define KEY_STORE_BASE_H_
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/*
+ * The library-independent part of the on-disk key stores of the SEAL, TFHE,
+ * and EVA benchmarks (key_store.h in each of them): the directory
+ * (KEY_STORE_DIR), the fingerprint that names the key files, the t_keygen
+ * column of warm runs, and writing files through a temporary file that is
+ * renamed afterwards, so that concurrent runs never see a partial file.
+ *
+ * Each library's KeyStore derives from KeyStoreBase and adds what is specific
+ * to its keys: what goes into the fingerprint and how keys are generated,
+ * saved, and loaded.
+ *
+ * This header is self-contained (C++11, no library dependencies) and shared
+ * by the SEAL, TFHE, and EVA benchmarks, whose builds add shared/ to the
+ * include path.
+ */
+
+/// Incremental FNV-1a hash of 64-bit values (least significant byte first).
+class Fingerprint {
+ public:
+  void mix(std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      hash ^= (value >> (8 * i)) & 0xff;
+      hash *= 1099511628211ULL;
+    }
+  }
+
+  /// Mixes the bit pattern of the value.
+  void mix_double(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    mix(bits);
+  }
+
+  std::uint64_t value() const { return hash; }
+
+ private:
+  std::uint64_t hash = 14695981039346656037ULL;
+};
+
+class KeyStoreBase {
+ public:
+  /// Store in the given directory, an empty directory disables the store.
+  explicit KeyStoreBase(std::string directory)
+      : directory(std::move(directory)) {}
+
+  bool enabled() const { return !directory.empty(); }
+
+  /// Name of the key setup timing, t_keygen (cold) or t_key_load (warm).
+  static const char *timing_name(bool loaded) {
+    return loaded ? "t_key_load" : "t_keygen";
+  }
+
+  /// Key setup time (ms) for the t_keygen column of the legacy CSV files,
+  /// empty if the keys were loaded. The load time is only recorded as
+  /// t_key_load in the result record, so that the CSV files of cold and warm
+  /// runs do not mix the two.
+  template <typename Duration>
+  static std::string keygen_column(bool loaded, Duration duration) {
+    if (loaded) return "";
+    return std::to_string(
+        std::chrono::duration_cast<std::chrono::milliseconds>(duration)
+            .count());
+  }
+
+ protected:
+  /// The directory given by the env var, empty (disabled) if it is unset.
+  static std::string directory_from_env(const char *env_var) {
+    auto v = std::getenv(env_var);
+    return v ? v : "";
+  }
+
+  /// <directory>/keys-<fingerprint, 16 hex digits><suffix>
+  std::string key_file(std::uint64_t fingerprint,
+                       const std::string &suffix) const {
+    std::stringstream ss;
+    ss << directory << "/keys-" << std::hex << std::setw(16)
+       << std::setfill('0') << fingerprint << suffix;
+    return ss.str();
+  }
+
+  /// Creates the directory of the store unless it exists already.
+  void create_directory() const { mkdir(directory.c_str(), 0755); }
+
+  /// Calls write(tmp_filename) and renames the temporary file to filename.
+  /// The temporary file is removed if writing or renaming fails.
+  template <typename Write>
+  static void write_file(const std::string &filename, Write write) {
+    const std::string tmp_filename =
+        filename + ".tmp" + std::to_string(getpid());
+    try {
+      write(tmp_filename);
+    } catch (...) {
+      std::remove(tmp_filename.c_str());
+      throw;
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+      const std::string error = std::strerror(errno);
+      std::remove(tmp_filename.c_str());
+      throw std::runtime_error(filename + ": " + error);
+    }
+  }
+
+  std::string directory;
+};
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Hardware performance counters (cycles, instructions, L1d/LLC read misses,
+ * branch misses) around timed regions, read through perf_event_open(2).
+ *
+ * Collection is enabled by setting the environment variable PERF_COUNTERS.
+ * Counters that cannot be opened (non-Linux systems, containers without
+ * CAP_PERFMON, perf_event_paranoid > 2, VMs without a PMU, ...) are reported
+ * as empty columns instead of failing the benchmark. Only the calling thread
+ * is counted, so multi-threaded libraries should be run with one thread.
+ *
+ * This header is self-contained (C++11, no library dependencies) and shared
+ * by the SEAL, PALISADE, and HElib benchmarks, whose builds add shared/ to
+ * the include path.
+ */
+
+inline bool perf_counters_enabled() {
+  return std::getenv("PERF_COUNTERS") != nullptr;
+}
+
+/// Mean counter values per timed region.
+struct PerfCounterValues {
+  enum Counter {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    NUM_COUNTERS
+  };
+
+  /// false if collection was disabled, all counters are unavailable then
+  bool measured = false;
+
+  /// number of regions the values are averaged over
+  std::size_t regions = 0;
+
+  bool available[NUM_COUNTERS] = {};
+  double values[NUM_COUNTERS] = {};
+
+  /// Instructions per cycle, 0 if either counter is unavailable.
+  double ipc() const {
+    if (!available[CYCLES] || !available[INSTRUCTIONS] || values[CYCLES] == 0)
+      return 0;
+    return values[INSTRUCTIONS] / values[CYCLES];
+  }
+};
+
+/// Accumulates counter values over any number of start()/stop() regions.
+class PerfCounters {
+ public:
+  /// Opens the counters if collection is enabled.
+  PerfCounters() : enabled(perf_counters_enabled()) {
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      fds[i] = -1;
+      totals[i] = 0;
+    }
+    if (enabled) open_counters();
+  }
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      if (fds[i] != -1) close(fds[i]);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool is_enabled() const { return enabled; }
+
+  void start() {
+#if defined(__linux__)
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      if (fds[i] == -1) continue;
+      ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void stop() {
+#if defined(__linux__)
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      if (fds[i] != -1) ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      if (fds[i] == -1) continue;
+      // value, time enabled, time running (PERF_FORMAT_TOTAL_TIME_*)
+      std::uint64_t data[3] = {0, 0, 0};
+      if (read(fds[i], data, sizeof(data)) != sizeof(data)) continue;
+      // scale up if the counter was multiplexed with other events
+      double value = static_cast<double>(data[0]);
+      if (data[2] > 0 && data[2] < data[1]) {
+        value *= static_cast<double>(data[1]) / data[2];
+      }
+      totals[i] += value;
+    }
+#endif
+    regions++;
+  }
+
+  /// Mean values per region since construction or the last reset().
+  PerfCounterValues mean() const {
+    PerfCounterValues result;
+    result.measured = enabled;
+    result.regions = regions;
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      result.available[i] = fds[i] != -1;
+      result.values[i] = (regions > 0) ? totals[i] / regions : 0;
+    }
+    return result;
+  }
+
+  void reset() {
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) totals[i] = 0;
+    regions = 0;
+  }
+
+ private:
+  void open_counters() {
+#if defined(__linux__)
+    const std::uint32_t types[] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                   PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+                                   PERF_TYPE_HARDWARE};
+    const std::uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const std::uint64_t configs[] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | read_miss,
+        PERF_COUNT_HW_CACHE_LL | read_miss, PERF_COUNT_HW_BRANCH_MISSES};
+
+    // counters are opened individually (not as a group), so that a counter
+    // the PMU does not support does not disable the others
+    bool any_failed = false;
+    for (int i = 0; i < PerfCounterValues::NUM_COUNTERS; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = types[i];
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      // calling thread, any CPU
+      long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      fds[i] = static_cast<int>(fd);
+      if (fd == -1) any_failed = true;
+    }
+    static bool warned = false;
+    if (any_failed && !warned) {
+      warned = true;
+      std::cerr << "Warning: some hardware performance counters are "
+                   "unavailable (check /proc/sys/kernel/perf_event_paranoid),"
+                   " their columns stay empty."
+                << std::endl;
+    }
+#else
+    std::cerr << "Warning: hardware performance counters are only supported "
+                 "on Linux, their columns stay empty."
+              << std::endl;
+#endif
+  }
+
+  bool enabled;
+  int fds[PerfCounterValues::NUM_COUNTERS];
+  double totals[PerfCounterValues::NUM_COUNTERS];
+  std::size_t regions = 0;
+};
+
+/// Runs setup() and op() the given number of times, counting only op().
+template <typename Setup, typename Operation>
+PerfCounterValues measure_counters(PerfCounters &counters,
+                                   std::size_t repetitions, Setup setup,
+                                   Operation op) {
+  counters.reset();
+  for (std::size_t i = 0; i < repetitions; ++i) {
+    setup();
+    counters.start();
+    op();
+    counters.stop();
+  }
+  return counters.mean();
+}
+
+/// Column names matching write_perf_counters().
+inline std::string perf_counters_header() {
+  return "cycles,instructions,ipc,l1d_misses,llc_misses,branch_misses";
+}
+
+/// Writes the mean values, leaving unavailable counters empty.
+inline void write_perf_counters(std::ostream &os,
+                                const PerfCounterValues &values) {
+  typedef PerfCounterValues V;
+  auto write_value = [&](int counter) {
+    if (values.measured && values.available[counter]) {
+      os << static_cast<unsigned long long>(values.values[counter]);
+    }
+  };
+  write_value(V::CYCLES);
+  os << ",";
+  write_value(V::INSTRUCTIONS);
+  os << ",";
+  if (values.ipc() > 0) os << values.ipc();
+  os << ",";
+  write_value(V::L1D_MISSES);
+  os << ",";
+  write_value(V::LLC_MISSES);
+  os << ",";
+  write_value(V::BRANCH_MISSES);
+}
+
+/// Writes "<operation>,<counters>" as one line.
+inline void write_perf_counters_row(std::ostream &os,
+                                    const std::string &operation,
+                                    const PerfCounterValues &values) {
+  os << operation << ",";
+  write_perf_counters(os, values);
+  os << std::endl;
+}
+
+/// Appends rows written by write_perf_counters_row() to the file named by
+/// the env var PERF_FILENAME (or the given fallback), and writes the header
+/// if the file is still empty.
+inline void append_perf_counters_file(const std::string &fallback_filename,
+                                      const std::string &rows) {
+  auto env_filename = std::getenv("PERF_FILENAME");
+  std::string filename = env_filename ? env_filename : fallback_filename;
+  std::ofstream file(filename, std::ios::out | std::ios::app | std::ios::ate);
+  if (file.tellp() == 0) {
+    file << "operation," << perf_counters_header() << std::endl;
+  }
+  file << rows;
+}
+
+#endif
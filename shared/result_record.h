@@ -0,0 +1,258 @@
+#ifndef RESULT_RECORD_H_
+#define RESULT_RECORD_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+ * Self-describing result records, written as one JSON object per line (JSON
+ * Lines) to the file named by the env var RESULTS_FILENAME.
+ *
+ * Besides the phase timings and the encryption parameters of a run, each
+ * record carries the information required to compare runs across machines
+ * and builds: timestamp, host, CPU model, thread count, compiler, compiler
+ * flags, and git revision. The latter two are injected by the build system
+ * (BENCHMARK_CXX_FLAGS, BENCHMARK_GIT_REVISION); if the sources are built
+ * outside of a git checkout (e.g., in Docker), the revision is read from the
+ * env var GIT_REVISION at runtime instead.
+ *
+ * This header is self-contained (C++11, no library dependencies) and shared
+ * by the SEAL, TFHE, and EVA benchmarks, whose builds add shared/ to the
+ * include path.
+ */
+
+#ifndef BENCHMARK_GIT_REVISION
+#define BENCHMARK_GIT_REVISION ""
+#endif
+
+#ifndef BENCHMARK_CXX_FLAGS
+#define BENCHMARK_CXX_FLAGS ""
+#endif
+
+/// Returns the string as a quoted JSON string.
+inline std::string to_json_value(const std::string &value) {
+  std::string result = "\"";
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      case '\t':
+        result += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buffer[8];
+          std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+          result += buffer;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result + "\"";
+}
+
+inline std::string to_json_value(const char *value) {
+  return to_json_value(std::string(value ? value : ""));
+}
+
+inline std::string to_json_value(bool value) {
+  return value ? "true" : "false";
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, std::string>::type
+to_json_value(T value) {
+  return std::to_string(value);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, std::string>::type
+to_json_value(T value) {
+  // JSON has no representation of NaN and infinity
+  if (!std::isfinite(value)) return "null";
+  std::ostringstream ss;
+  ss.precision(17);
+  ss << value;
+  return ss.str();
+}
+
+template <typename T>
+std::string to_json_value(const std::vector<T> &values) {
+  std::string result = "[";
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (i > 0) result += ",";
+    result += to_json_value(values[i]);
+  }
+  return result + "]";
+}
+
+/// Ordered JSON object whose values are already serialized.
+class JsonObject {
+ public:
+  template <typename T>
+  void set(const std::string &key, const T &value) {
+    set_raw(key, to_json_value(value));
+  }
+
+  /// Sets the key to an already serialized JSON value.
+  void set_raw(const std::string &key, const std::string &json) {
+    for (auto &member : members) {
+      if (member.first == key) {
+        member.second = json;
+        return;
+      }
+    }
+    members.push_back(std::make_pair(key, json));
+  }
+
+  bool empty() const { return members.empty(); }
+
+  std::string str() const {
+    std::string result = "{";
+    for (std::size_t i = 0; i < members.size(); ++i) {
+      if (i > 0) result += ",";
+      result += to_json_value(members[i].first) + ":" + members[i].second;
+    }
+    return result + "}";
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>> members;
+};
+
+/// Model name of the first CPU in /proc/cpuinfo, or "unknown".
+inline std::string cpu_model() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (line.compare(0, 10, "model name") != 0) continue;
+    auto pos = line.find(':');
+    if (pos != std::string::npos && pos + 2 <= line.size()) {
+      return line.substr(pos + 2);
+    }
+  }
+  return "unknown";
+}
+
+inline std::string host_name() {
+  char buffer[256] = {};
+  if (gethostname(buffer, sizeof(buffer) - 1) != 0) return "unknown";
+  return buffer;
+}
+
+inline std::string compiler_version() {
+#if defined(__clang__)
+  return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+  return std::string("gcc ") + __VERSION__;
+#else
+  return "unknown";
+#endif
+}
+
+inline std::string git_revision() {
+  std::string revision = BENCHMARK_GIT_REVISION;
+  if (!revision.empty()) return revision;
+  auto env_revision = std::getenv("GIT_REVISION");
+  return env_revision ? env_revision : "unknown";
+}
+
+/// Current time as ISO 8601 in UTC, e.g., 2020-08-01T12:34:56Z.
+inline std::string utc_timestamp() {
+  std::time_t now = std::time(nullptr);
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ",
+                std::gmtime(&now));
+  return buffer;
+}
+
+/// One run of a benchmark. Typical use:
+///
+///   ResultRecord record("cardio-bfv-batched");
+///   record.set_parameter("poly_modulus_degree", 16384);
+///   record.add_timing("t_keygen", t1 - t0);
+///   ...
+///   record.write("results.jsonl");
+class ResultRecord {
+ public:
+  explicit ResultRecord(const std::string &benchmark) : benchmark(benchmark) {
+    auto omp_threads = std::getenv("OMP_NUM_THREADS");
+    threads = omp_threads ? std::strtoul(omp_threads, nullptr, 10) : 1;
+  }
+
+  /// Number of threads the benchmark used (default: OMP_NUM_THREADS or 1).
+  void set_threads(std::size_t num_threads) { threads = num_threads; }
+
+  /// Encryption parameters (or other configuration) of the run.
+  template <typename T>
+  void set_parameter(const std::string &name, const T &value) {
+    parameters.set(name, value);
+  }
+
+  /// Duration of a phase, stored in milliseconds (with fractional part).
+  void add_timing(const std::string &phase,
+                  std::chrono::nanoseconds duration) {
+    timings_ms.set(phase, duration.count() / 1e6);
+  }
+
+  /// Further results of the run, e.g., the number of gates or the error.
+  template <typename T>
+  void set_metric(const std::string &name, const T &value) {
+    metrics.set(name, value);
+  }
+
+  std::string to_json() const {
+    JsonObject record;
+    record.set("benchmark", benchmark);
+    record.set("timestamp", utc_timestamp());
+    record.set("git_revision", git_revision());
+    record.set("host", host_name());
+    record.set("cpu_model", cpu_model());
+    record.set("hardware_threads", std::thread::hardware_concurrency());
+    record.set("threads", threads);
+    record.set("compiler", compiler_version());
+    record.set("compiler_flags", std::string(BENCHMARK_CXX_FLAGS));
+    record.set_raw("parameters", parameters.str());
+    record.set_raw("timings_ms", timings_ms.str());
+    if (!metrics.empty()) record.set_raw("metrics", metrics.str());
+    return record.str();
+  }
+
+  /// Appends the record as one line to the file named by RESULTS_FILENAME
+  /// (or the given fallback).
+  void write(const std::string &fallback_filename = "results.jsonl") const {
+    auto env_filename = std::getenv("RESULTS_FILENAME");
+    std::string filename = env_filename ? env_filename : fallback_filename;
+    std::ofstream file(filename, std::ios::out | std::ios::app);
+    file << to_json() << std::endl;
+  }
+
+ private:
+  std::string benchmark;
+  std::size_t threads;
+  JsonObject parameters;
+  JsonObject timings_ms;
+  JsonObject metrics;
+};
+
+#endif